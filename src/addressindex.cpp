@@ -0,0 +1,34 @@
+// Copyright (c) 2016 The Bitcoin Core developers
+// Copyright (c) 2018 The Blocknet developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "addressindex.h"
+
+#include "hash.h"
+#include "script/standard.h"
+
+bool GetAddressIndexKey(const CScript& script, uint160& hashBytes, int& type)
+{
+    txnouttype whichType;
+    std::vector<std::vector<unsigned char> > vSolutions;
+    if (!Solver(script, whichType, vSolutions))
+        return false;
+
+    switch (whichType) {
+    case TX_PUBKEY:
+        hashBytes = Hash160(vSolutions[0]);
+        type = ADDRESS_PUBKEYHASH;
+        return true;
+    case TX_PUBKEYHASH:
+        hashBytes = uint160(vSolutions[0]);
+        type = ADDRESS_PUBKEYHASH;
+        return true;
+    case TX_SCRIPTHASH:
+        hashBytes = uint160(vSolutions[0]);
+        type = ADDRESS_SCRIPTHASH;
+        return true;
+    default:
+        return false;
+    }
+}
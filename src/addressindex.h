@@ -0,0 +1,221 @@
+// Copyright (c) 2016 The Bitcoin Core developers
+// Copyright (c) 2018 The Blocknet developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_ADDRESSINDEX_H
+#define BITCOIN_ADDRESSINDEX_H
+
+#include "amount.h"
+#include "crypto/common.h"
+#include "script/script.h"
+#include "serialize.h"
+#include "uint256.h"
+
+#include <stdint.h>
+#include <utility>
+
+/** Address types kept in the address index */
+enum AddressIndexType {
+    ADDRESS_NONE = 0,
+    ADDRESS_PUBKEYHASH = 1, //!< pay to pubkey hash, and pay to pubkey outputs under the key's hash
+    ADDRESS_SCRIPTHASH = 2,
+};
+
+/**
+ * Returns the address type and hash an output script pays to, or false for
+ * scripts the address index does not track (multisig, OP_RETURN, non-standard).
+ */
+bool GetAddressIndexKey(const CScript& script, uint160& hashBytes, int& type);
+
+/**
+ * Heights and positions are stored big endian so that leveldb orders the
+ * entries of an address by block height.
+ */
+template <typename Stream>
+inline void SerializeBE32(Stream& s, uint32_t n)
+{
+    unsigned char buf[4];
+    WriteBE32(buf, n);
+    s.write((const char*)buf, sizeof(buf));
+}
+
+template <typename Stream>
+inline uint32_t UnserializeBE32(Stream& s)
+{
+    unsigned char buf[4];
+    s.read((char*)buf, sizeof(buf));
+    return ReadBE32(buf);
+}
+
+/** One output credited to (or spend debited from) an address, keyed for height range scans */
+struct CAddressIndexKey {
+    unsigned char type;
+    uint160 hashBytes;
+    int blockHeight;
+    unsigned int txindex;
+    uint256 txhash;
+    unsigned int index;
+    bool spending;
+
+    CAddressIndexKey() { SetNull(); }
+
+    CAddressIndexKey(int typeIn, const uint160& hashBytesIn, int blockHeightIn, unsigned int txindexIn,
+                     const uint256& txhashIn, unsigned int indexIn, bool spendingIn)
+        : type(typeIn), hashBytes(hashBytesIn), blockHeight(blockHeightIn), txindex(txindexIn),
+          txhash(txhashIn), index(indexIn), spending(spendingIn) {}
+
+    void SetNull()
+    {
+        type = ADDRESS_NONE;
+        hashBytes.SetNull();
+        blockHeight = 0;
+        txindex = 0;
+        txhash.SetNull();
+        index = 0;
+        spending = false;
+    }
+
+    size_t GetSerializeSize(int nType, int nVersion) const
+    {
+        return 1 + 20 + 4 + 4 + 32 + 4 + 1;
+    }
+
+    template <typename Stream>
+    void Serialize(Stream& s, int nType, int nVersion) const
+    {
+        ::Serialize(s, type, nType, nVersion);
+        hashBytes.Serialize(s, nType, nVersion);
+        SerializeBE32(s, blockHeight);
+        SerializeBE32(s, txindex);
+        txhash.Serialize(s, nType, nVersion);
+        ::Serialize(s, index, nType, nVersion);
+        ::Serialize(s, spending, nType, nVersion);
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s, int nType, int nVersion)
+    {
+        ::Unserialize(s, type, nType, nVersion);
+        hashBytes.Unserialize(s, nType, nVersion);
+        blockHeight = UnserializeBE32(s);
+        txindex = UnserializeBE32(s);
+        txhash.Unserialize(s, nType, nVersion);
+        ::Unserialize(s, index, nType, nVersion);
+        ::Unserialize(s, spending, nType, nVersion);
+    }
+};
+
+/** Seek key for the entries of an address, optionally starting at a height */
+struct CAddressIndexIteratorKey {
+    unsigned char type;
+    uint160 hashBytes;
+    bool fHeight;
+    int blockHeight;
+
+    CAddressIndexIteratorKey(int typeIn, const uint160& hashBytesIn)
+        : type(typeIn), hashBytes(hashBytesIn), fHeight(false), blockHeight(0) {}
+    CAddressIndexIteratorKey(int typeIn, const uint160& hashBytesIn, int blockHeightIn)
+        : type(typeIn), hashBytes(hashBytesIn), fHeight(true), blockHeight(blockHeightIn) {}
+
+    size_t GetSerializeSize(int nType, int nVersion) const
+    {
+        return 1 + 20 + (fHeight ? 4 : 0);
+    }
+
+    template <typename Stream>
+    void Serialize(Stream& s, int nType, int nVersion) const
+    {
+        ::Serialize(s, type, nType, nVersion);
+        hashBytes.Serialize(s, nType, nVersion);
+        if (fHeight)
+            SerializeBE32(s, blockHeight);
+    }
+};
+
+/** An unspent output paying to an address */
+struct CAddressUnspentKey {
+    unsigned char type;
+    uint160 hashBytes;
+    uint256 txhash;
+    unsigned int index;
+
+    CAddressUnspentKey() { SetNull(); }
+
+    CAddressUnspentKey(int typeIn, const uint160& hashBytesIn, const uint256& txhashIn, unsigned int indexIn)
+        : type(typeIn), hashBytes(hashBytesIn), txhash(txhashIn), index(indexIn) {}
+
+    void SetNull()
+    {
+        type = ADDRESS_NONE;
+        hashBytes.SetNull();
+        txhash.SetNull();
+        index = 0;
+    }
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
+    {
+        READWRITE(type);
+        READWRITE(hashBytes);
+        READWRITE(txhash);
+        READWRITE(index);
+    }
+};
+
+struct CAddressUnspentValue {
+    CAmount satoshis;
+    CScript script;
+    int blockHeight;
+
+    CAddressUnspentValue() { SetNull(); }
+
+    CAddressUnspentValue(CAmount satoshisIn, const CScript& scriptIn, int blockHeightIn)
+        : satoshis(satoshisIn), script(scriptIn), blockHeight(blockHeightIn) {}
+
+    void SetNull()
+    {
+        satoshis = -1;
+        script.clear();
+        blockHeight = 0;
+    }
+
+    //! A null value erases the output from the index
+    bool IsNull() const { return satoshis == -1; }
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
+    {
+        READWRITE(satoshis);
+        READWRITE(script);
+        READWRITE(blockHeight);
+    }
+};
+
+/** Running totals of an address, and the height of the last block that changed them */
+struct CAddressBalance {
+    CAmount nBalance;
+    CAmount nReceived;
+    int nHeight;
+
+    CAddressBalance() : nBalance(0), nReceived(0), nHeight(-1) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
+    {
+        READWRITE(nBalance);
+        READWRITE(nReceived);
+        READWRITE(nHeight);
+    }
+};
+
+typedef std::pair<CAddressIndexKey, CAmount> CAddressIndexEntry;
+typedef std::pair<CAddressUnspentKey, CAddressUnspentValue> CAddressUnspentEntry;
+
+#endif // BITCOIN_ADDRESSINDEX_H
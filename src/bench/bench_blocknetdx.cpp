@@ -0,0 +1,34 @@
+// Copyright (c) 2015 The Bitcoin Core developers
+// Copyright (c) 2018 The Blocknet developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "chainparams.h"
+#include "crypto/sha256.h"
+#include "pubkey.h"
+#include "random.h"
+#include "util.h"
+
+#include <memory>
+
+int main(int argc, char** argv)
+{
+    ParseParameters(argc, argv);
+
+    SHA256AutoDetect();
+    RandomInit();
+    SetupEnvironment();
+    fPrintToDebugLog = false; // don't want to write to debug.log file
+    SelectParams(CBaseChainParams::MAIN);
+
+    std::unique_ptr<ECCVerifyHandle> verifyHandle(new ECCVerifyHandle());
+
+    // Fixtures draw from insecure_rand, seed it so runs are comparable
+    seed_insecure_rand(true);
+
+    benchmark::BenchRunner::RunAll(GetArg("-time", 1000) / 1000.0, GetArg("-filter", ""));
+
+    return 0;
+}
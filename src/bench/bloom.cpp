@@ -0,0 +1,27 @@
+// Copyright (c) 2018 The Blocknet developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "data.h"
+
+#include "bloom.h"
+
+#include <vector>
+
+// Matching block transactions against an SPV client's filter of 1000 keys
+static void BloomFilterIsRelevant(benchmark::State& state)
+{
+    CBloomFilter filter(1000, 0.0001, 0, BLOOM_UPDATE_ALL);
+    for (int i = 0; i < 1000; i++) {
+        uint256 hash = benchmark::data::RandomHash();
+        filter.insert(std::vector<unsigned char>(hash.begin(), hash.begin() + 20));
+    }
+
+    std::vector<CTransaction> vtx = benchmark::data::MakeBlock(500).vtx;
+    size_t n = 0;
+    while (state.KeepRunning())
+        filter.IsRelevantAndUpdate(vtx[n++ % vtx.size()]);
+}
+
+BENCHMARK(BloomFilterIsRelevant);
@@ -0,0 +1,52 @@
+// Copyright (c) 2018 The Blocknet developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "checkqueue.h"
+
+#include <boost/thread.hpp>
+
+static const int BATCHES = 100;
+static const int BATCH_SIZE = 30;
+static const int WORKERS = 3;
+
+// Check with a small fixed amount of work, so the benchmark is dominated by
+// the queue's locking and hand-off rather than by the checks themselves.
+struct FakeCheck {
+    uint64_t n;
+    FakeCheck() : n(0) {}
+    bool operator()()
+    {
+        for (int i = 0; i < 100; i++)
+            n = n * 6364136223846793005ULL + 1442695040888963407ULL;
+        return n != 0;
+    }
+    void swap(FakeCheck& x) { std::swap(n, x.n); }
+};
+
+// Throughput of a block-sized stream of checks through CCheckQueue
+static void CCheckQueueSpeed(benchmark::State& state)
+{
+    CCheckQueue<FakeCheck> queue(128);
+    boost::thread_group threadGroup;
+    for (int i = 0; i < WORKERS; i++)
+        threadGroup.create_thread(boost::bind(&CCheckQueue<FakeCheck>::Thread, &queue));
+
+    while (state.KeepRunning()) {
+        CCheckQueueControl<FakeCheck> control(&queue);
+        for (int i = 0; i < BATCHES; i++) {
+            std::vector<FakeCheck> vChecks(BATCH_SIZE);
+            for (int j = 0; j < BATCH_SIZE; j++)
+                vChecks[j].n = i * BATCH_SIZE + j + 1;
+            control.Add(vChecks);
+        }
+        control.Wait();
+    }
+
+    threadGroup.interrupt_all();
+    threadGroup.join_all();
+}
+
+BENCHMARK(CCheckQueueSpeed);
@@ -0,0 +1,62 @@
+// Copyright (c) 2018 The Blocknet developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "data.h"
+
+#include "coins.h"
+#include "undo.h"
+
+#include <vector>
+
+static const int NUM_TXS = 1000;
+
+// Fill view with the outputs of NUM_TXS transactions
+static std::vector<CTransaction> SetupCoins(CCoinsViewCache& view)
+{
+    CKey key = benchmark::data::MakeKey(1);
+    std::vector<CTransaction> vtx;
+    for (int i = 0; i < NUM_TXS; i++) {
+        vtx.push_back(benchmark::data::MakeTransaction(key, 1, 1 + i % 20));
+        view.ModifyNewCoins(vtx.back().GetHash())->FromTx(vtx.back(), 100000 + i);
+    }
+    return vtx;
+}
+
+// Lookups of cached outputs, as done for every input by CheckInputs
+static void CCoinsCaching(benchmark::State& state)
+{
+    CCoinsView base;
+    CCoinsViewCache view(&base);
+    std::vector<CTransaction> vtx = SetupCoins(view);
+
+    size_t n = 0;
+    while (state.KeepRunning()) {
+        const CTransaction& tx = vtx[n++ % vtx.size()];
+        const CCoins* coins = view.AccessCoins(tx.GetHash());
+        assert(coins && coins->IsAvailable(0));
+    }
+}
+
+// Spend one output in a child view and flush it into the parent, the way
+// ConnectBlock works on top of pcoinsTip
+static void CCoinsSpendFlush(benchmark::State& state)
+{
+    CCoinsView base;
+    CCoinsViewCache tip(&base);
+    std::vector<CTransaction> vtx = SetupCoins(tip);
+
+    size_t n = 0;
+    while (state.KeepRunning()) {
+        const CTransaction& tx = vtx[n++ % vtx.size()];
+        CCoinsViewCache view(&tip);
+        CTxInUndo undo;
+        view.ModifyCoins(tx.GetHash())->Spend(COutPoint(tx.GetHash(), 0), undo);
+        view.ModifyCoins(tx.GetHash())->FromTx(tx, 100000); // unspend, so the fixture can be reused
+        view.Flush();
+    }
+}
+
+BENCHMARK(CCoinsCaching);
+BENCHMARK(CCoinsSpendFlush);
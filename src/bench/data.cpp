@@ -0,0 +1,61 @@
+// Copyright (c) 2018 The Blocknet developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "data.h"
+
+#include "random.h"
+#include "script/standard.h"
+
+#include <vector>
+
+uint256 benchmark::data::RandomHash()
+{
+    uint256 hash;
+    for (unsigned int i = 0; i < hash.size() / 4; i++) {
+        uint32_t n = insecure_rand();
+        memcpy(hash.begin() + i * 4, &n, 4);
+    }
+    return hash;
+}
+
+CKey benchmark::data::MakeKey(unsigned char seed)
+{
+    std::vector<unsigned char> vch(32, seed);
+    CKey key;
+    key.Set(vch.begin(), vch.end(), true);
+    return key;
+}
+
+CMutableTransaction benchmark::data::MakeTransaction(const CKey& key, int nIn, int nOut)
+{
+    CMutableTransaction tx;
+    tx.vin.resize(nIn);
+    for (int i = 0; i < nIn; i++) {
+        tx.vin[i].prevout = COutPoint(RandomHash(), insecure_rand() % 4);
+        // a typical pay-to-pubkey-hash scriptSig: signature and pubkey
+        tx.vin[i].scriptSig << std::vector<unsigned char>(72, 0x30) << ToByteVector(key.GetPubKey());
+    }
+    tx.vout.resize(nOut);
+    for (int i = 0; i < nOut; i++) {
+        tx.vout[i].nValue = (insecure_rand() % 1000 + 1) * COIN;
+        tx.vout[i].scriptPubKey = GetScriptForDestination(key.GetPubKey().GetID());
+    }
+    return tx;
+}
+
+CBlock benchmark::data::MakeBlock(int nTx)
+{
+    CKey key = MakeKey(1);
+
+    CBlock block;
+    block.nVersion = 3;
+    block.hashPrevBlock = RandomHash();
+    block.nTime = 1514764800;
+    block.nBits = 0x1e0fffff;
+    block.nNonce = insecure_rand();
+    for (int i = 0; i < nTx; i++)
+        block.vtx.push_back(MakeTransaction(key, 2, 2));
+    block.hashMerkleRoot = block.BuildMerkleTree();
+    return block;
+}
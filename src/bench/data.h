@@ -0,0 +1,36 @@
+// Copyright (c) 2018 The Blocknet developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_BENCH_DATA_H
+#define BITCOIN_BENCH_DATA_H
+
+#include "key.h"
+#include "primitives/block.h"
+#include "primitives/transaction.h"
+#include "uint256.h"
+
+/**
+ * Deterministic fixtures shared by the benchmarks. Everything is derived
+ * from fixed seeds or from insecure_rand seeded deterministically in main,
+ * so successive runs measure the same data.
+ */
+namespace benchmark
+{
+namespace data
+{
+//! uint256 filled from insecure_rand
+uint256 RandomHash();
+
+//! Compressed private key with every byte set to seed (seed must not be 0)
+CKey MakeKey(unsigned char seed);
+
+//! Transaction spending nIn random outpoints to nOut pay-to-pubkey-hash outputs of key
+CMutableTransaction MakeTransaction(const CKey& key, int nIn, int nOut);
+
+//! Block header plus nTx transactions of two inputs and two outputs each
+CBlock MakeBlock(int nTx);
+}
+}
+
+#endif // BITCOIN_BENCH_DATA_H
@@ -0,0 +1,62 @@
+// Copyright (c) 2018 The Blocknet developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "data.h"
+
+#include "crypto/sha256.h"
+#include "hash.h"
+
+#include <vector>
+
+// Block header proof of work hash
+static void HashQuarkHeader(benchmark::State& state)
+{
+    CBlockHeader header = benchmark::data::MakeBlock(0).GetBlockHeader();
+    while (state.KeepRunning()) {
+        header.nNonce++;
+        header.GetHash();
+    }
+}
+
+// Double SHA256 of a header sized buffer (txids, merkle nodes, stake kernels)
+static void HashSHA256D80(benchmark::State& state)
+{
+    std::vector<unsigned char> in(80, 0);
+    while (state.KeepRunning()) {
+        in[0]++;
+        Hash(in.begin(), in.end());
+    }
+}
+
+static void HashSHA256_1M(benchmark::State& state)
+{
+    uint8_t hash[CSHA256::OUTPUT_SIZE];
+    std::vector<uint8_t> in(1000 * 1000, 0);
+    while (state.KeepRunning())
+        CSHA256().Write(in.data(), in.size()).Finalize(hash);
+}
+
+// Merkle tree levels: 1024 pairs of hashes at once
+static void HashSHA256D64_1024(benchmark::State& state)
+{
+    std::vector<uint8_t> in(64 * 1024, 0);
+    while (state.KeepRunning()) {
+        in[0]++;
+        SHA256D64(in.data(), in.data(), 1024);
+    }
+}
+
+static void BuildMerkleTree1000(benchmark::State& state)
+{
+    CBlock block = benchmark::data::MakeBlock(1000);
+    while (state.KeepRunning())
+        block.BuildMerkleTree();
+}
+
+BENCHMARK(HashQuarkHeader);
+BENCHMARK(HashSHA256D80);
+BENCHMARK(HashSHA256_1M);
+BENCHMARK(HashSHA256D64_1024);
+BENCHMARK(BuildMerkleTree1000);
@@ -0,0 +1,32 @@
+// Copyright (c) 2018 The Blocknet developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "data.h"
+
+#include "kernel.h"
+
+// The hashing loop of CheckStakeKernelHash: one stake hash and target test
+// per second of hash drift. The stake modifier lookup is left out as it
+// needs a loaded block index.
+static void StakeKernelHash(benchmark::State& state)
+{
+    const uint256 prevoutHash = benchmark::data::RandomHash();
+    const unsigned int nTimeBlockFrom = 1514764800;
+    const int64_t nValueIn = 5000 * COIN;
+
+    uint256 bnTargetPerCoinDay;
+    bnTargetPerCoinDay.SetCompact(0x1d00ffff);
+
+    CDataStream ss(SER_GETHASH, 0);
+    ss << (uint64_t)0x0123456789abcdefULL;
+
+    unsigned int nTimeTx = nTimeBlockFrom + 3600 * 24;
+    while (state.KeepRunning()) {
+        uint256 hashProofOfStake = stakeHash(nTimeTx++, ss, 1, prevoutHash, nTimeBlockFrom);
+        stakeTargetHit(hashProofOfStake, nValueIn, bnTargetPerCoinDay);
+    }
+}
+
+BENCHMARK(StakeKernelHash);
@@ -0,0 +1,81 @@
+// Copyright (c) 2018 The Blocknet developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "data.h"
+
+#include "xbridge/xbridgepacket.h"
+#include "xrouter/xrouterpacket.h"
+
+#include <vector>
+
+struct PacketKeys {
+    std::vector<unsigned char> pubkey;
+    std::vector<unsigned char> privkey;
+
+    PacketKeys()
+    {
+        CKey key = benchmark::data::MakeKey(2);
+        CPubKey pub = key.GetPubKey();
+        pubkey.assign(pub.begin(), pub.end());
+        privkey.assign(key.begin(), key.end());
+    }
+};
+
+// Sign a fresh packet. sign() verifies the result, and as the body differs
+// every iteration that verification always misses the signature cache.
+static void XRouterPacketSign(benchmark::State& state)
+{
+    PacketKeys keys;
+    uint32_t n = 0;
+    while (state.KeepRunning()) {
+        xrouter::XRouterPacket packet(xrouter::xrGetBlockCount, "bench");
+        packet.append(std::string("BLOCK"));
+        packet.append(n++);
+        bool fOk = packet.sign(keys.pubkey, keys.privkey);
+        assert(fOk);
+    }
+}
+
+// Verify a packet that was seen before, e.g. a retransmitted query
+static void XRouterPacketVerifyCached(benchmark::State& state)
+{
+    PacketKeys keys;
+    xrouter::XRouterPacket packet(xrouter::xrGetBlockCount, "bench");
+    packet.append(std::string("BLOCK"));
+    bool fOk = packet.sign(keys.pubkey, keys.privkey);
+    assert(fOk);
+    while (state.KeepRunning())
+        packet.verify(keys.pubkey);
+}
+
+static void XBridgePacketSign(benchmark::State& state)
+{
+    PacketKeys keys;
+    uint32_t n = 0;
+    while (state.KeepRunning()) {
+        XBridgePacket packet(xbcTransaction);
+        packet.append(benchmark::data::RandomHash().begin(), 32);
+        packet.append(n++);
+        bool fOk = packet.sign(keys.pubkey, keys.privkey);
+        assert(fOk);
+    }
+}
+
+// Verify a relayed broadcast that was already received from another peer
+static void XBridgePacketVerifyCached(benchmark::State& state)
+{
+    PacketKeys keys;
+    XBridgePacket packet(xbcTransaction);
+    packet.append(benchmark::data::RandomHash().begin(), 32);
+    bool fOk = packet.sign(keys.pubkey, keys.privkey);
+    assert(fOk);
+    while (state.KeepRunning())
+        packet.verify(keys.pubkey);
+}
+
+BENCHMARK(XRouterPacketSign);
+BENCHMARK(XRouterPacketVerifyCached);
+BENCHMARK(XBridgePacketSign);
+BENCHMARK(XBridgePacketVerifyCached);
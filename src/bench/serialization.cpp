@@ -0,0 +1,54 @@
+// Copyright (c) 2018 The Blocknet developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "data.h"
+
+#include "version.h"
+#include "streams.h"
+
+static void SerializeBlock(benchmark::State& state)
+{
+    CBlock block = benchmark::data::MakeBlock(500);
+    while (state.KeepRunning()) {
+        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+        ss << block;
+    }
+}
+
+static void DeserializeBlock(benchmark::State& state)
+{
+    CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION);
+    ssBlock << benchmark::data::MakeBlock(500);
+    while (state.KeepRunning()) {
+        CDataStream ss(ssBlock);
+        CBlock block;
+        ss >> block;
+    }
+}
+
+static void SerializeTransaction(benchmark::State& state)
+{
+    CTransaction tx = benchmark::data::MakeTransaction(benchmark::data::MakeKey(1), 2, 2);
+    while (state.KeepRunning()) {
+        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+        ss << tx;
+    }
+}
+
+static void DeserializeTransaction(benchmark::State& state)
+{
+    CDataStream ssTx(SER_NETWORK, PROTOCOL_VERSION);
+    ssTx << CTransaction(benchmark::data::MakeTransaction(benchmark::data::MakeKey(1), 2, 2));
+    while (state.KeepRunning()) {
+        CDataStream ss(ssTx);
+        CTransaction tx;
+        ss >> tx;
+    }
+}
+
+BENCHMARK(SerializeBlock);
+BENCHMARK(DeserializeBlock);
+BENCHMARK(SerializeTransaction);
+BENCHMARK(DeserializeTransaction);
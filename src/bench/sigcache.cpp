@@ -0,0 +1,57 @@
+// Copyright (c) 2018 The Blocknet developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "data.h"
+
+#include "script/interpreter.h"
+#include "script/sigcache.h"
+#include "script/standard.h"
+
+// Signed input spending a pay-to-pubkey-hash output of key
+struct SignedInput {
+    CScript scriptPubKey;
+    CMutableTransaction tx;
+    uint256 sighash;
+    std::vector<unsigned char> vchSig;
+
+    SignedInput(const CKey& key)
+    {
+        scriptPubKey = GetScriptForDestination(key.GetPubKey().GetID());
+        tx = benchmark::data::MakeTransaction(key, 1, 2);
+        sighash = SignatureHash(scriptPubKey, tx, 0, SIGHASH_ALL);
+        key.Sign(sighash, vchSig);
+        vchSig.push_back((unsigned char)SIGHASH_ALL);
+        tx.vin[0].scriptSig = CScript() << vchSig << ToByteVector(key.GetPubKey());
+        vchSig.pop_back();
+    }
+};
+
+// Raw ECDSA verification, the cost of a signature cache miss
+static void VerifySignatureUncached(benchmark::State& state)
+{
+    CKey key = benchmark::data::MakeKey(1);
+    SignedInput input(key);
+    CPubKey pubkey = key.GetPubKey();
+    while (state.KeepRunning()) {
+        bool fOk = pubkey.Verify(input.sighash, input.vchSig);
+        assert(fOk);
+    }
+}
+
+// Full P2PKH script verification with the signature already in CSignatureCache,
+// as for a block transaction that was accepted to the mempool before
+static void VerifyScriptCached(benchmark::State& state)
+{
+    SignedInput input(benchmark::data::MakeKey(1));
+    const CTransaction tx(input.tx);
+    CachingTransactionSignatureChecker checker(&tx, 0, true);
+    bool fOk = VerifyScript(tx.vin[0].scriptSig, input.scriptPubKey, STANDARD_SCRIPT_VERIFY_FLAGS, checker);
+    assert(fOk);
+    while (state.KeepRunning())
+        VerifyScript(tx.vin[0].scriptSig, input.scriptPubKey, STANDARD_SCRIPT_VERIFY_FLAGS, checker);
+}
+
+BENCHMARK(VerifySignatureUncached);
+BENCHMARK(VerifyScriptCached);
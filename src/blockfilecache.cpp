@@ -0,0 +1,184 @@
+// Copyright (c) 2018 The Blocknet developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockfilecache.h"
+
+#include "chain.h"
+#include "chainparams.h"
+#include "crypto/common.h"
+#include "main.h"
+#include "serialize.h"
+#include "util.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifndef WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+CBlockFileCache* pblockfilecache = NULL;
+
+/** Size of the header in front of every record, message start and record size */
+static const unsigned int RECORD_HEADER_SIZE = MESSAGE_START_SIZE + sizeof(uint32_t);
+
+/** An open blk or rev file, either mapped or kept open for reading */
+struct CBlockFileHandle {
+    FILE* file;
+    const char* pMap;
+    size_t nMapSize;
+    //! serializes seeking and reading file
+    CCriticalSection cs;
+
+    CBlockFileHandle() : file(NULL), pMap(NULL), nMapSize(0) {}
+
+    ~CBlockFileHandle()
+    {
+#ifndef WIN32
+        if (pMap)
+            munmap((void*)pMap, nMapSize);
+#endif
+        if (file)
+            fclose(file);
+    }
+};
+
+/** Check the header in front of a record and return its size, nExtra included */
+static bool ParseRecordHeader(const char* pchHeader, unsigned int nExtra, size_t& nSize)
+{
+    if (memcmp(pchHeader, Params().MessageStart(), MESSAGE_START_SIZE) != 0)
+        return false;
+    uint32_t nRecordSize = ReadLE32((const unsigned char*)pchHeader + MESSAGE_START_SIZE);
+    if (nRecordSize > MAX_SIZE)
+        return false;
+    nSize = (size_t)nRecordSize + nExtra;
+    return true;
+}
+
+CBlockFileCache::CBlockFileCache(size_t nMaxFilesIn, bool fMmapIn) : nMaxFiles(std::max(nMaxFilesIn, (size_t)1)), fMmap(fMmapIn)
+{
+#ifdef WIN32
+    fMmap = false;
+#endif
+}
+
+CBlockFileCache::~CBlockFileCache()
+{
+}
+
+std::shared_ptr<CBlockFileHandle> CBlockFileCache::GetHandle(int nFile, const char* prefix, bool fReopen)
+{
+    FileKey key(prefix[0], nFile);
+
+    LOCK(cs);
+    std::map<FileKey, HandleList::iterator>::iterator it = mapHandles.find(key);
+    if (it != mapHandles.end()) {
+        if (!fReopen) {
+            listHandles.splice(listHandles.begin(), listHandles, it->second);
+            return it->second->second;
+        }
+        // readers still holding the old handle keep it alive until they are done
+        listHandles.erase(it->second);
+        mapHandles.erase(it);
+    }
+
+    boost::filesystem::path path = GetBlockPosFilename(CDiskBlockPos(nFile, 0), prefix);
+    FILE* file = fopen(path.string().c_str(), "rb");
+    if (!file)
+        return std::shared_ptr<CBlockFileHandle>();
+
+    std::shared_ptr<CBlockFileHandle> handle(new CBlockFileHandle());
+#ifndef WIN32
+    struct stat st;
+    if (fMmap && fstat(fileno(file), &st) == 0 && st.st_size > 0) {
+        void* pMap = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fileno(file), 0);
+        if (pMap != MAP_FAILED) {
+            // records are read one at a time from all over the file, don't read ahead
+            madvise(pMap, st.st_size, MADV_RANDOM);
+            handle->pMap = (const char*)pMap;
+            handle->nMapSize = st.st_size;
+            // the mapping stays valid without the descriptor
+            fclose(file);
+            file = NULL;
+        }
+    }
+#endif
+    if (file) {
+        // data appended through other handles must not hide behind a stale buffer
+        setvbuf(file, NULL, _IONBF, 0);
+        handle->file = file;
+    }
+
+    listHandles.push_front(std::make_pair(key, handle));
+    mapHandles[key] = listHandles.begin();
+    while (listHandles.size() > nMaxFiles) {
+        mapHandles.erase(listHandles.back().first);
+        listHandles.pop_back();
+    }
+    return handle;
+}
+
+bool CBlockFileCache::ReadRecord(const CDiskBlockPos& pos, const char* prefix, unsigned int nExtra, CBlockFileRecord& record)
+{
+    if (pos.IsNull() || pos.nPos < RECORD_HEADER_SIZE)
+        return false;
+
+    std::shared_ptr<CBlockFileHandle> handle = GetHandle(pos.nFile, prefix, false);
+    if (!handle)
+        return false;
+
+    if (handle->pMap) {
+        size_t nSize;
+        if (pos.nPos > handle->nMapSize) {
+            // the file grew since it was mapped
+            handle = GetHandle(pos.nFile, prefix, true);
+            if (!handle || !handle->pMap || pos.nPos > handle->nMapSize)
+                return false;
+        }
+        if (!ParseRecordHeader(handle->pMap + pos.nPos - RECORD_HEADER_SIZE, nExtra, nSize))
+            return false;
+        if (pos.nPos + nSize > handle->nMapSize) {
+            handle = GetHandle(pos.nFile, prefix, true);
+            if (!handle || !handle->pMap || pos.nPos + nSize > handle->nMapSize)
+                return false;
+        }
+
+#ifndef WIN32
+        // fault the whole record in at once
+        static const uintptr_t nPageMask = ~(uintptr_t)(sysconf(_SC_PAGESIZE) - 1);
+        uintptr_t nStart = (uintptr_t)(handle->pMap + pos.nPos) & nPageMask;
+        madvise((void*)nStart, (uintptr_t)(handle->pMap + pos.nPos + nSize) - nStart, MADV_WILLNEED);
+#endif
+
+        record.vch.clear();
+        record.pbegin = handle->pMap + pos.nPos;
+        record.pend = record.pbegin + nSize;
+        record.handle = handle;
+        return true;
+    }
+
+    LOCK(handle->cs);
+    char pchHeader[RECORD_HEADER_SIZE];
+    size_t nSize;
+    if (fseek(handle->file, pos.nPos - RECORD_HEADER_SIZE, SEEK_SET) != 0 ||
+        fread(pchHeader, 1, sizeof(pchHeader), handle->file) != sizeof(pchHeader) ||
+        !ParseRecordHeader(pchHeader, nExtra, nSize))
+        return false;
+
+    record.vch.resize(nSize);
+    if (nSize > 0 && fread(&record.vch[0], 1, nSize, handle->file) != nSize)
+        return false;
+    record.pbegin = record.vch.empty() ? NULL : &record.vch[0];
+    record.pend = record.pbegin + nSize;
+    record.handle.reset();
+    return true;
+}
+
+size_t CBlockFileCache::GetOpenCount() const
+{
+    LOCK(cs);
+    return listHandles.size();
+}
@@ -0,0 +1,87 @@
+// Copyright (c) 2018 The Blocknet developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BLOCKFILECACHE_H
+#define BLOCKFILECACHE_H
+
+#include "sync.h"
+
+#include <list>
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+
+struct CDiskBlockPos;
+class CBlockFileCache;
+struct CBlockFileHandle;
+
+extern CBlockFileCache* pblockfilecache;
+
+/** -blockfilecache default, the number of block and undo files kept open for reading */
+static const int DEFAULT_BLOCKFILECACHE = 16;
+/** -blockfilemmap default, mapping whole block files only makes sense with a 64 bit address space */
+static const bool DEFAULT_BLOCKFILEMMAP = sizeof(void*) >= 8;
+
+/**
+ * A record of a block or undo file, the data following its message start and
+ * size header, as a contiguous range of bytes. It either points into a mapping
+ * of the file, which it keeps alive, or holds a copy read out of the file.
+ */
+class CBlockFileRecord
+{
+public:
+    CBlockFileRecord() : pbegin(NULL), pend(NULL) {}
+
+    const char* begin() const { return pbegin; }
+    const char* end() const { return pend; }
+    size_t size() const { return pend - pbegin; }
+
+private:
+    friend class CBlockFileCache;
+
+    std::shared_ptr<CBlockFileHandle> handle;
+    std::vector<char> vch;
+    const char* pbegin;
+    const char* pend;
+};
+
+/**
+ * LRU cache of read-only handles of the blk and rev files, so that serving
+ * blocks, transactions and undo data does not open, seek and close a file on
+ * every read. Where supported the files are mapped into memory and records are
+ * deserialized right out of the mapping; otherwise an unbuffered FILE* is kept
+ * open per file.
+ */
+class CBlockFileCache
+{
+public:
+    CBlockFileCache(size_t nMaxFilesIn, bool fMmapIn);
+    ~CBlockFileCache();
+
+    /**
+     * Look up the record at pos of a "blk" or "rev" file, with nExtra trailing
+     * bytes (the checksum of undo data) included. Fails if the file cannot be
+     * opened or pos does not follow a valid record header.
+     */
+    bool ReadRecord(const CDiskBlockPos& pos, const char* prefix, unsigned int nExtra, CBlockFileRecord& record);
+
+    /** Number of files currently cached */
+    size_t GetOpenCount() const;
+
+private:
+    typedef std::pair<char, int> FileKey;
+    typedef std::list<std::pair<FileKey, std::shared_ptr<CBlockFileHandle> > > HandleList;
+
+    std::shared_ptr<CBlockFileHandle> GetHandle(int nFile, const char* prefix, bool fReopen);
+
+    mutable CCriticalSection cs;
+    size_t nMaxFiles;
+    bool fMmap;
+    //! most recently used first
+    HandleList listHandles;
+    std::map<FileKey, HandleList::iterator> mapHandles;
+};
+
+#endif
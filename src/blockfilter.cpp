@@ -0,0 +1,357 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Copyright (c) 2018 The Blocknet developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockfilter.h"
+
+#include "crypto/common.h"
+#include "hash.h"
+#include "main.h"
+#include "primitives/block.h"
+#include "script/script.h"
+#include "streams.h"
+
+#include <algorithm>
+#include <ios>
+#include <stdexcept>
+
+namespace
+{
+/** Appends bits to a byte vector, most significant bit first */
+class BitStreamWriter
+{
+private:
+    std::vector<unsigned char>& m_vch;
+    uint8_t m_buffer;
+    int m_offset; //!< number of bits already in m_buffer
+
+public:
+    explicit BitStreamWriter(std::vector<unsigned char>& vch) : m_vch(vch), m_buffer(0), m_offset(0) {}
+
+    ~BitStreamWriter() { Flush(); }
+
+    /** Write the nbits least significant bits of data, 0 <= nbits <= 64 */
+    void Write(uint64_t data, int nbits)
+    {
+        while (nbits > 0) {
+            int bits = std::min(8 - m_offset, nbits);
+            m_buffer |= (uint8_t)((data << (64 - nbits)) >> (64 - 8 + m_offset));
+            m_offset += bits;
+            nbits -= bits;
+            if (m_offset == 8)
+                Flush();
+        }
+    }
+
+    /** Write out any partial byte, padded with zero bits */
+    void Flush()
+    {
+        if (m_offset == 0)
+            return;
+        m_vch.push_back(m_buffer);
+        m_buffer = 0;
+        m_offset = 0;
+    }
+};
+
+/** Reads bits from a byte range, most significant bit first */
+class BitStreamReader
+{
+private:
+    const unsigned char* m_pos;
+    const unsigned char* m_end;
+    uint8_t m_buffer;
+    int m_offset; //!< number of bits of m_buffer consumed already
+
+public:
+    BitStreamReader(const unsigned char* begin, const unsigned char* end) : m_pos(begin), m_end(end), m_buffer(0), m_offset(8) {}
+
+    /** Read nbits and return them as the least significant bits of the result, 0 <= nbits <= 64 */
+    uint64_t Read(int nbits)
+    {
+        uint64_t data = 0;
+        while (nbits > 0) {
+            if (m_offset == 8) {
+                if (m_pos == m_end)
+                    throw std::ios_base::failure("BitStreamReader::Read : end of data");
+                m_buffer = *m_pos++;
+                m_offset = 0;
+            }
+            int bits = std::min(8 - m_offset, nbits);
+            data <<= bits;
+            data |= (uint8_t)(m_buffer << m_offset) >> (8 - bits);
+            m_offset += bits;
+            nbits -= bits;
+        }
+        return data;
+    }
+
+    /** Number of whole bytes not yet touched */
+    size_t Remaining() const { return m_end - m_pos; }
+};
+
+void GolombRiceEncode(BitStreamWriter& bitwriter, uint8_t P, uint64_t x)
+{
+    // Write quotient as unary-encoded: q 1's followed by one 0.
+    uint64_t q = x >> P;
+    while (q > 0) {
+        int nbits = q <= 64 ? static_cast<int>(q) : 64;
+        bitwriter.Write(~0ULL, nbits);
+        q -= nbits;
+    }
+    bitwriter.Write(0, 1);
+
+    // Write the remainder in P bits. Since the remainder is just the bottom
+    // P bits of x, there is no need to mask first.
+    bitwriter.Write(x, P);
+}
+
+uint64_t GolombRiceDecode(BitStreamReader& bitreader, uint8_t P)
+{
+    // Read unary-encoded quotient: q 1's followed by one 0.
+    uint64_t q = 0;
+    while (bitreader.Read(1) == 1)
+        ++q;
+
+    uint64_t r = bitreader.Read(P);
+    return (q << P) + r;
+}
+
+/** Map x uniformly into [0, n), see https://lemire.me/blog/2016/06/27/a-fast-alternative-to-the-modulo-reduction/ */
+uint64_t MapIntoRange(uint64_t x, uint64_t n)
+{
+#ifdef __SIZEOF_INT128__
+    return (uint64_t)(((unsigned __int128)x * (unsigned __int128)n) >> 64);
+#else
+    // To perform the calculation on 64-bit numbers without losing the
+    // result to overflow, split the numbers into the most significant and
+    // least significant 32 bits and perform multiplication piece-wise.
+    uint64_t a = x >> 32;
+    uint64_t b = x & 0xFFFFFFFF;
+    uint64_t c = n >> 32;
+    uint64_t d = n & 0xFFFFFFFF;
+
+    uint64_t ac = a * c;
+    uint64_t ad = a * d;
+    uint64_t bc = b * c;
+    uint64_t bd = b * d;
+
+    uint64_t mid34 = (bd >> 32) + (bc & 0xFFFFFFFF) + (ad & 0xFFFFFFFF);
+    uint64_t upper64 = ac + (bc >> 32) + (ad >> 32) + (mid34 >> 32);
+    return upper64;
+#endif
+}
+} // namespace
+
+uint64_t GCSFilter::HashToRange(const Element& element) const
+{
+    uint64_t hash = CSipHasher(m_params.m_siphash_k0, m_params.m_siphash_k1)
+                        .Write(element.empty() ? NULL : &element[0], element.size())
+                        .Finalize();
+    return MapIntoRange(hash, m_F);
+}
+
+std::vector<uint64_t> GCSFilter::BuildHashedSet(const ElementSet& elements) const
+{
+    std::vector<uint64_t> hashed_elements;
+    hashed_elements.reserve(elements.size());
+    for (ElementSet::const_iterator it = elements.begin(); it != elements.end(); ++it)
+        hashed_elements.push_back(HashToRange(*it));
+    std::sort(hashed_elements.begin(), hashed_elements.end());
+    return hashed_elements;
+}
+
+GCSFilter::GCSFilter(const Params& params)
+    : m_params(params), m_N(0), m_F(0)
+{
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    WriteCompactSize(ss, m_N);
+    m_encoded.assign(ss.begin(), ss.end());
+}
+
+GCSFilter::GCSFilter(const Params& params, const std::vector<unsigned char>& encoded_filter)
+    : m_params(params), m_encoded(encoded_filter)
+{
+    CDataStream ss(m_encoded, SER_NETWORK, PROTOCOL_VERSION);
+    uint64_t N = ReadCompactSize(ss);
+    m_N = static_cast<uint32_t>(N);
+    if (m_N != N)
+        throw std::ios_base::failure("N must be <2^32");
+    m_F = static_cast<uint64_t>(m_N) * static_cast<uint64_t>(m_params.m_M);
+
+    // Verify that the encoded filter contains exactly N elements. If it has too much or too little
+    // data, a std::ios_base::failure exception will be raised.
+    const unsigned char* begin = m_encoded.empty() ? NULL : &m_encoded[0];
+    BitStreamReader bitreader(begin + (m_encoded.size() - ss.size()), begin + m_encoded.size());
+    for (uint64_t i = 0; i < m_N; ++i)
+        GolombRiceDecode(bitreader, m_params.m_P);
+    if (bitreader.Remaining() != 0)
+        throw std::ios_base::failure("encoded_filter contains excess data");
+}
+
+GCSFilter::GCSFilter(const Params& params, const ElementSet& elements)
+    : m_params(params)
+{
+    size_t N = elements.size();
+    m_N = static_cast<uint32_t>(N);
+    if (m_N != N)
+        throw std::invalid_argument("N must be <2^32");
+    m_F = static_cast<uint64_t>(m_N) * static_cast<uint64_t>(m_params.m_M);
+
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    WriteCompactSize(ss, m_N);
+    m_encoded.assign(ss.begin(), ss.end());
+
+    if (elements.empty())
+        return;
+
+    BitStreamWriter bitwriter(m_encoded);
+
+    uint64_t last_value = 0;
+    std::vector<uint64_t> hashed_elements = BuildHashedSet(elements);
+    for (size_t i = 0; i < hashed_elements.size(); ++i) {
+        uint64_t delta = hashed_elements[i] - last_value;
+        GolombRiceEncode(bitwriter, m_params.m_P, delta);
+        last_value = hashed_elements[i];
+    }
+
+    bitwriter.Flush();
+}
+
+bool GCSFilter::MatchInternal(const uint64_t* element_hashes, size_t size) const
+{
+    CDataStream ss(m_encoded, SER_NETWORK, PROTOCOL_VERSION);
+
+    // Seek forward by size of N
+    uint64_t N = ReadCompactSize(ss);
+    assert(N == m_N);
+
+    const unsigned char* begin = &m_encoded[0];
+    BitStreamReader bitreader(begin + (m_encoded.size() - ss.size()), begin + m_encoded.size());
+
+    uint64_t value = 0;
+    size_t hashes_index = 0;
+    for (uint32_t i = 0; i < m_N; ++i) {
+        uint64_t delta = GolombRiceDecode(bitreader, m_params.m_P);
+        value += delta;
+
+        while (true) {
+            if (hashes_index == size) {
+                return false;
+            } else if (element_hashes[hashes_index] == value) {
+                return true;
+            } else if (element_hashes[hashes_index] > value) {
+                break;
+            }
+
+            hashes_index++;
+        }
+    }
+
+    return false;
+}
+
+bool GCSFilter::Match(const Element& element) const
+{
+    uint64_t query = HashToRange(element);
+    return MatchInternal(&query, 1);
+}
+
+bool GCSFilter::MatchAny(const ElementSet& elements) const
+{
+    if (elements.empty())
+        return false;
+    const std::vector<uint64_t> queries = BuildHashedSet(elements);
+    return MatchInternal(&queries[0], queries.size());
+}
+
+std::string BlockFilterTypeName(BlockFilterType filter_type)
+{
+    switch (filter_type) {
+    case BLOCK_FILTER_BASIC:
+        return "basic";
+    default:
+        return "";
+    }
+}
+
+bool BlockFilterTypeByName(const std::string& name, BlockFilterType& filter_type)
+{
+    if (name == "basic") {
+        filter_type = BLOCK_FILTER_BASIC;
+        return true;
+    }
+    return false;
+}
+
+static GCSFilter::ElementSet BasicFilterElements(const CBlock& block, const CBlockUndo& block_undo)
+{
+    GCSFilter::ElementSet elements;
+
+    for (unsigned int i = 0; i < block.vtx.size(); i++) {
+        const CTransaction& tx = block.vtx[i];
+        for (unsigned int j = 0; j < tx.vout.size(); j++) {
+            const CScript& script = tx.vout[j].scriptPubKey;
+            if (script.empty() || script[0] == OP_RETURN)
+                continue;
+            elements.insert(GCSFilter::Element(script.begin(), script.end()));
+        }
+    }
+
+    for (unsigned int i = 0; i < block_undo.vtxundo.size(); i++) {
+        const CTxUndo& tx_undo = block_undo.vtxundo[i];
+        for (unsigned int j = 0; j < tx_undo.vprevout.size(); j++) {
+            const CScript& script = tx_undo.vprevout[j].txout.scriptPubKey;
+            if (script.empty())
+                continue;
+            elements.insert(GCSFilter::Element(script.begin(), script.end()));
+        }
+    }
+
+    return elements;
+}
+
+BlockFilter::BlockFilter(BlockFilterType filter_type, const uint256& block_hash, const std::vector<unsigned char>& filter)
+    : m_filter_type(filter_type), m_block_hash(block_hash)
+{
+    GCSFilter::Params params;
+    if (!BuildParams(params))
+        throw std::invalid_argument("unknown filter_type");
+    m_filter = GCSFilter(params, filter);
+}
+
+BlockFilter::BlockFilter(BlockFilterType filter_type, const CBlock& block, const CBlockUndo& block_undo)
+    : m_filter_type(filter_type), m_block_hash(block.GetHash())
+{
+    GCSFilter::Params params;
+    if (!BuildParams(params))
+        throw std::invalid_argument("unknown filter_type");
+    m_filter = GCSFilter(params, BasicFilterElements(block, block_undo));
+}
+
+bool BlockFilter::BuildParams(GCSFilter::Params& params) const
+{
+    switch (m_filter_type) {
+    case BLOCK_FILTER_BASIC:
+        params.m_siphash_k0 = ReadLE64(m_block_hash.begin());
+        params.m_siphash_k1 = ReadLE64(m_block_hash.begin() + 8);
+        params.m_P = BASIC_FILTER_P;
+        params.m_M = BASIC_FILTER_M;
+        return true;
+    default:
+        return false;
+    }
+}
+
+uint256 BlockFilter::GetHash() const
+{
+    const std::vector<unsigned char>& data = GetEncodedFilter();
+    return Hash(data.begin(), data.end());
+}
+
+uint256 BlockFilter::ComputeHeader(const uint256& prev_header) const
+{
+    const uint256& filter_hash = GetHash();
+    return Hash(filter_hash.begin(), filter_hash.end(), prev_header.begin(), prev_header.end());
+}
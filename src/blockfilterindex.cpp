@@ -0,0 +1,187 @@
+// Copyright (c) 2018 The Blocknet developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockfilterindex.h"
+
+#include "main.h"
+#include "util.h"
+
+#include <boost/thread.hpp>
+
+CBlockFilterIndexDB* pblockfilterindex = NULL;
+
+static const char DB_FILTER = 'f';
+static const char DB_FILTER_HEADER = 'h';
+static const char DB_BEST_BLOCK = 'B';
+
+static bool fSynced = false;
+
+CBlockFilterIndexDB::CBlockFilterIndexDB(size_t nCacheSize, bool fMemory, bool fWipe)
+    : CLevelDBWrapper(GetDataDir() / "blockfilter", nCacheSize, fMemory, fWipe)
+{
+}
+
+bool CBlockFilterIndexDB::WriteFilter(const BlockFilter& filter, const uint256& header)
+{
+    CLevelDBBatch batch;
+    batch.Write(std::make_pair(DB_FILTER, filter.GetBlockHash()), filter.GetEncodedFilter());
+    batch.Write(std::make_pair(DB_FILTER_HEADER, filter.GetBlockHash()), std::make_pair(filter.GetHash(), header));
+    batch.Write(DB_BEST_BLOCK, filter.GetBlockHash());
+    return WriteBatch(batch);
+}
+
+bool CBlockFilterIndexDB::ReadFilter(const uint256& hashBlock, BlockFilter& filter) const
+{
+    std::vector<unsigned char> vchFilter;
+    if (!Read(std::make_pair(DB_FILTER, hashBlock), vchFilter))
+        return false;
+    try {
+        filter = BlockFilter(BLOCK_FILTER_BASIC, hashBlock, vchFilter);
+    } catch (const std::exception& e) {
+        return error("%s : Malformed filter of block %s - %s", __func__, hashBlock.ToString(), e.what());
+    }
+    return true;
+}
+
+bool CBlockFilterIndexDB::ReadFilterHash(const uint256& hashBlock, uint256& hash) const
+{
+    std::pair<uint256, uint256> entry;
+    if (!Read(std::make_pair(DB_FILTER_HEADER, hashBlock), entry))
+        return false;
+    hash = entry.first;
+    return true;
+}
+
+bool CBlockFilterIndexDB::ReadFilterHeader(const uint256& hashBlock, uint256& header) const
+{
+    std::pair<uint256, uint256> entry;
+    if (!Read(std::make_pair(DB_FILTER_HEADER, hashBlock), entry))
+        return false;
+    header = entry.second;
+    return true;
+}
+
+bool CBlockFilterIndexDB::HasFilter(const uint256& hashBlock) const
+{
+    return Exists(std::make_pair(DB_FILTER_HEADER, hashBlock));
+}
+
+bool CBlockFilterIndexDB::ReadBestBlock(uint256& hashBlock) const
+{
+    return Read(DB_BEST_BLOCK, hashBlock);
+}
+
+/** Compute, chain and store the filter of a block, if the header of its parent is known */
+static bool IndexBlockFilter(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex, bool& fIndexed)
+{
+    fIndexed = false;
+    uint256 hashPrevHeader;
+    if (pindex->pprev && !pblockfilterindex->ReadFilterHeader(pindex->pprev->GetBlockHash(), hashPrevHeader))
+        return true;
+
+    BlockFilter filter(BLOCK_FILTER_BASIC, block, blockundo);
+    try {
+        if (!pblockfilterindex->WriteFilter(filter, filter.ComputeHeader(hashPrevHeader)))
+            return false;
+    } catch (const leveldb_error& e) {
+        return error("%s : %s", __func__, e.what());
+    }
+    fIndexed = true;
+    return true;
+}
+
+bool BlockFilterIndexConnect(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex)
+{
+    if (!pblockfilterindex)
+        return true;
+
+    bool fIndexed;
+    if (!IndexBlockFilter(block, blockundo, pindex, fIndexed))
+        return error("%s : Failed to write the filter of block %s", __func__, pindex->GetBlockHash().ToString());
+    if (!fIndexed)
+        LogPrint("blockfilter", "%s : Parent of block %s not indexed yet, leaving it to the sync\n", __func__, pindex->GetBlockHash().ToString());
+    return true;
+}
+
+void SyncBlockFilterIndex()
+{
+    if (!pblockfilterindex)
+        return;
+
+    // Resume from where the active chain forks off the last indexed block
+    int nHeight = 0;
+    {
+        LOCK(cs_main);
+        uint256 hashBest;
+        if (pblockfilterindex->ReadBestBlock(hashBest)) {
+            BlockMap::const_iterator it = mapBlockIndex.find(hashBest);
+            if (it != mapBlockIndex.end()) {
+                const CBlockIndex* pfork = chainActive.FindFork(it->second);
+                if (pfork)
+                    nHeight = pfork->nHeight;
+            }
+        }
+    }
+
+    int nIndexed = 0;
+    int64_t nLastLog = GetTime();
+    LogPrintf("Syncing block filter index from height %d\n", nHeight);
+
+    while (true) {
+        boost::this_thread::interruption_point();
+
+        const CBlockIndex* pindex;
+        CDiskBlockPos undoPos;
+        {
+            LOCK(cs_main);
+            pindex = chainActive[nHeight];
+            if (!pindex) {
+                fSynced = true;
+                break;
+            }
+            if (pblockfilterindex->HasFilter(pindex->GetBlockHash())) {
+                nHeight++;
+                continue;
+            }
+            undoPos = pindex->GetUndoPos();
+        }
+
+        CBlock block;
+        CBlockUndo blockundo;
+        if (!ReadBlockFromDisk(block, pindex)) {
+            LogPrintf("%s : Failed to read block %s, stopping\n", __func__, pindex->GetBlockHash().ToString());
+            return;
+        }
+        if (pindex->pprev && (undoPos.IsNull() || !blockundo.ReadFromDisk(undoPos, pindex->pprev->GetBlockHash()))) {
+            LogPrintf("%s : Failed to read undo data of block %s, stopping\n", __func__, pindex->GetBlockHash().ToString());
+            return;
+        }
+
+        bool fIndexed;
+        if (!IndexBlockFilter(block, blockundo, pindex, fIndexed)) {
+            LogPrintf("%s : Failed to write the filter of block %s, stopping\n", __func__, pindex->GetBlockHash().ToString());
+            return;
+        }
+        if (!fIndexed) {
+            // the parent was reorganized away underneath us, go back to it
+            nHeight = std::max(nHeight - 1, 0);
+            continue;
+        }
+        nIndexed++;
+        nHeight++;
+
+        if (GetTime() >= nLastLog + 30) {
+            LogPrintf("Syncing block filter index at height %d\n", nHeight);
+            nLastLog = GetTime();
+        }
+    }
+
+    LogPrintf("Block filter index synced, %d filters built\n", nIndexed);
+}
+
+bool IsBlockFilterIndexSynced()
+{
+    LOCK(cs_main);
+    return pblockfilterindex && fSynced;
+}
@@ -0,0 +1,71 @@
+// Copyright (c) 2018 The Blocknet developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BLOCKFILTERINDEX_H
+#define BLOCKFILTERINDEX_H
+
+#include "blockfilter.h"
+#include "leveldbwrapper.h"
+#include "uint256.h"
+
+class CBlock;
+class CBlockIndex;
+class CBlockUndo;
+class CBlockFilterIndexDB;
+
+extern CBlockFilterIndexDB* pblockfilterindex;
+
+static const bool DEFAULT_BLOCKFILTERINDEX = false;
+static const bool DEFAULT_PEERBLOCKFILTERS = false;
+
+//! leveldb cache of the filter index
+static const size_t BLOCKFILTERINDEX_DB_CACHE = 8 << 20;
+
+/** Maximum number of filters served for one getcfilters request */
+static const uint32_t MAX_GETCFILTERS_SIZE = 1000;
+/** Maximum number of filter hashes served for one getcfheaders request */
+static const uint32_t MAX_GETCFHEADERS_SIZE = 2000;
+/** Distance between the filter headers of a cfcheckpt message */
+static const int CFCHECKPT_INTERVAL = 1000;
+
+/**
+ * Index of the BIP 158 basic filter of every block (datadir/blockfilter),
+ * along with its BIP 157 filter header. Entries are keyed by block hash, so
+ * the ones of blocks that were disconnected stay valid and nothing has to be
+ * undone on a reorg.
+ */
+class CBlockFilterIndexDB : public CLevelDBWrapper
+{
+public:
+    CBlockFilterIndexDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+
+    /** Store a filter and its header, and remember its block as the last one indexed */
+    bool WriteFilter(const BlockFilter& filter, const uint256& header);
+
+    bool ReadFilter(const uint256& hashBlock, BlockFilter& filter) const;
+    bool ReadFilterHash(const uint256& hashBlock, uint256& hash) const;
+    bool ReadFilterHeader(const uint256& hashBlock, uint256& header) const;
+    bool HasFilter(const uint256& hashBlock) const;
+
+    /** The block whose filter was written last, a hint for where to resume syncing */
+    bool ReadBestBlock(uint256& hashBlock) const;
+};
+
+/**
+ * Index the filter of a block that is being connected. Blocks whose parent is
+ * not indexed yet are skipped, SyncBlockFilterIndex fills them in.
+ */
+bool BlockFilterIndexConnect(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex);
+
+/**
+ * Index the active chain blocks that were connected while the index was
+ * disabled, reading them and their undo data back from disk. Run by the
+ * import thread once the blocks on disk were loaded.
+ */
+void SyncBlockFilterIndex();
+
+/** Whether every block of the active chain was indexed at some point since startup */
+bool IsBlockFilterIndexSynced();
+
+#endif
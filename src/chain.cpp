@@ -5,6 +5,8 @@
 
 #include "chain.h"
 
+#include <algorithm>
+
 using namespace std;
 
 /**
@@ -61,6 +63,18 @@ const CBlockIndex* CChain::FindFork(const CBlockIndex* pindex) const
     return pindex;
 }
 
+static bool BlockTimeMaxLess(const CBlockIndex* pindex, int64_t nTime)
+{
+    return pindex->GetBlockTimeMax() < nTime;
+}
+
+CBlockIndex* CChain::FindEarliestAtLeast(int64_t nTime) const
+{
+    // nTimeMax never decreases along the chain, so it can be searched directly
+    std::vector<CBlockIndex*>::const_iterator lower = std::lower_bound(vChain.begin(), vChain.end(), nTime, BlockTimeMaxLess);
+    return (lower == vChain.end() ? NULL : *lower);
+}
+
 uint256 CBlockIndex::GetBlockTrust() const
 {
     uint256 bnTarget;
@@ -169,6 +169,12 @@ public:
 
         convertSeed6(vFixedSeeds, pnSeed6_main, ARRAYLEN(pnSeed6_main));
 
+        // UTXO snapshots are reviewed like checkpoints: the hash_serialized that
+        // gettxoutsetinfo reports at the block, by height. None is trusted yet.
+        // A snapshot only spares connecting blocks a node already stores, it
+        // can't bootstrap a fresh node without headers-first sync.
+        mapUTXOSnapshots.clear();
+
         fRequireRPCPassword = true;
         fMiningRequiresPeers = true;
         fAllowMinDifficultyBlocks = false;
@@ -248,6 +254,7 @@ public:
         base58Prefixes[EXT_COIN_TYPE] = boost::assign::list_of(0x80)(0x00)(0x00)(0x01).convert_to_container<std::vector<unsigned char> >();
 
         convertSeed6(vFixedSeeds, pnSeed6_test, ARRAYLEN(pnSeed6_test));
+        mapUTXOSnapshots.clear(); //! Testnet doesn't trust any UTXO snapshots.
 
         fRequireRPCPassword = true;
         fMiningRequiresPeers = false;
@@ -356,6 +363,7 @@ public:
     virtual void setDefaultConsistencyChecks(bool afDefaultConsistencyChecks) { fDefaultConsistencyChecks = afDefaultConsistencyChecks; }
     virtual void setAllowMinDifficultyBlocks(bool afAllowMinDifficultyBlocks) { fAllowMinDifficultyBlocks = afAllowMinDifficultyBlocks; }
     virtual void setSkipProofOfWorkCheck(bool afSkipProofOfWorkCheck) { fSkipProofOfWorkCheck = afSkipProofOfWorkCheck; }
+    virtual void setUTXOSnapshots(const MapUTXOSnapshots& aUTXOSnapshots) { mapUTXOSnapshots = aUTXOSnapshots; }
 };
 static CUnitTestParams unitTestParams;
 
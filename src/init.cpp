@@ -15,16 +15,21 @@
 #include "activeservicenode.h"
 #include "addrman.h"
 #include "amount.h"
+#include "blockfilecache.h"
+#include "blockfilterindex.h"
 #include "checkpoints.h"
 #include "compat/sanity.h"
+#include "crypto/sha256.h"
 #include "key.h"
 #include "main.h"
 #include "servicenode-budget.h"
 #include "servicenode-payments.h"
+#include "servicenodecache.h"
 #include "servicenodeconfig.h"
 #include "servicenodeman.h"
 #include "miner.h"
 #include "net.h"
+#include "packetverifier.h"
 #include "rpcserver.h"
 #include "script/standard.h"
 #include "spork.h"
@@ -32,6 +37,7 @@
 #include "ui_interface.h"
 #include "util.h"
 #include "utilmoneystr.h"
+#include "utxosnapshot.h"
 #include "validationinterface.h"
 #include "xbridge/xbridgeapp.h"
 #include "xrouter/xrouterapp.h"
@@ -160,13 +166,15 @@ public:
     // Writes do not need similar protection, as failure to write is handled by the caller.
 };
 
-static CCoinsViewDB* pcoinsdbview = NULL;
 static CCoinsViewErrorCatcher* pcoinscatcher = NULL;
 static std::unique_ptr<ECCVerifyHandle> globalVerifyHandle;
 
 /** Preparing steps before shutting down or restarting the wallet */
 void PrepareShutdown()
 {
+    // Stop verifying packets before xbridge and xrouter shut down
+    packetVerifier.Stop();
+
     // Shutdown xbridge
     xbridge::App::instance().cancelMyXBridgeTransactions();
     xbridge::App::instance().disconnectWallets();
@@ -199,7 +207,11 @@ void PrepareShutdown()
     DumpServicenodes();
     DumpBudgets();
     DumpServicenodePayments();
+    delete psncachedb;
+    psncachedb = NULL;
     UnregisterNodeSignals(GetNodeSignals());
+    // Deliver notifications still queued for the wallet and ZMQ
+    SyncWithValidationInterfaceQueue();
 
     if (fFeeEstimatesInitialized) {
         boost::filesystem::path est_path = GetDataDir() / FEE_ESTIMATES_FILENAME;
@@ -227,7 +239,11 @@ void PrepareShutdown()
         pcoinsdbview = NULL;
         delete pblocktree;
         pblocktree = NULL;
+        delete pblockfilterindex;
+        pblockfilterindex = NULL;
     }
+    delete pblockfilecache;
+    pblockfilecache = NULL;
 #ifdef ENABLE_WALLET
     if (pwalletMain)
         bitdb.Flush(true);
@@ -328,8 +344,14 @@ std::string HelpMessage(HelpMessageMode mode)
     string strUsage = HelpMessageGroup(_("Options:"));
     strUsage += HelpMessageOpt("-?", _("This help message"));
     strUsage += HelpMessageOpt("-version", _("Print version and exit"));
+    strUsage += HelpMessageOpt("-addressindex", strprintf(_("Maintain an index of outputs, spends and balances by address, used by the getaddress* rpc calls and XRouter xrGetBalance (default: %u)"), DEFAULT_ADDRESSINDEX));
     strUsage += HelpMessageOpt("-alertnotify=<cmd>", _("Execute command when a relevant alert is received or we see a really long fork (%s in cmd is replaced by message)"));
     strUsage += HelpMessageOpt("-alerts", strprintf(_("Receive and display P2P network alerts (default: %u)"), DEFAULT_ALERTS));
+    strUsage += HelpMessageOpt("-blockfilecache=<n>", strprintf(_("Keep up to <n> block and undo files open for reading blocks, transactions and undo data (0 to disable, default: %u)"), DEFAULT_BLOCKFILECACHE));
+#ifndef WIN32
+    strUsage += HelpMessageOpt("-blockfilemmap", strprintf(_("Map the cached block and undo files into memory (default: %u)"), DEFAULT_BLOCKFILEMMAP));
+#endif
+    strUsage += HelpMessageOpt("-blockfilterindex", strprintf(_("Maintain an index of BIP 158 basic block filters, used by the getblockfilter rpc call and XRouter xrGetBlockFilters (default: %u)"), DEFAULT_BLOCKFILTERINDEX));
     strUsage += HelpMessageOpt("-blocknotify=<cmd>", _("Execute command when the best block changes (%s in cmd is replaced by block hash)"));
     strUsage += HelpMessageOpt("-checkblocks=<n>", strprintf(_("How many blocks to check at startup (default: %u, 0 = all)"), 500));
     strUsage += HelpMessageOpt("-checklevel=<n>", strprintf(_("How thorough the block verification of -checkblocks is (0-4, default: %u)"), 3));
@@ -343,6 +365,7 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-dbcache=<n>", strprintf(_("Set database cache size in megabytes (%d to %d, default: %d)"), nMinDbCache, nMaxDbCache, nDefaultDbCache));
     strUsage += HelpMessageOpt("-loadblock=<file>", _("Imports blocks from external blk000??.dat file") + " " + _("on startup"));
     strUsage += HelpMessageOpt("-maxorphantx=<n>", strprintf(_("Keep at most <n> unconnectable transactions in memory (default: %u)"), DEFAULT_MAX_ORPHAN_TRANSACTIONS));
+    strUsage += HelpMessageOpt("-maxvalidationqueue=<n>", strprintf(_("Let at most <n> wallet and ZMQ notifications queue up before block connection waits for them (default: %u)"), DEFAULT_VALIDATION_QUEUE_SIZE));
     strUsage += HelpMessageOpt("-par=<n>", strprintf(_("Set the number of script verification threads (%u to %d, 0 = auto, <0 = leave that many cores free, default: %d)"), -(int)boost::thread::hardware_concurrency(), MAX_SCRIPTCHECK_THREADS, DEFAULT_SCRIPTCHECK_THREADS));
 #ifndef WIN32
     strUsage += HelpMessageOpt("-pid=<file>", strprintf(_("Specify pid file (default: %s)"), "blocknetdxd.pid"));
@@ -369,9 +392,12 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-maxconnections=<n>", strprintf(_("Maintain at most <n> connections to peers (default: %u)"), 125));
     strUsage += HelpMessageOpt("-maxreceivebuffer=<n>", strprintf(_("Maximum per-connection receive buffer, <n>*1000 bytes (default: %u)"), 5000));
     strUsage += HelpMessageOpt("-maxsendbuffer=<n>", strprintf(_("Maximum per-connection send buffer, <n>*1000 bytes (default: %u)"), 1000));
+    strUsage += HelpMessageOpt("-msghandlerthreads=<n>", strprintf(_("Number of threads processing peer messages, the messages of each peer are processed in order (1 to %d, default: %d)"), MAX_MESSAGE_HANDLER_THREADS, DEFAULT_MESSAGE_HANDLER_THREADS));
     strUsage += HelpMessageOpt("-onion=<ip:port>", strprintf(_("Use separate SOCKS5 proxy to reach peers via Tor hidden services (default: %s)"), "-proxy"));
     strUsage += HelpMessageOpt("-onlynet=<net>", _("Only connect to nodes in network <net> (ipv4, ipv6 or onion)"));
+    strUsage += HelpMessageOpt("-packetverifythreads=<n>", strprintf(_("Number of threads verifying XRouter and XBridge packet signatures (0 = one per core, at most %d, default: %d)"), MAX_PACKET_VERIFY_THREADS, DEFAULT_PACKET_VERIFY_THREADS));
     strUsage += HelpMessageOpt("-permitbaremultisig", strprintf(_("Relay non-P2SH multisig (default: %u)"), 1));
+    strUsage += HelpMessageOpt("-peerblockfilters", strprintf(_("Serve compact block filters to peers per BIP 157, requires -blockfilterindex (default: %u)"), DEFAULT_PEERBLOCKFILTERS));
     strUsage += HelpMessageOpt("-peerbloomfilters", strprintf(_("Support filtering of blocks and transaction with bloom filters (default: %u)"), false));
     strUsage += HelpMessageOpt("-port=<port>", strprintf(_("Listen for connections on <port> (default: %u or testnet: %u)"), 41412, 41474));
     strUsage += HelpMessageOpt("-proxy=<ip:port>", _("Connect through SOCKS5 proxy"));
@@ -420,8 +446,10 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-zmqpubhashtx=<address>", _("Enable publish hash transaction in <address>"));
     strUsage += HelpMessageOpt("-zmqpubhashtxlock=<address>", _("Enable publish hash transaction (locked via SwiftTX) in <address>"));
     strUsage += HelpMessageOpt("-zmqpubrawblock=<address>", _("Enable publish raw block in <address>"));
+    strUsage += HelpMessageOpt("-zmqpubrawblockheader=<address>", _("Enable publish raw block header in <address>"));
     strUsage += HelpMessageOpt("-zmqpubrawtx=<address>", _("Enable publish raw transaction in <address>"));
     strUsage += HelpMessageOpt("-zmqpubrawtxlock=<address>", _("Enable publish raw transaction (locked via SwiftTX) in <address>"));
+    strUsage += HelpMessageOpt("-zmqpubrawxbridgeorder=<address>", _("Enable publish XBridge order updates in <address>"));
 #endif
 
     strUsage += HelpMessageGroup(_("Debugging/Testing options:"));
@@ -438,7 +466,7 @@ std::string HelpMessage(HelpMessageMode mode)
         strUsage += HelpMessageOpt("-stopafterblockimport", strprintf(_("Stop running after importing blocks from disk (default: %u)"), 0));
         strUsage += HelpMessageOpt("-sporkkey=<privkey>", _("Enable spork administration functionality with the appropriate private key."));
     }
-    string debugCategories = "addrman, alert, bench, coindb, db, lock, rand, rpc, selectcoins, mempool, net, blocknetdx, (obfuscation, swifttx, servicenode, mnpayments, mnbudget)"; // Don't translate these and qt below
+    string debugCategories = "addrman, alert, bench, blockfilter, coindb, db, lock, rand, rpc, selectcoins, mempool, net, blocknetdx, (obfuscation, swifttx, servicenode, mnpayments, mnbudget)"; // Don't translate these and qt below
     if (mode == HMM_BITCOIN_QT)
         debugCategories += ", qt";
     strUsage += HelpMessageOpt("-debug=<category>", strprintf(_("Output debugging information (default: %u, supplying <category> is optional)"), 0) + ". " +
@@ -629,6 +657,8 @@ void ThreadImport(std::vector<boost::filesystem::path> vImportFiles)
         LogPrintf("Stopping after block import\n");
         StartShutdown();
     }
+
+    SyncBlockFilterIndex();
 }
 
 /** Sanity checks
@@ -916,11 +946,17 @@ bool AppInit2(int argc, char* argv[], boost::thread_group& threadGroup)
     if (GetBoolArg("-peerbloomfilters", false))
         nLocalServices |= NODE_BLOOM;
 
+    if (GetBoolArg("-peerblockfilters", DEFAULT_PEERBLOCKFILTERS)) {
+        if (!GetBoolArg("-blockfilterindex", DEFAULT_BLOCKFILTERINDEX))
+            return InitError(_("Cannot set -peerblockfilters without -blockfilterindex."));
+        nLocalServices |= NODE_COMPACT_FILTERS;
+    }
+
     // ********************************************************* Step 4: application initialization: dir lock, daemonize, pidfile, debug log
 
     // Initialize elliptic curve code
-    // std::string sha256_algo = SHA256AutoDetect();
-    // LogPrintf("Using the '%s' SHA256 implementation\n", sha256_algo);
+    std::string sha256_algo = SHA256AutoDetect();
+    LogPrintf("Using the '%s' SHA256 implementation\n", sha256_algo);
 
     RandomInit();
 
@@ -971,6 +1007,19 @@ bool AppInit2(int argc, char* argv[], boost::thread_group& threadGroup)
             threadGroup.create_thread(&ThreadScriptCheck);
     }
 
+    threadGroup.create_thread(boost::bind(&TraceThread<void (*)()>, "valqueue", &ThreadValidationQueue));
+
+    // XRouter/XBridge packet signatures, the cache shares the script signature cache limit
+    packetSignatureCache.SetMaxSize(GetArg("-maxsigcachesize", 50000));
+    int nPacketVerifyThreads = GetArg("-packetverifythreads", DEFAULT_PACKET_VERIFY_THREADS);
+    if (nPacketVerifyThreads <= 0)
+        nPacketVerifyThreads = boost::thread::hardware_concurrency();
+    nPacketVerifyThreads = std::max(1, std::min(nPacketVerifyThreads, MAX_PACKET_VERIFY_THREADS));
+    LogPrintf("Using %u threads for packet verification\n", nPacketVerifyThreads);
+    packetVerifier.Start(nPacketVerifyThreads, WakeMessageHandler);
+    for (int i = 0; i < nPacketVerifyThreads; i++)
+        threadGroup.create_thread(&ThreadPacketVerify);
+
     if (mapArgs.count("-sporkkey")) // spork priv key
     {
         if (!sporkManager.SetPrivKey(GetArg("-sporkkey", "")))
@@ -1255,7 +1304,23 @@ bool AppInit2(int argc, char* argv[], boost::thread_group& threadGroup)
     nTotalCache -= nBlockTreeDBCache;
     size_t nCoinDBCache = nTotalCache / 2; // use half of the remaining cache for coindb cache
     nTotalCache -= nCoinDBCache;
-    nCoinCacheSize = nTotalCache / 300; // coins in memory require around 300 bytes
+    nCoinCacheUsage = nTotalCache;
+
+    int nBlockFileCache = GetArg("-blockfilecache", DEFAULT_BLOCKFILECACHE);
+    if (nBlockFileCache > 0) {
+        bool fBlockFileMmap = GetBoolArg("-blockfilemmap", DEFAULT_BLOCKFILEMMAP);
+        pblockfilecache = new CBlockFileCache(nBlockFileCache, fBlockFileMmap);
+        LogPrintf("Caching up to %d block files for reading%s\n", nBlockFileCache, fBlockFileMmap ? ", memory mapped" : "");
+    }
+
+    // Filters only depend on their block, so the index survives a -reindex as is
+    if (GetBoolArg("-blockfilterindex", DEFAULT_BLOCKFILTERINDEX)) {
+        try {
+            pblockfilterindex = new CBlockFilterIndexDB(BLOCKFILTERINDEX_DB_CACHE);
+        } catch (const leveldb_error& e) {
+            return InitError(strprintf(_("Error opening block filter index: %s"), e.what()));
+        }
+    }
 
     bool fLoaded = false;
     while (!fLoaded) {
@@ -1291,6 +1356,13 @@ bool AppInit2(int argc, char* argv[], boost::thread_group& threadGroup)
                 if (!mapBlockIndex.empty() && mapBlockIndex.count(Params().HashGenesisBlock()) == 0)
                     return InitError(_("Incorrect or no genesis block found. Wrong datadir for network?"));
 
+                // A snapshot that was only partly loaded left the coin database unusable
+                bool fSnapshotLoading = false;
+                if (pblocktree->ReadFlag("utxosnapshotloading", fSnapshotLoading) && fSnapshotLoading) {
+                    strLoadError = _("Loading a UTXO snapshot was interrupted, you need to rebuild the database");
+                    break;
+                }
+
                 // Initialize the block index (no-op if non-empty database was already loaded)
                 if (!InitBlockIndex()) {
                     strLoadError = _("Error initializing block database");
@@ -1303,6 +1375,12 @@ bool AppInit2(int argc, char* argv[], boost::thread_group& threadGroup)
                     break;
                 }
 
+                // Check for changed -addressindex state
+                if (fAddressIndex != GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX)) {
+                    strLoadError = _("You need to rebuild the database using -reindex to change -addressindex");
+                    break;
+                }
+
                 uiInterface.InitMessage(_("Verifying blocks..."));
                 if (!CVerifyDB().VerifyDB(pcoinsdbview, GetArg("-checklevel", 3),
                         GetArg("-checkblocks", 500))) {
@@ -1492,6 +1570,7 @@ bool AppInit2(int argc, char* argv[], boost::thread_group& threadGroup)
             vImportFiles.push_back(strFile);
     }
     threadGroup.create_thread(boost::bind(&ThreadImport, vImportFiles));
+    threadGroup.create_thread(boost::bind(&TraceThread<void (*)()>, "utxoval", &ThreadValidateUTXOSnapshot));
     if (chainActive.Tip() == NULL) {
         LogPrintf("Waiting for genesis block to be imported...\n");
         while (!fRequestShutdown && chainActive.Tip() == NULL)
@@ -1502,12 +1581,18 @@ bool AppInit2(int argc, char* argv[], boost::thread_group& threadGroup)
 
     uiInterface.InitMessage(_("Loading servicenode cache..."));
 
+    try {
+        psncachedb = new CServicenodeCacheDB(SNCACHE_DB_CACHE);
+    } catch (const leveldb_error& e) {
+        return InitError(strprintf(_("Error opening servicenode cache database: %s"), e.what()));
+    }
+
     CServicenodeDB mndb;
     CServicenodeDB::ReadResult readResult = mndb.Read(mnodeman);
     if (readResult == CServicenodeDB::FileError)
-        LogPrintf("Missing servicenode cache file - mncache.dat, will try to recreate\n");
+        LogPrintf("Missing servicenode cache, will try to recreate\n");
     else if (readResult != CServicenodeDB::Ok) {
-        LogPrintf("Error reading mncache.dat: ");
+        LogPrintf("Error reading servicenode cache: ");
         if (readResult == CServicenodeDB::IncorrectFormat)
             LogPrintf("magic is ok but data has invalid format, will try to recreate\n");
         else
@@ -1520,9 +1605,9 @@ bool AppInit2(int argc, char* argv[], boost::thread_group& threadGroup)
     CBudgetDB::ReadResult readResult2 = budgetdb.Read(budget);
 
     if (readResult2 == CBudgetDB::FileError)
-        LogPrintf("Missing budget cache - budget.dat, will try to recreate\n");
+        LogPrintf("Missing budget cache, will try to recreate\n");
     else if (readResult2 != CBudgetDB::Ok) {
-        LogPrintf("Error reading budget.dat: ");
+        LogPrintf("Error reading budget cache: ");
         if (readResult2 == CBudgetDB::IncorrectFormat)
             LogPrintf("magic is ok but data has invalid format, will try to recreate\n");
         else
@@ -1540,9 +1625,9 @@ bool AppInit2(int argc, char* argv[], boost::thread_group& threadGroup)
     CServicenodePaymentDB::ReadResult readResult3 = mnpayments.Read(servicenodePayments);
 
     if (readResult3 == CServicenodePaymentDB::FileError)
-        LogPrintf("Missing servicenode payment cache - mnpayments.dat, will try to recreate\n");
+        LogPrintf("Missing servicenode payment cache, will try to recreate\n");
     else if (readResult3 != CServicenodePaymentDB::Ok) {
-        LogPrintf("Error reading mnpayments.dat: ");
+        LogPrintf("Error reading servicenode payment cache: ");
         if (readResult3 == CServicenodePaymentDB::IncorrectFormat)
             LogPrintf("magic is ok but data has invalid format, will try to recreate\n");
         else
@@ -163,6 +163,12 @@ public:
         return WriteBatch(batch, true);
     }
 
+    //! Reclaim the space of erased and overwritten entries now rather than when leveldb gets to it
+    void Compact()
+    {
+        pdb->CompactRange(NULL, NULL);
+    }
+
     // not exactly clean encapsulation, but it's easiest for now
     leveldb::Iterator* NewIterator()
     {
@@ -11,6 +11,8 @@
 
 #include "addrman.h"
 #include "alert.h"
+#include "blockfilecache.h"
+#include "blockfilterindex.h"
 #include "chainparams.h"
 #include "checkpoints.h"
 #include "checkqueue.h"
@@ -30,10 +32,14 @@
 #include "ui_interface.h"
 #include "util.h"
 #include "utilmoneystr.h"
+#include "validationinterface.h"
 #include "xbridge/xbridgeapp.h"
 #include "xrouter/xrouterapp.h"
 #include "coinvalidator.h"
 
+#include <atomic>
+#include <limits>
+#include <memory>
 #include <sstream>
 
 #include <boost/algorithm/string/replace.hpp>
@@ -68,9 +74,10 @@ int nScriptCheckThreads = 0;
 bool fImporting = false;
 bool fReindex = false;
 bool fTxIndex = true;
+bool fAddressIndex = false;
 bool fIsBareMultisigStd = true;
 bool fCheckBlockIndex = false;
-unsigned int nCoinCacheSize = 5000;
+size_t nCoinCacheUsage = 5000 * 300;
 bool fAlerts = DEFAULT_ALERTS;
 CoinValidator &coinValidator = CoinValidator::instance();
 
@@ -177,6 +184,44 @@ set<CBlockIndex*> setDirtyBlockIndex;
 
 /** Dirty block file entries. */
 set<int> setDirtyFileInfo;
+
+/**
+ * Storage for all CBlockIndex entries. Entries are placed in large
+ * contiguous chunks instead of one heap allocation each, and live until
+ * shutdown, so their addresses stay valid. Protected by cs_main.
+ */
+class CBlockIndexArena
+{
+private:
+    static const size_t nChunkSize = 8192;
+    std::vector<CBlockIndex*> vChunks;
+    size_t nUsed;
+
+public:
+    CBlockIndexArena() : nUsed(nChunkSize) {}
+    ~CBlockIndexArena()
+    {
+        for (size_t i = 0; i < vChunks.size(); i++) {
+            size_t nCount = (i + 1 == vChunks.size()) ? nUsed : nChunkSize;
+            for (size_t j = 0; j < nCount; j++)
+                vChunks[i][j].~CBlockIndex();
+            ::operator delete(vChunks[i]);
+        }
+    }
+
+    template <typename... Args>
+    CBlockIndex* New(Args&&... args)
+    {
+        if (nUsed == nChunkSize) {
+            vChunks.push_back(static_cast<CBlockIndex*>(::operator new(nChunkSize * sizeof(CBlockIndex))));
+            nUsed = 0;
+        }
+        CBlockIndex* pindex = new (vChunks.back() + nUsed) CBlockIndex(std::forward<Args>(args)...);
+        nUsed++;
+        return pindex;
+    }
+};
+CBlockIndexArena blockIndexArena;
 } // anon namespace
 
 //////////////////////////////////////////////////////////////////////////////
@@ -309,6 +354,13 @@ struct CNodeState {
 /** Map maintaining per-node state. Requires cs_main. */
 map<NodeId, CNodeState> mapNodeState;
 
+/**
+ * Misbehavior reported by message handlers that do not hold cs_main, added to
+ * the CNodeState scores by ApplyPendingMisbehavior.
+ */
+CCriticalSection cs_pendingMisbehavior;
+map<NodeId, int> mapPendingMisbehavior;
+
 // Requires cs_main.
 CNodeState* State(NodeId pnode)
 {
@@ -318,15 +370,28 @@ CNodeState* State(NodeId pnode)
     return &it->second;
 }
 
-int GetHeight()
+// Requires cs_main.
+void ApplyPendingMisbehavior()
 {
-    while (true) {
-        TRY_LOCK(cs_main, lockMain);
-        if (!lockMain) {
-            MilliSleep(50);
+    map<NodeId, int> mapPending;
+    {
+        LOCK(cs_pendingMisbehavior);
+        mapPending.swap(mapPendingMisbehavior);
+    }
+
+    int banscore = GetArg("-banscore", 100);
+    for (map<NodeId, int>::const_iterator it = mapPending.begin(); it != mapPending.end(); ++it) {
+        CNodeState* state = State(it->first);
+        if (state == NULL)
             continue;
-        }
-        return chainActive.Height();
+
+        int howmuch = it->second;
+        state->nMisbehavior += howmuch;
+        if (state->nMisbehavior >= banscore && state->nMisbehavior - howmuch < banscore) {
+            LogPrintf("Misbehaving: %s (%d -> %d) BAN THRESHOLD EXCEEDED\n", state->name, state->nMisbehavior - howmuch, state->nMisbehavior);
+            state->fShouldBan = true;
+        } else
+            LogPrintf("Misbehaving: %s (%d -> %d)\n", state->name, state->nMisbehavior - howmuch, state->nMisbehavior);
     }
 }
 
@@ -352,6 +417,7 @@ void InitializeNode(NodeId nodeid, const CNode* pnode)
 void FinalizeNode(NodeId nodeid)
 {
     LOCK(cs_main);
+    ApplyPendingMisbehavior();
     CNodeState* state = State(nodeid);
 
     if (state->fSyncStarted)
@@ -543,6 +609,7 @@ void FindNextBlocksToDownload(NodeId nodeid, unsigned int count, std::vector<CBl
 bool GetNodeStateStats(NodeId nodeid, CNodeStateStats& stats)
 {
     LOCK(cs_main);
+    ApplyPendingMisbehavior();
     CNodeState* state = State(nodeid);
     if (state == NULL)
         return false;
@@ -561,6 +628,7 @@ void RegisterNodeSignals(CNodeSignals& nodeSignals)
     nodeSignals.GetHeight.connect(&GetHeight);
     nodeSignals.ProcessMessages.connect(&ProcessMessages);
     nodeSignals.SendMessages.connect(&SendMessages);
+    nodeSignals.ProcessQueuedTransactions.connect(&ProcessQueuedTransactions);
     nodeSignals.InitializeNode.connect(&InitializeNode);
     nodeSignals.FinalizeNode.connect(&FinalizeNode);
 }
@@ -570,6 +638,7 @@ void UnregisterNodeSignals(CNodeSignals& nodeSignals)
     nodeSignals.GetHeight.disconnect(&GetHeight);
     nodeSignals.ProcessMessages.disconnect(&ProcessMessages);
     nodeSignals.SendMessages.disconnect(&SendMessages);
+    nodeSignals.ProcessQueuedTransactions.disconnect(&ProcessQueuedTransactions);
     nodeSignals.InitializeNode.disconnect(&InitializeNode);
     nodeSignals.FinalizeNode.disconnect(&FinalizeNode);
 }
@@ -589,6 +658,7 @@ CBlockIndex* FindForkInGlobalIndex(const CChain& chain, const CBlockLocator& loc
 }
 
 CCoinsViewCache* pcoinsTip = NULL;
+CCoinsViewDB* pcoinsdbview = NULL;
 CBlockTreeDB* pblocktree = NULL;
 
 //////////////////////////////////////////////////////////////////////////////
@@ -890,6 +960,7 @@ int GetInputAgeIX(uint256 nTXHash, CTxIn& vin)
     if (nResult < 0) nResult = 0;
 
     if (nResult < 6) {
+        LOCK(cs_swifttx);
         std::map<uint256, CTransactionLock>::iterator i = mapTxLocks.find(nTXHash);
         if (i != mapTxLocks.end()) {
             sigs = (*i).second.CountSignatures();
@@ -906,6 +977,7 @@ int GetIXConfirmations(uint256 nTXHash)
 {
     int sigs = 0;
 
+    LOCK(cs_swifttx);
     std::map<uint256, CTransactionLock>::iterator i = mapTxLocks.find(nTXHash);
     if (i != mapTxLocks.end()) {
         sigs = (*i).second.CountSignatures();
@@ -1115,9 +1187,28 @@ CAmount GetMinRelayFee(const CTransaction& tx, unsigned int nBytes, bool fAllowF
 }
 
 
-bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState& state, const CTransaction& tx, bool fLimitFree, bool* pfMissingInputs, bool fRejectInsaneFee, bool ignoreFees)
+/** Script checks of ConnectBlock and AcceptToMemoryPool, both run under cs_main so they never share it */
+static CCheckQueue<CScriptCheck> scriptcheckqueue(128);
+
+/** A transaction on its way into the memory pool, with what its checks found out about it */
+struct CMemPoolCandidate {
+    const CTransaction& tx;
+    CValidationState& state;
+    CCoinsView dummy;
+    //! the inputs of tx, cut off from pcoinsTip and the pool once fetched
+    CCoinsViewCache view;
+    CTxMemPoolEntry entry;
+    bool fScriptsOk;
+
+    CMemPoolCandidate(const CTransaction& txIn, CValidationState& stateIn) : tx(txIn), state(stateIn), view(&dummy), fScriptsOk(false) {}
+};
+
+/** Everything AcceptToMemoryPool checks before the scripts, fetching the inputs of the candidate along the way */
+static bool MemPoolPreChecks(CTxMemPool& pool, CMemPoolCandidate& candidate, bool fLimitFree, bool* pfMissingInputs, bool fRejectInsaneFee, bool ignoreFees)
 {
     AssertLockHeld(cs_main);
+    const CTransaction& tx = candidate.tx;
+    CValidationState& state = candidate.state;
     if (pfMissingInputs)
         *pfMissingInputs = false;
 
@@ -1150,12 +1241,15 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState& state, const CTransa
 
     // ----------- swiftTX transaction scanning -----------
 
-    BOOST_FOREACH (const CTxIn& in, tx.vin) {
-        if (mapLockedInputs.count(in.prevout)) {
-            if (mapLockedInputs[in.prevout] != tx.GetHash()) {
-                return state.DoS(0,
-                    error("AcceptToMemoryPool : conflicts with existing transaction lock: %s", reason),
-                    REJECT_INVALID, "tx-lock-conflict");
+    {
+        LOCK(cs_swifttx);
+        BOOST_FOREACH (const CTxIn& in, tx.vin) {
+            if (mapLockedInputs.count(in.prevout)) {
+                if (mapLockedInputs[in.prevout] != tx.GetHash()) {
+                    return state.DoS(0,
+                        error("AcceptToMemoryPool : conflicts with existing transaction lock: %s", reason),
+                        REJECT_INVALID, "tx-lock-conflict");
+                }
             }
         }
     }
@@ -1174,8 +1268,8 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState& state, const CTransa
 
 
     {
-        CCoinsView dummy;
-        CCoinsViewCache view(&dummy);
+        CCoinsView& dummy = candidate.dummy;
+        CCoinsViewCache& view = candidate.view;
 
         CAmount nValueIn = 0;
         {
@@ -1241,8 +1335,8 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState& state, const CTransa
         CAmount nFees = nValueIn - nValueOut;
         double dPriority = view.GetPriority(tx, chainActive.Height());
 
-        CTxMemPoolEntry entry(tx, nFees, GetTime(), dPriority, chainActive.Height());
-        unsigned int nSize = entry.GetTxSize();
+        candidate.entry = CTxMemPoolEntry(tx, nFees, GetTime(), dPriority, chainActive.Height());
+        unsigned int nSize = candidate.entry.GetTxSize();
 
         // Don't accept it if it can't get into a block
         // but prioritise dstx and don't check fees for it
@@ -1289,34 +1383,166 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState& state, const CTransa
                 hash.ToString(),
                 nFees, ::minRelayTxFee.GetFee(nSize) * 10000);
 
-        // Check against previous transactions
-        // This is done last to help prevent CPU exhaustion denial-of-service attacks.
-        if (!CheckInputs(tx, state, view, true, STANDARD_SCRIPT_VERIFY_FLAGS, true)) {
-            return error("AcceptToMemoryPool: : ConnectInputs failed %s", hash.ToString());
-        }
+    }
 
-        // Check again against just the consensus-critical mandatory script
-        // verification flags, in case of bugs in the standard flags that cause
-        // transactions to pass as valid when they're actually invalid. For
-        // instance the STRICTENC flag was incorrectly allowing certain
-        // CHECKSIG NOT scripts to pass, even though they were invalid.
-        //
-        // There is a similar check in CreateNewBlock() to prevent creating
-        // invalid blocks, however allowing such transactions into the mempool
-        // can be exploited as a DoS attack.
-        if (!CheckInputs(tx, state, view, true, MANDATORY_SCRIPT_VERIFY_FLAGS, true)) {
-            return error("AcceptToMemoryPool: : BUG! PLEASE REPORT THIS! ConnectInputs failed against MANDATORY but not STANDARD flags %s", hash.ToString());
-        }
+    return true;
+}
 
-        // Store transaction in memory
-        pool.addUnchecked(hash, entry);
+/** Check the scripts of one candidate, recording the failure in its state */
+static bool CheckMemPoolScripts(CMemPoolCandidate& candidate)
+{
+    const CTransaction& tx = candidate.tx;
+    CValidationState& state = candidate.state;
+
+    // Check against previous transactions
+    // This is done last to help prevent CPU exhaustion denial-of-service attacks.
+    if (!CheckInputs(tx, state, candidate.view, true, STANDARD_SCRIPT_VERIFY_FLAGS, true)) {
+        return error("AcceptToMemoryPool: : ConnectInputs failed %s", tx.GetHash().ToString());
+    }
+
+    // Check again against just the consensus-critical mandatory script
+    // verification flags, in case of bugs in the standard flags that cause
+    // transactions to pass as valid when they're actually invalid. For
+    // instance the STRICTENC flag was incorrectly allowing certain
+    // CHECKSIG NOT scripts to pass, even though they were invalid.
+    //
+    // There is a similar check in CreateNewBlock() to prevent creating
+    // invalid blocks, however allowing such transactions into the mempool
+    // can be exploited as a DoS attack.
+    if (!CheckInputs(tx, state, candidate.view, true, MANDATORY_SCRIPT_VERIFY_FLAGS, true)) {
+        return error("AcceptToMemoryPool: : BUG! PLEASE REPORT THIS! ConnectInputs failed against MANDATORY but not STANDARD flags %s", tx.GetHash().ToString());
+    }
+
+    return true;
+}
+
+/** Verify the script checks of all candidates at once on the script check threads, only telling whether all passed */
+static bool CheckMemPoolScriptsParallel(const std::vector<CMemPoolCandidate*>& vCandidates, unsigned int flags)
+{
+    CCheckQueueControl<CScriptCheck> control(&scriptcheckqueue);
+    for (CMemPoolCandidate* pcandidate : vCandidates) {
+        std::vector<CScriptCheck> vChecks;
+        CValidationState stateDummy;
+        if (!CheckInputs(pcandidate->tx, stateDummy, pcandidate->view, true, flags, true, &vChecks))
+            return false;
+        control.Add(vChecks);
+    }
+    return control.Wait();
+}
+
+/**
+ * Check the scripts of the candidates, setting their fScriptsOk. Their input
+ * scripts are verified across the script check threads together, and only if
+ * that finds a failure the candidates are checked one by one to tell which
+ * of them failed and why.
+ */
+static void CheckMemPoolScripts(const std::vector<CMemPoolCandidate*>& vCandidates)
+{
+    unsigned int nInputs = 0;
+    for (CMemPoolCandidate* pcandidate : vCandidates)
+        nInputs += pcandidate->tx.vin.size();
+
+    if (nScriptCheckThreads && nInputs > 1 &&
+        CheckMemPoolScriptsParallel(vCandidates, STANDARD_SCRIPT_VERIFY_FLAGS) &&
+        CheckMemPoolScriptsParallel(vCandidates, MANDATORY_SCRIPT_VERIFY_FLAGS)) {
+        for (CMemPoolCandidate* pcandidate : vCandidates)
+            pcandidate->fScriptsOk = true;
+        return;
     }
 
-    SyncWithWallets(tx, NULL);
+    for (CMemPoolCandidate* pcandidate : vCandidates)
+        pcandidate->fScriptsOk = CheckMemPoolScripts(*pcandidate);
+}
+
+/** Store a checked candidate, unless a transaction added since its checks already spends one of its inputs */
+static bool AddToMemPool(CTxMemPool& pool, const CMemPoolCandidate& candidate)
+{
+    const CTransaction& tx = candidate.tx;
+    uint256 hash = tx.GetHash();
+    {
+        LOCK(pool.cs);
+        if (pool.exists(hash))
+            return false;
+        for (const CTxIn& txin : tx.vin) {
+            if (pool.mapNextTx.count(txin.prevout))
+                return false;
+        }
+    }
+
+    // Store transaction in memory
+    pool.addUnchecked(hash, candidate.entry);
+
+    SyncWithWallets(tx);
 
     return true;
 }
 
+bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState& state, const CTransaction& tx, bool fLimitFree, bool* pfMissingInputs, bool fRejectInsaneFee, bool ignoreFees)
+{
+    AssertLockHeld(cs_main);
+
+    CMemPoolCandidate candidate(tx, state);
+    if (!MemPoolPreChecks(pool, candidate, fLimitFree, pfMissingInputs, fRejectInsaneFee, ignoreFees))
+        return false;
+
+    CheckMemPoolScripts(std::vector<CMemPoolCandidate*>(1, &candidate));
+    if (!candidate.fScriptsOk)
+        return false;
+
+    return AddToMemPool(pool, candidate);
+}
+
+void AcceptToMemoryPoolBatch(CTxMemPool& pool, const std::vector<CTransaction>& vtx, bool fLimitFree, std::vector<CValidationState>& vState, std::vector<bool>& vAccepted, std::vector<bool>& vMissingInputs)
+{
+    AssertLockHeld(cs_main);
+    vState.assign(vtx.size(), CValidationState());
+    vAccepted.assign(vtx.size(), false);
+    vMissingInputs.assign(vtx.size(), false);
+
+    std::vector<size_t> vPending;
+    for (size_t i = 0; i < vtx.size(); i++)
+        vPending.push_back(i);
+
+    // Every round takes the transactions whose inputs are available by now,
+    // those that only spend the chain, the pool and the transactions accepted
+    // in earlier rounds, and verifies their scripts together.
+    while (true) {
+        std::vector<std::unique_ptr<CMemPoolCandidate> > vRound;
+        std::vector<size_t> vRoundIndex, vWaiting;
+        for (size_t i : vPending) {
+            bool fMissingInputs = false;
+            std::unique_ptr<CMemPoolCandidate> pcandidate(new CMemPoolCandidate(vtx[i], vState[i]));
+            if (MemPoolPreChecks(pool, *pcandidate, fLimitFree, &fMissingInputs, false, false)) {
+                vRound.push_back(std::move(pcandidate));
+                vRoundIndex.push_back(i);
+            } else if (fMissingInputs) {
+                vWaiting.push_back(i);
+            }
+        }
+
+        std::vector<CMemPoolCandidate*> vCandidates;
+        for (const std::unique_ptr<CMemPoolCandidate>& pcandidate : vRound)
+            vCandidates.push_back(pcandidate.get());
+        CheckMemPoolScripts(vCandidates);
+
+        // Insertion stays serial, in the order of vtx
+        unsigned int nAccepted = 0;
+        for (size_t j = 0; j < vRound.size(); j++) {
+            if (vRound[j]->fScriptsOk && AddToMemPool(pool, *vRound[j])) {
+                vAccepted[vRoundIndex[j]] = true;
+                nAccepted++;
+            }
+        }
+
+        if (nAccepted == 0 || vWaiting.empty()) {
+            for (size_t i : vWaiting)
+                vMissingInputs[i] = true;
+            break;
+        }
+        vPending.swap(vWaiting);
+    }
+}
+
 bool AcceptableInputs(CTxMemPool& pool, CValidationState& state, const CTransaction& tx, bool fLimitFree, bool* pfMissingInputs, bool fRejectInsaneFee, bool isDSTX)
 {
     AssertLockHeld(cs_main);
@@ -1346,12 +1572,15 @@ bool AcceptableInputs(CTxMemPool& pool, CValidationState& state, const CTransact
 
     // ----------- swiftTX transaction scanning -----------
 
-    BOOST_FOREACH (const CTxIn& in, tx.vin) {
-        if (mapLockedInputs.count(in.prevout)) {
-            if (mapLockedInputs[in.prevout] != tx.GetHash()) {
-                return state.DoS(0,
-                    error("AcceptableInputs : conflicts with existing transaction lock: %s", reason),
-                    REJECT_INVALID, "tx-lock-conflict");
+    {
+        LOCK(cs_swifttx);
+        BOOST_FOREACH (const CTxIn& in, tx.vin) {
+            if (mapLockedInputs.count(in.prevout)) {
+                if (mapLockedInputs[in.prevout] != tx.GetHash()) {
+                    return state.DoS(0,
+                        error("AcceptableInputs : conflicts with existing transaction lock: %s", reason),
+                        REJECT_INVALID, "tx-lock-conflict");
+                }
             }
         }
     }
@@ -1523,16 +1752,28 @@ bool GetTransaction(const uint256& hash, CTransaction& txOut, uint256& hashBlock
         if (fTxIndex) {
             CDiskTxPos postx;
             if (pblocktree->ReadTxIndex(hash, postx)) {
-                CAutoFile file(OpenBlockFile(postx, true), SER_DISK, CLIENT_VERSION);
-                if (file.IsNull())
-                    return error("%s: OpenBlockFile failed", __func__);
                 CBlockHeader header;
-                try {
-                    file >> header;
-                    fseek(file.Get(), postx.nTxOffset, SEEK_CUR);
-                    file >> txOut;
-                } catch (std::exception& e) {
-                    return error("%s : Deserialize or I/O error - %s", __func__, e.what());
+                CBlockFileRecord record;
+                if (pblockfilecache && pblockfilecache->ReadRecord(postx, "blk", 0, record)) {
+                    try {
+                        CSpanReader reader(record.begin(), record.end(), SER_DISK, CLIENT_VERSION);
+                        reader >> header;
+                        reader.ignore(postx.nTxOffset);
+                        reader >> txOut;
+                    } catch (std::exception& e) {
+                        return error("%s : Deserialize or I/O error - %s", __func__, e.what());
+                    }
+                } else {
+                    CAutoFile file(OpenBlockFile(postx, true), SER_DISK, CLIENT_VERSION);
+                    if (file.IsNull())
+                        return error("%s: OpenBlockFile failed", __func__);
+                    try {
+                        file >> header;
+                        fseek(file.Get(), postx.nTxOffset, SEEK_CUR);
+                        file >> txOut;
+                    } catch (std::exception& e) {
+                        return error("%s : Deserialize or I/O error - %s", __func__, e.what());
+                    }
                 }
                 hashBlock = header.GetHash();
                 if (txOut.GetHash() != hash)
@@ -1604,16 +1845,25 @@ bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos)
 {
     block.SetNull();
 
-    // Open history file to read
-    CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
-    if (filein.IsNull())
-        return error("ReadBlockFromDisk : OpenBlockFile failed");
+    // Read block, straight out of the cached block file if possible
+    CBlockFileRecord record;
+    if (pblockfilecache && pblockfilecache->ReadRecord(pos, "blk", 0, record)) {
+        try {
+            CSpanReader(record.begin(), record.end(), SER_DISK, CLIENT_VERSION) >> block;
+        } catch (std::exception& e) {
+            return error("%s : Deserialize or I/O error - %s", __func__, e.what());
+        }
+    } else {
+        // Open history file to read
+        CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
+        if (filein.IsNull())
+            return error("ReadBlockFromDisk : OpenBlockFile failed");
 
-    // Read block
-    try {
-        filein >> block;
-    } catch (std::exception& e) {
-        return error("%s : Deserialize or I/O error - %s", __func__, e.what());
+        try {
+            filein >> block;
+        } catch (std::exception& e) {
+            return error("%s : Deserialize or I/O error - %s", __func__, e.what());
+        }
     }
 
     // Check the header
@@ -1795,25 +2045,16 @@ void CheckForkWarningConditionsOnNewFork(CBlockIndex* pindexNewForkTip)
     CheckForkWarningConditions();
 }
 
-// Requires cs_main.
 void Misbehaving(NodeId pnode, int howmuch)
 {
     if (howmuch == 0)
         return;
 
-    CNodeState* state = State(pnode);
-    if (state == NULL)
-        return;
-
-    state->nMisbehavior += howmuch;
-    int banscore = GetArg("-banscore", 100);
-    if (state->nMisbehavior >= banscore && state->nMisbehavior - howmuch < banscore) {
-        LogPrintf("Misbehaving: %s (%d -> %d) BAN THRESHOLD EXCEEDED\n", state->name, state->nMisbehavior - howmuch, state->nMisbehavior);
-        state->fShouldBan = true;
-    } else
-        LogPrintf("Misbehaving: %s (%d -> %d)\n", state->name, state->nMisbehavior - howmuch, state->nMisbehavior);
+    LOCK(cs_pendingMisbehavior);
+    mapPendingMisbehavior[pnode] += howmuch;
 }
 
+
 void static InvalidChainFound(CBlockIndex* pindexNew)
 {
     if (!pindexBestInvalid || pindexNew->nChainWork > pindexBestInvalid->nChainWork)
@@ -1849,6 +2090,43 @@ void static InvalidBlockFound(CBlockIndex* pindex, const CValidationState& state
     }
 }
 
+/**
+ * Collect the address index entries of a transaction: what it pays to each
+ * address and what it spends from them. When connecting, created outputs
+ * enter the unspent index and spent ones leave it; when disconnecting it is
+ * the other way round, with vPrevHeights giving the heights of the restored
+ * outputs.
+ */
+static void GetAddressIndexEntries(const CTransaction& tx, unsigned int nTxIndex, const CTxUndo& txundo, int nHeight, bool fConnect,
+    const std::vector<int>& vPrevHeights, std::vector<CAddressIndexEntry>& vIndex, std::vector<CAddressUnspentEntry>& vUnspent)
+{
+    const uint256 hash = tx.GetHash();
+    uint160 hashBytes;
+    int type;
+
+    for (unsigned int k = 0; k < tx.vout.size(); k++) {
+        const CTxOut& out = tx.vout[k];
+        if (!GetAddressIndexKey(out.scriptPubKey, hashBytes, type))
+            continue;
+        vIndex.push_back(std::make_pair(CAddressIndexKey(type, hashBytes, nHeight, nTxIndex, hash, k, false), out.nValue));
+        vUnspent.push_back(std::make_pair(CAddressUnspentKey(type, hashBytes, hash, k),
+            fConnect ? CAddressUnspentValue(out.nValue, out.scriptPubKey, nHeight) : CAddressUnspentValue()));
+    }
+
+    if (tx.IsCoinBase())
+        return;
+
+    for (unsigned int j = 0; j < tx.vin.size(); j++) {
+        const COutPoint& prevout = tx.vin[j].prevout;
+        const CTxOut& prev = txundo.vprevout[j].txout;
+        if (!GetAddressIndexKey(prev.scriptPubKey, hashBytes, type))
+            continue;
+        vIndex.push_back(std::make_pair(CAddressIndexKey(type, hashBytes, nHeight, nTxIndex, hash, j, true), prev.nValue * -1));
+        vUnspent.push_back(std::make_pair(CAddressUnspentKey(type, hashBytes, prevout.hash, prevout.n),
+            fConnect ? CAddressUnspentValue() : CAddressUnspentValue(prev.nValue, prev.scriptPubKey, vPrevHeights[j])));
+    }
+}
+
 void UpdateCoins(const CTransaction& tx, CValidationState& /*state*/, CCoinsViewCache& inputs, CTxUndo& txundo, int nHeight)
 {
     // mark inputs spent
@@ -1862,7 +2140,10 @@ void UpdateCoins(const CTransaction& tx, CValidationState& /*state*/, CCoinsView
     }
 
     // add outputs
-    inputs.ModifyCoins(tx.GetHash())->FromTx(tx, nHeight);
+    if (tx.IsCoinBase())
+        inputs.ModifyCoins(tx.GetHash())->FromTx(tx, nHeight);
+    else
+        inputs.ModifyNewCoins(tx.GetHash())->FromTx(tx, nHeight);
 }
 
 bool CScriptCheck::operator()()
@@ -1993,10 +2274,17 @@ bool DisconnectBlock(CBlock& block, CValidationState& /*state*/, CBlockIndex* pi
     if (blockUndo.vtxundo.size() + 1 != block.vtx.size())
         return error("DisconnectBlock() : block and undo data inconsistent");
 
+    // The address index is left alone when only verifying the database
+    bool fUpdateAddressIndex = fAddressIndex && !pfClean;
+    std::vector<CAddressIndexEntry> vAddressIndex;
+    std::vector<CAddressUnspentEntry> vAddressUnspent;
+    CTxUndo undoDummy;
+
     // undo transactions in reverse order
     for (int i = block.vtx.size() - 1; i >= 0; i--) {
         const CTransaction& tx = block.vtx[i];
         uint256 hash = tx.GetHash();
+        std::vector<int> vPrevHeights(tx.IsCoinBase() ? 0 : tx.vin.size());
 
         // Check that all outputs are available and match the outputs in the block itself
         // exactly. Note that transactions with only provably unspendable outputs won't
@@ -2046,10 +2334,18 @@ bool DisconnectBlock(CBlock& block, CValidationState& /*state*/, CBlockIndex* pi
                 if (coins->vout.size() < out.n + 1)
                     coins->vout.resize(out.n + 1);
                 coins->vout[out.n] = undo.txout;
+                if (fUpdateAddressIndex)
+                    vPrevHeights[j] = coins->nHeight;
             }
         }
+
+        if (fUpdateAddressIndex)
+            GetAddressIndexEntries(tx, i, i == 0 ? undoDummy : blockUndo.vtxundo[i - 1], pindex->nHeight, false, vPrevHeights, vAddressIndex, vAddressUnspent);
     }
 
+    if (fUpdateAddressIndex && !pblocktree->EraseAddressIndex(vAddressIndex, vAddressUnspent, pindex->nHeight))
+        return error("DisconnectBlock() : failed to update address index");
+
     // move best block pointer to prevout block
     view.SetBestBlock(pindex->pprev->GetBlockHash());
 
@@ -2086,8 +2382,6 @@ void static FlushBlockFile(bool fFinalize = false)
 
 bool FindUndoPos(CValidationState& state, int nFile, CDiskBlockPos& pos, unsigned int nAddSize);
 
-static CCheckQueue<CScriptCheck> scriptcheckqueue(128);
-
 void ThreadScriptCheck()
 {
     RenameThread("blocknetdx-scriptch");
@@ -2149,6 +2443,8 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
     // Special case for the genesis block, skipping connection of its transactions
     // (its coinbase is unspendable)
     if (block.GetHash() == Params().HashGenesisBlock()) {
+        if (!fJustCheck && !BlockFilterIndexConnect(block, CBlockUndo(), pindex))
+            return state.Abort("Failed to write block filter index");
         view.SetBestBlock(pindex->GetBlockHash());
         return true;
     }
@@ -2214,6 +2510,8 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
     CDiskTxPos pos(pindex->GetBlockPos(), GetSizeOfCompactSize(block.vtx.size()));
     std::vector<std::pair<uint256, CDiskTxPos> > vPos;
     vPos.reserve(block.vtx.size());
+    std::vector<CAddressIndexEntry> vAddressIndex;
+    std::vector<CAddressUnspentEntry> vAddressUnspent;
     blockundo.vtxundo.reserve(block.vtx.size() - 1);
     int64_t nValueOut = 0;
     int64_t nValueIn = 0;
@@ -2257,6 +2555,9 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
         }
         UpdateCoins(tx, state, view, i == 0 ? undoDummy : blockundo.vtxundo.back(), pindex->nHeight);
 
+        if (fAddressIndex && !fJustCheck)
+            GetAddressIndexEntries(tx, i, i == 0 ? undoDummy : blockundo.vtxundo.back(), pindex->nHeight, true, std::vector<int>(), vAddressIndex, vAddressUnspent);
+
         vPos.push_back(std::make_pair(tx.GetHash(), pos));
         pos.nTxOffset += ::GetSerializeSize(tx, SER_DISK, CLIENT_VERSION);
     }
@@ -2319,6 +2620,13 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
         if (!pblocktree->WriteTxIndex(vPos))
             return state.Abort("Failed to write transaction index");
 
+    if (fAddressIndex)
+        if (!pblocktree->WriteAddressIndex(vAddressIndex, vAddressUnspent, pindex->nHeight))
+            return state.Abort("Failed to write address index");
+
+    if (!BlockFilterIndexConnect(block, blockundo, pindex))
+        return state.Abort("Failed to write block filter index");
+
     // add this block to the view's block chain
     view.SetBestBlock(pindex->GetBlockHash());
 
@@ -2355,7 +2663,7 @@ bool static FlushStateToDisk(CValidationState& state, FlushStateMode mode)
     static int64_t nLastWrite = 0;
     try {
         if ((mode == FLUSH_STATE_ALWAYS) ||
-            ((mode == FLUSH_STATE_PERIODIC || mode == FLUSH_STATE_IF_NEEDED) && pcoinsTip->GetCacheSize() > nCoinCacheSize) ||
+            ((mode == FLUSH_STATE_PERIODIC || mode == FLUSH_STATE_IF_NEEDED) && pcoinsTip->DynamicMemoryUsage() > nCoinCacheUsage) ||
             (mode == FLUSH_STATE_PERIODIC && GetTimeMicros() > nLastWrite + DATABASE_WRITE_INTERVAL * 1000000)) {
             // Typical CCoins structures on disk are around 100 bytes in size.
             // Pushing a new one to the database can cause it to be written
@@ -2406,19 +2714,28 @@ void FlushStateToDisk()
     FlushStateToDisk(state, FLUSH_STATE_ALWAYS);
 }
 
+/** Height of chainActive, mirrored for readers that must not wait for cs_main */
+static std::atomic<int> nChainActiveHeight(-1);
+
+int GetHeight()
+{
+    return nChainActiveHeight;
+}
+
 /** Update chainActive and related internal data structures. */
 void static UpdateTip(CBlockIndex* pindexNew)
 {
     chainActive.SetTip(pindexNew);
+    nChainActiveHeight = chainActive.Height();
 
     // New best block
     nTimeBestReceived = GetTime();
     mempool.AddTransactionsUpdated(1);
 
-    LogPrintf("UpdateTip: new best=%s  height=%d  log2_work=%.8g  tx=%lu  date=%s progress=%f  cache=%u\n",
+    LogPrintf("UpdateTip: new best=%s  height=%d  log2_work=%.8g  tx=%lu  date=%s progress=%f  cache=%.1fMiB(%utx)\n",
         chainActive.Tip()->GetBlockHash().ToString(), chainActive.Height(), log(chainActive.Tip()->nChainWork.getdouble()) / log(2.0), (unsigned long)chainActive.Tip()->nChainTx,
         DateTimeStrFormat("%Y-%m-%d %H:%M:%S", chainActive.Tip()->GetBlockTime()),
-              SyncProgress(chainActive.Height()), (unsigned int)pcoinsTip->GetCacheSize());
+              SyncProgress(chainActive.Height()), pcoinsTip->DynamicMemoryUsage() * (1.0 / (1 << 20)), (unsigned int)pcoinsTip->GetCacheSize());
 
     cvBlockChange.notify_all();
 
@@ -2480,7 +2797,7 @@ bool static DisconnectTip(CValidationState& state)
     // Let wallets know transactions went from 1-confirmed to
     // 0-confirmed or conflicted:
     BOOST_FOREACH (const CTransaction& tx, block.vtx) {
-        SyncWithWallets(tx, NULL);
+        SyncWithWallets(tx);
     }
     return true;
 }
@@ -2492,10 +2809,11 @@ static int64_t nTimeChainState = 0;
 static int64_t nTimePostConnect = 0;
 
 /**
- * Connect a new block to chainActive. pblock is either NULL or a pointer to a CBlock
- * corresponding to pindexNew, to bypass loading it again from disk.
+ * Connect a new block to chainActive. pblock is either empty or the CBlock
+ * corresponding to pindexNew, to bypass loading it again from disk. On success
+ * pblockConnected is the connected block, shared with the queued notifications.
  */
-bool static ConnectTip(CValidationState& state, CBlockIndex* pindexNew, CBlock* pblock)
+bool static ConnectTip(CValidationState& state, CBlockIndex* pindexNew, const boost::shared_ptr<const CBlock>& pblockIn, boost::shared_ptr<const CBlock>& pblockConnected)
 {
     assert(pindexNew->pprev == chainActive.Tip());
     mempool.check(pcoinsTip);
@@ -2503,11 +2821,12 @@ bool static ConnectTip(CValidationState& state, CBlockIndex* pindexNew, CBlock*
 
     // Read block from disk.
     int64_t nTime1 = GetTimeMicros();
-    CBlock block;
+    boost::shared_ptr<const CBlock> pblock = pblockIn;
     if (!pblock) {
-        if (!ReadBlockFromDisk(block, pindexNew))
+        boost::shared_ptr<CBlock> pblockRead(new CBlock());
+        if (!ReadBlockFromDisk(*pblockRead, pindexNew))
             return state.Abort("Failed to read block");
-        pblock = &block;
+        pblock = pblockRead;
     }
     // Apply the block atomically to the chain state.
     int64_t nTime2 = GetTimeMicros();
@@ -2552,12 +2871,14 @@ bool static ConnectTip(CValidationState& state, CBlockIndex* pindexNew, CBlock*
     // Tell wallet about transactions that went from mempool
     // to conflicted:
     BOOST_FOREACH (const CTransaction& tx, txConflicted) {
-        SyncWithWallets(tx, NULL);
+        SyncWithWallets(tx);
     }
-    // ... and about transactions that got confirmed:
+    // ... and about transactions that got confirmed. The notifications are delivered
+    // asynchronously, so they hold on to the block.
     BOOST_FOREACH (const CTransaction& tx, pblock->vtx) {
         SyncWithWallets(tx, pblock);
     }
+    pblockConnected = pblock;
 
     int64_t nTime6 = GetTimeMicros();
     nTimePostConnect += nTime6 - nTime5;
@@ -2726,8 +3047,9 @@ static void PruneBlockIndexCandidates()
 /**
  * Try to make some progress towards making pindexMostWork the active block.
  * pblock is either NULL or a pointer to a CBlock corresponding to pindexMostWork.
+ * pblockTip is set to the block of the new tip if this step connected it.
  */
-static bool ActivateBestChainStep(CValidationState& state, CBlockIndex* pindexMostWork, CBlock* pblock)
+static bool ActivateBestChainStep(CValidationState& state, CBlockIndex* pindexMostWork, const boost::shared_ptr<const CBlock>& pblock, boost::shared_ptr<const CBlock>& pblockTip)
 {
     AssertLockHeld(cs_main);
     bool fInvalidFound = false;
@@ -2738,6 +3060,7 @@ static bool ActivateBestChainStep(CValidationState& state, CBlockIndex* pindexMo
     while (chainActive.Tip() && chainActive.Tip() != pindexFork) {
         if (!DisconnectTip(state))
             return false;
+        pblockTip.reset();
     }
 
     // Build list of new blocks to connect.
@@ -2759,7 +3082,8 @@ static bool ActivateBestChainStep(CValidationState& state, CBlockIndex* pindexMo
 
         // Connect new blocks.
         BOOST_REVERSE_FOREACH (CBlockIndex* pindexConnect, vpindexToConnect) {
-            if (!ConnectTip(state, pindexConnect, pindexConnect == pindexMostWork ? pblock : NULL)) {
+            boost::shared_ptr<const CBlock> pblockConnected;
+            if (!ConnectTip(state, pindexConnect, pindexConnect == pindexMostWork ? pblock : boost::shared_ptr<const CBlock>(), pblockConnected)) {
                 if (state.IsInvalid()) {
                     // The block violates a consensus rule.
                     if (!state.CorruptionPossible())
@@ -2773,6 +3097,7 @@ static bool ActivateBestChainStep(CValidationState& state, CBlockIndex* pindexMo
                     return false;
                 }
             } else {
+                pblockTip = pblockConnected;
                 PruneBlockIndexCandidates();
                 if (!pindexOldTip || chainActive.Tip()->nChainWork > pindexOldTip->nChainWork) {
                     // We're in a better position than we were. Return temporarily to release the lock.
@@ -2794,13 +3119,16 @@ static bool ActivateBestChainStep(CValidationState& state, CBlockIndex* pindexMo
 
 /**
  * Make the best chain active, in multiple steps. The result is either failure
- * or an activated best chain. pblock is either NULL or a pointer to a block
- * that is already loaded (to avoid loading it again from disk).
+ * or an activated best chain. pblock is either empty or a block that is
+ * already loaded (to avoid loading it again from disk). Must not be called
+ * with cs_main held, as it waits for the queued notifications between steps.
  */
-bool ActivateBestChain(CValidationState& state, CBlock* pblock)
+bool ActivateBestChain(CValidationState& state, const boost::shared_ptr<const CBlock>& pblock)
 {
+    AssertLockNotHeld(cs_main);
     CBlockIndex* pindexNewTip = NULL;
     CBlockIndex* pindexMostWork = NULL;
+    boost::shared_ptr<const CBlock> pblockNewTip;
     do {
         boost::this_thread::interruption_point();
 
@@ -2818,7 +3146,7 @@ bool ActivateBestChain(CValidationState& state, CBlock* pblock)
             if (pindexMostWork == NULL || pindexMostWork == chainActive.Tip())
                 return true;
 
-            if (!ActivateBestChainStep(state, pindexMostWork, pblock && pblock->GetHash() == pindexMostWork->GetBlockHash() ? pblock : NULL))
+            if (!ActivateBestChainStep(state, pindexMostWork, pblock && pblock->GetHash() == pindexMostWork->GetBlockHash() ? pblock : boost::shared_ptr<const CBlock>(), pblockNewTip))
                 return false;
 
             pindexNewTip = chainActive.Tip();
@@ -2840,7 +3168,12 @@ bool ActivateBestChain(CValidationState& state, CBlock* pblock)
             }
             // Notify external listeners about the new tip.
             uiInterface.NotifyBlockTip(hashNewTip);
+            NotifyUpdatedBlockTip(pindexNewTip, pblockNewTip);
         }
+
+        // Don't let wallet and ZMQ notifications fall too far behind the tip. This
+        // waits with cs_main released, so the listeners can catch up meanwhile.
+        LimitValidationInterfaceQueue();
     } while (pindexMostWork != chainActive.Tip());
     CheckBlockIndex();
 
@@ -2921,6 +3254,22 @@ bool ReconsiderBlock(CValidationState& /*state*/, CBlockIndex* pindex)
     return true;
 }
 
+bool ActivateUTXOSnapshot(CBlockIndex* pindexBase)
+{
+    AssertLockHeld(cs_main);
+
+    // The cache was flushed before the database was replaced underneath it
+    pcoinsTip->SetBestBlock(pindexBase->GetBlockHash());
+    mempool.clear();
+
+    setBlockIndexCandidates.insert(pindexBase);
+    UpdateTip(pindexBase);
+    PruneBlockIndexCandidates();
+
+    CValidationState state;
+    return FlushStateToDisk(state, FLUSH_STATE_ALWAYS);
+}
+
 CBlockIndex* AddToBlockIndex(const CBlock& block)
 {
     // Check for duplicate
@@ -2930,8 +3279,7 @@ CBlockIndex* AddToBlockIndex(const CBlock& block)
         return it->second;
 
     // Construct new block index object
-    CBlockIndex* pindexNew = new CBlockIndex(block);
-    assert(pindexNew);
+    CBlockIndex* pindexNew = blockIndexArena.New(block);
     // We assign the sequence id to blocks only when the full data is available,
     // to avoid miners withholding blocks but broadcasting headers, to get a
     // competitive advantage.
@@ -2977,6 +3325,7 @@ CBlockIndex* AddToBlockIndex(const CBlock& block)
             LogPrintf("AddToBlockIndex() : Rejected by stake modifier checkpoint height=%d, modifier=%s \n", pindexNew->nHeight, boost::lexical_cast<std::string>(nStakeModifier));
     }
     pindexNew->nChainWork = (pindexNew->pprev ? pindexNew->pprev->nChainWork : 0) + GetBlockProof(*pindexNew);
+    pindexNew->nTimeMax = (pindexNew->pprev ? std::max(pindexNew->pprev->nTimeMax, pindexNew->nTime) : pindexNew->nTime);
     pindexNew->RaiseValidity(BLOCK_VALID_TREE);
     if (pindexBestHeader == NULL || pindexBestHeader->nChainWork < pindexNew->nChainWork)
         pindexBestHeader = pindexNew;
@@ -3192,6 +3541,7 @@ bool CheckBlock(const CBlock& block, CValidationState& state, bool /*fCheckPOW*/
     // ----------- swiftTX transaction scanning -----------
 
     if (IsSporkActive(SPORK_3_SWIFTTX_BLOCK_FILTERING)) {
+        LOCK(cs_swifttx);
         BOOST_FOREACH (const CTransaction& tx, block.vtx) {
             if (!tx.IsCoinBase()) {
                 //only reject blocks when it's based on complete consensus
@@ -3528,7 +3878,7 @@ void CBlockIndex::BuildSkip()
         pskip = pprev->GetAncestor(GetSkipHeight(nHeight));
 }
 
-bool ProcessNewBlock(CValidationState& state, CNode* pfrom, CBlock* pblock, CDiskBlockPos* dbp)
+bool ProcessNewBlock(CValidationState& state, CNode* pfrom, const boost::shared_ptr<CBlock>& pblock, CDiskBlockPos* dbp)
 {
     // Preliminary checks
     int64_t nStartTime = GetTimeMillis();
@@ -3695,9 +4045,7 @@ CBlockIndex* InsertBlockIndex(uint256 hash)
         return (*mi).second;
 
     // Create new
-    CBlockIndex* pindexNew = new CBlockIndex();
-    if (!pindexNew)
-        throw runtime_error("LoadBlockIndex() : new CBlockIndex failed");
+    CBlockIndex* pindexNew = blockIndexArena.New();
     mi = mapBlockIndex.insert(make_pair(hash, pindexNew)).first;
 
     //mark as PoS seen
@@ -3727,6 +4075,7 @@ bool static LoadBlockIndexDB()
     BOOST_FOREACH (const PAIRTYPE(int, CBlockIndex*) & item, vSortedByHeight) {
         CBlockIndex* pindex = item.second;
         pindex->nChainWork = (pindex->pprev ? pindex->pprev->nChainWork : 0) + GetBlockProof(*pindex);
+        pindex->nTimeMax = (pindex->pprev ? std::max(pindex->pprev->nTimeMax, pindex->nTime) : pindex->nTime);
         if (pindex->nStatus & BLOCK_HAVE_DATA) {
             if (pindex->pprev) {
                 if (pindex->pprev->nChainTx) {
@@ -3796,6 +4145,10 @@ bool static LoadBlockIndexDB()
     pblocktree->ReadFlag("txindex", fTxIndex);
     LogPrintf("LoadBlockIndexDB(): transaction index %s\n", fTxIndex ? "enabled" : "disabled");
 
+    // Check whether we have an address index
+    pblocktree->ReadFlag("addressindex", fAddressIndex);
+    LogPrintf("LoadBlockIndexDB(): address index %s\n", fAddressIndex ? "enabled" : "disabled");
+
     // If this is written true before the next client init, then we know the shutdown process failed
     pblocktree->WriteFlag("shutdown", false);
 
@@ -3804,6 +4157,7 @@ bool static LoadBlockIndexDB()
     if (it == mapBlockIndex.end())
         return true;
     chainActive.SetTip(it->second);
+    nChainActiveHeight = chainActive.Height();
 
     PruneBlockIndexCandidates();
 
@@ -3848,6 +4202,9 @@ bool CVerifyDB::VerifyDB(CCoinsView* coinsview, int nCheckLevel, int nCheckDepth
         uiInterface.ShowProgress(_("Verifying blocks..."), std::max(1, std::min(99, (int)(((double)(chainActive.Height() - pindex->nHeight)) / (double)nCheckDepth * (nCheckLevel >= 4 ? 50 : 100)))));
         if (pindex->nHeight < chainActive.Height() - nCheckDepth)
             break;
+        // blocks below a loaded UTXO snapshot were never connected and have no undo data
+        if (!(pindex->nStatus & BLOCK_HAVE_UNDO))
+            break;
         CBlock block;
         // check level 0: read from disk
         if (!ReadBlockFromDisk(block, pindex))
@@ -3865,7 +4222,7 @@ bool CVerifyDB::VerifyDB(CCoinsView* coinsview, int nCheckLevel, int nCheckDepth
             }
         }
         // check level 3: check for inconsistencies during memory-only disconnect of tip blocks
-        if (nCheckLevel >= 3 && pindex == pindexState && (coins.GetCacheSize() + pcoinsTip->GetCacheSize()) <= nCoinCacheSize) {
+        if (nCheckLevel >= 3 && pindex == pindexState && (coins.DynamicMemoryUsage() + pcoinsTip->DynamicMemoryUsage()) <= nCoinCacheUsage) {
             bool fClean = true;
             if (!DisconnectBlock(block, state, pindex, coins, &fClean))
                 return error("VerifyDB() : *** irrecoverable inconsistency in block data at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString());
@@ -3907,6 +4264,7 @@ void UnloadBlockIndex()
     mapBlockIndex.clear();
     setBlockIndexCandidates.clear();
     chainActive.SetTip(NULL);
+    nChainActiveHeight = -1;
     pindexBestInvalid = NULL;
 }
 
@@ -3921,18 +4279,26 @@ bool LoadBlockIndex()
 
 bool InitBlockIndex()
 {
-    LOCK(cs_main);
-    // Check whether we're already initialized
-    if (chainActive.Genesis() != NULL)
-        return true;
+    // Only add the genesis block if not reindexing (in which case we reuse the one already on disk)
+    boost::shared_ptr<const CBlock> pblockGenesis;
+    {
+        LOCK(cs_main);
+        // Check whether we're already initialized
+        if (chainActive.Genesis() != NULL)
+            return true;
 
-    // Use the provided setting for -txindex in the new database
-    fTxIndex = GetBoolArg("-txindex", true);
-    pblocktree->WriteFlag("txindex", fTxIndex);
-    LogPrintf("Initializing databases...\n");
+        // Use the provided setting for -txindex in the new database
+        fTxIndex = GetBoolArg("-txindex", true);
+        pblocktree->WriteFlag("txindex", fTxIndex);
+
+        // Use the provided setting for -addressindex in the new database
+        fAddressIndex = GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX);
+        pblocktree->WriteFlag("addressindex", fAddressIndex);
+        LogPrintf("Initializing databases...\n");
+
+        if (fReindex)
+            return true;
 
-    // Only add the genesis block if not reindexing (in which case we reuse the one already on disk)
-    if (!fReindex) {
         try {
             CBlock& block = const_cast<CBlock&>(Params().GenesisBlock());
             // Start new block file
@@ -3946,23 +4312,136 @@ bool InitBlockIndex()
             CBlockIndex* pindex = AddToBlockIndex(block);
             if (!ReceivedBlockTransactions(block, state, pindex, blockPos))
                 return error("LoadBlockIndex() : genesis block not accepted");
-            if (!ActivateBestChain(state, &block))
-                return error("LoadBlockIndex() : genesis block cannot be activated");
-            // Force a chainstate write so that when we VerifyDB in a moment, it doesnt check stale data
-            return FlushStateToDisk(state, FLUSH_STATE_ALWAYS);
+            pblockGenesis.reset(new CBlock(block));
         } catch (std::runtime_error& e) {
             return error("LoadBlockIndex() : failed to initialize block database: %s", e.what());
         }
     }
 
+    // ActivateBestChain takes cs_main itself
+    try {
+        CValidationState state;
+        if (!ActivateBestChain(state, pblockGenesis))
+            return error("LoadBlockIndex() : genesis block cannot be activated");
+        // Force a chainstate write so that when we VerifyDB in a moment, it doesnt check stale data
+        return FlushStateToDisk(state, FLUSH_STATE_ALWAYS);
+    } catch (std::runtime_error& e) {
+        return error("LoadBlockIndex() : failed to initialize block database: %s", e.what());
+    }
+}
+
+
+//! Blocks read from an external file per batch, before they are hashed and connected
+static const size_t IMPORT_BATCH_BLOCKS = 256;
+static const size_t IMPORT_BATCH_BYTES = 32 * 1024 * 1024;
+//! Serialized size of the out of order blocks held in memory until their parent shows up
+static const size_t IMPORT_UNKNOWN_PARENT_BYTES = 64 * 1024 * 1024;
+
+/** A block found in an external file, as it moves from the reader to the connecting thread */
+struct CImportBlock {
+    //! where to resume scanning if the block turns out not to deserialize
+    uint64_t nRewind;
+    CDiskBlockPos pos;
+    bool fHavePos;
+    size_t nSize;
+    std::vector<char> vRaw;
+    boost::shared_ptr<CBlock> pblock;
+    uint256 hash;
+
+    CImportBlock() : nRewind(0), fHavePos(false), nSize(0) {}
+};
+
+/**
+ * Scan the file for up to a batch of blocks and return their raw bytes.
+ * Returns false once the end of the file is reached.
+ */
+static bool ReadImportBatch(CBufferedFile& blkdat, uint64_t& nRewind, const CDiskBlockPos* dbp, std::vector<CImportBlock>& vBatch)
+{
+    size_t nBytes = 0;
+    while (vBatch.size() < IMPORT_BATCH_BLOCKS && nBytes < IMPORT_BATCH_BYTES) {
+        boost::this_thread::interruption_point();
+
+        // after a block of an earlier batch failed to deserialize, the position
+        // to resume at may be further back than the buffer keeps. Only test for
+        // the end of the file once there, the reader may have hit it already.
+        if (!blkdat.SetPos(nRewind) && !blkdat.Seek(nRewind))
+            throw std::runtime_error(strprintf("%s : failed to seek to position %u", __func__, nRewind));
+        if (blkdat.eof())
+            return false;
+        nRewind++;         // start one byte further next time, in case of failure
+        blkdat.SetLimit(); // remove former limit
+        unsigned int nSize = 0;
+        try {
+            // locate a header
+            unsigned char buf[MESSAGE_START_SIZE];
+            blkdat.FindByte(Params().MessageStart()[0]);
+            nRewind = blkdat.GetPos() + 1;
+            blkdat >> FLATDATA(buf);
+            if (memcmp(buf, Params().MessageStart(), MESSAGE_START_SIZE))
+                continue;
+            // read size
+            blkdat >> nSize;
+            if (nSize < 80 || nSize > MAX_BLOCK_SIZE)
+                continue;
+        } catch (const std::exception&) {
+            // no valid block header found; don't complain
+            return false;
+        }
+        try {
+            // read block
+            uint64_t nBlockPos = blkdat.GetPos();
+            blkdat.SetLimit(nBlockPos + nSize);
+            vBatch.push_back(CImportBlock());
+            CImportBlock& entry = vBatch.back();
+            entry.nRewind = nRewind;
+            if (dbp) {
+                entry.pos = *dbp;
+                entry.pos.nPos = nBlockPos;
+                entry.fHavePos = true;
+            }
+            entry.nSize = nSize;
+            entry.vRaw.resize(nSize);
+            blkdat.read(&entry.vRaw[0], nSize);
+            nRewind = blkdat.GetPos();
+            nBytes += nSize;
+        } catch (std::exception& e) {
+            vBatch.pop_back();
+            LogPrintf("%s : Deserialize or I/O error - %s", __func__, e.what());
+        }
+    }
     return true;
 }
 
+/**
+ * Deserialize, hash and check the signature of each block of a batch.
+ * These only depend on the block itself, so they run ahead of connection on
+ * all cores; CheckBlockSignature() remembers its result for ProcessNewBlock.
+ */
+static void HashImportBatch(std::vector<CImportBlock>& vBatch, std::atomic<size_t>& nNext)
+{
+    size_t n;
+    while ((n = nNext++) < vBatch.size()) {
+        CImportBlock& entry = vBatch[n];
+        try {
+            CDataStream ss(entry.vRaw, SER_DISK, CLIENT_VERSION);
+            boost::shared_ptr<CBlock> pblock(new CBlock());
+            ss >> *pblock;
+            entry.hash = pblock->GetHash();
+            pblock->CheckBlockSignature();
+            entry.pblock = pblock;
+        } catch (const std::exception& e) {
+            LogPrintf("%s : Deserialize error - %s\n", __func__, e.what());
+        }
+        std::vector<char>().swap(entry.vRaw);
+    }
+}
 
 bool LoadExternalBlockFile(FILE* fileIn, CDiskBlockPos* dbp)
 {
-    // Map of disk positions for blocks with unknown parent (only used for reindex)
-    static std::multimap<uint256, CDiskBlockPos> mapBlocksUnknownParent;
+    // Blocks with unknown parent, by parent hash. They are kept in memory up
+    // to a budget, past that only their disk position is (when reindexing).
+    static std::multimap<uint256, CImportBlock> mapBlocksUnknownParent;
+    static size_t nUnknownParentBytes = 0;
     int64_t nStart = GetTimeMillis();
 
     int nLoaded = 0;
@@ -3970,86 +4449,116 @@ bool LoadExternalBlockFile(FILE* fileIn, CDiskBlockPos* dbp)
         // This takes over fileIn and calls fclose() on it in the CBufferedFile destructor
         CBufferedFile blkdat(fileIn, 2 * MAX_BLOCK_SIZE, MAX_BLOCK_SIZE + 8, SER_DISK, CLIENT_VERSION);
         uint64_t nRewind = blkdat.GetPos();
-        while (!blkdat.eof()) {
-            boost::this_thread::interruption_point();
-
-            blkdat.SetPos(nRewind);
-            nRewind++;         // start one byte further next time, in case of failure
-            blkdat.SetLimit(); // remove former limit
-            unsigned int nSize = 0;
-            try {
-                // locate a header
-                unsigned char buf[MESSAGE_START_SIZE];
-                blkdat.FindByte(Params().MessageStart()[0]);
-                nRewind = blkdat.GetPos() + 1;
-                blkdat >> FLATDATA(buf);
-                if (memcmp(buf, Params().MessageStart(), MESSAGE_START_SIZE))
-                    continue;
-                // read size
-                blkdat >> nSize;
-                if (nSize < 80 || nSize > MAX_BLOCK_SIZE)
-                    continue;
-            } catch (const std::exception&) {
-                // no valid block header found; don't complain
-                break;
+        bool fEof = false;
+        const int nThreads = std::max<int>(boost::thread::hardware_concurrency(), 1);
+
+        // The file is read in batches on this thread. While it connects one
+        // batch in order, the worker threads hash the batch read after it.
+        std::vector<CImportBlock> vHashed;
+        while (!fEof || !vHashed.empty()) {
+            std::vector<CImportBlock> vRead;
+            if (!fEof)
+                fEof = !ReadImportBatch(blkdat, nRewind, dbp, vRead);
+
+            std::atomic<size_t> nNext(0);
+            boost::thread_group threadGroup;
+            if (!vRead.empty()) {
+                for (int i = 0; i < nThreads; i++)
+                    threadGroup.create_thread(boost::bind(&HashImportBatch, boost::ref(vRead), boost::ref(nNext)));
             }
-            try {
-                // read block
-                uint64_t nBlockPos = blkdat.GetPos();
-                if (dbp)
-                    dbp->nPos = nBlockPos;
-                blkdat.SetLimit(nBlockPos + nSize);
-                blkdat.SetPos(nBlockPos);
-                CBlock block;
-                blkdat >> block;
-                nRewind = blkdat.GetPos();
-
-                // detect out of order blocks, and store them for later
-                uint256 hash = block.GetHash();
-                if (hash != Params().HashGenesisBlock() && mapBlockIndex.find(block.hashPrevBlock) == mapBlockIndex.end()) {
-                    LogPrint("reindex", "%s: Out of order block %s, parent %s not known\n", __func__, hash.ToString(),
-                        block.hashPrevBlock.ToString());
-                    if (dbp)
-                        mapBlocksUnknownParent.insert(std::make_pair(block.hashPrevBlock, *dbp));
-                    continue;
-                }
 
-                // process in case the block isn't known yet
-                if (mapBlockIndex.count(hash) == 0 || (mapBlockIndex[hash]->nStatus & BLOCK_HAVE_DATA) == 0) {
-                    CValidationState state;
-                    if (ProcessNewBlock(state, NULL, &block, dbp))
-                        nLoaded++;
-                    if (state.IsError())
+            bool fRewound = false;
+            bool fError = false;
+            try {
+                BOOST_FOREACH (CImportBlock& entry, vHashed) {
+                    if (!entry.pblock) {
+                        // not a block after all: scan again from just past its header
+                        // and drop whatever was read beyond it, ReadImportBatch seeks
+                        // back in the file when that is out of the buffer's reach
+                        nRewind = entry.nRewind;
+                        fEof = false;
+                        fRewound = true;
                         break;
-                } else if (hash != Params().HashGenesisBlock() && mapBlockIndex[hash]->nHeight % 1000 == 0) {
-                    LogPrintf("Block Import: already had block %s at height %d\n", hash.ToString(), mapBlockIndex[hash]->nHeight);
-                }
+                    }
+                    try {
+                        CBlock& block = *entry.pblock;
+                        CDiskBlockPos* pos = entry.fHavePos ? &entry.pos : NULL;
+
+                        // detect out of order blocks, and store them for later
+                        const uint256& hash = entry.hash;
+                        if (hash != Params().HashGenesisBlock() && mapBlockIndex.find(block.hashPrevBlock) == mapBlockIndex.end()) {
+                            LogPrint("reindex", "%s: Out of order block %s, parent %s not known\n", __func__, hash.ToString(),
+                                block.hashPrevBlock.ToString());
+                            if (nUnknownParentBytes + entry.nSize <= IMPORT_UNKNOWN_PARENT_BYTES) {
+                                nUnknownParentBytes += entry.nSize;
+                                mapBlocksUnknownParent.insert(std::make_pair(block.hashPrevBlock, entry));
+                            } else if (entry.fHavePos) {
+                                entry.pblock.reset();
+                                mapBlocksUnknownParent.insert(std::make_pair(block.hashPrevBlock, entry));
+                            }
+                            continue;
+                        }
 
-                // Recursively process earlier encountered successors of this block
-                deque<uint256> queue;
-                queue.push_back(hash);
-                while (!queue.empty()) {
-                    uint256 head = queue.front();
-                    queue.pop_front();
-                    std::pair<std::multimap<uint256, CDiskBlockPos>::iterator, std::multimap<uint256, CDiskBlockPos>::iterator> range = mapBlocksUnknownParent.equal_range(head);
-                    while (range.first != range.second) {
-                        std::multimap<uint256, CDiskBlockPos>::iterator it = range.first;
-                        if (ReadBlockFromDisk(block, it->second)) {
-                            LogPrintf("%s: Processing out of order child %s of %s\n", __func__, block.GetHash().ToString(),
-                                head.ToString());
-                            CValidationState dummy;
-                            if (ProcessNewBlock(dummy, NULL, &block, &it->second)) {
+                        // process in case the block isn't known yet
+                        if (mapBlockIndex.count(hash) == 0 || (mapBlockIndex[hash]->nStatus & BLOCK_HAVE_DATA) == 0) {
+                            CValidationState state;
+                            if (ProcessNewBlock(state, NULL, entry.pblock, pos))
                                 nLoaded++;
-                                queue.push_back(block.GetHash());
+                            if (state.IsError())
+                                fError = true;
+                        } else if (hash != Params().HashGenesisBlock() && mapBlockIndex[hash]->nHeight % 1000 == 0) {
+                            LogPrintf("Block Import: already had block %s at height %d\n", hash.ToString(), mapBlockIndex[hash]->nHeight);
+                        }
+
+                        // Recursively process earlier encountered successors of this block
+                        deque<uint256> queue;
+                        if (!fError)
+                            queue.push_back(hash);
+                        while (!queue.empty()) {
+                            uint256 head = queue.front();
+                            queue.pop_front();
+                            std::pair<std::multimap<uint256, CImportBlock>::iterator, std::multimap<uint256, CImportBlock>::iterator> range = mapBlocksUnknownParent.equal_range(head);
+                            while (range.first != range.second) {
+                                std::multimap<uint256, CImportBlock>::iterator it = range.first;
+                                CImportBlock& child = it->second;
+                                if (child.pblock) {
+                                    nUnknownParentBytes -= child.nSize;
+                                } else {
+                                    child.pblock.reset(new CBlock());
+                                    if (!ReadBlockFromDisk(*child.pblock, child.pos))
+                                        child.pblock.reset();
+                                }
+                                if (child.pblock) {
+                                    LogPrintf("%s: Processing out of order child %s of %s\n", __func__, child.pblock->GetHash().ToString(),
+                                        head.ToString());
+                                    CValidationState dummy;
+                                    if (ProcessNewBlock(dummy, NULL, child.pblock, child.fHavePos ? &child.pos : NULL)) {
+                                        nLoaded++;
+                                        queue.push_back(child.pblock->GetHash());
+                                    }
+                                }
+                                range.first++;
+                                mapBlocksUnknownParent.erase(it);
                             }
                         }
-                        range.first++;
-                        mapBlocksUnknownParent.erase(it);
+                    } catch (std::exception& e) {
+                        LogPrintf("%s : Deserialize or I/O error - %s", __func__, e.what());
                     }
+                    if (fError)
+                        break;
                 }
-            } catch (std::exception& e) {
-                LogPrintf("%s : Deserialize or I/O error - %s", __func__, e.what());
+            } catch (...) {
+                // interrupted or failed while the workers still use vRead
+                threadGroup.join_all();
+                throw;
             }
+            threadGroup.join_all();
+
+            if (fError)
+                break;
+            if (fRewound)
+                vRead.clear();
+            vHashed.swap(vRead);
         }
     } catch (std::runtime_error& e) {
         AbortNode(std::string("System error: ") + e.what());
@@ -4396,43 +4905,49 @@ bool static AlreadyHave(const CInv& inv)
         return mapObfuscationBroadcastTxes.count(inv.hash);
     case MSG_BLOCK:
         return mapBlockIndex.count(inv.hash);
-    case MSG_TXLOCK_REQUEST:
+    case MSG_TXLOCK_REQUEST: {
+        LOCK(cs_swifttx);
         return mapTxLockReq.count(inv.hash) ||
                mapTxLockReqRejected.count(inv.hash);
-    case MSG_TXLOCK_VOTE:
+    }
+    case MSG_TXLOCK_VOTE: {
+        LOCK(cs_swifttx);
         return mapTxLockVote.count(inv.hash);
-    case MSG_SPORK:
+    }
+    case MSG_SPORK: {
+        LOCK(cs_spork);
         return mapSporks.count(inv.hash);
-    case MSG_SERVICENODE_WINNER:
-        if (servicenodePayments.mapServicenodePayeeVotes.count(inv.hash)) {
-            servicenodeSync.AddedServicenodeWinner(inv.hash);
-            return true;
+    }
+    case MSG_SERVICENODE_WINNER: {
+        bool fHave;
+        {
+            LOCK(cs_mapServicenodePayeeVotes);
+            fHave = servicenodePayments.mapServicenodePayeeVotes.count(inv.hash);
         }
-        return false;
+        if (fHave)
+            servicenodeSync.AddedServicenodeWinner(inv.hash);
+        return fHave;
+    }
     case MSG_BUDGET_VOTE:
-        if (budget.mapSeenServicenodeBudgetVotes.count(inv.hash)) {
-            servicenodeSync.AddedBudgetItem(inv.hash);
-            return true;
-        }
-        return false;
     case MSG_BUDGET_PROPOSAL:
-        if (budget.mapSeenServicenodeBudgetProposals.count(inv.hash)) {
-            servicenodeSync.AddedBudgetItem(inv.hash);
-            return true;
-        }
-        return false;
     case MSG_BUDGET_FINALIZED_VOTE:
-        if (budget.mapSeenFinalizedBudgetVotes.count(inv.hash)) {
-            servicenodeSync.AddedBudgetItem(inv.hash);
-            return true;
-        }
-        return false;
-    case MSG_BUDGET_FINALIZED:
-        if (budget.mapSeenFinalizedBudgets.count(inv.hash)) {
+    case MSG_BUDGET_FINALIZED: {
+        bool fHave;
+        {
+            LOCK(budget.cs_seen);
+            if (inv.type == MSG_BUDGET_VOTE)
+                fHave = budget.mapSeenServicenodeBudgetVotes.count(inv.hash);
+            else if (inv.type == MSG_BUDGET_PROPOSAL)
+                fHave = budget.mapSeenServicenodeBudgetProposals.count(inv.hash);
+            else if (inv.type == MSG_BUDGET_FINALIZED_VOTE)
+                fHave = budget.mapSeenFinalizedBudgetVotes.count(inv.hash);
+            else
+                fHave = budget.mapSeenFinalizedBudgets.count(inv.hash);
+        }
+        if (fHave)
             servicenodeSync.AddedBudgetItem(inv.hash);
-            return true;
-        }
-        return false;
+        return fHave;
+    }
     case MSG_SERVICENODE_ANNOUNCE:
         if (mnodeman.mapSeenServicenodeBroadcast.count(inv.hash)) {
             servicenodeSync.AddedServicenodeList(inv.hash);
@@ -4544,80 +5059,118 @@ void static ProcessGetData(CNode* pfrom)
                         pushed = true;
                     }
                 }
+                // the messages are serialized under their lock and sent after releasing it
                 if (!pushed && inv.type == MSG_TXLOCK_VOTE) {
-                    if (mapTxLockVote.count(inv.hash)) {
-                        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
-                        ss.reserve(1000);
-                        ss << mapTxLockVote[inv.hash];
-                        pfrom->PushMessage("txlvote", ss);
-                        pushed = true;
+                    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+                    {
+                        LOCK(cs_swifttx);
+                        if (mapTxLockVote.count(inv.hash)) {
+                            ss.reserve(1000);
+                            ss << mapTxLockVote[inv.hash];
+                            pushed = true;
+                        }
                     }
+                    if (pushed)
+                        pfrom->PushMessage("txlvote", ss);
                 }
                 if (!pushed && inv.type == MSG_TXLOCK_REQUEST) {
-                    if (mapTxLockReq.count(inv.hash)) {
-                        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
-                        ss.reserve(1000);
-                        ss << mapTxLockReq[inv.hash];
-                        pfrom->PushMessage("ix", ss);
-                        pushed = true;
+                    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+                    {
+                        LOCK(cs_swifttx);
+                        if (mapTxLockReq.count(inv.hash)) {
+                            ss.reserve(1000);
+                            ss << mapTxLockReq[inv.hash];
+                            pushed = true;
+                        }
                     }
+                    if (pushed)
+                        pfrom->PushMessage("ix", ss);
                 }
                 if (!pushed && inv.type == MSG_SPORK) {
-                    if (mapSporks.count(inv.hash)) {
-                        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
-                        ss.reserve(1000);
-                        ss << mapSporks[inv.hash];
-                        pfrom->PushMessage("spork", ss);
-                        pushed = true;
+                    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+                    {
+                        LOCK(cs_spork);
+                        if (mapSporks.count(inv.hash)) {
+                            ss.reserve(1000);
+                            ss << mapSporks[inv.hash];
+                            pushed = true;
+                        }
                     }
+                    if (pushed)
+                        pfrom->PushMessage("spork", ss);
                 }
                 if (!pushed && inv.type == MSG_SERVICENODE_WINNER) {
-                    if (servicenodePayments.mapServicenodePayeeVotes.count(inv.hash)) {
-                        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
-                        ss.reserve(1000);
-                        ss << servicenodePayments.mapServicenodePayeeVotes[inv.hash];
-                        pfrom->PushMessage("mnw", ss);
-                        pushed = true;
+                    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+                    {
+                        LOCK(cs_mapServicenodePayeeVotes);
+                        std::map<uint256, CServicenodePaymentWinner>::const_iterator mi = servicenodePayments.mapServicenodePayeeVotes.find(inv.hash);
+                        if (mi != servicenodePayments.mapServicenodePayeeVotes.end()) {
+                            ss.reserve(1000);
+                            ss << mi->second;
+                            pushed = true;
+                        }
                     }
+                    if (pushed)
+                        pfrom->PushMessage("mnw", ss);
                 }
                 if (!pushed && inv.type == MSG_BUDGET_VOTE) {
-                    if (budget.mapSeenServicenodeBudgetVotes.count(inv.hash)) {
-                        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
-                        ss.reserve(1000);
-                        ss << budget.mapSeenServicenodeBudgetVotes[inv.hash];
-                        pfrom->PushMessage("mvote", ss);
-                        pushed = true;
+                    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+                    {
+                        LOCK(budget.cs_seen);
+                        std::map<uint256, CBudgetVote>::const_iterator mi = budget.mapSeenServicenodeBudgetVotes.find(inv.hash);
+                        if (mi != budget.mapSeenServicenodeBudgetVotes.end()) {
+                            ss.reserve(1000);
+                            ss << mi->second;
+                            pushed = true;
+                        }
                     }
+                    if (pushed)
+                        pfrom->PushMessage("mvote", ss);
                 }
 
                 if (!pushed && inv.type == MSG_BUDGET_PROPOSAL) {
-                    if (budget.mapSeenServicenodeBudgetProposals.count(inv.hash)) {
-                        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
-                        ss.reserve(1000);
-                        ss << budget.mapSeenServicenodeBudgetProposals[inv.hash];
-                        pfrom->PushMessage("mprop", ss);
-                        pushed = true;
+                    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+                    {
+                        LOCK(budget.cs_seen);
+                        std::map<uint256, CBudgetProposalBroadcast>::const_iterator mi = budget.mapSeenServicenodeBudgetProposals.find(inv.hash);
+                        if (mi != budget.mapSeenServicenodeBudgetProposals.end()) {
+                            ss.reserve(1000);
+                            ss << mi->second;
+                            pushed = true;
+                        }
                     }
+                    if (pushed)
+                        pfrom->PushMessage("mprop", ss);
                 }
 
                 if (!pushed && inv.type == MSG_BUDGET_FINALIZED_VOTE) {
-                    if (budget.mapSeenFinalizedBudgetVotes.count(inv.hash)) {
-                        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
-                        ss.reserve(1000);
-                        ss << budget.mapSeenFinalizedBudgetVotes[inv.hash];
-                        pfrom->PushMessage("fbvote", ss);
-                        pushed = true;
+                    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+                    {
+                        LOCK(budget.cs_seen);
+                        std::map<uint256, CFinalizedBudgetVote>::const_iterator mi = budget.mapSeenFinalizedBudgetVotes.find(inv.hash);
+                        if (mi != budget.mapSeenFinalizedBudgetVotes.end()) {
+                            ss.reserve(1000);
+                            ss << mi->second;
+                            pushed = true;
+                        }
                     }
+                    if (pushed)
+                        pfrom->PushMessage("fbvote", ss);
                 }
 
                 if (!pushed && inv.type == MSG_BUDGET_FINALIZED) {
-                    if (budget.mapSeenFinalizedBudgets.count(inv.hash)) {
-                        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
-                        ss.reserve(1000);
-                        ss << budget.mapSeenFinalizedBudgets[inv.hash];
-                        pfrom->PushMessage("fbs", ss);
-                        pushed = true;
+                    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+                    {
+                        LOCK(budget.cs_seen);
+                        std::map<uint256, CFinalizedBudgetBroadcast>::const_iterator mi = budget.mapSeenFinalizedBudgets.find(inv.hash);
+                        if (mi != budget.mapSeenFinalizedBudgets.end()) {
+                            ss.reserve(1000);
+                            ss << mi->second;
+                            pushed = true;
+                        }
                     }
+                    if (pushed)
+                        pfrom->PushMessage("fbs", ss);
                 }
 
                 if (!pushed && inv.type == MSG_SERVICENODE_ANNOUNCE) {
@@ -4679,6 +5232,211 @@ void static ProcessGetData(CNode* pfrom)
     }
 }
 
+/**
+ * Check a block filter request and find the block it stops at. Peers asking
+ * for filters we do not serve, or for too many at once, are disconnected;
+ * requests we merely cannot answer yet are ignored.
+ */
+static bool PrepareBlockFilterRequest(CNode* pfrom, uint8_t nFilterType, uint32_t nStartHeight, const uint256& hashStop,
+    uint32_t nMaxHeightDiff, const CBlockIndex*& pindexStop)
+{
+    AssertLockHeld(cs_main);
+
+    if (!(nLocalServices & NODE_COMPACT_FILTERS) || nFilterType != BLOCK_FILTER_BASIC) {
+        LogPrint("net", "peer %d requested unsupported block filter type %d\n", pfrom->id, nFilterType);
+        pfrom->fDisconnect = true;
+        return false;
+    }
+
+    BlockMap::const_iterator mi = mapBlockIndex.find(hashStop);
+    if (mi == mapBlockIndex.end()) {
+        LogPrint("net", "peer %d requested block filters up to unknown block %s\n", pfrom->id, hashStop.ToString());
+        pfrom->fDisconnect = true;
+        return false;
+    }
+    pindexStop = mi->second;
+
+    if (nStartHeight > (uint32_t)pindexStop->nHeight) {
+        LogPrint("net", "peer %d sent invalid getcfilters/getcfheaders with start height %d and stop height %d\n",
+            pfrom->id, nStartHeight, pindexStop->nHeight);
+        pfrom->fDisconnect = true;
+        return false;
+    }
+    if ((uint32_t)pindexStop->nHeight - nStartHeight >= nMaxHeightDiff) {
+        LogPrint("net", "peer %d requested too many block filters/headers: %d / %d\n",
+            pfrom->id, pindexStop->nHeight - nStartHeight + 1, nMaxHeightDiff);
+        pfrom->fDisconnect = true;
+        return false;
+    }
+
+    if (!chainActive.Contains(pindexStop) || !IsBlockFilterIndexSynced()) {
+        LogPrint("net", "peer %d requested block filters up to %s, which are not available\n", pfrom->id, hashStop.ToString());
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Act on the outcome of accepting a transaction relayed by pfrom: relay it and accept
+ * the orphans that spend it, keep it as an orphan, or reject it.
+ */
+static void ProcessRelayedTx(CNode* pfrom, const std::string& strCommand, const CTransaction& tx, bool fAccepted, bool fMissingInputs, CValidationState& state)
+{
+    AssertLockHeld(cs_main);
+    vector<uint256> vWorkQueue;
+    vector<uint256> vEraseQueue;
+    CInv inv(MSG_TX, tx.GetHash());
+
+    if (fAccepted) {
+        mempool.check(pcoinsTip);
+        RelayTransaction(tx);
+        vWorkQueue.push_back(inv.hash);
+
+        LogPrint("mempool", "AcceptToMemoryPool: peer=%d %s : accepted %s (poolsz %u)\n",
+            pfrom->id, pfrom->cleanSubVer,
+            tx.GetHash().ToString(),
+            mempool.mapTx.size());
+
+        // Recursively process any orphan transactions that depended on this one,
+        // one generation at a time so that the scripts of a generation are
+        // verified together
+        set<NodeId> setMisbehaving;
+        set<uint256> setDone;
+        unsigned int nGeneration = 0;
+        while (nGeneration < vWorkQueue.size()) {
+            set<uint256> setOrphanHash;
+            vector<uint256> vOrphanHash;
+            vector<CTransaction> vOrphanTx;
+            for (unsigned int nEnd = vWorkQueue.size(); nGeneration < nEnd; nGeneration++) {
+                map<uint256, set<uint256> >::iterator itByPrev = mapOrphanTransactionsByPrev.find(vWorkQueue[nGeneration]);
+                if (itByPrev == mapOrphanTransactionsByPrev.end())
+                    continue;
+                BOOST_FOREACH (const uint256& orphanHash, itByPrev->second) {
+                    if (setMisbehaving.count(mapOrphanTransactions[orphanHash].fromPeer) || setDone.count(orphanHash) || !setOrphanHash.insert(orphanHash).second)
+                        continue;
+                    vOrphanHash.push_back(orphanHash);
+                    vOrphanTx.push_back(mapOrphanTransactions[orphanHash].tx);
+                }
+            }
+            if (vOrphanTx.empty())
+                continue;
+
+            // Use dummy CValidationStates so someone can't setup nodes to counter-DoS based on orphan
+            // resolution (that is, feeding people an invalid transaction based on LegitTxX in order to get
+            // anyone relaying LegitTxX banned)
+            vector<CValidationState> vStateDummy;
+            vector<bool> vAccepted, vMissingInputs2;
+            AcceptToMemoryPoolBatch(mempool, vOrphanTx, true, vStateDummy, vAccepted, vMissingInputs2);
+
+            for (unsigned int i = 0; i < vOrphanTx.size(); i++) {
+                const uint256& orphanHash = vOrphanHash[i];
+                NodeId fromPeer = mapOrphanTransactions[orphanHash].fromPeer;
+                if (vAccepted[i]) {
+                    LogPrint("mempool", "   accepted orphan tx %s\n", orphanHash.ToString());
+                    RelayTransaction(vOrphanTx[i]);
+                    vWorkQueue.push_back(orphanHash);
+                    vEraseQueue.push_back(orphanHash);
+                    setDone.insert(orphanHash);
+                } else if (!vMissingInputs2[i]) {
+                    if (setMisbehaving.count(fromPeer))
+                        continue;
+                    int nDos = 0;
+                    if (vStateDummy[i].IsInvalid(nDos) && nDos > 0) {
+                        // Punish peer that gave us an invalid orphan tx
+                        Misbehaving(fromPeer, nDos);
+                        setMisbehaving.insert(fromPeer);
+                        LogPrint("mempool", "   invalid orphan tx %s\n", orphanHash.ToString());
+                    }
+                    // Has inputs but not accepted to mempool
+                    // Probably non-standard or insufficient fee/priority
+                    LogPrint("mempool", "   removed orphan tx %s\n", orphanHash.ToString());
+                    vEraseQueue.push_back(orphanHash);
+                    setDone.insert(orphanHash);
+                }
+            }
+            mempool.check(pcoinsTip);
+        }
+
+        BOOST_FOREACH (uint256 hash, vEraseQueue)
+            EraseOrphanTx(hash);
+    } else if (fMissingInputs) {
+        AddOrphanTx(tx, pfrom->GetId());
+
+        // DoS prevention: do not allow mapOrphanTransactions to grow unbounded
+        unsigned int nMaxOrphanTx = (unsigned int)std::max((int64_t)0, GetArg("-maxorphantx", DEFAULT_MAX_ORPHAN_TRANSACTIONS));
+        unsigned int nEvicted = LimitOrphanTxSize(nMaxOrphanTx);
+        if (nEvicted > 0)
+            LogPrint("mempool", "mapOrphan overflow, removed %u tx\n", nEvicted);
+    } else if (pfrom->fWhitelisted) {
+        // Always relay transactions received from whitelisted peers, even
+        // if they are already in the mempool (allowing the node to function
+        // as a gateway for nodes hidden behind it).
+
+        RelayTransaction(tx);
+    }
+
+    int nDoS = 0;
+    if (state.IsInvalid(nDoS)) {
+        LogPrint("mempool", "%s from peer=%d %s was not accepted into the memory pool: %s\n", tx.GetHash().ToString(),
+            pfrom->id, pfrom->cleanSubVer,
+            state.GetRejectReason());
+        pfrom->PushMessage("reject", strCommand, state.GetRejectCode(),
+            state.GetRejectReason().substr(0, MAX_REJECT_MESSAGE_LENGTH), inv.hash);
+        if (nDoS > 0)
+            Misbehaving(pfrom->GetId(), nDoS);
+    }
+}
+
+/** A "tx" message waiting for the end of the message handler pass */
+struct CQueuedTx {
+    CNode* pfrom;
+    CTransaction tx;
+};
+
+/** The "tx" messages received during the current pass of this message handler thread */
+static boost::thread_specific_ptr<std::vector<CQueuedTx> > ptrQueuedTxs;
+
+void ProcessQueuedTransactions()
+{
+    std::vector<CQueuedTx>* pqueued = ptrQueuedTxs.get();
+    if (!pqueued || pqueued->empty())
+        return;
+    std::vector<CQueuedTx> vQueued;
+    vQueued.swap(*pqueued);
+
+    LOCK(cs_main);
+
+    // A transaction several peers sent during the pass is only checked for the first,
+    // the others are told it's already known like before
+    std::vector<CTransaction> vtx;
+    std::vector<int> vBatchIndex;
+    std::set<uint256> setHashes;
+    for (const CQueuedTx& queued : vQueued) {
+        const uint256& hash = queued.tx.GetHash();
+        mapAlreadyAskedFor.erase(CInv(MSG_TX, hash));
+        if (setHashes.insert(hash).second) {
+            vBatchIndex.push_back(vtx.size());
+            vtx.push_back(queued.tx);
+        } else {
+            vBatchIndex.push_back(-1);
+        }
+    }
+
+    std::vector<CValidationState> vState;
+    std::vector<bool> vAccepted, vMissingInputs;
+    AcceptToMemoryPoolBatch(mempool, vtx, true, vState, vAccepted, vMissingInputs);
+
+    for (size_t i = 0; i < vQueued.size(); i++) {
+        const int nIndex = vBatchIndex[i];
+        if (nIndex < 0) {
+            CValidationState state;
+            ProcessRelayedTx(vQueued[i].pfrom, "tx", vQueued[i].tx, false, false, state);
+        } else {
+            ProcessRelayedTx(vQueued[i].pfrom, "tx", vQueued[i].tx, vAccepted[nIndex], vMissingInputs[nIndex], vState[nIndex]);
+        }
+    }
+}
+
 bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv, int64_t nTimeReceived)
 {
     RandAddSeedPerfmon();
@@ -4976,6 +5734,97 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
     }
 
 
+    else if (strCommand == "getcfilters") {
+        uint8_t nFilterType;
+        uint32_t nStartHeight;
+        uint256 hashStop;
+        vRecv >> nFilterType >> nStartHeight >> hashStop;
+
+        std::vector<uint256> vHashes;
+        {
+            LOCK(cs_main);
+            const CBlockIndex* pindexStop;
+            if (!PrepareBlockFilterRequest(pfrom, nFilterType, nStartHeight, hashStop, MAX_GETCFILTERS_SIZE, pindexStop))
+                return true;
+            for (const CBlockIndex* pindex = pindexStop; pindex && pindex->nHeight >= (int)nStartHeight; pindex = pindex->pprev)
+                vHashes.push_back(pindex->GetBlockHash());
+        }
+
+        // Filters are read outside cs_main; nothing is sent unless all of them were found
+        std::vector<BlockFilter> vFilters(vHashes.size());
+        for (size_t i = 0; i < vHashes.size(); i++) {
+            if (!pblockfilterindex->ReadFilter(vHashes[vHashes.size() - 1 - i], vFilters[i])) {
+                LogPrint("net", "Failed to find block filter of block %s\n", vHashes[vHashes.size() - 1 - i].ToString());
+                return true;
+            }
+        }
+        BOOST_FOREACH (const BlockFilter& filter, vFilters)
+            pfrom->PushMessage("cfilter", (uint8_t)filter.GetFilterType(), filter.GetBlockHash(), filter.GetEncodedFilter());
+    }
+
+
+    else if (strCommand == "getcfheaders") {
+        uint8_t nFilterType;
+        uint32_t nStartHeight;
+        uint256 hashStop;
+        vRecv >> nFilterType >> nStartHeight >> hashStop;
+
+        std::vector<uint256> vHashes;
+        uint256 hashPrevBlock;
+        {
+            LOCK(cs_main);
+            const CBlockIndex* pindexStop;
+            if (!PrepareBlockFilterRequest(pfrom, nFilterType, nStartHeight, hashStop, MAX_GETCFHEADERS_SIZE, pindexStop))
+                return true;
+            const CBlockIndex* pindex = pindexStop;
+            for (; pindex && pindex->nHeight >= (int)nStartHeight; pindex = pindex->pprev)
+                vHashes.push_back(pindex->GetBlockHash());
+            if (pindex)
+                hashPrevBlock = pindex->GetBlockHash();
+        }
+
+        uint256 hashPrevHeader;
+        if (nStartHeight > 0 && !pblockfilterindex->ReadFilterHeader(hashPrevBlock, hashPrevHeader)) {
+            LogPrint("net", "Failed to find block filter header of block %s\n", hashPrevBlock.ToString());
+            return true;
+        }
+        std::vector<uint256> vFilterHashes(vHashes.size());
+        for (size_t i = 0; i < vHashes.size(); i++) {
+            if (!pblockfilterindex->ReadFilterHash(vHashes[vHashes.size() - 1 - i], vFilterHashes[i])) {
+                LogPrint("net", "Failed to find block filter hash of block %s\n", vHashes[vHashes.size() - 1 - i].ToString());
+                return true;
+            }
+        }
+        pfrom->PushMessage("cfheaders", nFilterType, hashStop, hashPrevHeader, vFilterHashes);
+    }
+
+
+    else if (strCommand == "getcfcheckpt") {
+        uint8_t nFilterType;
+        uint256 hashStop;
+        vRecv >> nFilterType >> hashStop;
+
+        std::vector<uint256> vHashes;
+        {
+            LOCK(cs_main);
+            const CBlockIndex* pindexStop;
+            if (!PrepareBlockFilterRequest(pfrom, nFilterType, 0, hashStop, std::numeric_limits<uint32_t>::max(), pindexStop))
+                return true;
+            for (int nHeight = CFCHECKPT_INTERVAL; nHeight <= pindexStop->nHeight; nHeight += CFCHECKPT_INTERVAL)
+                vHashes.push_back(pindexStop->GetAncestor(nHeight)->GetBlockHash());
+        }
+
+        std::vector<uint256> vHeaders(vHashes.size());
+        for (size_t i = 0; i < vHashes.size(); i++) {
+            if (!pblockfilterindex->ReadFilterHeader(vHashes[i], vHeaders[i])) {
+                LogPrint("net", "Failed to find block filter header of block %s\n", vHashes[i].ToString());
+                return true;
+            }
+        }
+        pfrom->PushMessage("cfcheckpt", nFilterType, hashStop, vHeaders);
+    }
+
+
     else if (strCommand == "headers" && Params().HeadersFirstSyncingActive()) {
         CBlockLocator locator;
         uint256 hashStop;
@@ -5015,8 +5864,6 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
 
 
     else if (strCommand == "tx" || strCommand == "dstx") {
-        vector<uint256> vWorkQueue;
-        vector<uint256> vEraseQueue;
         CTransaction tx;
 
         //servicenode signed transaction
@@ -5030,7 +5877,26 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
         } else if (strCommand == "dstx") {
             //these allow servicenodes to publish a limited amount of free transactions
             vRecv >> tx >> vin >> vchSig >> sigTime;
+        }
+
+        CInv inv(MSG_TX, tx.GetHash());
+        pfrom->AddInventoryKnown(inv);
+
+        // Relayed transactions are accepted together at the end of the handler pass, so
+        // their scripts are verified in one batch across the script check threads
+        if (strCommand == "tx") {
+            if (!ptrQueuedTxs.get())
+                ptrQueuedTxs.reset(new std::vector<CQueuedTx>());
+            ptrQueuedTxs->push_back(CQueuedTx{pfrom, tx});
+            return true;
+        }
+
+        // mapObfuscationBroadcastTxes is guarded by cs_main, and the servicenode
+        // may only be used while mnodeman.cs is held
+        LOCK(cs_main);
 
+        if (strCommand == "dstx") {
+            LOCK(mnodeman.cs);
             CServicenode* pmn = mnodeman.Find(vin);
             if (pmn != NULL) {
                 if (!pmn->allowFreeTx) {
@@ -5065,102 +5931,19 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
             }
         }
 
-        CInv inv(MSG_TX, tx.GetHash());
-        pfrom->AddInventoryKnown(inv);
-
-        LOCK(cs_main);
-
         bool fMissingInputs = false;
         CValidationState state;
 
         mapAlreadyAskedFor.erase(inv);
 
-        if (AcceptToMemoryPool(mempool, state, tx, true, &fMissingInputs, false, ignoreFees)) {
-            mempool.check(pcoinsTip);
-            RelayTransaction(tx);
-            vWorkQueue.push_back(inv.hash);
-
-            LogPrint("mempool", "AcceptToMemoryPool: peer=%d %s : accepted %s (poolsz %u)\n",
-                pfrom->id, pfrom->cleanSubVer,
-                tx.GetHash().ToString(),
-                mempool.mapTx.size());
-
-            // Recursively process any orphan transactions that depended on this one
-            set<NodeId> setMisbehaving;
-            for (unsigned int i = 0; i < vWorkQueue.size(); i++) {
-                map<uint256, set<uint256> >::iterator itByPrev = mapOrphanTransactionsByPrev.find(vWorkQueue[i]);
-                if (itByPrev == mapOrphanTransactionsByPrev.end())
-                    continue;
-                for (set<uint256>::iterator mi = itByPrev->second.begin();
-                     mi != itByPrev->second.end();
-                     ++mi) {
-                    const uint256& orphanHash = *mi;
-                    const CTransaction& orphanTx = mapOrphanTransactions[orphanHash].tx;
-                    NodeId fromPeer = mapOrphanTransactions[orphanHash].fromPeer;
-                    bool fMissingInputs2 = false;
-                    // Use a dummy CValidationState so someone can't setup nodes to counter-DoS based on orphan
-                    // resolution (that is, feeding people an invalid transaction based on LegitTxX in order to get
-                    // anyone relaying LegitTxX banned)
-                    CValidationState stateDummy;
-
-
-                    if (setMisbehaving.count(fromPeer))
-                        continue;
-                    if (AcceptToMemoryPool(mempool, stateDummy, orphanTx, true, &fMissingInputs2)) {
-                        LogPrint("mempool", "   accepted orphan tx %s\n", orphanHash.ToString());
-                        RelayTransaction(orphanTx);
-                        vWorkQueue.push_back(orphanHash);
-                        vEraseQueue.push_back(orphanHash);
-                    } else if (!fMissingInputs2) {
-                        int nDos = 0;
-                        if (stateDummy.IsInvalid(nDos) && nDos > 0) {
-                            // Punish peer that gave us an invalid orphan tx
-                            Misbehaving(fromPeer, nDos);
-                            setMisbehaving.insert(fromPeer);
-                            LogPrint("mempool", "   invalid orphan tx %s\n", orphanHash.ToString());
-                        }
-                        // Has inputs but not accepted to mempool
-                        // Probably non-standard or insufficient fee/priority
-                        LogPrint("mempool", "   removed orphan tx %s\n", orphanHash.ToString());
-                        vEraseQueue.push_back(orphanHash);
-                    }
-                    mempool.check(pcoinsTip);
-                }
-            }
-
-            BOOST_FOREACH (uint256 hash, vEraseQueue)
-                EraseOrphanTx(hash);
-        } else if (fMissingInputs) {
-            AddOrphanTx(tx, pfrom->GetId());
-
-            // DoS prevention: do not allow mapOrphanTransactions to grow unbounded
-            unsigned int nMaxOrphanTx = (unsigned int)std::max((int64_t)0, GetArg("-maxorphantx", DEFAULT_MAX_ORPHAN_TRANSACTIONS));
-            unsigned int nEvicted = LimitOrphanTxSize(nMaxOrphanTx);
-            if (nEvicted > 0)
-                LogPrint("mempool", "mapOrphan overflow, removed %u tx\n", nEvicted);
-        } else if (pfrom->fWhitelisted) {
-            // Always relay transactions received from whitelisted peers, even
-            // if they are already in the mempool (allowing the node to function
-            // as a gateway for nodes hidden behind it).
-
-            RelayTransaction(tx);
-        }
+        bool fAccepted = AcceptToMemoryPool(mempool, state, tx, true, &fMissingInputs, false, ignoreFees);
+        ProcessRelayedTx(pfrom, strCommand, tx, fAccepted, fMissingInputs, state);
 
         if (strCommand == "dstx") {
             CInv inv(MSG_DSTX, tx.GetHash());
             RelayInv(inv);
         }
 
-        int nDoS = 0;
-        if (state.IsInvalid(nDoS)) {
-            LogPrint("mempool", "%s from peer=%d %s was not accepted into the memory pool: %s\n", tx.GetHash().ToString(),
-                pfrom->id, pfrom->cleanSubVer,
-                state.GetRejectReason());
-            pfrom->PushMessage("reject", strCommand, state.GetRejectCode(),
-                state.GetRejectReason().substr(0, MAX_REJECT_MESSAGE_LENGTH), inv.hash);
-            if (nDoS > 0)
-                Misbehaving(pfrom->GetId(), nDoS);
-        }
     }
 
 
@@ -5225,37 +6008,49 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
 
     else if (strCommand == "block" && !fImporting && !fReindex) // Ignore blocks received while importing
     {
-        CBlock block;
-        vRecv >> block;
+        boost::shared_ptr<CBlock> pblock(new CBlock());
+        vRecv >> *pblock;
+        const CBlock& block = *pblock;
         uint256 hashBlock = block.GetHash();
         CInv inv(MSG_BLOCK, hashBlock);
         LogPrint("net", "received block %s peer=%d\n", inv.hash.ToString(), pfrom->id);
 
+        // Other handler threads insert into mapBlockIndex and move the tip, so look up and
+        // build the locator under cs_main, then send after releasing it
+        bool fHavePrev;
+        bool fHaveBlock;
+        CBlockLocator locator;
+        {
+            LOCK(cs_main);
+            fHavePrev = mapBlockIndex.count(block.hashPrevBlock) > 0;
+            fHaveBlock = mapBlockIndex.count(hashBlock) > 0;
+            if (!fHavePrev)
+                locator = chainActive.GetLocator();
+        }
+
         //sometimes we will be sent their most recent block and its not the one we want, in that case tell where we are
-        if (!mapBlockIndex.count(block.hashPrevBlock)) {
+        if (!fHavePrev) {
             if (find(pfrom->vBlockRequested.begin(), pfrom->vBlockRequested.end(), hashBlock) != pfrom->vBlockRequested.end()) {
                 //we already asked for this block, so lets work backwards and ask for the previous block
-                pfrom->PushMessage("getblocks", chainActive.GetLocator(), block.hashPrevBlock);
+                pfrom->PushMessage("getblocks", locator, block.hashPrevBlock);
                 pfrom->vBlockRequested.push_back(block.hashPrevBlock);
             } else {
                 //ask to sync to this block
-                pfrom->PushMessage("getblocks", chainActive.GetLocator(), hashBlock);
+                pfrom->PushMessage("getblocks", locator, hashBlock);
                 pfrom->vBlockRequested.push_back(hashBlock);
             }
         } else {
             pfrom->AddInventoryKnown(inv);
 
             CValidationState state;
-            if (!mapBlockIndex.count(block.GetHash())) {
-                ProcessNewBlock(state, pfrom, &block);
+            if (!fHaveBlock) {
+                ProcessNewBlock(state, pfrom, pblock);
                 int nDoS;
                 if(state.IsInvalid(nDoS)) {
                     pfrom->PushMessage("reject", strCommand, state.GetRejectCode(),
                                        state.GetRejectReason().substr(0, MAX_REJECT_MESSAGE_LENGTH), inv.hash);
-                    if(nDoS > 0) {
-                        TRY_LOCK(cs_main, lockMain);
-                        if(lockMain) Misbehaving(pfrom->GetId(), nDoS);
-                    }
+                    if(nDoS > 0)
+                        Misbehaving(pfrom->GetId(), nDoS);
                 }
                 //disconnect this node if its old protocol version
                 pfrom->DisconnectOldProtocol(ActiveProtocol(), strCommand);
@@ -5272,7 +6067,7 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
     // Making users (which are behind NAT and can only make outgoing connections) ignore
     // getaddr message mitigates the attack.
     else if ((strCommand == "getaddr") && (pfrom->fInbound)) {
-        pfrom->vAddrToSend.clear();
+        pfrom->ClearAddrToSend();
         vector<CAddress> vAddr = addrman.GetAddr();
         BOOST_FOREACH (const CAddress& addr, vAddr)
             pfrom->PushAddress(addr);
@@ -5531,11 +6326,11 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
 
                     if (addr != zero)
                     {
-                        app.onMessageReceived(addr, raw, state);
+                        app.onMessageReceived(addr, raw, pfrom->packetVerifyQueue, state);
                     }
                     else
                     {
-                        app.onBroadcastReceived(raw, state);
+                        app.onBroadcastReceived(raw, pfrom->packetVerifyQueue, state);
                     }
 
                     int dos = 0;
@@ -5565,7 +6360,6 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
             vRecv >> raw;
             if (raw.size() < (20 + sizeof(time_t))) {
                 // bad packet, small penalty
-                LOCK(cs_main);
                 Misbehaving(pfrom->GetId(), 10);
             } else {
                 xrouter::App& app = xrouter::App::instance();
@@ -5575,7 +6369,6 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
                     LogPrint("xrouter", "xrouter packet from peer=%d %s processed with error: %s\n",
                              pfrom->id, pfrom->cleanSubVer, std::string(e.what()));
                     // bad packet, small penalty
-                    LOCK(cs_main);
                     Misbehaving(pfrom->GetId(), 10);
                 }
             }
@@ -5708,8 +6501,11 @@ bool ProcessMessages(CNode* pfrom)
     }
 
     // In case the connection got shut down, its receive buffer was wiped
-    if (!pfrom->Disconnecting())
+    if (!pfrom->Disconnecting()) {
+        for (std::deque<CNetMessage>::iterator itMsg = pfrom->vRecvMsg.begin(); itMsg != it; ++itMsg)
+            itMsg->ReleaseBuffer();
         pfrom->vRecvMsg.erase(pfrom->vRecvMsg.begin(), it);
+    }
 
     return fOk;
 }
@@ -5762,7 +6558,7 @@ bool SendMessages(CNode* pto, bool fSendTrickle)
             BOOST_FOREACH (CNode* pnode, vNodes) {
                 // Periodically clear setAddrKnown to allow refresh broadcasts
                 if (nLastRebroadcast)
-                    pnode->setAddrKnown.clear();
+                    pnode->ClearAddrKnown();
 
                 // Rebroadcast our address
                 AdvertizeLocal(pnode);
@@ -5775,24 +6571,22 @@ bool SendMessages(CNode* pto, bool fSendTrickle)
         // Message: addr
         //
         if (fSendTrickle) {
+            vector<CAddress> vAddrToSend = pto->TakeAddrToSend();
             vector<CAddress> vAddr;
-            vAddr.reserve(pto->vAddrToSend.size());
-            BOOST_FOREACH (const CAddress& addr, pto->vAddrToSend) {
-                // returns true if wasn't already contained in the set
-                if (pto->setAddrKnown.insert(addr).second) {
-                    vAddr.push_back(addr);
-                    // receiver rejects addr messages larger than 1000
-                    if (vAddr.size() >= 1000) {
-                        pto->PushMessage("addr", vAddr);
-                        vAddr.clear();
-                    }
+            vAddr.reserve(std::min(vAddrToSend.size(), (size_t)1000));
+            BOOST_FOREACH (const CAddress& addr, vAddrToSend) {
+                vAddr.push_back(addr);
+                // receiver rejects addr messages larger than 1000
+                if (vAddr.size() >= 1000) {
+                    pto->PushMessage("addr", vAddr);
+                    vAddr.clear();
                 }
             }
-            pto->vAddrToSend.clear();
             if (!vAddr.empty())
                 pto->PushMessage("addr", vAddr);
         }
 
+        ApplyPendingMisbehavior();
         CNodeState& state = *State(pto->GetId());
         if (state.fShouldBan) {
             if (pto->fWhitelisted)
@@ -5971,18 +6765,27 @@ bool CBlockUndo::WriteToDisk(CDiskBlockPos& pos, const uint256& hashBlock)
 
 bool CBlockUndo::ReadFromDisk(const CDiskBlockPos& pos, const uint256& hashBlock)
 {
-    // Open history file to read
-    CAutoFile filein(OpenUndoFile(pos, true), SER_DISK, CLIENT_VERSION);
-    if (filein.IsNull())
-        return error("CBlockUndo::ReadFromDisk : OpenBlockFile failed");
-
-    // Read block
+    // Read undo data and its checksum, straight out of the cached undo file if possible
     uint256 hashChecksum;
-    try {
-        filein >> *this;
-        filein >> hashChecksum;
-    } catch (std::exception& e) {
-        return error("%s : Deserialize or I/O error - %s", __func__, e.what());
+    CBlockFileRecord record;
+    if (pblockfilecache && pblockfilecache->ReadRecord(pos, "rev", sizeof(hashChecksum), record)) {
+        try {
+            CSpanReader(record.begin(), record.end(), SER_DISK, CLIENT_VERSION) >> *this >> hashChecksum;
+        } catch (std::exception& e) {
+            return error("%s : Deserialize or I/O error - %s", __func__, e.what());
+        }
+    } else {
+        // Open history file to read
+        CAutoFile filein(OpenUndoFile(pos, true), SER_DISK, CLIENT_VERSION);
+        if (filein.IsNull())
+            return error("CBlockUndo::ReadFromDisk : OpenBlockFile failed");
+
+        try {
+            filein >> *this;
+            filein >> hashChecksum;
+        } catch (std::exception& e) {
+            return error("%s : Deserialize or I/O error - %s", __func__, e.what());
+        }
     }
 
     // Verify checksum
@@ -6007,10 +6810,7 @@ public:
     CMainCleanup() {}
     ~CMainCleanup()
     {
-        // block headers
-        BlockMap::iterator it1 = mapBlockIndex.begin();
-        for (; it1 != mapBlockIndex.end(); it1++)
-            delete (*it1).second;
+        // block headers, the entries themselves are owned by blockIndexArena
         mapBlockIndex.clear();
 
         // orphan transactions
@@ -19,6 +19,7 @@
 #include "timedata.h"
 #include "util.h"
 #include "utilmoneystr.h"
+#include "validationinterface.h"
 #ifdef ENABLE_WALLET
 #include "wallet.h"
 #endif
@@ -429,9 +430,10 @@ bool ProcessBlockFound(CBlock* pblock, CWallet& wallet, CReserveKey& reservekey)
         wallet.mapRequestCount[pblock->GetHash()] = 0;
     }
 
-    // Process this block the same as if we had received it from another node
+    // Process this block the same as if we had received it from another node. The
+    // template keeps its block, so the queued notifications get their own copy.
     CValidationState state;
-    if (!ProcessNewBlock(state, NULL, pblock))
+    if (!ProcessNewBlock(state, NULL, boost::shared_ptr<CBlock>(new CBlock(*pblock))))
         return error("BlocknetMiner : ProcessNewBlock, block not accepted");
 
     return true;
@@ -475,6 +477,11 @@ void BitcoinMiner(CWallet* pwallet, bool fProofOfStake)
             }
         }
 
+        // Wallet notifications are delivered asynchronously, stake with the coins
+        // of every block connected so far
+        if (fProofOfStake)
+            SyncWithValidationInterfaceQueue();
+
         //
         // Create new block
         //
@@ -35,6 +35,8 @@
 #include <miniupnpc/upnperrors.h>
 #endif
 
+#include <atomic>
+
 #include <boost/filesystem.hpp>
 #include <boost/thread.hpp>
 
@@ -106,6 +108,17 @@ CCriticalSection cs_nLastNodeId;
 
 static CSemaphore* semOutbound = NULL;
 boost::condition_variable messageHandlerCondition;
+//! Peer picked by the first message handler each round to trickle addresses and inventory to, -1 once sent
+static std::atomic<NodeId> nodeTrickle(-1);
+
+CNetBufferPool netBufferPool;
+
+/** Capacity of the buffers of each pool size class, the largest fits any protocol message */
+static const size_t nNetBufferClassSize[CNetBufferPool::SIZE_CLASSES] = {1 << 10, 16 << 10, 128 << 10, 512 << 10, MAX_PROTOCOL_MESSAGE_LENGTH};
+/** How many buffers of each size class are kept around, about 11 MiB in total */
+static const size_t nNetBufferClassMax[CNetBufferPool::SIZE_CLASSES] = {256, 64, 16, 8, 2};
+/** Maximum number of queued messages handed to a single sendmsg call */
+static const int MAX_SEND_IOVECS = 64;
 
 // Signals for message handling
 static CNodeSignals g_signals;
@@ -627,7 +640,8 @@ bool CNode::ReceiveMsgBytes(const char* pch, unsigned int nBytes)
 
         if (msg.complete()) {
             msg.nTime = GetTimeMicros();
-            messageHandlerCondition.notify_one();
+            // the waiting worker may not be the one this peer belongs to
+            messageHandlerCondition.notify_all();
         }
     }
 
@@ -671,7 +685,16 @@ int CNetMessage::readData(const char* pch, unsigned int nBytes)
 
     if (vRecv.size() < nDataPos + nCopy) {
         // Allocate up to 256 KiB ahead, but never more than the total message size.
-        vRecv.resize(std::min(hdr.nMessageSize, nDataPos + nCopy + 256 * 1024));
+        unsigned int nSize = std::min(hdr.nMessageSize, nDataPos + nCopy + 256 * 1024);
+        if (nSize > vRecv.capacity()) {
+            // Move to a pooled buffer rather than letting the vector reallocate
+            CSerializeData data;
+            netBufferPool.Get(data, nSize);
+            data.assign(vRecv.begin(), vRecv.begin() + nDataPos);
+            vRecv.swap(data);
+            netBufferPool.Put(data);
+        }
+        vRecv.resize(nSize);
     }
 
     memcpy(&vRecv[nDataPos], pch, nCopy);
@@ -680,6 +703,62 @@ int CNetMessage::readData(const char* pch, unsigned int nBytes)
     return nCopy;
 }
 
+void CNetMessage::ReleaseBuffer()
+{
+    CSerializeData data;
+    vRecv.swap(data);
+    netBufferPool.Put(data);
+}
+
+void CNetBufferPool::Get(CSerializeData& data, size_t nSize)
+{
+    data.clear();
+    for (int i = 0; i < SIZE_CLASSES; i++) {
+        if (nSize > nNetBufferClassSize[i])
+            continue;
+        {
+            LOCK(cs);
+            if (!vBuffers[i].empty()) {
+                data.swap(vBuffers[i].back());
+                vBuffers[i].pop_back();
+                return;
+            }
+        }
+        data.reserve(nNetBufferClassSize[i]);
+        return;
+    }
+    // too large to be pooled
+    data.reserve(nSize);
+}
+
+void CNetBufferPool::Put(CSerializeData& data)
+{
+    // file the buffer under the largest class it can serve
+    int nClass = -1;
+    while (nClass + 1 < SIZE_CLASSES && data.capacity() >= nNetBufferClassSize[nClass + 1])
+        nClass++;
+
+    if (nClass >= 0 && data.capacity() <= 2 * nNetBufferClassSize[nClass]) {
+        data.clear();
+        LOCK(cs);
+        if (vBuffers[nClass].size() < nNetBufferClassMax[nClass]) {
+            vBuffers[nClass].push_back(CSerializeData());
+            vBuffers[nClass].back().swap(data);
+            return;
+        }
+    }
+    CSerializeData().swap(data);
+}
+
+size_t CNetBufferPool::GetPooledCount() const
+{
+    LOCK(cs);
+    size_t nCount = 0;
+    for (int i = 0; i < SIZE_CLASSES; i++)
+        nCount += vBuffers[i].size();
+    return nCount;
+}
+
 
 // requires LOCK(cs_vSend)
 void SocketSendData(CNode* pnode)
@@ -687,19 +766,45 @@ void SocketSendData(CNode* pnode)
     std::deque<CSerializeData>::iterator it = pnode->vSendMsg.begin();
 
     while (it != pnode->vSendMsg.end()) {
+        assert(it->size() > pnode->nSendOffset);
+#ifdef WIN32
         const CSerializeData& data = *it;
-        assert(data.size() > pnode->nSendOffset);
         int nBytes = send(pnode->hSocket, &data[pnode->nSendOffset], data.size() - pnode->nSendOffset, MSG_NOSIGNAL | MSG_DONTWAIT);
+#else
+        // Hand as many queued messages as possible to the kernel at once
+        struct iovec iov[MAX_SEND_IOVECS];
+        int nIov = 0;
+        for (std::deque<CSerializeData>::iterator itIov = it; itIov != pnode->vSendMsg.end() && nIov < MAX_SEND_IOVECS; ++itIov, ++nIov) {
+            size_t nOffset = nIov == 0 ? pnode->nSendOffset : 0;
+            iov[nIov].iov_base = &(*itIov)[nOffset];
+            iov[nIov].iov_len = itIov->size() - nOffset;
+        }
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = nIov;
+        ssize_t nBytes = sendmsg(pnode->hSocket, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+#endif
         if (nBytes > 0) {
             pnode->nLastSend = GetTime();
             pnode->nSendBytes += nBytes;
-            pnode->nSendOffset += nBytes;
             pnode->RecordBytesSent(nBytes);
-            if (pnode->nSendOffset == data.size()) {
+
+            // Retire the messages that went out completely, their buffers go back to the pool
+            size_t nSent = nBytes;
+            while (nSent > 0) {
+                size_t nPending = it->size() - pnode->nSendOffset;
+                if (nSent < nPending) {
+                    pnode->nSendOffset += nSent;
+                    break;
+                }
+                nSent -= nPending;
                 pnode->nSendOffset = 0;
-                pnode->nSendSize -= data.size();
+                pnode->nSendSize -= it->size();
+                netBufferPool.Put(*it);
                 it++;
-            } else {
+            }
+            if (pnode->nSendOffset != 0) {
                 // could not send full message; stop sending more
                 break;
             }
@@ -733,6 +838,7 @@ void ThreadSocketHandler()
         //
         // Disconnect nodes
         //
+        std::vector<std::string> vRemovedAddrs;
         {
             LOCK(cs_vNodes);
             // Disconnect unused nodes
@@ -742,6 +848,7 @@ void ThreadSocketHandler()
                     (pnode->GetRefCount() <= 0 && pnode->vRecvMsg.empty() && pnode->nSendSize == 0 && pnode->ssSend.empty())) {
                     // remove from vNodes
                     vNodes.erase(remove(vNodes.begin(), vNodes.end(), pnode), vNodes.end());
+                    vRemovedAddrs.push_back(pnode->NodeAddress());
 
                     // release outbound grant (if any)
                     pnode->grantOutbound.Release();
@@ -756,6 +863,11 @@ void ThreadSocketHandler()
                 }
             }
         }
+        // XRouter only selects connected service nodes
+        if (!vRemovedAddrs.empty() && xrouter::App::isEnabled()) {
+            for (const std::string& addr : vRemovedAddrs)
+                xrouter::App::instance().removeCandidate(addr);
+        }
         {
             // Delete disconnected nodes
             list<CNode*> vNodesDisconnectedCopy = vNodesDisconnected;
@@ -1400,7 +1512,12 @@ CNode* OpenNetworkConnection(const CAddress& addrConnect, CSemaphoreGrant* grant
 }
 
 
-void ThreadMessageHandler()
+/**
+ * Process the messages of the peers whose id maps to this worker. Every peer
+ * is always handled by the same worker, so its messages are processed in the
+ * order they arrived while the peers of different workers run concurrently.
+ */
+void ThreadMessageHandler(int nThread, int nThreads)
 {
     boost::mutex condition_mutex;
     boost::unique_lock<boost::mutex> lock(condition_mutex);
@@ -1410,17 +1527,19 @@ void ThreadMessageHandler()
         vector<CNode*> vNodesCopy;
         {
             LOCK(cs_vNodes);
-            vNodesCopy = vNodes;
-            BOOST_FOREACH (CNode* pnode, vNodesCopy) {
+            BOOST_FOREACH (CNode* pnode, vNodes) {
+                if (pnode->GetId() % nThreads != nThread)
+                    continue;
                 pnode->AddRef();
+                vNodesCopy.push_back(pnode);
             }
+
+            // one trickle peer per round for the whole pool, as with a single handler
+            if (nThread == 0 && !vNodes.empty())
+                nodeTrickle = vNodes[GetRand(vNodes.size())]->GetId();
         }
 
         // Poll the connected nodes for messages
-        CNode* pnodeTrickle = NULL;
-        if (!vNodesCopy.empty())
-            pnodeTrickle = vNodesCopy[GetRand(vNodesCopy.size())];
-
         bool fSleep = true;
 
         BOOST_FOREACH (CNode* pnode, vNodesCopy) {
@@ -1434,6 +1553,9 @@ void ThreadMessageHandler()
                     if (!g_signals.ProcessMessages(pnode))
                         pnode->CloseSocketDisconnect();
 
+                    // go on with the XBridge and XRouter packets of this peer verified so far
+                    pnode->packetVerifyQueue.RunVerified();
+
                     if (pnode->nSendSize < SendBufferSize()) {
                         if (!pnode->vRecvGetData.empty() || (!pnode->vRecvMsg.empty() && pnode->vRecvMsg[0].complete())) {
                             fSleep = false;
@@ -1446,12 +1568,17 @@ void ThreadMessageHandler()
             // Send messages
             {
                 TRY_LOCK(pnode->cs_vSend, lockSend);
-                if (lockSend)
-                    g_signals.SendMessages(pnode, pnode == pnodeTrickle || pnode->fWhitelisted);
+                if (lockSend) {
+                    NodeId nodeid = pnode->GetId();
+                    bool fTrickle = nodeTrickle == nodeid && nodeTrickle.compare_exchange_strong(nodeid, -1);
+                    g_signals.SendMessages(pnode, fTrickle || pnode->fWhitelisted);
+                }
             }
             boost::this_thread::interruption_point();
         }
 
+        // Accept the transactions the peers relayed during this pass, while they're still referenced
+        g_signals.ProcessQueuedTransactions();
 
         {
             LOCK(cs_vNodes);
@@ -1464,6 +1591,11 @@ void ThreadMessageHandler()
     }
 }
 
+void WakeMessageHandler()
+{
+    messageHandlerCondition.notify_all();
+}
+
 // ppcoin: stake minter thread
 void static ThreadStakeMinter()
 {
@@ -1659,7 +1791,12 @@ void StartNode(boost::thread_group& threadGroup)
     threadGroup.create_thread(boost::bind(&TraceThread<void (*)()>, "opencon", &ThreadOpenConnections));
 
     // Process messages
-    threadGroup.create_thread(boost::bind(&TraceThread<void (*)()>, "msghand", &ThreadMessageHandler));
+    int nMessageHandlerThreads = GetArg("-msghandlerthreads", DEFAULT_MESSAGE_HANDLER_THREADS);
+    nMessageHandlerThreads = std::max(1, std::min(nMessageHandlerThreads, MAX_MESSAGE_HANDLER_THREADS));
+    LogPrintf("Using %d message handler threads\n", nMessageHandlerThreads);
+    for (int i = 0; i < nMessageHandlerThreads; i++)
+        threadGroup.create_thread(boost::bind(&TraceThread<boost::function<void()> >, "msghand",
+            boost::function<void()>(boost::bind(&ThreadMessageHandler, i, nMessageHandlerThreads))));
 
     // Dump network addresses
     threadGroup.create_thread(boost::bind(&LoopForever<void (*)()>, "dumpaddr", &DumpAddresses, DUMP_ADDRESSES_INTERVAL * 1000));
@@ -2090,6 +2227,7 @@ void CNode::EndMessage() UNLOCK_FUNCTION(cs_vSend)
     LogPrint("net", "(%d bytes) peer=%d\n", nSize, id);
 
     std::deque<CSerializeData>::iterator it = vSendMsg.insert(vSendMsg.end(), CSerializeData());
+    netBufferPool.Get(*it, ssSend.size());
     ssSend.GetAndClear(*it);
     nSendSize += (*it).size();
 
@@ -12,6 +12,7 @@
 #include "limitedmap.h"
 #include "mruset.h"
 #include "netbase.h"
+#include "packetverifier.h"
 #include "protocol.h"
 #include "random.h"
 #include "streams.h"
@@ -59,6 +60,10 @@ static const bool DEFAULT_UPNP = false;
 #endif
 /** The maximum number of entries in mapAskFor */
 static const size_t MAPASKFOR_MAX_SZ = MAX_INV_SZ;
+/** -msghandlerthreads default */
+static const int DEFAULT_MESSAGE_HANDLER_THREADS = 1;
+/** Upper bound of -msghandlerthreads */
+static const int MAX_MESSAGE_HANDLER_THREADS = 16;
 
 unsigned int ReceiveFloodSize();
 unsigned int SendBufferSize();
@@ -79,6 +84,8 @@ bool BindListenPort(const CService& bindAddr, std::string& strError, bool fWhite
 void StartNode(boost::thread_group& threadGroup);
 bool StopNode();
 void SocketSendData(CNode* pnode);
+/** Wake the message handler threads, e.g. when packets they posted for verification are done */
+void WakeMessageHandler();
 
 typedef int NodeId;
 
@@ -87,6 +94,7 @@ struct CNodeSignals {
     boost::signals2::signal<int()> GetHeight;
     boost::signals2::signal<bool(CNode*)> ProcessMessages;
     boost::signals2::signal<bool(CNode*, bool)> SendMessages;
+    boost::signals2::signal<void()> ProcessQueuedTransactions;
     boost::signals2::signal<void(NodeId, const CNode*)> InitializeNode;
     boost::signals2::signal<void(NodeId)> FinalizeNode;
 };
@@ -173,6 +181,31 @@ public:
 };
 
 
+/**
+ * Recycles the buffers of network messages, by size class. Buffers that are
+ * handed back keep their allocation, so the next message of a similar size
+ * neither allocates nor has the zero_after_free_allocator wipe a buffer that
+ * only ever held public data.
+ */
+class CNetBufferPool
+{
+public:
+    static const int SIZE_CLASSES = 5;
+
+    /** Make data an empty buffer with room for at least nSize bytes, taken out of the pool if possible */
+    void Get(CSerializeData& data, size_t nSize);
+    /** Take the allocation of data back into the pool, leaving data empty */
+    void Put(CSerializeData& data);
+    /** Number of buffers waiting in the pool */
+    size_t GetPooledCount() const;
+
+private:
+    mutable CCriticalSection cs;
+    std::vector<CSerializeData> vBuffers[SIZE_CLASSES];
+};
+
+extern CNetBufferPool netBufferPool;
+
 class CNetMessage
 {
 public:
@@ -211,6 +244,9 @@ public:
 
     int readHeader(const char* pch, unsigned int nBytes);
     int readData(const char* pch, unsigned int nBytes);
+
+    /** Hand the buffer of the processed message back to netBufferPool */
+    void ReleaseBuffer();
 };
 
 
@@ -231,6 +267,8 @@ public:
     std::deque<CInv> vRecvGetData;
     std::deque<CNetMessage> vRecvMsg;
     CCriticalSection cs_vRecvMsg;
+    // XBridge and XRouter packets being verified, processed in order by this peer's handler thread
+    CPacketVerifyQueue packetVerifyQueue;
     uint64_t nRecvBytes;
     int nRecvVersion;
 
@@ -295,7 +333,7 @@ public:
     uint256 hashContinue;
     int nStartingHeight;
 
-    // flood relay
+    // flood relay, vAddrToSend and setAddrKnown are guarded by cs
     std::vector<CAddress> vAddrToSend;
     mruset<CAddress> setAddrKnown;
     bool fGetAddr;
@@ -396,6 +434,33 @@ public:
         }
     }
 
+    /** Take the queued addresses this peer does not know yet, they count as known from now on */
+    std::vector<CAddress> TakeAddrToSend()
+    {
+        LOCK(cs);
+        std::vector<CAddress> vAddr;
+        vAddr.reserve(vAddrToSend.size());
+        for (const CAddress& addr : vAddrToSend) {
+            // returns true if wasn't already contained in the set
+            if (setAddrKnown.insert(addr).second)
+                vAddr.push_back(addr);
+        }
+        vAddrToSend.clear();
+        return vAddr;
+    }
+
+    void ClearAddrToSend()
+    {
+        LOCK(cs);
+        vAddrToSend.clear();
+    }
+
+    void ClearAddrKnown()
+    {
+        LOCK(cs);
+        setAddrKnown.clear();
+    }
+
 
     void AddInventoryKnown(const CInv& inv)
     {
@@ -8,6 +8,7 @@
 #include "coincontrol.h"
 #include "init.h"
 #include "main.h"
+#include "servicenode-budget.h"
 #include "servicenodeman.h"
 #include "script/sign.h"
 #include "swifttx.h"
@@ -49,6 +50,9 @@ void CObfuscationPool::ProcessMessageObfuscation(CNode* pfrom, std::string& strC
     if (fLiteMode) return; //disable all Obfuscation/Servicenode related functionality
     if (!servicenodeSync.IsBlockchainSynced()) return;
 
+    // the pool's session, entries and queue are shared by all message handler threads
+    LOCK(cs_obfuscation);
+
     if (strCommand == "dsa") { //Obfuscation Accept Into Pool
 
         int errorID;
@@ -73,21 +77,24 @@ void CObfuscationPool::ProcessMessageObfuscation(CNode* pfrom, std::string& strC
         CTransaction txCollateral;
         vRecv >> nDenom >> txCollateral;
 
-        CServicenode* pmn = mnodeman.Find(activeServicenode.vin);
-        if (pmn == NULL) {
-            errorID = ERR_MN_LIST;
-            pfrom->PushMessage("dssu", sessionID, GetState(), GetEntriesCount(), SERVICENODE_REJECTED, errorID);
-            return;
-        }
-
-        if (sessionUsers == 0) {
-            if (pmn->nLastDsq != 0 &&
-                pmn->nLastDsq + mnodeman.CountEnabled(ActiveProtocol()) / 5 > mnodeman.nDsqCount) {
-                LogPrintf("dsa -- last dsq too recent, must wait. %s \n", pfrom->addr.ToString());
-                errorID = ERR_RECENT;
+        {
+            LOCK(mnodeman.cs);
+            CServicenode* pmn = mnodeman.Find(activeServicenode.vin);
+            if (pmn == NULL) {
+                errorID = ERR_MN_LIST;
                 pfrom->PushMessage("dssu", sessionID, GetState(), GetEntriesCount(), SERVICENODE_REJECTED, errorID);
                 return;
             }
+
+            if (sessionUsers == 0) {
+                if (pmn->nLastDsq != 0 &&
+                    pmn->nLastDsq + mnodeman.CountEnabled(ActiveProtocol()) / 5 > mnodeman.nDsqCount) {
+                    LogPrintf("dsa -- last dsq too recent, must wait. %s \n", pfrom->addr.ToString());
+                    errorID = ERR_RECENT;
+                    pfrom->PushMessage("dssu", sessionID, GetState(), GetEntriesCount(), SERVICENODE_REJECTED, errorID);
+                    return;
+                }
+            }
         }
 
         if (!IsCompatibleWithSession(nDenom, txCollateral, errorID)) {
@@ -101,9 +108,6 @@ void CObfuscationPool::ProcessMessageObfuscation(CNode* pfrom, std::string& strC
         }
 
     } else if (strCommand == "dsq") { //Obfuscation Queue
-        TRY_LOCK(cs_obfuscation, lockRecv);
-        if (!lockRecv) return;
-
         if (pfrom->nVersion < ActiveProtocol()) {
             return;
         }
@@ -117,8 +121,7 @@ void CObfuscationPool::ProcessMessageObfuscation(CNode* pfrom, std::string& strC
 
         if (dsq.IsExpired()) return;
 
-        CServicenode* pmn = mnodeman.Find(dsq.vin);
-        if (pmn == NULL) return;
+        if (mnodeman.Find(dsq.vin) == NULL) return;
 
         // if the queue is ready, submit if we can
         if (dsq.ready) {
@@ -137,16 +140,22 @@ void CObfuscationPool::ProcessMessageObfuscation(CNode* pfrom, std::string& strC
                 if (q.vin == dsq.vin) return;
             }
 
-            LogPrint("obfuscation", "dsq last %d last2 %d count %d\n", pmn->nLastDsq, pmn->nLastDsq + mnodeman.size() / 5, mnodeman.nDsqCount);
-            //don't allow a few nodes to dominate the queuing process
-            if (pmn->nLastDsq != 0 &&
-                pmn->nLastDsq + mnodeman.CountEnabled(ActiveProtocol()) / 5 > mnodeman.nDsqCount) {
-                LogPrint("obfuscation", "dsq -- Servicenode sending too many dsq messages. %s \n", pmn->addr.ToString());
-                return;
+            {
+                LOCK(mnodeman.cs);
+                CServicenode* pmn = mnodeman.Find(dsq.vin);
+                if (pmn == NULL) return;
+
+                LogPrint("obfuscation", "dsq last %d last2 %d count %d\n", pmn->nLastDsq, pmn->nLastDsq + mnodeman.size() / 5, mnodeman.nDsqCount);
+                //don't allow a few nodes to dominate the queuing process
+                if (pmn->nLastDsq != 0 &&
+                    pmn->nLastDsq + mnodeman.CountEnabled(ActiveProtocol()) / 5 > mnodeman.nDsqCount) {
+                    LogPrint("obfuscation", "dsq -- Servicenode sending too many dsq messages. %s \n", pmn->addr.ToString());
+                    return;
+                }
+                mnodeman.nDsqCount++;
+                pmn->nLastDsq = mnodeman.nDsqCount;
+                pmn->allowFreeTx = true;
             }
-            mnodeman.nDsqCount++;
-            pmn->nLastDsq = mnodeman.nDsqCount;
-            pmn->allowFreeTx = true;
 
             LogPrint("obfuscation", "dsq - new Obfuscation queue object - %s\n", addr.ToString());
             vecObfuscationQueue.push_back(dsq);
@@ -2310,7 +2319,12 @@ void ThreadCheckObfuScationPool()
                 CleanTransactionLocksList();
             }
 
-            //if(c % SERVICENODES_DUMP_SECONDS == 0) DumpServicenodes();
+            // flush what changed since the last dump, so a crash only loses the last interval
+            if (c % SERVICENODES_DUMP_SECONDS == 0) {
+                DumpServicenodes();
+                DumpBudgets();
+                DumpServicenodePayments();
+            }
 
             obfuScationPool.CheckTimeout();
             obfuScationPool.CheckForCompleteQueue();
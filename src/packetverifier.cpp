@@ -0,0 +1,193 @@
+// Copyright (c) 2018 The Blocknet developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "packetverifier.h"
+
+#include "crypto/sha256.h"
+#include "random.h"
+#include "util.h"
+
+#include <algorithm>
+#include <vector>
+
+#include <boost/thread/locks.hpp>
+
+CPacketSignatureCache packetSignatureCache;
+CPacketVerifier packetVerifier;
+
+CPacketSignatureCache::CPacketSignatureCache() : nMaxSize(50000)
+{
+}
+
+uint256 CPacketSignatureCache::Key(const unsigned char* hash, const unsigned char* signature, size_t nSignatureSize,
+                                   const unsigned char* pubkey, size_t nPubKeySize)
+{
+    uint256 key;
+    CSHA256 sha256;
+    sha256.Write(hash, CSHA256::OUTPUT_SIZE);
+    sha256.Write(signature, nSignatureSize);
+    sha256.Write(pubkey, nPubKeySize);
+    sha256.Finalize(key.begin());
+    return key;
+}
+
+bool CPacketSignatureCache::Get(const uint256& key)
+{
+    boost::shared_lock<boost::shared_mutex> lock(mutex);
+    return setValid.count(key) > 0;
+}
+
+void CPacketSignatureCache::Set(const uint256& key)
+{
+    boost::unique_lock<boost::shared_mutex> lock(mutex);
+    if (nMaxSize <= 0)
+        return;
+
+    while (static_cast<int64_t>(setValid.size()) >= nMaxSize) {
+        // Evict a random entry, see CSignatureCache
+        std::set<uint256>::iterator it = setValid.lower_bound(GetRandHash());
+        if (it == setValid.end())
+            it = setValid.begin();
+        setValid.erase(it);
+    }
+    setValid.insert(key);
+}
+
+void CPacketSignatureCache::SetMaxSize(int64_t nMaxSizeIn)
+{
+    boost::unique_lock<boost::shared_mutex> lock(mutex);
+    nMaxSize = nMaxSizeIn;
+    if (nMaxSize <= 0)
+        setValid.clear();
+    while (static_cast<int64_t>(setValid.size()) > nMaxSize)
+        setValid.erase(setValid.begin());
+}
+
+CPacketVerifier::CPacketVerifier() : fRunning(false), nThreads(0)
+{
+}
+
+void CPacketVerifier::RunCheck(const CJob& job)
+{
+    bool fValid = false;
+    try {
+        fValid = job.check();
+    } catch (const std::exception& e) {
+        LogPrintf("%s: %s\n", __func__, e.what());
+    } catch (...) {
+        LogPrintf("%s: unknown exception\n", __func__);
+    }
+    job.result->nState = fValid ? CPacketVerifyResult::VALID : CPacketVerifyResult::INVALID;
+}
+
+void CPacketVerifier::Post(CPacketVerifyQueue& results, const Check& check, const Done& done)
+{
+    CJob job = {check, std::make_shared<CPacketVerifyResult>()};
+    job.result->done = done;
+    job.result->nState = CPacketVerifyResult::PENDING;
+    {
+        boost::unique_lock<boost::mutex> lock(results.mutex);
+        results.queue.push_back(job.result);
+    }
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        if (fRunning && queue.size() < PACKET_VERIFY_QUEUE_MAX) {
+            queue.push_back(job);
+            cond.notify_one();
+            return;
+        }
+    }
+    RunCheck(job);
+}
+
+void CPacketVerifier::Start(int nThreadsIn, const std::function<void()>& fnVerifiedIn)
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    nThreads = std::max(nThreadsIn, 1);
+    fnVerified = fnVerifiedIn;
+    fRunning = true;
+}
+
+void CPacketVerifier::Stop()
+{
+    std::deque<CJob> vLeft;
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        fRunning = false;
+        vLeft.swap(queue);
+    }
+    for (const CJob& job : vLeft)
+        RunCheck(job);
+}
+
+void CPacketVerifier::Thread()
+{
+    std::vector<CJob> vBatch;
+    while (true) {
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            while (queue.empty())
+                cond.wait(lock);
+
+            // Share what is pending between the threads, but take a whole batch
+            // during a burst so the results come back in large chunks
+            size_t nBatch = std::max<size_t>(1, std::min(PACKET_VERIFY_BATCH_MAX, queue.size() / nThreads));
+            vBatch.assign(queue.begin(), queue.begin() + nBatch);
+            queue.erase(queue.begin(), queue.begin() + nBatch);
+            if (!queue.empty())
+                cond.notify_one();
+        }
+
+        for (const CJob& job : vBatch)
+            RunCheck(job);
+        vBatch.clear();
+
+        // the continuations run on the handler threads of the peers that posted them
+        if (fnVerified)
+            fnVerified();
+    }
+}
+
+size_t CPacketVerifier::GetPending()
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    return queue.size();
+}
+
+size_t CPacketVerifyQueue::RunVerified()
+{
+    size_t nRun = 0;
+    while (true) {
+        std::shared_ptr<CPacketVerifyResult> result;
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            if (queue.empty() || queue.front()->nState == CPacketVerifyResult::PENDING)
+                break;
+            result = queue.front();
+            queue.pop_front();
+        }
+
+        try {
+            result->done(result->nState == CPacketVerifyResult::VALID);
+        } catch (const std::exception& e) {
+            LogPrintf("%s: %s\n", __func__, e.what());
+        } catch (...) {
+            LogPrintf("%s: unknown exception\n", __func__);
+        }
+        ++nRun;
+    }
+    return nRun;
+}
+
+size_t CPacketVerifyQueue::GetPending()
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    return queue.size();
+}
+
+void ThreadPacketVerify()
+{
+    RenameThread("blocknetdx-pktverify");
+    packetVerifier.Thread();
+}
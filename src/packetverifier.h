@@ -0,0 +1,146 @@
+// Copyright (c) 2018 The Blocknet developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef PACKETVERIFIER_H
+#define PACKETVERIFIER_H
+
+#include "uint256.h"
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <set>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/shared_mutex.hpp>
+
+/** -packetverifythreads default, 0 means one per core */
+static const int DEFAULT_PACKET_VERIFY_THREADS = 0;
+/** Upper bound of -packetverifythreads */
+static const int MAX_PACKET_VERIFY_THREADS = 16;
+/** Most packets a verification thread takes off the queue at once */
+static const size_t PACKET_VERIFY_BATCH_MAX = 64;
+/** Packets queued for verification before posting ones are verified by the poster */
+static const size_t PACKET_VERIFY_QUEUE_MAX = 10000;
+
+/**
+ * Cache of the XRouter and XBridge packet signatures that verified, keyed by
+ * sha256(body hash, signature, pubkey). The same signed packet is commonly
+ * received several times (relayed broadcasts, retransmits) and checked again by
+ * the session handlers. Entries are evicted at random, as in CSignatureCache.
+ */
+class CPacketSignatureCache
+{
+public:
+    CPacketSignatureCache();
+
+    static uint256 Key(const unsigned char* hash, const unsigned char* signature, size_t nSignatureSize,
+                       const unsigned char* pubkey, size_t nPubKeySize);
+
+    bool Get(const uint256& key);
+    void Set(const uint256& key);
+
+    /** Set once at startup from -maxsigcachesize, 0 disables the cache */
+    void SetMaxSize(int64_t nMaxSizeIn);
+
+private:
+    std::set<uint256> setValid;
+    int64_t nMaxSize;
+    boost::shared_mutex mutex;
+};
+
+/** One posted check, shared by the verifier and the queue of the peer that posted it */
+struct CPacketVerifyResult {
+    enum State {
+        PENDING,
+        VALID,
+        INVALID
+    };
+
+    std::function<void(bool)> done;
+    std::atomic<int> nState;
+};
+
+/**
+ * The packets one peer posted for verification, in the order they arrived. The
+ * continuations only run when the peer's message handler thread calls
+ * RunVerified(), for the packets at the front whose checks are done, so the
+ * packets of a peer are verified in parallel but still processed one at a time
+ * and in order.
+ */
+class CPacketVerifyQueue
+{
+public:
+    /** Run the continuations of the verified packets at the front, returns how many ran */
+    size_t RunVerified();
+
+    /** Packets whose continuation has not run yet */
+    size_t GetPending();
+
+private:
+    friend class CPacketVerifier;
+
+    boost::mutex mutex;
+    std::deque<std::shared_ptr<CPacketVerifyResult> > queue;
+};
+
+/**
+ * Verifies packet signatures on a pool of threads. The message handlers post a
+ * check along with what to do with the packet once it is known to be valid or
+ * not. Every thread takes a batch of the pending checks at a time and runs all
+ * of them, so during a burst the signatures are verified on all cores. The
+ * continuations are handed back to the posting peer's CPacketVerifyQueue and
+ * the handler thread is woken to run them.
+ *
+ * Until Start() and after Stop() checks run right away on the posting thread,
+ * as they do when too many are pending.
+ */
+class CPacketVerifier
+{
+public:
+    typedef std::function<bool()> Check;
+    typedef std::function<void(bool)> Done;
+
+    CPacketVerifier();
+
+    /** Run the check, on a verification thread if they are started, and queue done for results.RunVerified() */
+    void Post(CPacketVerifyQueue& results, const Check& check, const Done& done);
+
+    /** Start handing posted checks to nThreads threads running Thread(), fnVerified is called after every batch */
+    void Start(int nThreads, const std::function<void()>& fnVerified);
+    /** Stop queueing checks and run those still pending on the calling thread */
+    void Stop();
+
+    /** Worker loop, interrupted through boost::thread::interrupt() */
+    void Thread();
+
+    size_t GetPending();
+
+private:
+    struct CJob {
+        Check check;
+        std::shared_ptr<CPacketVerifyResult> result;
+    };
+
+    static void RunCheck(const CJob& job);
+
+    boost::mutex mutex;
+    boost::condition_variable cond;
+    std::deque<CJob> queue;
+    bool fRunning;
+    int nThreads;
+    std::function<void()> fnVerified;
+};
+
+extern CPacketSignatureCache packetSignatureCache;
+extern CPacketVerifier packetVerifier;
+
+/** Thread verifying posted packet signatures, see CPacketVerifier */
+void ThreadPacketVerify();
+
+#endif // PACKETVERIFIER_H
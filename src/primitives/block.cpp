@@ -5,6 +5,7 @@
 
 #include "primitives/block.h"
 
+#include "crypto/sha256.h"
 #include "hash.h"
 #include "script/standard.h"
 #include "script/sign.h"
@@ -62,15 +63,18 @@ uint256 CBlock::BuildMerkleTree(bool* fMutated) const
     bool mutated = false;
     for (int nSize = vtx.size(); nSize > 1; nSize = (nSize + 1) / 2)
     {
-        for (int i = 0; i < nSize; i += 2)
-        {
-            int i2 = std::min(i+1, nSize-1);
-            if (i2 == i + 1 && i2 + 1 == nSize && vMerkleTree[j+i] == vMerkleTree[j+i2]) {
-                // Two identical hashes at the end of the list at a particular level.
-                mutated = true;
-            }
-            vMerkleTree.push_back(Hash(BEGIN(vMerkleTree[j+i]),  END(vMerkleTree[j+i]),
-                                       BEGIN(vMerkleTree[j+i2]), END(vMerkleTree[j+i2])));
+        if (nSize % 2 == 0 && vMerkleTree[j+nSize-2] == vMerkleTree[j+nSize-1]) {
+            // Two identical hashes at the end of the list at a particular level.
+            mutated = true;
+        }
+        // The pairs of a level are adjacent 64-byte blobs, hash them in one batch.
+        // An odd one out at the end is paired with itself.
+        const int nPairs = nSize / 2;
+        vMerkleTree.resize(j + nSize + (nSize + 1) / 2);
+        SHA256D64(vMerkleTree[j+nSize].begin(), vMerkleTree[j].begin(), nPairs);
+        if (nSize % 2) {
+            const uint256& last = vMerkleTree[j+nSize-1];
+            vMerkleTree[j+nSize+nPairs] = Hash(BEGIN(last), END(last), BEGIN(last), END(last));
         }
         j += nSize;
     }
@@ -140,6 +144,8 @@ void CBlock::print() const
 // ppcoin: sign block
 bool CBlock::SignBlock(const CKeyStore& keystore)
 {
+    fSignatureChecked = false;
+
     std::vector<valtype> vSolutions;
     txnouttype whichType;
 
@@ -219,6 +225,9 @@ bool CBlock::CheckBlockSignature() const
     if (IsProofOfWork())
         return vchBlockSig.empty();
 
+    if (fSignatureChecked)
+        return true;
+
     std::vector<valtype> vSolutions;
     txnouttype whichType;
 
@@ -237,7 +246,8 @@ bool CBlock::CheckBlockSignature() const
         if (vchBlockSig.empty())
             return false;
 
-        return pubkey.Verify(GetHash(), vchBlockSig);
+        fSignatureChecked = pubkey.Verify(GetHash(), vchBlockSig);
+        return fSignatureChecked;
     }
     else if(whichType == TX_PUBKEYHASH)
     {
@@ -252,7 +262,8 @@ bool CBlock::CheckBlockSignature() const
         if (vchBlockSig.empty())
             return false;
 
-        return pubkey.Verify(GetHash(), vchBlockSig);
+        fSignatureChecked = pubkey.Verify(GetHash(), vchBlockSig);
+        return fSignatureChecked;
 
     }
 
@@ -87,6 +87,8 @@ public:
     // memory only
     mutable CScript payee;
     mutable std::vector<uint256> vMerkleTree;
+    //! set once CheckBlockSignature() passed, so a block checked ahead of time is not verified twice
+    mutable bool fSignatureChecked;
 
     CBlock()
     {
@@ -107,6 +109,8 @@ public:
         READWRITE(vtx);
 	if(vtx.size() > 1 && vtx[1].IsCoinStake())
 		READWRITE(vchBlockSig);
+        if (ser_action.ForRead())
+            fSignatureChecked = false;
     }
 
     void SetNull()
@@ -116,6 +120,7 @@ public:
         vMerkleTree.clear();
         payee = CScript();
         vchBlockSig.clear();
+        fSignatureChecked = false;
     }
 
     CBlockHeader GetBlockHeader() const
@@ -72,6 +72,10 @@ enum {
     // but no longer do as of protocol version 70011 (= NO_BLOOM_VERSION)
     NODE_BLOOM = (1 << 2),
 
+    // NODE_COMPACT_FILTERS means the node will service basic block filter requests
+    // (getcfilters, getcfheaders and getcfcheckpt), see BIP 157 and 158.
+    NODE_COMPACT_FILTERS = (1 << 6),
+
     // Bits 24-31 are reserved for temporary experiments. Just pick a bit that
     // isn't getting used, or one not being used much, and notify the
     // bitcoin-development mailing list. Remember that service bits are just
@@ -226,7 +226,10 @@ void BlocknetCreateProposal3::onSubmit() {
         return;
     }
 
-    budget.mapSeenServicenodeBudgetProposals.insert(make_pair(budgetProposalBroadcast.GetHash(), budgetProposalBroadcast));
+    {
+        LOCK(budget.cs_seen);
+        budget.mapSeenServicenodeBudgetProposals.insert(make_pair(budgetProposalBroadcast.GetHash(), budgetProposalBroadcast));
+    }
     budgetProposalBroadcast.Relay();
 
     QString hash = QString::fromStdString(budgetProposalBroadcast.GetHash().ToString());
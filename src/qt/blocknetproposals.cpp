@@ -610,7 +610,10 @@ void BlocknetProposals::onVote() {
 
                     std::string strError = "";
                     if (budget.UpdateProposal(vote, nullptr, strError)) {
-                        budget.mapSeenServicenodeBudgetVotes.insert(make_pair(vote.GetHash(), vote));
+                        {
+                            LOCK(budget.cs_seen);
+                            budget.mapSeenServicenodeBudgetVotes.insert(make_pair(vote.GetHash(), vote));
+                        }
                         vote.Relay();
                         ++successfulVotes;
                     } else {
@@ -650,7 +653,10 @@ void BlocknetProposals::onVote() {
 
                 std::string strError = "";
                 if (budget.UpdateProposal(vote, nullptr, strError)) {
-                    budget.mapSeenServicenodeBudgetVotes.insert(make_pair(vote.GetHash(), vote));
+                    {
+                        LOCK(budget.cs_seen);
+                        budget.mapSeenServicenodeBudgetVotes.insert(make_pair(vote.GetHash(), vote));
+                    }
                     vote.Relay();
                     return true;
                 } else {
@@ -6,14 +6,19 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include "blockfilterindex.h"
 #include "checkpoints.h"
 #include "main.h"
 #include "rpcserver.h"
 #include "sync.h"
 #include "util.h"
+#include "utxosnapshot.h"
+#include "validationinterface.h"
 
 #include <stdint.h>
 
+#include <boost/filesystem.hpp>
+
 #include "json/json_spirit_value.h"
 
 using namespace json_spirit;
@@ -351,6 +356,53 @@ Value getblockheader(const Array& params, bool fHelp)
     return blockHeaderToJSON(block, pblockindex);
 }
 
+Value getblockfilter(const Array& params, bool fHelp)
+{
+    if (fHelp || params.size() < 1 || params.size() > 2)
+        throw runtime_error(
+            "getblockfilter \"hash\" ( \"filtertype\" )\n"
+            "\nRetrieve a BIP 157 content filter for a particular block.\n"
+            "Requires -blockfilterindex.\n"
+            "\nArguments:\n"
+            "1. \"hash\"          (string, required) The hash of the block\n"
+            "2. \"filtertype\"    (string, optional, default=basic) The type name of the filter\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"filter\" : \"hex\",  (string) the hex-encoded filter data\n"
+            "  \"header\" : \"hex\"   (string) the hex-encoded filter header\n"
+            "}\n"
+            "\nExamples:\n" +
+            HelpExampleCli("getblockfilter", "\"00000000000fd08c2fb661d2fcb0d49abb3a91e5f27082ce64feed3b4dede2e2\" \"basic\"") + HelpExampleRpc("getblockfilter", "\"00000000000fd08c2fb661d2fcb0d49abb3a91e5f27082ce64feed3b4dede2e2\", \"basic\""));
+
+    uint256 hash(params[0].get_str());
+
+    BlockFilterType filterType = BLOCK_FILTER_BASIC;
+    if (params.size() > 1 && !BlockFilterTypeByName(params[1].get_str(), filterType))
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Unknown filtertype");
+
+    if (!pblockfilterindex)
+        throw JSONRPCError(RPC_MISC_ERROR, "Index is not enabled for filtertype " + BlockFilterTypeName(filterType));
+
+    {
+        LOCK(cs_main);
+        if (mapBlockIndex.count(hash) == 0)
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+    }
+
+    BlockFilter filter;
+    uint256 header;
+    if (!pblockfilterindex->ReadFilter(hash, filter) || !pblockfilterindex->ReadFilterHeader(hash, header)) {
+        if (!IsBlockFilterIndexSynced())
+            throw JSONRPCError(RPC_MISC_ERROR, "Block filters are still in the process of being indexed.");
+        throw JSONRPCError(RPC_MISC_ERROR, "Filter not found.");
+    }
+
+    Object ret;
+    ret.push_back(Pair("filter", HexStr(filter.GetEncodedFilter())));
+    ret.push_back(Pair("header", header.GetHex()));
+    return ret;
+}
+
 Value gettxoutsetinfo(const Array& params, bool fHelp)
 {
     if (fHelp || params.size() != 0)
@@ -387,6 +439,77 @@ Value gettxoutsetinfo(const Array& params, bool fHelp)
     return ret;
 }
 
+Value dumptxoutset(const Array& params, bool fHelp)
+{
+    if (fHelp || params.size() != 1)
+        throw runtime_error(
+            "dumptxoutset \"path\"\n"
+            "\nWrites the unspent transaction output set at the current tip to a snapshot file.\n"
+            "Note this call may take some time.\n"
+            "\nArguments:\n"
+            "1. \"path\"     (string, required) The file to write, relative to the data directory unless absolute\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"height\":n,                (numeric) The height of the block the snapshot was taken at\n"
+            "  \"bestblock\": \"hex\",        (string) The hash of that block\n"
+            "  \"transactions\": n,         (numeric) The number of transactions with unspent outputs\n"
+            "  \"hash_serialized\": \"hash\", (string) The hash of the snapshot, as gettxoutsetinfo reports it\n"
+            "  \"path\": \"path\"             (string) The absolute path of the file written\n"
+            "}\n"
+            "\nExamples:\n" +
+            HelpExampleCli("dumptxoutset", "\"utxo.dat\"") + HelpExampleRpc("dumptxoutset", "\"utxo.dat\""));
+
+    boost::filesystem::path path = boost::filesystem::absolute(params[0].get_str(), GetDataDir());
+    CUTXOSnapshotMetadata metadata;
+    uint256 hashSerialized;
+    std::string strError;
+    if (!DumpUTXOSnapshot(path, metadata, hashSerialized, strError))
+        throw JSONRPCError(RPC_MISC_ERROR, strError);
+
+    Object ret;
+    ret.push_back(Pair("height", metadata.nHeight));
+    ret.push_back(Pair("bestblock", metadata.hashBlock.GetHex()));
+    ret.push_back(Pair("transactions", (int64_t)metadata.nTransactions));
+    ret.push_back(Pair("hash_serialized", hashSerialized.GetHex()));
+    ret.push_back(Pair("path", path.string()));
+    return ret;
+}
+
+Value loadtxoutset(const Array& params, bool fHelp)
+{
+    if (fHelp || params.size() != 1)
+        throw runtime_error(
+            "loadtxoutset \"path\"\n"
+            "\nReplaces the chain state with a snapshot file written by dumptxoutset and makes its block the tip.\n"
+            "The snapshot must be one this version knows the hash of, and its block and all blocks before it\n"
+            "must be stored but not yet connected. They are validated in the background afterwards.\n"
+            "This only spares connecting blocks already on disk, for example copied block files. It does not\n"
+            "bootstrap a node without them, as blocks past the active tip aren't downloaded.\n"
+            "Wallet transactions in those blocks are only found with -rescan.\n"
+            "\nArguments:\n"
+            "1. \"path\"     (string, required) The snapshot file, relative to the data directory unless absolute\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"height\":n,           (numeric) The height of the block the snapshot was taken at\n"
+            "  \"bestblock\": \"hex\",   (string) The hash of that block\n"
+            "  \"transactions\": n     (numeric) The number of transactions with unspent outputs loaded\n"
+            "}\n"
+            "\nExamples:\n" +
+            HelpExampleCli("loadtxoutset", "\"utxo.dat\"") + HelpExampleRpc("loadtxoutset", "\"utxo.dat\""));
+
+    boost::filesystem::path path = boost::filesystem::absolute(params[0].get_str(), GetDataDir());
+    CUTXOSnapshotMetadata metadata;
+    std::string strError;
+    if (!LoadUTXOSnapshot(path, metadata, strError))
+        throw JSONRPCError(RPC_MISC_ERROR, strError);
+
+    Object ret;
+    ret.push_back(Pair("height", metadata.nHeight));
+    ret.push_back(Pair("bestblock", metadata.hashBlock.GetHex()));
+    ret.push_back(Pair("transactions", (int64_t)metadata.nTransactions));
+    return ret;
+}
+
 Value gettxout(const Array& params, bool fHelp)
 {
     if (fHelp || params.size() < 2 || params.size() > 3)
@@ -638,6 +761,38 @@ Value getmempoolinfo(const Array& params, bool fHelp)
     return ret;
 }
 
+Value getvalidationqueueinfo(const Array& params, bool fHelp)
+{
+    if (fHelp || params.size() != 0)
+        throw runtime_error(
+            "getvalidationqueueinfo\n"
+            "\nReturns details on the queue delivering block and transaction notifications to the wallet and ZMQ.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"running\": true|false      (boolean) Whether notifications are delivered by the background thread\n"
+            "  \"size\": xxxxx                (numeric) Notifications waiting to be delivered\n"
+            "  \"peak\": xxxxx                (numeric) Largest size seen since startup\n"
+            "  \"limit\": xxxxx               (numeric) Size at which block connection waits (-maxvalidationqueue)\n"
+            "  \"posted\": xxxxx              (numeric) Notifications posted since startup\n"
+            "  \"delivered\": xxxxx           (numeric) Notifications delivered since startup\n"
+            "  \"throttled\": xxxxx           (numeric) Times block connection waited for the queue\n"
+            "}\n"
+            "\nExamples:\n" +
+            HelpExampleCli("getvalidationqueueinfo", "") + HelpExampleRpc("getvalidationqueueinfo", ""));
+
+    const CValidationQueueStats stats = GetValidationQueueStats();
+    Object ret;
+    ret.push_back(Pair("running", stats.fRunning));
+    ret.push_back(Pair("size", (int64_t)stats.nDepth));
+    ret.push_back(Pair("peak", (int64_t)stats.nPeak));
+    ret.push_back(Pair("limit", (int64_t)stats.nLimit));
+    ret.push_back(Pair("posted", (int64_t)stats.nPosted));
+    ret.push_back(Pair("delivered", (int64_t)stats.nDelivered));
+    ret.push_back(Pair("throttled", (int64_t)stats.nThrottled));
+
+    return ret;
+}
+
 Value invalidateblock(const Array& params, bool fHelp)
 {
     if (fHelp || params.size() != 1)
@@ -87,6 +87,9 @@ static const CRPCConvertParam vRPCConvertParams[] =
         {"signrawtransaction", 1},
         {"signrawtransaction", 2},
         {"sendrawtransaction", 1},
+        {"getaddressbalance", 0},
+        {"getaddressutxos", 0},
+        {"getaddresstxids", 0},
         {"gettxout", 1},
         {"gettxout", 2},
         {"lockunspent", 0},
@@ -131,6 +134,7 @@ static const CRPCConvertParam vRPCConvertParams[] =
         {"xrGetBlockHash",2},
         {"xrGetBlock",2},
         {"xrGetBlocks",2},
+        {"xrGetBlockFilters",2},
         {"xrGetTransaction",2},
         {"xrGetTransactions",2},
         {"xrDecodeRawTransaction",2},
@@ -143,6 +147,9 @@ static const CRPCConvertParam vRPCConvertParams[] =
         {"xrGetBlockAtTime",1},
         {"xrGetBlockAtTime",2},
         {"xrConnect",1},
+        {"xrLoadTest",2},
+        {"xrLoadTest",3},
+        {"xrLoadTest",4},
     };
 
 class CRPCConvertTable
@@ -14,8 +14,10 @@
 #include "net.h"
 #include "netbase.h"
 #include "rpcserver.h"
+#include "script/standard.h"
 #include "spork.h"
 #include "timedata.h"
+#include "txdb.h"
 #include "util.h"
 
 #include "xbridge/version.h"
@@ -489,6 +491,193 @@ Value setmocktime(const Array& params, bool fHelp)
     return Value::null;
 }
 
+/** An address as stored in the address index */
+struct AddressIndexTarget {
+    std::string address;
+    int type;
+    uint160 hashBytes;
+};
+
+static std::string AddressFromIndexKey(int type, const uint160& hashBytes)
+{
+    if (type == ADDRESS_SCRIPTHASH)
+        return CBitcoinAddress(CScriptID(hashBytes)).ToString();
+    return CBitcoinAddress(CKeyID(hashBytes)).ToString();
+}
+
+/**
+ * Parse the address argument of the getaddress* calls: either a single
+ * address string or {"addresses": [...]}, optionally with "start" and "end"
+ * block heights when fHeights is set.
+ */
+static std::vector<AddressIndexTarget> ParseAddressIndexParams(const Value& param, bool fHeights, int& nStart, int& nEnd)
+{
+    if (!fAddressIndex)
+        throw JSONRPCError(RPC_MISC_ERROR, "Address index not enabled, restart with -addressindex -reindex");
+
+    nStart = 0;
+    nEnd = 0;
+    Array addresses;
+    if (param.type() == str_type) {
+        addresses.push_back(param);
+    } else if (param.type() == obj_type) {
+        const Object& o = param.get_obj();
+        const Value& vAddresses = find_value(o, "addresses");
+        if (vAddresses.type() != array_type)
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Addresses is expected to be an array");
+        addresses = vAddresses.get_array();
+        if (fHeights) {
+            const Value& vStart = find_value(o, "start");
+            const Value& vEnd = find_value(o, "end");
+            if (vStart.type() == int_type)
+                nStart = vStart.get_int();
+            if (vEnd.type() == int_type)
+                nEnd = vEnd.get_int();
+            if (nStart < 0 || nEnd < 0 || (nEnd > 0 && nEnd < nStart))
+                throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid start or end height");
+        }
+    } else {
+        throw JSONRPCError(RPC_TYPE_ERROR, "Expected an address or an object with addresses");
+    }
+
+    std::vector<AddressIndexTarget> vTargets;
+    BOOST_FOREACH (const Value& v, addresses) {
+        if (v.type() != str_type)
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
+        CBitcoinAddress address(v.get_str());
+        AddressIndexTarget target;
+        if (!address.IsValid() || !GetAddressIndexKey(GetScriptForDestination(address.Get()), target.hashBytes, target.type))
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address: " + v.get_str());
+        target.address = address.ToString();
+        vTargets.push_back(target);
+    }
+    return vTargets;
+}
+
+Value getaddressbalance(const Array& params, bool fHelp)
+{
+    if (fHelp || params.size() != 1)
+        throw runtime_error(
+            "getaddressbalance \"address\"|{\"addresses\":[\"address\",...]}\n"
+            "\nReturns the balance of one or more addresses (requires -addressindex).\n"
+            "\nArguments:\n"
+            "1. \"address\"         (string or object, required) An address, or an object with an array of addresses\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"balance\" : x.xxx,   (numeric) The current balance in BLOCK\n"
+            "  \"received\" : x.xxx,  (numeric) The total amount received in BLOCK, including change\n"
+            "  \"height\" : n         (numeric) The height of the last block that changed the balance\n"
+            "}\n"
+            "\nExamples:\n" +
+            HelpExampleCli("getaddressbalance", "'{\"addresses\": [\"1PSSGeFHDnKNxiEyFrD1wcEaHr9hrQDDWc\"]}'") +
+            HelpExampleRpc("getaddressbalance", "\"1PSSGeFHDnKNxiEyFrD1wcEaHr9hrQDDWc\""));
+
+    int nStart, nEnd;
+    std::vector<AddressIndexTarget> vTargets = ParseAddressIndexParams(params[0], false, nStart, nEnd);
+
+    CAmount nBalance = 0;
+    CAmount nReceived = 0;
+    int nHeight = -1;
+    BOOST_FOREACH (const AddressIndexTarget& target, vTargets) {
+        CAddressBalance balance;
+        if (!pblocktree->ReadAddressBalance(target.type, target.hashBytes, balance))
+            continue;
+        nBalance += balance.nBalance;
+        nReceived += balance.nReceived;
+        nHeight = std::max(nHeight, balance.nHeight);
+    }
+
+    Object result;
+    result.push_back(Pair("balance", ValueFromAmount(nBalance)));
+    result.push_back(Pair("received", ValueFromAmount(nReceived)));
+    result.push_back(Pair("height", nHeight));
+    return result;
+}
+
+Value getaddressutxos(const Array& params, bool fHelp)
+{
+    if (fHelp || params.size() != 1)
+        throw runtime_error(
+            "getaddressutxos \"address\"|{\"addresses\":[\"address\",...]}\n"
+            "\nReturns the unspent outputs of one or more addresses (requires -addressindex).\n"
+            "\nArguments:\n"
+            "1. \"address\"         (string or object, required) An address, or an object with an array of addresses\n"
+            "\nResult:\n"
+            "[\n"
+            "  {\n"
+            "    \"address\" : \"address\",  (string) The address\n"
+            "    \"txid\" : \"hash\",        (string) The transaction id\n"
+            "    \"outputIndex\" : n,      (numeric) The output index\n"
+            "    \"script\" : \"hex\",       (string) The script hex\n"
+            "    \"amount\" : x.xxx,       (numeric) The output amount in BLOCK\n"
+            "    \"height\" : n            (numeric) The height of the block containing the output\n"
+            "  }\n"
+            "  ,...\n"
+            "]\n"
+            "\nExamples:\n" +
+            HelpExampleCli("getaddressutxos", "'{\"addresses\": [\"1PSSGeFHDnKNxiEyFrD1wcEaHr9hrQDDWc\"]}'") +
+            HelpExampleRpc("getaddressutxos", "\"1PSSGeFHDnKNxiEyFrD1wcEaHr9hrQDDWc\""));
+
+    int nStart, nEnd;
+    std::vector<AddressIndexTarget> vTargets = ParseAddressIndexParams(params[0], false, nStart, nEnd);
+
+    Array result;
+    BOOST_FOREACH (const AddressIndexTarget& target, vTargets) {
+        std::vector<CAddressUnspentEntry> vUnspent;
+        if (!pblocktree->ReadAddressUnspentIndex(target.type, target.hashBytes, vUnspent))
+            throw JSONRPCError(RPC_DATABASE_ERROR, "Unable to read address index");
+        BOOST_FOREACH (const CAddressUnspentEntry& entry, vUnspent) {
+            Object output;
+            output.push_back(Pair("address", AddressFromIndexKey(entry.first.type, entry.first.hashBytes)));
+            output.push_back(Pair("txid", entry.first.txhash.GetHex()));
+            output.push_back(Pair("outputIndex", (int)entry.first.index));
+            output.push_back(Pair("script", HexStr(entry.second.script.begin(), entry.second.script.end())));
+            output.push_back(Pair("amount", ValueFromAmount(entry.second.satoshis)));
+            output.push_back(Pair("height", entry.second.blockHeight));
+            result.push_back(output);
+        }
+    }
+    return result;
+}
+
+Value getaddresstxids(const Array& params, bool fHelp)
+{
+    if (fHelp || params.size() != 1)
+        throw runtime_error(
+            "getaddresstxids \"address\"|{\"addresses\":[\"address\",...],\"start\":n,\"end\":n}\n"
+            "\nReturns the ids of the transactions paying to or spending from one or more addresses,\n"
+            "in block order (requires -addressindex).\n"
+            "\nArguments:\n"
+            "1. \"address\"         (string or object, required) An address, or an object with an array of addresses\n"
+            "                     and optional \"start\" and \"end\" block heights (inclusive)\n"
+            "\nResult:\n"
+            "[\n"
+            "  \"transactionid\"  (string) The transaction id\n"
+            "  ,...\n"
+            "]\n"
+            "\nExamples:\n" +
+            HelpExampleCli("getaddresstxids", "'{\"addresses\": [\"1PSSGeFHDnKNxiEyFrD1wcEaHr9hrQDDWc\"], \"start\": 1000, \"end\": 2000}'") +
+            HelpExampleRpc("getaddresstxids", "{\"addresses\": [\"1PSSGeFHDnKNxiEyFrD1wcEaHr9hrQDDWc\"], \"start\": 1000, \"end\": 2000}"));
+
+    int nStart, nEnd;
+    std::vector<AddressIndexTarget> vTargets = ParseAddressIndexParams(params[0], true, nStart, nEnd);
+
+    // Order by block height and position in the block, dropping duplicates
+    std::set<std::pair<std::pair<int, unsigned int>, uint256> > setTxids;
+    BOOST_FOREACH (const AddressIndexTarget& target, vTargets) {
+        std::vector<CAddressIndexEntry> vIndex;
+        if (!pblocktree->ReadAddressIndex(target.type, target.hashBytes, vIndex, nStart, nEnd))
+            throw JSONRPCError(RPC_DATABASE_ERROR, "Unable to read address index");
+        BOOST_FOREACH (const CAddressIndexEntry& entry, vIndex)
+            setTxids.insert(std::make_pair(std::make_pair(entry.first.blockHeight, entry.first.txindex), entry.first.txhash));
+    }
+
+    Array result;
+    for (std::set<std::pair<std::pair<int, unsigned int>, uint256> >::const_iterator it = setTxids.begin(); it != setTxids.end(); it++)
+        result.push_back(it->second.GetHex());
+    return result;
+}
+
 #ifdef ENABLE_WALLET
 Value getstakingstatus(const Array & params, bool fHelp)
 {
@@ -13,6 +13,7 @@
 #include "main.h"
 #include "ui_interface.h"
 #include "util.h"
+#include "validationinterface.h"
 #ifdef ENABLE_WALLET
 #include "wallet.h"
 #endif
@@ -270,12 +271,16 @@ static const CRPCCommand vRPCCommands[] =
         {"blockchain", "getblock", &getblock, true, true, false},
         {"blockchain", "getblockhash", &getblockhash, true, true, false},
         {"blockchain", "getblockheader", &getblockheader, false, false, false},
+        {"blockchain", "getblockfilter", &getblockfilter, true, true, false},
         {"blockchain", "getchaintips", &getchaintips, true, false, false},
         {"blockchain", "getdifficulty", &getdifficulty, true, false, false},
         {"blockchain", "getmempoolinfo", &getmempoolinfo, true, true, false},
+        {"blockchain", "getvalidationqueueinfo", &getvalidationqueueinfo, true, true, false},
         {"blockchain", "getrawmempool", &getrawmempool, true, true, false},
         {"blockchain", "gettxout", &gettxout, true, true, false},
         {"blockchain", "gettxoutsetinfo", &gettxoutsetinfo, true, false, false},
+        {"blockchain", "dumptxoutset", &dumptxoutset, true, false, false},
+        {"blockchain", "loadtxoutset", &loadtxoutset, true, false, false},
         {"blockchain", "verifychain", &verifychain, true, false, false},
         {"blockchain", "invalidateblock", &invalidateblock, true, true, false},
         {"blockchain", "reconsiderblock", &reconsiderblock, true, true, false},
@@ -311,6 +316,11 @@ static const CRPCCommand vRPCCommands[] =
         {"util", "estimatefee", &estimatefee, true, true, false},
         {"util", "estimatepriority", &estimatepriority, true, true, false},
 
+        /* Address index */
+        {"addressindex", "getaddressbalance", &getaddressbalance, true, true, false},
+        {"addressindex", "getaddressutxos", &getaddressutxos, true, true, false},
+        {"addressindex", "getaddresstxids", &getaddresstxids, true, true, false},
+
         /* Not shown in help */
         {"hidden", "invalidateblock", &invalidateblock, true, true, false},
         {"hidden", "reconsiderblock", &reconsiderblock, true, true, false},
@@ -349,9 +359,10 @@ static const CRPCCommand vRPCCommands[] =
         {"wallet", "gettransaction", &gettransaction, false, true, true},
         {"wallet", "getunconfirmedbalance", &getunconfirmedbalance, false, false, true},
         {"wallet", "getwalletinfo", &getwalletinfo, false, true, true},
-        {"wallet", "importprivkey", &importprivkey, true, false, true},
+        {"wallet", "importprivkey", &importprivkey, true, true, true},
         {"wallet", "importwallet", &importwallet, true, false, true},
-        {"wallet", "importaddress", &importaddress, true, false, true},
+        {"wallet", "importaddress", &importaddress, true, true, true},
+        {"wallet", "abortrescan", &abortrescan, true, true, true},
         {"wallet", "keypoolrefill", &keypoolrefill, true, false, true},
         {"wallet", "listaccounts", &listaccounts, false, true, true},
         {"wallet", "listaddressgroupings", &listaddressgroupings, false, true, true},
@@ -397,6 +408,7 @@ static const CRPCCommand vRPCCommands[] =
         {"xrouter", "xrGetBlockHash",                       &xrGetBlockHash,             true, true, true},
         {"xrouter", "xrGetBlock",                           &xrGetBlock,                 true, true, true},
         {"xrouter", "xrGetBlocks",                          &xrGetBlocks,                true, true, true},
+        {"xrouter", "xrGetBlockFilters",                    &xrGetBlockFilters,          true, true, true},
         {"xrouter", "xrGetTransaction",                     &xrGetTransaction,           true, true, true},
         {"xrouter", "xrGetTransactions",                    &xrGetTransactions,          true, true, true},
         {"xrouter", "xrDecodeRawTransaction",               &xrDecodeRawTransaction,     true, true, true},
@@ -416,6 +428,7 @@ static const CRPCCommand vRPCCommands[] =
         {"xrouter", "xrStatus",                             &xrStatus,                   true, true, true},
         {"xrouter", "xrGetNetworkServices",                 &xrGetNetworkServices,       true, true, true},
 //        {"xrouter", "xrTest",                               &xrTest,                     true, true, true},
+        {"xrouter", "xrLoadTest",                           &xrLoadTest,                 true, true, true},
 
     #endif // ENABLE_WALLET
 };
@@ -1030,6 +1043,23 @@ void ServiceConnection(AcceptedConnection* conn)
     }
 }
 
+#ifdef ENABLE_WALLET
+/**
+ * Wallet RPCs that wait for the queued wallet notifications before running: the sends
+ * select coins and then write a transaction, the others read what earlier blocks and
+ * sends wrote. Other wallet RPCs don't wait, the queue can be behind during a sync.
+ */
+static bool SyncsWalletNotifications(const std::string& strMethod)
+{
+    static const char* const vMethods[] = {"getbalance", "gettransaction", "listsinceblock", "listtransactions",
+                                           "listunspent", "sendfrom", "sendmany", "sendtoaddress"};
+    for (unsigned int i = 0; i < sizeof(vMethods) / sizeof(vMethods[0]); i++)
+        if (strMethod == vMethods[i])
+            return true;
+    return false;
+}
+#endif
+
 json_spirit::Value CRPCTable::execute(const std::string& strMethod, const json_spirit::Array& params) const
 {
     // Find method
@@ -1058,6 +1088,13 @@ json_spirit::Value CRPCTable::execute(const std::string& strMethod, const json_s
         !pcmd->okSafeMode)
         throw JSONRPCError(RPC_FORBIDDEN_BY_SAFE_MODE, string("Safe mode: ") + strWarning);
 
+#ifdef ENABLE_WALLET
+    // Wallet notifications are delivered asynchronously, make sure the wallet has
+    // seen every block and transaction processed so far
+    if (pcmd->reqWallet && pwalletMain && SyncsWalletNotifications(strMethod))
+        SyncWithValidationInterfaceQueue();
+#endif
+
     try {
         // Execute
         Value result;
@@ -159,6 +159,7 @@ extern json_spirit::Value disconnectpeer(const json_spirit::Array& params, bool
 extern json_spirit::Value dumpprivkey(const json_spirit::Array& params, bool fHelp); // in rpcdump.cpp
 extern json_spirit::Value importprivkey(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value importaddress(const json_spirit::Array& params, bool fHelp);
+extern json_spirit::Value abortrescan(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value dumpwallet(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value importwallet(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value bip38encrypt(const json_spirit::Array& params, bool fHelp);
@@ -210,6 +211,9 @@ extern json_spirit::Value walletpassphrasechange(const json_spirit::Array& param
 extern json_spirit::Value walletlock(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value encryptwallet(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value validateaddress(const json_spirit::Array& params, bool fHelp);
+extern json_spirit::Value getaddressbalance(const json_spirit::Array& params, bool fHelp);
+extern json_spirit::Value getaddressutxos(const json_spirit::Array& params, bool fHelp);
+extern json_spirit::Value getaddresstxids(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value getinfo(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value getwalletinfo(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value getblockchaininfo(const json_spirit::Array& params, bool fHelp);
@@ -236,11 +240,15 @@ extern json_spirit::Value getbestblockhash(const json_spirit::Array& params, boo
 extern json_spirit::Value getdifficulty(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value settxfee(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value getmempoolinfo(const json_spirit::Array& params, bool fHelp);
+extern json_spirit::Value getvalidationqueueinfo(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value getrawmempool(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value getblockhash(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value getblock(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value getblockheader(const json_spirit::Array& params, bool fHelp);
+extern json_spirit::Value getblockfilter(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value gettxoutsetinfo(const json_spirit::Array& params, bool fHelp);
+extern json_spirit::Value dumptxoutset(const json_spirit::Array& params, bool fHelp);
+extern json_spirit::Value loadtxoutset(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value gettxout(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value verifychain(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value getchaintips(const json_spirit::Array& params, bool fHelp);
@@ -683,6 +691,7 @@ extern json_spirit::Value xrGetBlockCount(const json_spirit::Array& params, bool
 extern json_spirit::Value xrGetBlockHash(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value xrGetBlock(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value xrGetBlocks(const json_spirit::Array& params, bool fHelp);
+extern json_spirit::Value xrGetBlockFilters(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value xrGetTransaction(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value xrGetTransactions(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value xrDecodeRawTransaction(const json_spirit::Array& params, bool fHelp);
@@ -706,6 +715,7 @@ extern json_spirit::Value xrRegisterDomain(const json_spirit::Array& params, boo
 extern json_spirit::Value xrQueryDomain(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value xrGetBalance(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value xrTest(const json_spirit::Array& params, bool fHelp);
+extern json_spirit::Value xrLoadTest(const json_spirit::Array& params, bool fHelp);
 
 /** @} */
 
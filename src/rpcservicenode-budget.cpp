@@ -189,7 +189,10 @@ Value mnbudget(const Array& params, bool fHelp)
         //     return "Proposal is not valid - " + budgetProposalBroadcast.GetHash().ToString() + " - " + strError;
         // }
 
-        budget.mapSeenServicenodeBudgetProposals.insert(make_pair(budgetProposalBroadcast.GetHash(), budgetProposalBroadcast));
+        {
+            LOCK(budget.cs_seen);
+            budget.mapSeenServicenodeBudgetProposals.insert(make_pair(budgetProposalBroadcast.GetHash(), budgetProposalBroadcast));
+        }
         budgetProposalBroadcast.Relay();
         if(budget.AddProposal(budgetProposalBroadcast)) {
             return budgetProposalBroadcast.GetHash().ToString();
@@ -256,7 +259,10 @@ Value mnbudget(const Array& params, bool fHelp)
 
             std::string strError = "";
             if (budget.UpdateProposal(vote, NULL, strError)) {
-                budget.mapSeenServicenodeBudgetVotes.insert(make_pair(vote.GetHash(), vote));
+                {
+                    LOCK(budget.cs_seen);
+                    budget.mapSeenServicenodeBudgetVotes.insert(make_pair(vote.GetHash(), vote));
+                }
                 vote.Relay();
                 success++;
                 statusObj.push_back(Pair("result", "success"));
@@ -345,7 +351,10 @@ if(strCommand == "vote-alias")
 
             std::string strError = "";
             if(budget.UpdateProposal(vote, NULL, strError)) {
-                budget.mapSeenServicenodeBudgetVotes.insert(make_pair(vote.GetHash(), vote));
+                {
+                    LOCK(budget.cs_seen);
+                    budget.mapSeenServicenodeBudgetVotes.insert(make_pair(vote.GetHash(), vote));
+                }
                 vote.Relay();
                 success++;
                 statusObj.push_back(Pair("result", "success"));
@@ -395,7 +404,10 @@ if(strCommand == "vote-alias")
 
         std::string strError = "";
         if (budget.UpdateProposal(vote, NULL, strError)) {
-            budget.mapSeenServicenodeBudgetVotes.insert(make_pair(vote.GetHash(), vote));
+            {
+                LOCK(budget.cs_seen);
+                budget.mapSeenServicenodeBudgetVotes.insert(make_pair(vote.GetHash(), vote));
+            }
             vote.Relay();
             return "Voted successfully";
         } else {
@@ -617,7 +629,10 @@ Value mnbudgetvoteraw(const Array& params, bool fHelp)
 
     std::string strError = "";
     if (budget.UpdateProposal(vote, NULL, strError)) {
-        budget.mapSeenServicenodeBudgetVotes.insert(make_pair(vote.GetHash(), vote));
+        {
+            LOCK(budget.cs_seen);
+            budget.mapSeenServicenodeBudgetVotes.insert(make_pair(vote.GetHash(), vote));
+        }
         vote.Relay();
         return "Voted successfully";
     } else {
@@ -695,7 +710,10 @@ Value mnfinalbudget(const Array& params, bool fHelp)
 
             std::string strError = "";
             if (budget.UpdateFinalizedBudget(vote, NULL, strError)) {
-                budget.mapSeenFinalizedBudgetVotes.insert(make_pair(vote.GetHash(), vote));
+                {
+                    LOCK(budget.cs_seen);
+                    budget.mapSeenFinalizedBudgetVotes.insert(make_pair(vote.GetHash(), vote));
+                }
                 vote.Relay();
                 success++;
                 statusObj.push_back(Pair("result", "success"));
@@ -740,7 +758,10 @@ Value mnfinalbudget(const Array& params, bool fHelp)
 
         std::string strError = "";
         if (budget.UpdateFinalizedBudget(vote, NULL, strError)) {
-            budget.mapSeenFinalizedBudgetVotes.insert(make_pair(vote.GetHash(), vote));
+            {
+                LOCK(budget.cs_seen);
+                budget.mapSeenFinalizedBudgetVotes.insert(make_pair(vote.GetHash(), vote));
+            }
             vote.Relay();
             return "success";
         } else {
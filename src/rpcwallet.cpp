@@ -2036,10 +2036,18 @@ Value getwalletinfo(const Array& params, bool fHelp)
             "{\n"
             "  \"walletversion\": xxxxx,     (numeric) the wallet version\n"
             "  \"balance\": xxxxxxx,         (numeric) the total BLOCK balance of the wallet\n"
+            "  \"unconfirmed_balance\": xxx, (numeric) the total unconfirmed balance of the wallet in BLOCK\n"
+            "  \"immature_balance\": xxxxxx, (numeric) the total immature balance of the wallet in BLOCK\n"
+            "  \"locked_balance\": xxxxxx,   (numeric) the part of the balance held in locked coins, in BLOCK\n"
             "  \"txcount\": xxxxxxx,         (numeric) the total number of transactions in the wallet\n"
             "  \"keypoololdest\": xxxxxx,    (numeric) the timestamp (seconds since GMT epoch) of the oldest pre-generated key in the key pool\n"
             "  \"keypoolsize\": xxxx,        (numeric) how many new keys are pre-generated\n"
             "  \"unlocked_until\": ttt,      (numeric) the timestamp in seconds since epoch (midnight Jan 1 1970 GMT) that the wallet is unlocked for transfers, or 0 if the wallet is locked\n"
+            "  \"scanning\":                 (json object) current rescan details, or false if no rescan is running\n"
+            "    {\n"
+            "      \"duration\" : xxxx        (numeric) elapsed seconds since the rescan started\n"
+            "      \"progress\" : xxxx        (numeric) rescan progress in percent\n"
+            "    }\n"
             "}\n"
             "\nExamples:\n" +
             HelpExampleCli("getwalletinfo", "") + HelpExampleRpc("getwalletinfo", ""));
@@ -2047,7 +2055,11 @@ Value getwalletinfo(const Array& params, bool fHelp)
 
     Object obj;
     obj.push_back(Pair("walletversion", pwalletMain->GetVersion()));
-    obj.push_back(Pair("balance", ValueFromAmount(pwalletMain->GetBalance())));
+    CWalletBalances balances = pwalletMain->GetBalances();
+    obj.push_back(Pair("balance", ValueFromAmount(balances.nTrusted)));
+    obj.push_back(Pair("unconfirmed_balance", ValueFromAmount(balances.nUnconfirmed)));
+    obj.push_back(Pair("immature_balance", ValueFromAmount(balances.nImmature)));
+    obj.push_back(Pair("locked_balance", ValueFromAmount(balances.nLocked)));
 
     {
     LOCK2(cs_main, pwalletMain->cs_wallet);
@@ -2062,6 +2074,15 @@ Value getwalletinfo(const Array& params, bool fHelp)
         obj.push_back(Pair("unlocked_until", nWalletUnlockTime));
     }
 
+    if (pwalletMain->IsScanning()) {
+        Object scanning;
+        scanning.push_back(Pair("duration", pwalletMain->ScanningDuration() / 1000));
+        scanning.push_back(Pair("progress", pwalletMain->ScanningProgress()));
+        obj.push_back(Pair("scanning", scanning));
+    } else {
+        obj.push_back(Pair("scanning", false));
+    }
+
     return obj;
 }
 
@@ -8,8 +8,10 @@
 #include "main.h"
 
 #include "addrman.h"
+#include "bloom.h"
 #include "servicenode-budget.h"
 #include "servicenode-sync.h"
+#include "servicenodecache.h"
 #include "servicenode.h"
 #include "servicenodeman.h"
 #include "obfuscation.h"
@@ -179,7 +181,7 @@ void CBudgetManager::SubmitFinalBudget()
 
     CFinalizedBudgetBroadcast tempBudget(strBudgetName, nBlockStart, vecTxBudgetPayments, 0);
     {
-        LOCK(cs);
+        LOCK(cs_seen);
         if (mapSeenFinalizedBudgets.count(tempBudget.GetHash())) {
             LogPrintf("CBudgetManager::SubmitFinalBudget - Budget already exists - %s\n", tempBudget.GetHash().ToString());
             nSubmittedHeight = nCurrentHeight;
@@ -249,7 +251,10 @@ void CBudgetManager::SubmitFinalBudget()
     }
 
     LOCK(cs);
-    mapSeenFinalizedBudgets.insert(make_pair(finalizedBudgetBroadcast.GetHash(), finalizedBudgetBroadcast));
+    {
+        LOCK(cs_seen);
+        mapSeenFinalizedBudgets.insert(make_pair(finalizedBudgetBroadcast.GetHash(), finalizedBudgetBroadcast));
+    }
     finalizedBudgetBroadcast.Relay();
     budget.AddFinalizedBudget(finalizedBudgetBroadcast);
     nSubmittedHeight = nCurrentHeight;
@@ -268,38 +273,89 @@ CBudgetDB::CBudgetDB()
 
 bool CBudgetDB::Write(const CBudgetManager& objToSave)
 {
-    LOCK(objToSave.cs);
+    if (!psncachedb)
+        return error("%s : Servicenode cache store is not open", __func__);
 
     int64_t nStart = GetTimeMillis();
-
-    // serialize, checksum data up to that point, then append checksum
-    CDataStream ssObj(SER_DISK, CLIENT_VERSION);
-    ssObj << strMagicMessage;                   // servicenode cache file specific magic message
-    ssObj << FLATDATA(Params().MessageStart()); // network specific magic number
-    ssObj << objToSave;
-    uint256 hash = Hash(ssObj.begin(), ssObj.end());
-    ssObj << hash;
-
-    // open output file, and associate with CAutoFile
-    FILE* file = fopen(pathDB.string().c_str(), "wb");
-    CAutoFile fileout(file, SER_DISK, CLIENT_VERSION);
-    if (fileout.IsNull())
-        return error("%s : Failed to open file %s", __func__, pathDB.string());
-
-    // Write and commit header, data
+    {
+        LOCK(psncachedb->cs);
+        {
+            LOCK2(objToSave.cs, objToSave.cs_seen);
+            psncachedb->StageTable(SNCACHE_PROPOSAL, objToSave.mapProposals);
+            psncachedb->StageTable(SNCACHE_FINALIZED_BUDGET, objToSave.mapFinalizedBudgets);
+            psncachedb->StageTable(SNCACHE_SEEN_PROPOSAL, objToSave.mapSeenServicenodeBudgetProposals);
+            psncachedb->StageTable(SNCACHE_SEEN_VOTE, objToSave.mapSeenServicenodeBudgetVotes);
+            psncachedb->StageTable(SNCACHE_ORPHAN_VOTE, objToSave.mapOrphanServicenodeBudgetVotes);
+            psncachedb->StageTable(SNCACHE_SEEN_FINALIZED, objToSave.mapSeenFinalizedBudgets);
+            psncachedb->StageTable(SNCACHE_SEEN_FINALIZED_VOTE, objToSave.mapSeenFinalizedBudgetVotes);
+            psncachedb->StageTable(SNCACHE_ORPHAN_FINALIZED_VOTE, objToSave.mapOrphanFinalizedBudgetVotes);
+        }
+        psncachedb->StageMarker("budget");
+        if (!psncachedb->Commit())
+            return error("%s : Failed to write budgets", __func__);
+    }
+
+    // the store supersedes budget.dat from now on
     try {
-        fileout << ssObj;
-    } catch (std::exception& e) {
-        return error("%s : Serialize or I/O error - %s", __func__, e.what());
+        boost::filesystem::remove(pathDB);
+    } catch (const boost::filesystem::filesystem_error& e) {
+        LogPrintf("%s : Failed to remove %s - %s\n", __func__, pathDB.string(), e.what());
     }
-    fileout.fclose();
 
-    LogPrintf("Written info to budget.dat  %dms\n", GetTimeMillis() - nStart);
+    LogPrintf("Written info to budget cache  %dms\n", GetTimeMillis() - nStart);
 
     return true;
 }
 
 CBudgetDB::ReadResult CBudgetDB::Read(CBudgetManager& objToLoad, bool fDryRun)
+{
+    if (!psncachedb)
+        return FileError;
+
+    bool fWrongNetwork = false;
+    if (!psncachedb->HasMarker("budget", fWrongNetwork)) {
+        if (fWrongNetwork) {
+            error("%s : Invalid network magic number", __func__);
+            return IncorrectMagicNumber;
+        }
+        return ReadFile(objToLoad, fDryRun);
+    }
+
+    int64_t nStart = GetTimeMillis();
+    {
+        LOCK2(psncachedb->cs, objToLoad.cs);
+        LOCK(objToLoad.cs_seen);
+        if (!psncachedb->ReadTable(SNCACHE_PROPOSAL, objToLoad.mapProposals) ||
+            !psncachedb->ReadTable(SNCACHE_FINALIZED_BUDGET, objToLoad.mapFinalizedBudgets) ||
+            !psncachedb->ReadTable(SNCACHE_SEEN_PROPOSAL, objToLoad.mapSeenServicenodeBudgetProposals) ||
+            !psncachedb->ReadTable(SNCACHE_SEEN_VOTE, objToLoad.mapSeenServicenodeBudgetVotes) ||
+            !psncachedb->ReadTable(SNCACHE_ORPHAN_VOTE, objToLoad.mapOrphanServicenodeBudgetVotes) ||
+            !psncachedb->ReadTable(SNCACHE_SEEN_FINALIZED, objToLoad.mapSeenFinalizedBudgets) ||
+            !psncachedb->ReadTable(SNCACHE_SEEN_FINALIZED_VOTE, objToLoad.mapSeenFinalizedBudgetVotes) ||
+            !psncachedb->ReadTable(SNCACHE_ORPHAN_FINALIZED_VOTE, objToLoad.mapOrphanFinalizedBudgetVotes)) {
+            objToLoad.Clear();
+            // drop the unreadable tables so the next write starts them over
+            const char vchTables[] = {SNCACHE_PROPOSAL, SNCACHE_FINALIZED_BUDGET, SNCACHE_SEEN_PROPOSAL, SNCACHE_SEEN_VOTE,
+                                      SNCACHE_ORPHAN_VOTE, SNCACHE_SEEN_FINALIZED, SNCACHE_SEEN_FINALIZED_VOTE, SNCACHE_ORPHAN_FINALIZED_VOTE};
+            for (unsigned int i = 0; i < sizeof(vchTables); i++)
+                psncachedb->WipeTable(vchTables[i]);
+            return IncorrectFormat;
+        }
+    }
+
+    LogPrintf("Loaded info from budget cache  %dms\n", GetTimeMillis() - nStart);
+    LogPrintf("  %s\n", objToLoad.ToString());
+    if (!fDryRun) {
+        LogPrintf("Budget manager - cleaning....\n");
+        objToLoad.CheckAndRemove();
+        LogPrintf("Budget manager - result:\n");
+        LogPrintf("  %s\n", objToLoad.ToString());
+    }
+
+    return Ok;
+}
+
+CBudgetDB::ReadResult CBudgetDB::ReadFile(CBudgetManager& objToLoad, bool fDryRun)
 {
     LOCK(objToLoad.cs);
 
@@ -389,23 +445,6 @@ void DumpBudgets()
     int64_t nStart = GetTimeMillis();
 
     CBudgetDB budgetdb;
-    CBudgetManager tempBudget;
-
-    LogPrintf("Verifying budget.dat format...\n");
-    CBudgetDB::ReadResult readResult = budgetdb.Read(tempBudget, true);
-    // there was an error and it was not an error on file opening => do not proceed
-    if (readResult == CBudgetDB::FileError)
-        LogPrintf("Missing budgets file - budget.dat, will try to recreate\n");
-    else if (readResult != CBudgetDB::Ok) {
-        LogPrintf("Error reading budget.dat: ");
-        if (readResult == CBudgetDB::IncorrectFormat)
-            LogPrintf("magic is ok but data has invalid format, will try to recreate\n");
-        else {
-            LogPrintf("file format is unknown or invalid, please fix it manually\n");
-            return;
-        }
-    }
-    LogPrintf("Writting info to budget.dat...\n");
     budgetdb.Write(budget);
 
     LogPrintf("Budget dump finished  %dms\n", GetTimeMillis() - nStart);
@@ -1046,11 +1085,34 @@ void CBudgetManager::ProcessMessage(CNode* pfrom, std::string& strCommand, CData
         LogPrint("mnbudget", "mnvs - Sent Servicenode votes to peer %i\n", pfrom->GetId());
     }
 
+    if (strCommand == "mnvsf") { //Servicenode vote sync, skipping what the peer already has
+        CBloomFilter filter;
+        vRecv >> filter;
+
+        if (!filter.IsWithinSizeConstraints()) {
+            Misbehaving(pfrom->GetId(), 100);
+            return;
+        }
+        filter.UpdateEmptyFull();
+
+        if (Params().NetworkID() == CBaseChainParams::MAIN) {
+            if (pfrom->HasFulfilledRequest("mnvs")) {
+                LogPrintf("mnvsf - peer already asked me for the list\n");
+                Misbehaving(pfrom->GetId(), 20);
+                return;
+            }
+            pfrom->FulfilledRequest("mnvs");
+        }
+
+        SyncFiltered(pfrom, filter);
+        LogPrint("mnbudget", "mnvsf - Sent Servicenode votes to peer %i\n", pfrom->GetId());
+    }
+
     if (strCommand == "mprop") { //Servicenode Proposal
         CBudgetProposalBroadcast budgetProposalBroadcast;
         vRecv >> budgetProposalBroadcast;
 
-        if (mapSeenServicenodeBudgetProposals.count(budgetProposalBroadcast.GetHash())) {
+        if (HaveSeen(budgetProposalBroadcast.GetHash())) {
             servicenodeSync.AddedBudgetItem(budgetProposalBroadcast.GetHash());
             return;
         }
@@ -1063,7 +1125,10 @@ void CBudgetManager::ProcessMessage(CNode* pfrom, std::string& strCommand, CData
             return;
         }
 
-        mapSeenServicenodeBudgetProposals.insert(make_pair(budgetProposalBroadcast.GetHash(), budgetProposalBroadcast));
+        {
+            LOCK(cs_seen);
+            mapSeenServicenodeBudgetProposals.insert(make_pair(budgetProposalBroadcast.GetHash(), budgetProposalBroadcast));
+        }
 
         if (!budgetProposalBroadcast.IsValid(strError)) {
             LogPrintf("mprop - invalid budget proposal - %s\n", strError);
@@ -1085,44 +1150,26 @@ void CBudgetManager::ProcessMessage(CNode* pfrom, std::string& strCommand, CData
     if (strCommand == "mvote") { //Servicenode Vote
         CBudgetVote vote;
         vRecv >> vote;
-        vote.fValid = true;
-
-        if (mapSeenServicenodeBudgetVotes.count(vote.GetHash())) {
-            servicenodeSync.AddedBudgetItem(vote.GetHash());
-            return;
-        }
-
-        CServicenode* pmn = mnodeman.Find(vote.vin);
-        if (pmn == NULL) {
-            LogPrintf("mvote - unknown servicenode - vin: %s\n", vote.vin.prevout.hash.ToString());
-            mnodeman.AskForMN(pfrom, vote.vin);
-            return;
-        }
-
+        ProcessVote(pfrom, vote);
+    }
 
-        mapSeenServicenodeBudgetVotes.insert(make_pair(vote.GetHash(), vote));
-        if (!vote.SignatureValid(true)) {
-            LogPrintf("mvote - signature invalid\n");
-            if (servicenodeSync.IsSynced()) Misbehaving(pfrom->GetId(), 20);
-            // it could just be a non-synced servicenode
-            mnodeman.AskForMN(pfrom, vote.vin);
+    if (strCommand == "mvotes") { //Servicenode Votes, bulk reply to mnvsf
+        std::vector<CBudgetVote> vVotes;
+        vRecv >> vVotes;
+        if (vVotes.size() > SERVICENODE_SYNC_BULK_MAX) {
+            Misbehaving(pfrom->GetId(), 20);
             return;
         }
-
-        std::string strError = "";
-        if (UpdateProposal(vote, pfrom, strError)) {
-            vote.Relay();
-            servicenodeSync.AddedBudgetItem(vote.GetHash());
-        }
-
-        LogPrint("mnbudget", "mvote - new budget vote - %s\n", vote.GetHash().ToString());
+        BOOST_FOREACH (CBudgetVote& vote, vVotes)
+            ProcessVote(pfrom, vote);
+        LogPrint("mnbudget", "mvotes - processed %d budget votes from peer %i\n", vVotes.size(), pfrom->GetId());
     }
 
     if (strCommand == "fbs") { //Finalized Budget Suggestion
         CFinalizedBudgetBroadcast finalizedBudgetBroadcast;
         vRecv >> finalizedBudgetBroadcast;
 
-        if (mapSeenFinalizedBudgets.count(finalizedBudgetBroadcast.GetHash())) {
+        if (HaveSeen(finalizedBudgetBroadcast.GetHash())) {
             servicenodeSync.AddedBudgetItem(finalizedBudgetBroadcast.GetHash());
             return;
         }
@@ -1136,7 +1183,10 @@ void CBudgetManager::ProcessMessage(CNode* pfrom, std::string& strCommand, CData
             return;
         }
 
-        mapSeenFinalizedBudgets.insert(make_pair(finalizedBudgetBroadcast.GetHash(), finalizedBudgetBroadcast));
+        {
+            LOCK(cs_seen);
+            mapSeenFinalizedBudgets.insert(make_pair(finalizedBudgetBroadcast.GetHash(), finalizedBudgetBroadcast));
+        }
 
         if (!finalizedBudgetBroadcast.IsValid(strError)) {
             LogPrintf("fbs - invalid finalized budget - %s\n", strError);
@@ -1158,38 +1208,96 @@ void CBudgetManager::ProcessMessage(CNode* pfrom, std::string& strCommand, CData
     if (strCommand == "fbvote") { //Finalized Budget Vote
         CFinalizedBudgetVote vote;
         vRecv >> vote;
-        vote.fValid = true;
+        ProcessFinalizedVote(pfrom, vote);
+    }
 
-        if (mapSeenFinalizedBudgetVotes.count(vote.GetHash())) {
-            servicenodeSync.AddedBudgetItem(vote.GetHash());
+    if (strCommand == "fbvotes") { //Finalized Budget Votes, bulk reply to mnvsf
+        std::vector<CFinalizedBudgetVote> vVotes;
+        vRecv >> vVotes;
+        if (vVotes.size() > SERVICENODE_SYNC_BULK_MAX) {
+            Misbehaving(pfrom->GetId(), 20);
             return;
         }
+        BOOST_FOREACH (CFinalizedBudgetVote& vote, vVotes)
+            ProcessFinalizedVote(pfrom, vote);
+        LogPrint("mnbudget", "fbvotes - processed %d finalized budget votes from peer %i\n", vVotes.size(), pfrom->GetId());
+    }
+}
 
-        CServicenode* pmn = mnodeman.Find(vote.vin);
-        if (pmn == NULL) {
-            LogPrint("mnbudget", "fbvote - unknown servicenode - vin: %s\n", vote.vin.prevout.hash.ToString());
-            mnodeman.AskForMN(pfrom, vote.vin);
-            return;
-        }
+void CBudgetManager::ProcessVote(CNode* pfrom, CBudgetVote& vote)
+{
+    vote.fValid = true;
+
+    if (HaveSeen(vote.GetHash())) {
+        servicenodeSync.AddedBudgetItem(vote.GetHash());
+        return;
+    }
+
+    CServicenode* pmn = mnodeman.Find(vote.vin);
+    if (pmn == NULL) {
+        LogPrintf("mvote - unknown servicenode - vin: %s\n", vote.vin.prevout.hash.ToString());
+        mnodeman.AskForMN(pfrom, vote.vin);
+        return;
+    }
+
+
+    {
+        LOCK(cs_seen);
+        mapSeenServicenodeBudgetVotes.insert(make_pair(vote.GetHash(), vote));
+    }
+    if (!vote.SignatureValid(true)) {
+        LogPrintf("mvote - signature invalid\n");
+        if (servicenodeSync.IsSynced()) Misbehaving(pfrom->GetId(), 20);
+        // it could just be a non-synced servicenode
+        mnodeman.AskForMN(pfrom, vote.vin);
+        return;
+    }
+
+    std::string strError = "";
+    if (UpdateProposal(vote, pfrom, strError)) {
+        vote.Relay();
+        servicenodeSync.AddedBudgetItem(vote.GetHash());
+    }
+
+    LogPrint("mnbudget", "mvote - new budget vote - %s\n", vote.GetHash().ToString());
+}
 
+void CBudgetManager::ProcessFinalizedVote(CNode* pfrom, CFinalizedBudgetVote& vote)
+{
+    vote.fValid = true;
+
+    if (HaveSeen(vote.GetHash())) {
+        servicenodeSync.AddedBudgetItem(vote.GetHash());
+        return;
+    }
+
+    CServicenode* pmn = mnodeman.Find(vote.vin);
+    if (pmn == NULL) {
+        LogPrint("mnbudget", "fbvote - unknown servicenode - vin: %s\n", vote.vin.prevout.hash.ToString());
+        mnodeman.AskForMN(pfrom, vote.vin);
+        return;
+    }
+
+    {
+        LOCK(cs_seen);
         mapSeenFinalizedBudgetVotes.insert(make_pair(vote.GetHash(), vote));
-        if (!vote.SignatureValid(true)) {
-            LogPrintf("fbvote - signature invalid\n");
-            if (servicenodeSync.IsSynced()) Misbehaving(pfrom->GetId(), 20);
-            // it could just be a non-synced servicenode
-            mnodeman.AskForMN(pfrom, vote.vin);
-            return;
-        }
+    }
+    if (!vote.SignatureValid(true)) {
+        LogPrintf("fbvote - signature invalid\n");
+        if (servicenodeSync.IsSynced()) Misbehaving(pfrom->GetId(), 20);
+        // it could just be a non-synced servicenode
+        mnodeman.AskForMN(pfrom, vote.vin);
+        return;
+    }
 
-        std::string strError = "";
-        if (UpdateFinalizedBudget(vote, pfrom, strError)) {
-            vote.Relay();
-            servicenodeSync.AddedBudgetItem(vote.GetHash());
+    std::string strError = "";
+    if (UpdateFinalizedBudget(vote, pfrom, strError)) {
+        vote.Relay();
+        servicenodeSync.AddedBudgetItem(vote.GetHash());
 
-            LogPrintf("fbvote - new finalized budget vote - %s\n", vote.GetHash().ToString());
-        } else {
-            LogPrintf("fbvote - rejected finalized budget vote - %s - %s\n", vote.GetHash().ToString(), strError);
-        }
+        LogPrintf("fbvote - new finalized budget vote - %s\n", vote.GetHash().ToString());
+    } else {
+        LogPrintf("fbvote - rejected finalized budget vote - %s - %s\n", vote.GetHash().ToString(), strError);
     }
 }
 
@@ -1200,9 +1308,16 @@ bool CBudgetManager::PropExists(uint256 nHash)
 }
 
 //mark that a full sync is needed
+bool CBudgetManager::HaveSeen(const uint256& hash) const
+{
+    LOCK(cs_seen);
+    return mapSeenServicenodeBudgetProposals.count(hash) || mapSeenServicenodeBudgetVotes.count(hash) ||
+           mapSeenFinalizedBudgets.count(hash) || mapSeenFinalizedBudgetVotes.count(hash);
+}
+
 void CBudgetManager::ResetSync()
 {
-    LOCK(cs);
+    LOCK2(cs, cs_seen);
 
 
     std::map<uint256, CBudgetProposalBroadcast>::iterator it1 = mapSeenServicenodeBudgetProposals.begin();
@@ -1236,7 +1351,7 @@ void CBudgetManager::ResetSync()
 
 void CBudgetManager::MarkSynced()
 {
-    LOCK(cs);
+    LOCK2(cs, cs_seen);
 
     /*
         Mark that we've sent all valid items
@@ -1276,7 +1391,7 @@ void CBudgetManager::MarkSynced()
 
 void CBudgetManager::Sync(CNode* pfrom, uint256 nProp, bool fPartial)
 {
-    LOCK(cs);
+    LOCK2(cs, cs_seen);
 
     /*
         Sync with a client on the network
@@ -1344,6 +1459,107 @@ void CBudgetManager::Sync(CNode* pfrom, uint256 nProp, bool fPartial)
     LogPrint("mnbudget", "CBudgetManager::Sync - sent %d items\n", nInvCount);
 }
 
+CBloomFilter CBudgetManager::GetSyncFilter()
+{
+    LOCK2(cs, cs_seen);
+
+    unsigned int nElements = mapSeenServicenodeBudgetProposals.size() + mapSeenServicenodeBudgetVotes.size() +
+                             mapSeenFinalizedBudgets.size() + mapSeenFinalizedBudgetVotes.size();
+    CBloomFilter filter(std::max(nElements, 1u), SERVICENODE_SYNC_FILTER_FP_RATE, GetRandInt(std::numeric_limits<int>::max()), BLOOM_UPDATE_NONE);
+
+    for (std::map<uint256, CBudgetProposalBroadcast>::iterator it = mapSeenServicenodeBudgetProposals.begin(); it != mapSeenServicenodeBudgetProposals.end(); ++it)
+        filter.insert(it->first);
+    for (std::map<uint256, CBudgetVote>::iterator it = mapSeenServicenodeBudgetVotes.begin(); it != mapSeenServicenodeBudgetVotes.end(); ++it)
+        filter.insert(it->first);
+    for (std::map<uint256, CFinalizedBudgetBroadcast>::iterator it = mapSeenFinalizedBudgets.begin(); it != mapSeenFinalizedBudgets.end(); ++it)
+        filter.insert(it->first);
+    for (std::map<uint256, CFinalizedBudgetVote>::iterator it = mapSeenFinalizedBudgetVotes.begin(); it != mapSeenFinalizedBudgetVotes.end(); ++it)
+        filter.insert(it->first);
+
+    return filter;
+}
+
+void CBudgetManager::SyncFiltered(CNode* pfrom, const CBloomFilter& filter)
+{
+    LOCK2(cs, cs_seen);
+
+    /*
+        Answer a filtered sync request
+
+        --
+
+        Unlike Sync() the objects are pushed directly instead of announced, proposals and budgets first so the
+        votes that follow them are not orphans, and votes are packed many to a message. Objects matching the
+        peer's filter are skipped; a false positive only delays that object until a later sync or relay.
+    */
+
+    int nInvCount = 0;
+    std::vector<CBudgetVote> vVotes;
+
+    std::map<uint256, CBudgetProposalBroadcast>::iterator it1 = mapSeenServicenodeBudgetProposals.begin();
+    while (it1 != mapSeenServicenodeBudgetProposals.end()) {
+        CBudgetProposal* pbudgetProposal = FindProposal((*it1).first);
+        if (pbudgetProposal && pbudgetProposal->fValid) {
+            if (!filter.contains((*it1).first)) {
+                pfrom->PushMessage("mprop", (*it1).second);
+                nInvCount++;
+            }
+
+            std::map<uint256, CBudgetVote>::iterator it2 = pbudgetProposal->mapVotes.begin();
+            while (it2 != pbudgetProposal->mapVotes.end()) {
+                if ((*it2).second.fValid && !filter.contains((*it2).second.GetHash())) {
+                    vVotes.push_back((*it2).second);
+                    nInvCount++;
+                    if (vVotes.size() == SERVICENODE_SYNC_BULK_MAX) {
+                        pfrom->PushMessage("mvotes", vVotes);
+                        vVotes.clear();
+                    }
+                }
+                ++it2;
+            }
+        }
+        ++it1;
+    }
+    if (!vVotes.empty())
+        pfrom->PushMessage("mvotes", vVotes);
+
+    pfrom->PushMessage("ssc", SERVICENODE_SYNC_BUDGET_PROP, nInvCount);
+    LogPrint("mnbudget", "CBudgetManager::SyncFiltered - sent %d items\n", nInvCount);
+
+    nInvCount = 0;
+    std::vector<CFinalizedBudgetVote> vFinalizedVotes;
+
+    std::map<uint256, CFinalizedBudgetBroadcast>::iterator it3 = mapSeenFinalizedBudgets.begin();
+    while (it3 != mapSeenFinalizedBudgets.end()) {
+        CFinalizedBudget* pfinalizedBudget = FindFinalizedBudget((*it3).first);
+        if (pfinalizedBudget && pfinalizedBudget->fValid) {
+            if (!filter.contains((*it3).first)) {
+                pfrom->PushMessage("fbs", (*it3).second);
+                nInvCount++;
+            }
+
+            std::map<uint256, CFinalizedBudgetVote>::iterator it4 = pfinalizedBudget->mapVotes.begin();
+            while (it4 != pfinalizedBudget->mapVotes.end()) {
+                if ((*it4).second.fValid && !filter.contains((*it4).second.GetHash())) {
+                    vFinalizedVotes.push_back((*it4).second);
+                    nInvCount++;
+                    if (vFinalizedVotes.size() == SERVICENODE_SYNC_BULK_MAX) {
+                        pfrom->PushMessage("fbvotes", vFinalizedVotes);
+                        vFinalizedVotes.clear();
+                    }
+                }
+                ++it4;
+            }
+        }
+        ++it3;
+    }
+    if (!vFinalizedVotes.empty())
+        pfrom->PushMessage("fbvotes", vFinalizedVotes);
+
+    pfrom->PushMessage("ssc", SERVICENODE_SYNC_BUDGET_FIN, nInvCount);
+    LogPrint("mnbudget", "CBudgetManager::SyncFiltered - sent %d items\n", nInvCount);
+}
+
 bool CBudgetManager::UpdateProposal(CBudgetVote& vote, CNode* pfrom, std::string& strError)
 {
     LOCK(cs);
@@ -2039,7 +2255,10 @@ void CFinalizedBudget::SubmitVote()
     if (budget.UpdateFinalizedBudget(vote, NULL, strError)) {
         LogPrintf("CFinalizedBudget::SubmitVote  - new finalized budget vote - %s\n", vote.GetHash().ToString());
 
-        budget.mapSeenFinalizedBudgetVotes.insert(make_pair(vote.GetHash(), vote));
+        {
+            LOCK(budget.cs_seen);
+            budget.mapSeenFinalizedBudgetVotes.insert(make_pair(vote.GetHash(), vote));
+        }
         vote.Relay();
     } else {
         LogPrintf("CFinalizedBudget::SubmitVote : Error submitting vote - %s\n", strError);
@@ -2167,7 +2386,7 @@ bool CFinalizedBudgetVote::SignatureValid(bool fSignatureCheck)
 
 std::string CBudgetManager::ToString() const
 {
-    LOCK(cs);
+    LOCK2(cs, cs_seen);
     std::ostringstream info;
 
     info << "Proposals: " << (int)mapProposals.size() << ", Budgets: " << (int)mapFinalizedBudgets.size() << ", Seen Budgets: " << (int)mapSeenServicenodeBudgetProposals.size() << ", Seen Budget Votes: " << (int)mapSeenServicenodeBudgetVotes.size() << ", Seen Final Budgets: " << (int)mapSeenFinalizedBudgets.size() << ", Seen Final Budget Votes: " << (int)mapSeenFinalizedBudgetVotes.size();
@@ -7,6 +7,7 @@
 #define SERVICENODE_BUDGET_H
 
 #include "base58.h"
+#include "bloom.h"
 #include "init.h"
 #include "key.h"
 #include "main.h"
@@ -146,7 +147,8 @@ public:
     }
 };
 
-/** Save Budget Manager (budget.dat)
+/** Access to the budget tables of the servicenode cache store,
+ *  reading the budget.dat of older versions once when the store has none
  */
 class CBudgetDB
 {
@@ -168,6 +170,9 @@ public:
     CBudgetDB();
     bool Write(const CBudgetManager& objToSave);
     ReadResult Read(CBudgetManager& objToLoad, bool fDryRun = false);
+
+private:
+    ReadResult ReadFile(CBudgetManager& objToLoad, bool fDryRun);
 };
 
 
@@ -185,6 +190,8 @@ private:
 public:
     // critical section to protect the inner data structures
     mutable CCriticalSection cs;
+    // protects the mapSeen* maps; a leaf, taken after cs_main and cs and holding nothing but node send locks
+    mutable CCriticalSection cs_seen;
 
     // keep track of the scanning errors I've seen
     map<uint256, CBudgetProposal> mapProposals;
@@ -205,6 +212,7 @@ public:
 
     void ClearSeen()
     {
+        LOCK(cs_seen);
         mapSeenServicenodeBudgetProposals.clear();
         mapSeenServicenodeBudgetVotes.clear();
         mapSeenFinalizedBudgets.clear();
@@ -217,8 +225,17 @@ public:
     void ResetSync();
     void MarkSynced();
     void Sync(CNode* node, uint256 nProp, bool fPartial = false);
+    //! Filter of every proposal, budget and vote seen, sent with "mnvsf"
+    CBloomFilter GetSyncFilter();
+    //! Push every valid proposal, budget and vote not in the filter, votes in bulk
+    void SyncFiltered(CNode* node, const CBloomFilter& filter);
+
+    //! True if the hash is a proposal, budget or vote in one of the seen maps
+    bool HaveSeen(const uint256& hash) const;
 
     void ProcessMessage(CNode* pfrom, std::string& strCommand, CDataStream& vRecv);
+    void ProcessVote(CNode* pfrom, CBudgetVote& vote);
+    void ProcessFinalizedVote(CNode* pfrom, CFinalizedBudgetVote& vote);
     void NewBlock();
     CBudgetProposal* FindProposal(const std::string& strProposalName);
     CBudgetProposal* FindProposal(uint256 nHash);
@@ -245,7 +262,7 @@ public:
     void CheckOrphanVotes();
     void Clear()
     {
-        LOCK(cs);
+        LOCK2(cs, cs_seen);
 
         LogPrintf("Budget object cleared\n");
         mapProposals.clear();
@@ -266,6 +283,7 @@ public:
     template <typename Stream, typename Operation>
     inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
     {
+        LOCK(cs_seen);
         READWRITE(mapSeenServicenodeBudgetProposals);
         READWRITE(mapSeenServicenodeBudgetVotes);
         READWRITE(mapSeenFinalizedBudgets);
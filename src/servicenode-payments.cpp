@@ -6,8 +6,10 @@
 
 #include "servicenode-payments.h"
 #include "addrman.h"
+#include "bloom.h"
 #include "servicenode-budget.h"
 #include "servicenode-sync.h"
+#include "servicenodecache.h"
 #include "servicenodeman.h"
 #include "obfuscation.h"
 #include "spork.h"
@@ -36,36 +38,75 @@ CServicenodePaymentDB::CServicenodePaymentDB()
 
 bool CServicenodePaymentDB::Write(const CServicenodePayments& objToSave)
 {
+    if (!psncachedb)
+        return error("%s : Servicenode cache store is not open", __func__);
+
     int64_t nStart = GetTimeMillis();
+    {
+        LOCK(psncachedb->cs);
+        {
+            LOCK2(cs_mapServicenodeBlocks, cs_mapServicenodePayeeVotes);
+            psncachedb->StageTable(SNCACHE_PAYEE_VOTE, objToSave.mapServicenodePayeeVotes);
+            psncachedb->StageTable(SNCACHE_BLOCK_PAYEES, objToSave.mapServicenodeBlocks);
+        }
+        psncachedb->StageMarker("mnpayments");
+        if (!psncachedb->Commit())
+            return error("%s : Failed to write servicenode payments", __func__);
+    }
 
-    // serialize, checksum data up to that point, then append checksum
-    CDataStream ssObj(SER_DISK, CLIENT_VERSION);
-    ssObj << strMagicMessage;                   // servicenode cache file specific magic message
-    ssObj << FLATDATA(Params().MessageStart()); // network specific magic number
-    ssObj << objToSave;
-    uint256 hash = Hash(ssObj.begin(), ssObj.end());
-    ssObj << hash;
-
-    // open output file, and associate with CAutoFile
-    FILE* file = fopen(pathDB.string().c_str(), "wb");
-    CAutoFile fileout(file, SER_DISK, CLIENT_VERSION);
-    if (fileout.IsNull())
-        return error("%s : Failed to open file %s", __func__, pathDB.string());
-
-    // Write and commit header, data
+    // the store supersedes mnpayments.dat from now on
     try {
-        fileout << ssObj;
-    } catch (std::exception& e) {
-        return error("%s : Serialize or I/O error - %s", __func__, e.what());
+        boost::filesystem::remove(pathDB);
+    } catch (const boost::filesystem::filesystem_error& e) {
+        LogPrintf("%s : Failed to remove %s - %s\n", __func__, pathDB.string(), e.what());
     }
-    fileout.fclose();
 
-    LogPrintf("Written info to mnpayments.dat  %dms\n", GetTimeMillis() - nStart);
+    LogPrintf("Written info to servicenode payment cache  %dms\n", GetTimeMillis() - nStart);
 
     return true;
 }
 
 CServicenodePaymentDB::ReadResult CServicenodePaymentDB::Read(CServicenodePayments& objToLoad, bool fDryRun)
+{
+    if (!psncachedb)
+        return FileError;
+
+    bool fWrongNetwork = false;
+    if (!psncachedb->HasMarker("mnpayments", fWrongNetwork)) {
+        if (fWrongNetwork) {
+            error("%s : Invalid network magic number", __func__);
+            return IncorrectMagicNumber;
+        }
+        return ReadFile(objToLoad, fDryRun);
+    }
+
+    int64_t nStart = GetTimeMillis();
+    {
+        LOCK(psncachedb->cs);
+        LOCK2(cs_mapServicenodeBlocks, cs_mapServicenodePayeeVotes);
+        if (!psncachedb->ReadTable(SNCACHE_PAYEE_VOTE, objToLoad.mapServicenodePayeeVotes) ||
+            !psncachedb->ReadTable(SNCACHE_BLOCK_PAYEES, objToLoad.mapServicenodeBlocks)) {
+            objToLoad.Clear();
+            // drop the unreadable tables so the next write starts them over
+            psncachedb->WipeTable(SNCACHE_PAYEE_VOTE);
+            psncachedb->WipeTable(SNCACHE_BLOCK_PAYEES);
+            return IncorrectFormat;
+        }
+    }
+
+    LogPrintf("Loaded info from servicenode payment cache  %dms\n", GetTimeMillis() - nStart);
+    LogPrintf("  %s\n", objToLoad.ToString());
+    if (!fDryRun) {
+        LogPrintf("Servicenode payments manager - cleaning....\n");
+        objToLoad.CleanPaymentList();
+        LogPrintf("Servicenode payments manager - result:\n");
+        LogPrintf("  %s\n", objToLoad.ToString());
+    }
+
+    return Ok;
+}
+
+CServicenodePaymentDB::ReadResult CServicenodePaymentDB::ReadFile(CServicenodePayments& objToLoad, bool fDryRun)
 {
     int64_t nStart = GetTimeMillis();
     // open input file, and associate with CAutoFile
@@ -152,26 +193,9 @@ void DumpServicenodePayments()
     int64_t nStart = GetTimeMillis();
 
     CServicenodePaymentDB paymentdb;
-    CServicenodePayments tempPayments;
-
-    LogPrintf("Verifying mnpayments.dat format...\n");
-    CServicenodePaymentDB::ReadResult readResult = paymentdb.Read(tempPayments, true);
-    // there was an error and it was not an error on file opening => do not proceed
-    if (readResult == CServicenodePaymentDB::FileError)
-        LogPrintf("Missing budgets file - mnpayments.dat, will try to recreate\n");
-    else if (readResult != CServicenodePaymentDB::Ok) {
-        LogPrintf("Error reading mnpayments.dat: ");
-        if (readResult == CServicenodePaymentDB::IncorrectFormat)
-            LogPrintf("magic is ok but data has invalid format, will try to recreate\n");
-        else {
-            LogPrintf("file format is unknown or invalid, please fix it manually\n");
-            return;
-        }
-    }
-    LogPrintf("Writting info to mnpayments.dat...\n");
     paymentdb.Write(servicenodePayments);
 
-    LogPrintf("Budget dump finished  %dms\n", GetTimeMillis() - nStart);
+    LogPrintf("Servicenode payments dump finished  %dms\n", GetTimeMillis() - nStart);
 }
 
 bool IsBlockValueValid(const CBlock& block, CAmount nExpectedValue, CAmount nMinted)
@@ -358,6 +382,28 @@ void CServicenodePayments::ProcessMessageServicenodePayments(CNode* pfrom, std::
         pfrom->FulfilledRequest("mnget");
         servicenodePayments.Sync(pfrom, nCountNeeded);
         LogPrint("mnpayments", "mnget - Sent Servicenode winners to peer %i\n", pfrom->GetId());
+    } else if (strCommand == "mnwf") { //Servicenode Payments Request Sync, skipping what the peer already has
+        int nCountNeeded;
+        CBloomFilter filter;
+        vRecv >> nCountNeeded >> filter;
+
+        if (!filter.IsWithinSizeConstraints()) {
+            Misbehaving(pfrom->GetId(), 100);
+            return;
+        }
+        filter.UpdateEmptyFull();
+
+        if (Params().NetworkID() == CBaseChainParams::MAIN) {
+            if (pfrom->HasFulfilledRequest("mnget")) {
+                LogPrintf("mnwf - peer already asked me for the list\n");
+                Misbehaving(pfrom->GetId(), 20);
+                return;
+            }
+        }
+
+        pfrom->FulfilledRequest("mnget");
+        servicenodePayments.SyncFiltered(pfrom, nCountNeeded, filter);
+        LogPrint("mnpayments", "mnwf - Sent Servicenode winners to peer %i\n", pfrom->GetId());
     } else if (strCommand == "mnw") { //Servicenode Payments Declare Winner
         //this is required in litemodef
         CServicenodePaymentWinner winner;
@@ -365,54 +411,77 @@ void CServicenodePayments::ProcessMessageServicenodePayments(CNode* pfrom, std::
 
         if (pfrom->nVersion < ActiveProtocol()) return;
 
-        int nHeight;
-        {
-            TRY_LOCK(cs_main, locked);
-            if (!locked || chainActive.Tip() == NULL) return;
-            nHeight = chainActive.Tip()->nHeight;
-        }
+        int nHeight = GetHeight();
+        if (nHeight < 0) return;
 
-        if (servicenodePayments.mapServicenodePayeeVotes.count(winner.GetHash())) {
-            LogPrint("mnpayments", "mnw - Already seen - %s bestHeight %d\n", winner.GetHash().ToString().c_str(), nHeight);
-            servicenodeSync.AddedServicenodeWinner(winner.GetHash());
-            return;
-        }
+        ProcessWinner(pfrom, winner, nHeight);
+    } else if (strCommand == "mnws") { //Servicenode Payments Winners, bulk reply to mnwf
+        std::vector<CServicenodePaymentWinner> vWinners;
+        vRecv >> vWinners;
 
-        int nFirstBlock = nHeight - (mnodeman.CountEnabled() * 1.25);
-        if (winner.nBlockHeight < nFirstBlock || winner.nBlockHeight > nHeight + 20) {
-            LogPrint("mnpayments", "mnw - winner out of range - FirstBlock %d Height %d bestHeight %d\n", nFirstBlock, winner.nBlockHeight, nHeight);
+        if (pfrom->nVersion < ActiveProtocol()) return;
+        if (vWinners.size() > SERVICENODE_SYNC_BULK_MAX) {
+            Misbehaving(pfrom->GetId(), 20);
             return;
         }
 
-        std::string strError = "";
-        if (!winner.IsValid(pfrom, strError)) {
-            // if(strError != "") LogPrintf("mnw - invalid message - %s\n", strError);
-            return;
-        }
+        // The peer sends a batch only once, so never drop it because a lock is busy
+        int nHeight = GetHeight();
+        if (nHeight < 0) return;
 
-        if (!servicenodePayments.CanVote(winner.vinServicenode.prevout, winner.nBlockHeight)) {
-            //  LogPrintf("mnw - servicenode already voted - %s\n", winner.vinServicenode.prevout.ToStringShort());
-            return;
-        }
+        BOOST_FOREACH (CServicenodePaymentWinner& winner, vWinners)
+            ProcessWinner(pfrom, winner, nHeight);
+        LogPrint("mnpayments", "mnws - processed %d winners from peer %i\n", vWinners.size(), pfrom->GetId());
+    }
+}
 
-        if (!winner.SignatureValid()) {
-            // LogPrintf("mnw - invalid signature\n");
-            if (servicenodeSync.IsSynced()) Misbehaving(pfrom->GetId(), 20);
-            // it could just be a non-synced servicenode
-            mnodeman.AskForMN(pfrom, winner.vinServicenode);
-            return;
-        }
+void CServicenodePayments::ProcessWinner(CNode* pfrom, CServicenodePaymentWinner& winner, int nHeight)
+{
+    bool fSeen;
+    {
+        LOCK(cs_mapServicenodePayeeVotes);
+        fSeen = mapServicenodePayeeVotes.count(winner.GetHash());
+    }
+    if (fSeen) {
+        LogPrint("mnpayments", "mnw - Already seen - %s bestHeight %d\n", winner.GetHash().ToString().c_str(), nHeight);
+        servicenodeSync.AddedServicenodeWinner(winner.GetHash());
+        return;
+    }
 
-        CTxDestination address1;
-        ExtractDestination(winner.payee, address1);
-        CBitcoinAddress address2(address1);
+    int nFirstBlock = nHeight - (mnodeman.CountEnabled() * 1.25);
+    if (winner.nBlockHeight < nFirstBlock || winner.nBlockHeight > nHeight + 20) {
+        LogPrint("mnpayments", "mnw - winner out of range - FirstBlock %d Height %d bestHeight %d\n", nFirstBlock, winner.nBlockHeight, nHeight);
+        return;
+    }
 
-        //   LogPrint("mnpayments", "mnw - winning vote - Addr %s Height %d bestHeight %d - %s\n", address2.ToString().c_str(), winner.nBlockHeight, nHeight, winner.vinServicenode.prevout.ToStringShort());
+    std::string strError = "";
+    if (!winner.IsValid(pfrom, strError)) {
+        // if(strError != "") LogPrintf("mnw - invalid message - %s\n", strError);
+        return;
+    }
 
-        if (servicenodePayments.AddWinningServicenode(winner)) {
-            winner.Relay();
-            servicenodeSync.AddedServicenodeWinner(winner.GetHash());
-        }
+    if (!servicenodePayments.CanVote(winner.vinServicenode.prevout, winner.nBlockHeight)) {
+        //  LogPrintf("mnw - servicenode already voted - %s\n", winner.vinServicenode.prevout.ToStringShort());
+        return;
+    }
+
+    if (!winner.SignatureValid()) {
+        // LogPrintf("mnw - invalid signature\n");
+        if (servicenodeSync.IsSynced()) Misbehaving(pfrom->GetId(), 20);
+        // it could just be a non-synced servicenode
+        mnodeman.AskForMN(pfrom, winner.vinServicenode);
+        return;
+    }
+
+    CTxDestination address1;
+    ExtractDestination(winner.payee, address1);
+    CBitcoinAddress address2(address1);
+
+    //   LogPrint("mnpayments", "mnw - winning vote - Addr %s Height %d bestHeight %d - %s\n", address2.ToString().c_str(), winner.nBlockHeight, nHeight, winner.vinServicenode.prevout.ToStringShort());
+
+    if (servicenodePayments.AddWinningServicenode(winner)) {
+        winner.Relay();
+        servicenodeSync.AddedServicenodeWinner(winner.GetHash());
     }
 }
 
@@ -453,12 +522,8 @@ bool CServicenodePayments::IsScheduled(CServicenode& mn, int nNotBlockHeight)
 {
     LOCK(cs_mapServicenodeBlocks);
 
-    int nHeight;
-    {
-        TRY_LOCK(cs_main, locked);
-        if (!locked || chainActive.Tip() == NULL) return false;
-        nHeight = chainActive.Tip()->nHeight;
-    }
+    int nHeight = GetHeight();
+    if (nHeight < 0) return false;
 
     CScript mnpayee;
     mnpayee = GetScriptForDestination(mn.pubKeyCollateralAddress.GetID());
@@ -668,12 +733,8 @@ void CServicenodePayments::CleanPaymentList()
 {
     LOCK2(cs_mapServicenodePayeeVotes, cs_mapServicenodeBlocks);
 
-    int nHeight;
-    {
-        TRY_LOCK(cs_main, locked);
-        if (!locked || chainActive.Tip() == NULL) return;
-        nHeight = chainActive.Tip()->nHeight;
-    }
+    int nHeight = GetHeight();
+    if (nHeight < 0) return;
 
     //keep up to five cycles for historical sake
     int nLimit = std::max(int(mnodeman.size() * 1.25), 1000);
@@ -828,12 +889,8 @@ void CServicenodePayments::Sync(CNode* node, int nCountNeeded)
 {
     LOCK(cs_mapServicenodePayeeVotes);
 
-    int nHeight;
-    {
-        TRY_LOCK(cs_main, locked);
-        if (!locked || chainActive.Tip() == NULL) return;
-        nHeight = chainActive.Tip()->nHeight;
-    }
+    int nHeight = GetHeight();
+    if (nHeight < 0) return;
 
     int nCount = (mnodeman.CountEnabled() * 1.25);
     if (nCountNeeded > nCount) nCountNeeded = nCount;
@@ -851,6 +908,47 @@ void CServicenodePayments::Sync(CNode* node, int nCountNeeded)
     node->PushMessage("ssc", SERVICENODE_SYNC_MNW, nInvCount);
 }
 
+CBloomFilter CServicenodePayments::GetSyncFilter()
+{
+    LOCK(cs_mapServicenodePayeeVotes);
+
+    unsigned int nElements = mapServicenodePayeeVotes.size();
+    CBloomFilter filter(std::max(nElements, 1u), SERVICENODE_SYNC_FILTER_FP_RATE, GetRandInt(std::numeric_limits<int>::max()), BLOOM_UPDATE_NONE);
+    for (std::map<uint256, CServicenodePaymentWinner>::iterator it = mapServicenodePayeeVotes.begin(); it != mapServicenodePayeeVotes.end(); ++it)
+        filter.insert(it->first);
+    return filter;
+}
+
+void CServicenodePayments::SyncFiltered(CNode* node, int nCountNeeded, const CBloomFilter& filter)
+{
+    LOCK(cs_mapServicenodePayeeVotes);
+
+    int nHeight = GetHeight();
+    if (nHeight < 0) return;
+
+    int nCount = (mnodeman.CountEnabled() * 1.25);
+    if (nCountNeeded > nCount) nCountNeeded = nCount;
+
+    int nInvCount = 0;
+    std::vector<CServicenodePaymentWinner> vWinners;
+    std::map<uint256, CServicenodePaymentWinner>::iterator it = mapServicenodePayeeVotes.begin();
+    while (it != mapServicenodePayeeVotes.end()) {
+        const CServicenodePaymentWinner& winner = (*it).second;
+        if (winner.nBlockHeight >= nHeight - nCountNeeded && winner.nBlockHeight <= nHeight + 20 && !filter.contains((*it).first)) {
+            vWinners.push_back(winner);
+            nInvCount++;
+            if (vWinners.size() == SERVICENODE_SYNC_BULK_MAX) {
+                node->PushMessage("mnws", vWinners);
+                vWinners.clear();
+            }
+        }
+        ++it;
+    }
+    if (!vWinners.empty())
+        node->PushMessage("mnws", vWinners);
+    node->PushMessage("ssc", SERVICENODE_SYNC_MNW, nInvCount);
+}
+
 std::string CServicenodePayments::ToString() const
 {
     std::ostringstream info;
@@ -6,6 +6,7 @@
 #ifndef SERVICENODE_PAYMENTS_H
 #define SERVICENODE_PAYMENTS_H
 
+#include "bloom.h"
 #include "key.h"
 #include "main.h"
 #include "servicenode.h"
@@ -34,7 +35,8 @@ void FillBlockPayee(CMutableTransaction& txNew, int64_t nFees, bool fProofOfStak
 
 void DumpServicenodePayments();
 
-/** Save Servicenode Payment Data (mnpayments.dat)
+/** Access to the payment tables of the servicenode cache store,
+ *  reading the mnpayments.dat of older versions once when the store has none
  */
 class CServicenodePaymentDB
 {
@@ -56,6 +58,9 @@ public:
     CServicenodePaymentDB();
     bool Write(const CServicenodePayments& objToSave);
     ReadResult Read(CServicenodePayments& objToLoad, bool fDryRun = false);
+
+private:
+    ReadResult ReadFile(CServicenodePayments& objToLoad, bool fDryRun);
 };
 
 class CServicenodePayee
@@ -258,6 +263,10 @@ public:
     bool ProcessBlock(int nBlockHeight);
 
     void Sync(CNode* node, int nCountNeeded);
+    //! Filter of every winner seen, sent with "mnwf"
+    CBloomFilter GetSyncFilter();
+    //! Push the winners in range not in the filter, in bulk
+    void SyncFiltered(CNode* node, int nCountNeeded, const CBloomFilter& filter);
     void CleanPaymentList();
     int LastPayment(CServicenode& mn);
 
@@ -282,6 +291,7 @@ public:
 
     int GetMinServicenodePaymentsProto();
     void ProcessMessageServicenodePayments(CNode* pfrom, std::string& strCommand, CDataStream& vRecv);
+    void ProcessWinner(CNode* pfrom, CServicenodePaymentWinner& winner, int nHeight);
     std::string GetRequiredPaymentsString(int nBlockHeight);
     void FillBlockPayee(CMutableTransaction& txNew, int64_t nFees, bool fProofOfStake);
     std::string ToString() const;
@@ -81,6 +81,8 @@ void CServicenodeSync::Reset()
     countServicenodeWinner = 0;
     countBudgetItemProp = 0;
     countBudgetItemFin = 0;
+    countBulkServicenodeWinner = 0;
+    countBulkBudgetItem = 0;
     RequestedServicenodeAssets = SERVICENODE_SYNC_INITIAL;
     RequestedServicenodeAttempt = 0;
     nAssetSyncStarted = GetTime();
@@ -88,7 +90,15 @@ void CServicenodeSync::Reset()
 
 void CServicenodeSync::AddedServicenodeList(uint256 hash)
 {
-    if (mnodeman.mapSeenServicenodeBroadcast.count(hash)) {
+    // look the broadcast up before taking cs, which is kept a leaf
+    bool fSeen;
+    {
+        LOCK(mnodeman.cs);
+        fSeen = mnodeman.mapSeenServicenodeBroadcast.count(hash);
+    }
+
+    LOCK(cs);
+    if (fSeen) {
         if (mapSeenSyncMNB[hash] < SERVICENODE_SYNC_THRESHOLD) {
             lastServicenodeList = GetTime();
             mapSeenSyncMNB[hash]++;
@@ -101,7 +111,14 @@ void CServicenodeSync::AddedServicenodeList(uint256 hash)
 
 void CServicenodeSync::AddedServicenodeWinner(uint256 hash)
 {
-    if (servicenodePayments.mapServicenodePayeeVotes.count(hash)) {
+    bool fSeen;
+    {
+        LOCK(cs_mapServicenodePayeeVotes);
+        fSeen = servicenodePayments.mapServicenodePayeeVotes.count(hash);
+    }
+
+    LOCK(cs);
+    if (fSeen) {
         if (mapSeenSyncMNW[hash] < SERVICENODE_SYNC_THRESHOLD) {
             lastServicenodeWinner = GetTime();
             mapSeenSyncMNW[hash]++;
@@ -114,8 +131,10 @@ void CServicenodeSync::AddedServicenodeWinner(uint256 hash)
 
 void CServicenodeSync::AddedBudgetItem(uint256 hash)
 {
-    if (budget.mapSeenServicenodeBudgetProposals.count(hash) || budget.mapSeenServicenodeBudgetVotes.count(hash) ||
-        budget.mapSeenFinalizedBudgets.count(hash) || budget.mapSeenFinalizedBudgetVotes.count(hash)) {
+    bool fSeen = budget.HaveSeen(hash);
+
+    LOCK(cs);
+    if (fSeen) {
         if (mapSeenSyncBudget[hash] < SERVICENODE_SYNC_THRESHOLD) {
             lastBudgetItem = GetTime();
             mapSeenSyncBudget[hash]++;
@@ -128,11 +147,13 @@ void CServicenodeSync::AddedBudgetItem(uint256 hash)
 
 bool CServicenodeSync::IsBudgetPropEmpty()
 {
+    LOCK(cs);
     return sumBudgetItemProp == 0 && countBudgetItemProp > 0;
 }
 
 bool CServicenodeSync::IsBudgetFinEmpty()
 {
+    LOCK(cs);
     return sumBudgetItemFin == 0 && countBudgetItemFin > 0;
 }
 
@@ -183,14 +204,16 @@ std::string CServicenodeSync::GetSyncStatus()
     return "";
 }
 
-void CServicenodeSync::ProcessMessage(CNode* /*pfrom*/, std::string& strCommand, CDataStream& vRecv)
+void CServicenodeSync::ProcessMessage(CNode* pfrom, std::string& strCommand, CDataStream& vRecv)
 {
     if (strCommand == "ssc") { //Sync status count
         int nItemID;
         int nCount;
         vRecv >> nItemID >> nCount;
 
-        int syncState = RequestedServicenodeAssetsLocked();
+        // counts of different peers arrive on different message handler threads
+        LOCK(cs);
+        int syncState = RequestedServicenodeAssets;
         if (syncState >= SERVICENODE_SYNC_FINISHED) return;
 
         //this means we will receive no further communication
@@ -204,6 +227,7 @@ void CServicenodeSync::ProcessMessage(CNode* /*pfrom*/, std::string& strCommand,
             if (nItemID != syncState) return;
             sumServicenodeWinner += nCount;
             countServicenodeWinner++;
+            if (pfrom->nVersion >= BULK_GOVERNANCE_SYNC_VERSION) countBulkServicenodeWinner++;
             break;
         case (SERVICENODE_SYNC_BUDGET_PROP):
             if (syncState != SERVICENODE_SYNC_BUDGET) return;
@@ -214,6 +238,7 @@ void CServicenodeSync::ProcessMessage(CNode* /*pfrom*/, std::string& strCommand,
             if (syncState != SERVICENODE_SYNC_BUDGET) return;
             sumBudgetItemFin += nCount;
             countBudgetItemFin++;
+            if (pfrom->nVersion >= BULK_GOVERNANCE_SYNC_VERSION) countBulkBudgetItem++;
             break;
         }
 
@@ -332,6 +357,12 @@ void CServicenodeSync::Process()
             }
 
             if (RequestedServicenodeAssetsLocked() == SERVICENODE_SYNC_MNW) {
+                // filtered syncs report their count after the last winner, nothing more is coming
+                if (countBulkServicenodeWinner >= SERVICENODE_SYNC_THRESHOLD) {
+                    GetNextAsset();
+                    return;
+                }
+
                 if (lastServicenodeWinner > 0 && lastServicenodeWinner < GetTime() - SERVICENODE_SYNC_TIMEOUT * 2 && RequestedServicenodeAttempt >= SERVICENODE_SYNC_THRESHOLD) { //hasn't received a new item in the last five seconds, so we'll move to the
                     GetNextAsset();
                     return;
@@ -361,7 +392,10 @@ void CServicenodeSync::Process()
                 if (pindexPrev == NULL) return;
 
                 int nMnCount = mnodeman.CountEnabled();
-                pnode->PushMessage("mnget", nMnCount); //sync payees
+                if (pnode->nVersion >= BULK_GOVERNANCE_SYNC_VERSION)
+                    pnode->PushMessage("mnwf", nMnCount, servicenodePayments.GetSyncFilter()); //sync payees we don't have
+                else
+                    pnode->PushMessage("mnget", nMnCount); //sync payees
                 RequestedServicenodeAttempt++;
 
                 return;
@@ -370,6 +404,13 @@ void CServicenodeSync::Process()
 
         if (pnode->nVersion >= ActiveProtocol()) {
             if (RequestedServicenodeAssetsLocked() == SERVICENODE_SYNC_BUDGET) {
+                // filtered syncs report their count after the last vote, nothing more is coming
+                if (countBulkBudgetItem >= SERVICENODE_SYNC_THRESHOLD) {
+                    GetNextAsset();
+                    activeServicenode.ManageStatus();
+                    return;
+                }
+
                 //we'll start rejecting votes if we accidentally get set as synced too soon
                 if (lastBudgetItem > 0 && lastBudgetItem < GetTime() - SERVICENODE_SYNC_TIMEOUT * 2 && RequestedServicenodeAttempt >= SERVICENODE_SYNC_THRESHOLD) { //hasn't received a new item in the last five seconds, so we'll move to the
                     GetNextAsset();
@@ -400,8 +441,12 @@ void CServicenodeSync::Process()
 
                 if (RequestedServicenodeAttempt >= SERVICENODE_SYNC_THRESHOLD * 3) return;
 
-                uint256 n = 0;
-                pnode->PushMessage("mnvs", n); //sync servicenode votes
+                if (pnode->nVersion >= BULK_GOVERNANCE_SYNC_VERSION) {
+                    pnode->PushMessage("mnvsf", budget.GetSyncFilter()); //sync servicenode votes we don't have
+                } else {
+                    uint256 n = 0;
+                    pnode->PushMessage("mnvs", n); //sync servicenode votes
+                }
                 RequestedServicenodeAttempt++;
 
                 return;
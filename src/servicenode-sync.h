@@ -18,6 +18,10 @@
 
 #define SERVICENODE_SYNC_TIMEOUT 5
 #define SERVICENODE_SYNC_THRESHOLD 2
+//! Most votes or winners carried by one bulk sync message
+#define SERVICENODE_SYNC_BULK_MAX 1000
+//! False positive rate of the filter describing the items a syncing node already has
+#define SERVICENODE_SYNC_FILTER_FP_RATE 0.0001
 
 class CServicenodeSync;
 extern CServicenodeSync servicenodeSync;
@@ -49,6 +53,9 @@ public:
     int countServicenodeWinner;
     int countBudgetItemProp;
     int countBudgetItemFin;
+    // peers that answered a filtered sync; their count arrives after all the items
+    int countBulkServicenodeWinner;
+    int countBulkBudgetItem;
 
     // Count peers we've requested the list from
     int RequestedServicenodeAssets;
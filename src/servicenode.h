@@ -29,7 +29,6 @@ using namespace std;
 class CServicenode;
 class CServicenodeBroadcast;
 class CServicenodePing;
-extern map<int64_t, uint256> mapCacheBlockHashes;
 
 bool GetBlockHash(uint256& hash, int nBlockHeight);
 
@@ -214,6 +213,7 @@ public:
     }
 
     uint256 CalculateScore(int mod = 1, int64_t nBlockHeight = 0);
+    static uint256 CalculateScore(const COutPoint& prevout, const uint256& hashBlock);
 
     ADD_SERIALIZE_METHODS;
 
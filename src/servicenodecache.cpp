@@ -0,0 +1,97 @@
+// Copyright (c) 2018 The Blocknet developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "servicenodecache.h"
+
+#include "chainparams.h"
+#include "util.h"
+
+CServicenodeCacheDB* psncachedb = NULL;
+
+CServicenodeCacheDB::CServicenodeCacheDB(size_t nCacheSize, bool fMemory, bool fWipe)
+    : CLevelDBWrapper(GetDataDir() / "sncache", nCacheSize, fMemory, fWipe),
+      nStagedWritten(0), nStagedErased(0), nErasedSinceCompact(0)
+{
+}
+
+void CServicenodeCacheDB::StageTableEnd(char chTable)
+{
+    Table& staged = mapStaged[chTable];
+    const Table& table = mapTables[chTable];
+    for (Table::const_iterator it = table.begin(); it != table.end(); ++it) {
+        if (staged.count(it->first))
+            continue;
+        batch.Erase(CSerializedBytes(it->first));
+        nStagedErased++;
+    }
+}
+
+void CServicenodeCacheDB::StageMarker(const std::string& strCache)
+{
+    std::vector<unsigned char> vchMagic(Params().MessageStart(), Params().MessageStart() + MESSAGE_START_SIZE);
+    batch.Write(std::make_pair(SNCACHE_MARKER, strCache), vchMagic);
+}
+
+bool CServicenodeCacheDB::HasMarker(const std::string& strCache, bool& fWrongNetwork)
+{
+    std::vector<unsigned char> vchMagic;
+    fWrongNetwork = false;
+    if (!Read(std::make_pair(SNCACHE_MARKER, strCache), vchMagic))
+        return false;
+    fWrongNetwork = vchMagic.size() != MESSAGE_START_SIZE ||
+                    memcmp(&vchMagic[0], Params().MessageStart(), MESSAGE_START_SIZE);
+    return !fWrongNetwork;
+}
+
+bool CServicenodeCacheDB::Commit()
+{
+    int64_t nWritten = nStagedWritten;
+    int64_t nErased = nStagedErased;
+    bool fOk = true;
+    try {
+        WriteBatch(batch, true);
+        for (std::map<char, Table>::iterator it = mapStaged.begin(); it != mapStaged.end(); ++it)
+            mapTables[it->first].swap(it->second);
+    } catch (const leveldb_error& e) {
+        fOk = error("%s : %s", __func__, e.what());
+    }
+
+    // on failure the written state is left as it was, so the next flush stages the same changes again
+    mapStaged.clear();
+    batch = CLevelDBBatch();
+    nStagedWritten = 0;
+    nStagedErased = 0;
+    if (!fOk)
+        return false;
+
+    LogPrint("servicenode", "%s : %d objects written, %d erased\n", __func__, nWritten, nErased);
+
+    nErasedSinceCompact += nErased;
+    if (nErasedSinceCompact >= SNCACHE_COMPACT_ERASED) {
+        int64_t nStart = GetTimeMillis();
+        Compact();
+        nErasedSinceCompact = 0;
+        LogPrint("servicenode", "%s : compacted  %dms\n", __func__, GetTimeMillis() - nStart);
+    }
+    return true;
+}
+
+bool CServicenodeCacheDB::WipeTable(char chTable)
+{
+    CLevelDBBatch batchWipe;
+    boost::scoped_ptr<leveldb::Iterator> pcursor(NewIterator());
+    pcursor->Seek(leveldb::Slice(&chTable, 1));
+    for (; pcursor->Valid(); pcursor->Next()) {
+        leveldb::Slice slKey = pcursor->key();
+        if (slKey.empty() || slKey[0] != chTable)
+            break;
+        batchWipe.Erase(CSerializedBytes(slKey.ToString()));
+    }
+    mapTables.erase(chTable);
+    try {
+        return WriteBatch(batchWipe, true);
+    } catch (const leveldb_error& e) {
+        return error("%s : %s", __func__, e.what());
+    }
+}
@@ -0,0 +1,171 @@
+// Copyright (c) 2018 The Blocknet developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef SERVICENODECACHE_H
+#define SERVICENODECACHE_H
+
+#include "hash.h"
+#include "leveldbwrapper.h"
+#include "sync.h"
+#include "uint256.h"
+
+#include <map>
+#include <string>
+
+#include <boost/scoped_ptr.hpp>
+
+class CServicenodeCacheDB;
+
+extern CServicenodeCacheDB* psncachedb;
+
+/** Tables of the store; they share one key space, so each needs its own letter */
+static const char SNCACHE_MARKER = 'M';
+// servicenode manager
+static const char SNCACHE_SERVICENODE = 'n';
+static const char SNCACHE_SEEN_BROADCAST = 'b';
+static const char SNCACHE_SEEN_PING = 'p';
+static const char SNCACHE_ASKED_US = 'a';
+static const char SNCACHE_WE_ASKED = 'w';
+static const char SNCACHE_WE_ASKED_ENTRY = 'e';
+static const char SNCACHE_DSQ_COUNT = 'd';
+// servicenode payments
+static const char SNCACHE_PAYEE_VOTE = 'v';
+static const char SNCACHE_BLOCK_PAYEES = 'k';
+// budget manager
+static const char SNCACHE_PROPOSAL = 'P';
+static const char SNCACHE_FINALIZED_BUDGET = 'F';
+static const char SNCACHE_SEEN_PROPOSAL = 's';
+static const char SNCACHE_SEEN_VOTE = 'S';
+static const char SNCACHE_ORPHAN_VOTE = 'o';
+static const char SNCACHE_SEEN_FINALIZED = 'f';
+static const char SNCACHE_SEEN_FINALIZED_VOTE = 'g';
+static const char SNCACHE_ORPHAN_FINALIZED_VOTE = 'O';
+
+//! leveldb cache of the store, it is read in full once at startup
+static const size_t SNCACHE_DB_CACHE = 2 << 20;
+
+//! Compact the store once this many entries were erased since the last compaction
+static const int64_t SNCACHE_COMPACT_ERASED = 10000;
+
+/** Bytes of a key or value that were serialized already, written out verbatim */
+class CSerializedBytes
+{
+public:
+    std::string str;
+
+    explicit CSerializedBytes(const std::string& strIn) : str(strIn) {}
+
+    unsigned int GetSerializeSize(int nType, int nVersion) const
+    {
+        return str.size();
+    }
+
+    template <typename Stream>
+    void Serialize(Stream& s, int nType, int nVersion) const
+    {
+        if (!str.empty())
+            s.write(str.data(), str.size());
+    }
+};
+
+/**
+ * Per-object store behind the servicenode, payment and budget caches
+ * (datadir/sncache). Every object lives under its own key, prefixed with the
+ * table it belongs to. A flush stages each table against what was written
+ * last time and puts only the objects whose serialization changed, erasing
+ * the ones that are gone, so writing the caches costs disk I/O in proportion
+ * to the churn since the previous flush rather than to their size.
+ */
+class CServicenodeCacheDB : public CLevelDBWrapper
+{
+public:
+    //! held across the staging and commit of a flush
+    mutable CCriticalSection cs;
+
+    CServicenodeCacheDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+
+    /** Queue a put of the object if it differs from the version written last */
+    template <typename K, typename V>
+    void StageObject(char chTable, const K& key, const V& value)
+    {
+        CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+        ssKey << chTable << key;
+        CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+        ssValue << value;
+
+        std::string strKey(ssKey.begin(), ssKey.end());
+        uint256 hash = Hash(ssValue.begin(), ssValue.end());
+        mapStaged[chTable][strKey] = hash;
+
+        const Table& table = mapTables[chTable];
+        Table::const_iterator it = table.find(strKey);
+        if (it == table.end() || it->second != hash) {
+            batch.Write(CSerializedBytes(strKey), CSerializedBytes(std::string(ssValue.begin(), ssValue.end())));
+            nStagedWritten++;
+        }
+    }
+
+    /** Queue erases for the objects of a table that were not staged since the last commit */
+    void StageTableEnd(char chTable);
+
+    /** Stage every object of a map as one table */
+    template <typename K, typename V>
+    void StageTable(char chTable, const std::map<K, V>& mapObjects)
+    {
+        for (typename std::map<K, V>::const_iterator it = mapObjects.begin(); it != mapObjects.end(); ++it)
+            StageObject(chTable, it->first, it->second);
+        StageTableEnd(chTable);
+    }
+
+    /** Stage the record that marks the tables of a cache as written, for this network */
+    void StageMarker(const std::string& strCache);
+
+    /** Whether the tables of a cache were ever written; fWrongNetwork is set if that was for another network */
+    bool HasMarker(const std::string& strCache, bool& fWrongNetwork);
+
+    /** Write the staged changes in one batch */
+    bool Commit();
+
+    /** Load every object of a table, and remember what was read so the next flush can diff against it */
+    template <typename K, typename V>
+    bool ReadTable(char chTable, std::map<K, V>& mapObjects)
+    {
+        Table& table = mapTables[chTable];
+        boost::scoped_ptr<leveldb::Iterator> pcursor(NewIterator());
+        pcursor->Seek(leveldb::Slice(&chTable, 1));
+        for (; pcursor->Valid(); pcursor->Next()) {
+            leveldb::Slice slKey = pcursor->key();
+            if (slKey.empty() || slKey[0] != chTable)
+                break;
+            leveldb::Slice slValue = pcursor->value();
+            try {
+                CDataStream ssKey(slKey.data() + 1, slKey.data() + slKey.size(), SER_DISK, CLIENT_VERSION);
+                CDataStream ssValue(slValue.data(), slValue.data() + slValue.size(), SER_DISK, CLIENT_VERSION);
+                K key;
+                ssKey >> key;
+                ssValue >> mapObjects[key];
+            } catch (const std::exception& e) {
+                return error("%s : Deserialize error in table '%c' - %s", __func__, chTable, e.what());
+            }
+            table[slKey.ToString()] = Hash(slValue.data(), slValue.data() + slValue.size());
+        }
+        return true;
+    }
+
+    /** Erase every object of a table, e.g. after it failed to load */
+    bool WipeTable(char chTable);
+
+private:
+    //! serialized key -> hash of the value last written under it
+    typedef std::map<std::string, uint256> Table;
+
+    std::map<char, Table> mapTables;
+    std::map<char, Table> mapStaged;
+    CLevelDBBatch batch;
+    int64_t nStagedWritten;
+    int64_t nStagedErased;
+    int64_t nErasedSinceCompact;
+};
+
+#endif
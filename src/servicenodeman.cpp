@@ -8,9 +8,11 @@
 #include "activeservicenode.h"
 #include "addrman.h"
 #include "servicenode.h"
+#include "servicenodecache.h"
 #include "obfuscation.h"
 #include "spork.h"
 #include "util.h"
+#include "xrouter/xrouterapp.h"
 #include <boost/filesystem.hpp>
 #include <boost/lexical_cast.hpp>
 
@@ -53,38 +55,98 @@ CServicenodeDB::CServicenodeDB()
 
 bool CServicenodeDB::Write(const CServicenodeMan& mnodemanToSave)
 {
+    if (!psncachedb)
+        return error("%s : Servicenode cache store is not open", __func__);
+
     int64_t nStart = GetTimeMillis();
+    {
+        LOCK(psncachedb->cs);
+        {
+            LOCK(mnodemanToSave.cs);
+            BOOST_FOREACH (const CServicenode& mn, mnodemanToSave.listServicenodes)
+                psncachedb->StageObject(SNCACHE_SERVICENODE, mn.vin.prevout, mn);
+            psncachedb->StageTableEnd(SNCACHE_SERVICENODE);
+            psncachedb->StageTable(SNCACHE_ASKED_US, mnodemanToSave.mAskedUsForServicenodeList);
+            psncachedb->StageTable(SNCACHE_WE_ASKED, mnodemanToSave.mWeAskedForServicenodeList);
+            psncachedb->StageTable(SNCACHE_WE_ASKED_ENTRY, mnodemanToSave.mWeAskedForServicenodeListEntry);
+            psncachedb->StageObject(SNCACHE_DSQ_COUNT, 0, mnodemanToSave.nDsqCount);
+            psncachedb->StageTable(SNCACHE_SEEN_BROADCAST, mnodemanToSave.mapSeenServicenodeBroadcast);
+            psncachedb->StageTable(SNCACHE_SEEN_PING, mnodemanToSave.mapSeenServicenodePing);
+        }
+        psncachedb->StageMarker("mncache");
+        if (!psncachedb->Commit())
+            return error("%s : Failed to write servicenode cache", __func__);
+    }
 
-    // serialize, checksum data up to that point, then append checksum
-    CDataStream ssServicenodes(SER_DISK, CLIENT_VERSION);
-    ssServicenodes << strMagicMessage;                   // servicenode cache file specific magic message
-    ssServicenodes << FLATDATA(Params().MessageStart()); // network specific magic number
-    ssServicenodes << mnodemanToSave;
-    uint256 hash = Hash(ssServicenodes.begin(), ssServicenodes.end());
-    ssServicenodes << hash;
-
-    // open output file, and associate with CAutoFile
-    FILE* file = fopen(pathMN.string().c_str(), "wb");
-    CAutoFile fileout(file, SER_DISK, CLIENT_VERSION);
-    if (fileout.IsNull())
-        return error("%s : Failed to open file %s", __func__, pathMN.string());
-
-    // Write and commit header, data
+    // the store supersedes mncache.dat from now on
     try {
-        fileout << ssServicenodes;
-    } catch (std::exception& e) {
-        return error("%s : Serialize or I/O error - %s", __func__, e.what());
+        boost::filesystem::remove(pathMN);
+    } catch (const boost::filesystem::filesystem_error& e) {
+        LogPrintf("%s : Failed to remove %s - %s\n", __func__, pathMN.string(), e.what());
     }
-    //    FileCommit(fileout);
-    fileout.fclose();
 
-    LogPrintf("Written info to mncache.dat  %dms\n", GetTimeMillis() - nStart);
+    LogPrintf("Written info to servicenode cache  %dms\n", GetTimeMillis() - nStart);
     LogPrintf("  %s\n", mnodemanToSave.ToString());
 
     return true;
 }
 
 CServicenodeDB::ReadResult CServicenodeDB::Read(CServicenodeMan& mnodemanToLoad, bool fDryRun)
+{
+    if (!psncachedb)
+        return FileError;
+
+    bool fWrongNetwork = false;
+    if (!psncachedb->HasMarker("mncache", fWrongNetwork)) {
+        if (fWrongNetwork) {
+            error("%s : Invalid network magic number", __func__);
+            return IncorrectMagicNumber;
+        }
+        return ReadFile(mnodemanToLoad, fDryRun);
+    }
+
+    int64_t nStart = GetTimeMillis();
+    {
+        LOCK2(psncachedb->cs, mnodemanToLoad.cs);
+        std::map<COutPoint, CServicenode> mapServicenodes;
+        std::map<int, int64_t> mapDsqCount;
+        if (!psncachedb->ReadTable(SNCACHE_SERVICENODE, mapServicenodes) ||
+            !psncachedb->ReadTable(SNCACHE_ASKED_US, mnodemanToLoad.mAskedUsForServicenodeList) ||
+            !psncachedb->ReadTable(SNCACHE_WE_ASKED, mnodemanToLoad.mWeAskedForServicenodeList) ||
+            !psncachedb->ReadTable(SNCACHE_WE_ASKED_ENTRY, mnodemanToLoad.mWeAskedForServicenodeListEntry) ||
+            !psncachedb->ReadTable(SNCACHE_DSQ_COUNT, mapDsqCount) ||
+            !psncachedb->ReadTable(SNCACHE_SEEN_BROADCAST, mnodemanToLoad.mapSeenServicenodeBroadcast) ||
+            !psncachedb->ReadTable(SNCACHE_SEEN_PING, mnodemanToLoad.mapSeenServicenodePing)) {
+            mnodemanToLoad.Clear();
+            // drop the unreadable tables so the next write starts them over
+            const char vchTables[] = {SNCACHE_SERVICENODE, SNCACHE_ASKED_US, SNCACHE_WE_ASKED, SNCACHE_WE_ASKED_ENTRY,
+                                      SNCACHE_DSQ_COUNT, SNCACHE_SEEN_BROADCAST, SNCACHE_SEEN_PING};
+            for (unsigned int i = 0; i < sizeof(vchTables); i++)
+                psncachedb->WipeTable(vchTables[i]);
+            return IncorrectFormat;
+        }
+
+        mnodemanToLoad.listServicenodes.clear();
+        for (std::map<COutPoint, CServicenode>::const_iterator it = mapServicenodes.begin(); it != mapServicenodes.end(); ++it)
+            mnodemanToLoad.listServicenodes.push_back(it->second);
+        mnodemanToLoad.ReindexServicenodes();
+        if (mapDsqCount.count(0))
+            mnodemanToLoad.nDsqCount = mapDsqCount[0];
+    }
+
+    LogPrintf("Loaded info from servicenode cache  %dms\n", GetTimeMillis() - nStart);
+    LogPrintf("  %s\n", mnodemanToLoad.ToString());
+    if (!fDryRun) {
+        LogPrintf("Servicenode manager - cleaning....\n");
+        mnodemanToLoad.CheckAndRemove(true);
+        LogPrintf("Servicenode manager - result:\n");
+        LogPrintf("  %s\n", mnodemanToLoad.ToString());
+    }
+
+    return Ok;
+}
+
+CServicenodeDB::ReadResult CServicenodeDB::ReadFile(CServicenodeMan& mnodemanToLoad, bool fDryRun)
 {
     int64_t nStart = GetTimeMillis();
     // open input file, and associate with CAutoFile
@@ -170,23 +232,6 @@ void DumpServicenodes()
     int64_t nStart = GetTimeMillis();
 
     CServicenodeDB mndb;
-    CServicenodeMan tempMnodeman;
-
-    LogPrintf("Verifying mncache.dat format...\n");
-    CServicenodeDB::ReadResult readResult = mndb.Read(tempMnodeman, true);
-    // there was an error and it was not an error on file opening => do not proceed
-    if (readResult == CServicenodeDB::FileError)
-        LogPrintf("Missing servicenode cache file - mncache.dat, will try to recreate\n");
-    else if (readResult != CServicenodeDB::Ok) {
-        LogPrintf("Error reading mncache.dat: ");
-        if (readResult == CServicenodeDB::IncorrectFormat)
-            LogPrintf("magic is ok but data has invalid format, will try to recreate\n");
-        else {
-            LogPrintf("file format is unknown or invalid, please fix it manually\n");
-            return;
-        }
-    }
-    LogPrintf("Writting info to mncache.dat...\n");
     mndb.Write(mnodeman);
 
     LogPrintf("Servicenode dump finished  %dms\n", GetTimeMillis() - nStart);
@@ -207,7 +252,10 @@ bool CServicenodeMan::Add(CServicenode& mn)
     CServicenode* pmn = Find(mn.vin);
     if (pmn == NULL) {
         LogPrint("servicenode", "CServicenodeMan: Adding new Servicenode %s - %i now\n", mn.vin.prevout.hash.ToString(), size() + 1);
-        vServicenodes.push_back(mn);
+        ServicenodeIter it = listServicenodes.insert(listServicenodes.end(), mn);
+        mapServicenodesByVin[mn.vin.prevout] = it;
+        IndexServicenodeKeys(it);
+        mapRankTables.clear();
         return true;
     }
 
@@ -234,7 +282,7 @@ void CServicenodeMan::Check()
 {
     LOCK(cs);
 
-    BOOST_FOREACH (CServicenode& mn, vServicenodes) {
+    BOOST_FOREACH (CServicenode& mn, listServicenodes) {
         mn.Check();
     }
 }
@@ -246,8 +294,8 @@ void CServicenodeMan::CheckAndRemove(bool forceExpiredRemoval)
     LOCK(cs);
 
     //remove inactive and outdated
-    vector<CServicenode>::iterator it = vServicenodes.begin();
-    while (it != vServicenodes.end()) {
+    ServicenodeIter it = listServicenodes.begin();
+    while (it != listServicenodes.end()) {
         if ((*it).activeState == CServicenode::SERVICENODE_REMOVE ||
             (*it).activeState == CServicenode::SERVICENODE_VIN_SPENT ||
             (forceExpiredRemoval && (*it).activeState == CServicenode::SERVICENODE_EXPIRED) ||
@@ -277,7 +325,7 @@ void CServicenodeMan::CheckAndRemove(bool forceExpiredRemoval)
                 }
             }
 
-            it = vServicenodes.erase(it);
+            it = EraseServicenode(it);
         } else {
             ++it;
         }
@@ -338,7 +386,12 @@ void CServicenodeMan::CheckAndRemove(bool forceExpiredRemoval)
 void CServicenodeMan::Clear()
 {
     LOCK(cs);
-    vServicenodes.clear();
+    listServicenodes.clear();
+    mapServicenodesByVin.clear();
+    mapServicenodesByPayee.clear();
+    mapServicenodesByPubKey.clear();
+    mapServicenodesByAddr.clear();
+    mapRankTables.clear();
     mAskedUsForServicenodeList.clear();
     mWeAskedForServicenodeList.clear();
     mWeAskedForServicenodeListEntry.clear();
@@ -352,7 +405,7 @@ int CServicenodeMan::CountEnabled(int protocolVersion)
     int i = 0;
     protocolVersion = protocolVersion == -1 ? servicenodePayments.GetMinServicenodePaymentsProto() : protocolVersion;
 
-    BOOST_FOREACH (CServicenode& mn, vServicenodes) {
+    BOOST_FOREACH (CServicenode& mn, listServicenodes) {
         mn.Check();
         if (mn.protocolVersion < protocolVersion || !mn.IsEnabled()) continue;
         i++;
@@ -384,26 +437,30 @@ void CServicenodeMan::DsegUpdate(CNode* pnode)
 
 CServicenode* CServicenodeMan::Find(const CScript& payee)
 {
+    // servicenodes are paid to the key id of their collateral address
+    CTxDestination dest;
+    if (!ExtractDestination(payee, dest))
+        return NULL;
+    const CKeyID* keyID = boost::get<CKeyID>(&dest);
+    if (keyID == NULL || GetScriptForDestination(*keyID) != payee)
+        return NULL;
+
     LOCK(cs);
-    CScript payee2;
 
-    BOOST_FOREACH (CServicenode& mn, vServicenodes) {
-        payee2 = GetScriptForDestination(mn.pubKeyCollateralAddress.GetID());
-        if (payee2 == payee)
-            return &mn;
-    }
-    return NULL;
+    boost::unordered_multimap<CKeyID, ServicenodeIter, ServicenodeIndexHasher>::iterator it = mapServicenodesByPayee.find(*keyID);
+    if (it == mapServicenodesByPayee.end())
+        return NULL;
+    return &*it->second;
 }
 
 CServicenode* CServicenodeMan::Find(const CTxIn& vin)
 {
     LOCK(cs);
 
-    BOOST_FOREACH (CServicenode& mn, vServicenodes) {
-        if (mn.vin.prevout == vin.prevout)
-            return &mn;
-    }
-    return NULL;
+    boost::unordered_map<COutPoint, ServicenodeIter, ServicenodeIndexHasher>::iterator it = mapServicenodesByVin.find(vin.prevout);
+    if (it == mapServicenodesByVin.end())
+        return NULL;
+    return &*it->second;
 }
 
 
@@ -411,22 +468,20 @@ CServicenode* CServicenodeMan::Find(const CPubKey& pubKeyServicenode)
 {
     LOCK(cs);
 
-    BOOST_FOREACH (CServicenode& mn, vServicenodes) {
-        if (mn.pubKeyServicenode == pubKeyServicenode)
-            return &mn;
-    }
-    return NULL;
+    boost::unordered_multimap<CPubKey, ServicenodeIter, ServicenodeIndexHasher>::iterator it = mapServicenodesByPubKey.find(pubKeyServicenode);
+    if (it == mapServicenodesByPubKey.end())
+        return NULL;
+    return &*it->second;
 }
 
 CServicenode* CServicenodeMan::Find(const std::string & nodeAddr)
 {
     LOCK(cs);
 
-    for (CServicenode & mn : vServicenodes) {
-        if (mn.addr.ToString() == nodeAddr)
-            return &mn;
-    }
-    return nullptr;
+    boost::unordered_multimap<std::string, ServicenodeIter>::iterator it = mapServicenodesByAddr.find(nodeAddr);
+    if (it == mapServicenodesByAddr.end())
+        return nullptr;
+    return &*it->second;
 }
 
 //
@@ -444,7 +499,7 @@ CServicenode* CServicenodeMan::GetNextServicenodeInQueueForPayment(int nBlockHei
     */
 
     int nMnCount = CountEnabled();
-    BOOST_FOREACH (CServicenode& mn, vServicenodes) {
+    BOOST_FOREACH (CServicenode& mn, listServicenodes) {
         if (!servicenodePayments.ValidNode(mn, fFilterSigTime, nMnCount))
             continue;
 
@@ -498,7 +553,7 @@ CServicenode* CServicenodeMan::FindRandomNotInVec(std::vector<CTxIn>& vecToExclu
     LogPrint("servicenode", "CServicenodeMan::FindRandomNotInVec - rand %d\n", rand);
     bool found;
 
-    BOOST_FOREACH (CServicenode& mn, vServicenodes) {
+    BOOST_FOREACH (CServicenode& mn, listServicenodes) {
         if (mn.protocolVersion < protocolVersion || !mn.IsEnabled()) continue;
         found = false;
         BOOST_FOREACH (CTxIn& usedVin, vecToExclude) {
@@ -522,7 +577,7 @@ CServicenode* CServicenodeMan::GetCurrentServiceNode(int mod, int64_t nBlockHeig
     CServicenode* winner = NULL;
 
     // scan for winner
-    BOOST_FOREACH (CServicenode& mn, vServicenodes) {
+    BOOST_FOREACH (CServicenode& mn, listServicenodes) {
         mn.Check();
         if (mn.protocolVersion < minProtocol || !mn.IsEnabled()) continue;
 
@@ -540,25 +595,43 @@ CServicenode* CServicenodeMan::GetCurrentServiceNode(int mod, int64_t nBlockHeig
     return winner;
 }
 
-int CServicenodeMan::GetServicenodeRank(const CTxIn& vin, int64_t nBlockHeight, int minProtocol, bool fOnlyActive)
+const CServicenodeRankTable* CServicenodeMan::GetRankTable(int64_t nBlockHeight, int minProtocol, RankFilter filter)
 {
-    std::vector<pair<int64_t, CTxIn> > vecServicenodeScores;
+    AssertLockHeld(cs_main);
+    AssertLockHeld(cs);
 
     //make sure we know about this block
     uint256 hash = 0;
-    if (!GetBlockHash(hash, nBlockHeight)) return -1;
+    if (!GetBlockHash(hash, nBlockHeight)) return NULL;
+
+    // eligibility follows the servicenode checks, so tables filtering on it live as long as a check does
+    std::pair<int64_t, std::pair<int, int> > key = std::make_pair(nBlockHeight, std::make_pair(minProtocol, (int)filter));
+    std::map<std::pair<int64_t, std::pair<int, int> >, CServicenodeRankTable>::iterator itTable = mapRankTables.find(key);
+    if (itTable != mapRankTables.end() && itTable->second.hashBlock == hash &&
+        (filter == RANK_PROTOCOL || GetTime() - itTable->second.nTimeBuilt < SERVICENODE_CHECK_SECONDS))
+        return &itTable->second;
+
+    // scores only depend on the block and the collateral, keep them for as long as the block is in the chain
+    ScoreCache& scores = mapScoreCache[nBlockHeight];
+    if (scores.hashBlock != hash) {
+        scores.hashBlock = hash;
+        scores.mapScores.clear();
+    }
+
+    std::vector<pair<int64_t, CTxIn> > vecServicenodeScores;
+    vecServicenodeScores.reserve(listServicenodes.size());
+    BOOST_FOREACH (CServicenode& mn, listServicenodes) {
+        if (filter != RANK_PROTOCOL)
+            mn.Check();
 
-    // scan for winner
-    BOOST_FOREACH (CServicenode& mn, vServicenodes) {
         if (mn.protocolVersion < minProtocol) {
-            if (fDebug)
+            if (fDebug && filter == RANK_MATURE)
                 LogPrintf("Skipping Servicenode %s with obsolete version: %d)\n", mn.vin.prevout.hash.ToString(), mn.protocolVersion);
             continue;
         }
-        if (fOnlyActive) {
-            mn.Check();
 
-            if (mn.GetServicenodeInputAge() < vServicenodes.size())
+        if (filter == RANK_MATURE) {
+            if (mn.GetServicenodeInputAge() < listServicenodes.size())
                 continue;
 
             auto snodeAge = GetAdjustedTime() - mn.sigTime;
@@ -567,60 +640,79 @@ int CServicenodeMan::GetServicenodeRank(const CTxIn& vin, int64_t nBlockHeight,
                     LogPrintf("Skipping recently activated Servicenode %s with age: %ld\n", mn.vin.prevout.hash.ToString(), snodeAge);
                 continue;
             }
+        }
 
-            if (!mn.IsEnabled()) continue;
+        if (filter != RANK_PROTOCOL && !mn.IsEnabled()) {
+            if (filter == RANK_LISTED)
+                vecServicenodeScores.push_back(make_pair(9999, mn.vin));
+            continue;
         }
-        uint256 n = mn.CalculateScore(1, nBlockHeight);
-        int64_t n2 = n.GetCompact(false);
 
-        vecServicenodeScores.push_back(make_pair(n2, mn.vin));
+        boost::unordered_map<COutPoint, int64_t, ServicenodeIndexHasher>::iterator itScore = scores.mapScores.find(mn.vin.prevout);
+        if (itScore == scores.mapScores.end()) {
+            int64_t n2 = CServicenode::CalculateScore(mn.vin.prevout, hash).GetCompact(false);
+            itScore = scores.mapScores.insert(std::make_pair(mn.vin.prevout, n2)).first;
+        }
+
+        vecServicenodeScores.push_back(make_pair(itScore->second, mn.vin));
     }
 
     sort(vecServicenodeScores.rbegin(), vecServicenodeScores.rend(), CompareScoreTxIn());
 
-    int rank = 0;
+    CServicenodeRankTable& table = mapRankTables[key];
+    table.hashBlock = hash;
+    table.nTimeBuilt = GetTime();
+    table.vecRanked.clear();
+    table.mapRanks.clear();
+    table.vecRanked.reserve(vecServicenodeScores.size());
     BOOST_FOREACH (PAIRTYPE(int64_t, CTxIn) & s, vecServicenodeScores) {
-        rank++;
-        if (s.second.prevout == vin.prevout) {
-            return rank;
-        }
+        table.vecRanked.push_back(s.second);
+        table.mapRanks[s.second.prevout] = table.vecRanked.size();
     }
 
-    return -1;
+    // only the most recent blocks are asked about, drop the tables of the oldest heights
+    while (mapScoreCache.size() > SERVICENODES_RANK_CACHE_HEIGHTS)
+        mapScoreCache.erase(mapScoreCache.begin());
+    std::set<int64_t> setHeights;
+    for (itTable = mapRankTables.begin(); itTable != mapRankTables.end(); ++itTable)
+        setHeights.insert(itTable->first.first);
+    while (setHeights.size() > SERVICENODES_RANK_CACHE_HEIGHTS && *setHeights.begin() < nBlockHeight) {
+        while (mapRankTables.begin()->first.first == *setHeights.begin())
+            mapRankTables.erase(mapRankTables.begin());
+        setHeights.erase(setHeights.begin());
+    }
+
+    return &table;
 }
 
-std::vector<pair<int, CServicenode> > CServicenodeMan::GetServicenodeRanks(int64_t nBlockHeight, int minProtocol)
+int CServicenodeMan::GetServicenodeRank(const CTxIn& vin, int64_t nBlockHeight, int minProtocol, bool fOnlyActive)
 {
-    std::vector<pair<int64_t, CServicenode> > vecServicenodeScores;
-    std::vector<pair<int, CServicenode> > vecServicenodeRanks;
+    // the rank tables are built for blocks of the active chain
+    LOCK2(cs_main, cs);
 
-    //make sure we know about this block
-    uint256 hash = 0;
-    if (!GetBlockHash(hash, nBlockHeight)) return vecServicenodeRanks;
+    const CServicenodeRankTable* pTable = GetRankTable(nBlockHeight, minProtocol, fOnlyActive ? RANK_MATURE : RANK_PROTOCOL);
+    if (pTable == NULL) return -1;
 
-    // scan for winner
-    BOOST_FOREACH (CServicenode& mn, vServicenodes) {
-        mn.Check();
-
-        if (mn.protocolVersion < minProtocol) continue;
-
-        if (!mn.IsEnabled()) {
-            vecServicenodeScores.push_back(make_pair(9999, mn));
-            continue;
-        }
+    boost::unordered_map<COutPoint, int, ServicenodeIndexHasher>::const_iterator it = pTable->mapRanks.find(vin.prevout);
+    if (it == pTable->mapRanks.end()) return -1;
+    return it->second;
+}
 
-        uint256 n = mn.CalculateScore(1, nBlockHeight);
-        int64_t n2 = n.GetCompact(false);
+std::vector<pair<int, CServicenode> > CServicenodeMan::GetServicenodeRanks(int64_t nBlockHeight, int minProtocol)
+{
+    std::vector<pair<int, CServicenode> > vecServicenodeRanks;
 
-        vecServicenodeScores.push_back(make_pair(n2, mn));
-    }
+    LOCK2(cs_main, cs);
 
-    sort(vecServicenodeScores.rbegin(), vecServicenodeScores.rend(), CompareScoreMN());
+    const CServicenodeRankTable* pTable = GetRankTable(nBlockHeight, minProtocol, RANK_LISTED);
+    if (pTable == NULL) return vecServicenodeRanks;
 
+    vecServicenodeRanks.reserve(pTable->vecRanked.size());
     int rank = 0;
-    BOOST_FOREACH (PAIRTYPE(int64_t, CServicenode) & s, vecServicenodeScores) {
+    BOOST_FOREACH (const CTxIn& vin, pTable->vecRanked) {
         rank++;
-        vecServicenodeRanks.push_back(make_pair(rank, s.second));
+        CServicenode* pmn = Find(vin);
+        if (pmn) vecServicenodeRanks.push_back(make_pair(rank, *pmn));
     }
 
     return vecServicenodeRanks;
@@ -628,33 +720,13 @@ std::vector<pair<int, CServicenode> > CServicenodeMan::GetServicenodeRanks(int64
 
 CServicenode* CServicenodeMan::GetServicenodeByRank(int nRank, int64_t nBlockHeight, int minProtocol, bool fOnlyActive)
 {
-    std::vector<pair<int64_t, CTxIn> > vecServicenodeScores;
+    // the rank tables are built for blocks of the active chain
+    LOCK2(cs_main, cs);
 
-    // scan for winner
-    BOOST_FOREACH (CServicenode& mn, vServicenodes) {
-        if (mn.protocolVersion < minProtocol) continue;
-        if (fOnlyActive) {
-            mn.Check();
-            if (!mn.IsEnabled()) continue;
-        }
-
-        uint256 n = mn.CalculateScore(1, nBlockHeight);
-        int64_t n2 = n.GetCompact(false);
+    const CServicenodeRankTable* pTable = GetRankTable(nBlockHeight, minProtocol, fOnlyActive ? RANK_ENABLED : RANK_PROTOCOL);
+    if (pTable == NULL || nRank < 1 || nRank > (int)pTable->vecRanked.size()) return NULL;
 
-        vecServicenodeScores.push_back(make_pair(n2, mn.vin));
-    }
-
-    sort(vecServicenodeScores.rbegin(), vecServicenodeScores.rend(), CompareScoreTxIn());
-
-    int rank = 0;
-    BOOST_FOREACH (PAIRTYPE(int64_t, CTxIn) & s, vecServicenodeScores) {
-        rank++;
-        if (rank == nRank) {
-            return Find(s.second);
-        }
-    }
-
-    return NULL;
+    return Find(pTable->vecRanked[nRank - 1]);
 }
 
 void CServicenodeMan::ProcessServicenodeConnections()
@@ -774,7 +846,7 @@ void CServicenodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CDat
 
         int nInvCount = 0;
 
-        BOOST_FOREACH (CServicenode& mn, vServicenodes) {
+        BOOST_FOREACH (CServicenode& mn, listServicenodes) {
             if (mn.addr.IsRFC1918()) continue; //local network
 
             if (mn.IsEnabled()) {
@@ -806,14 +878,10 @@ void CServicenodeMan::Remove(CTxIn vin)
 {
     LOCK(cs);
 
-    vector<CServicenode>::iterator it = vServicenodes.begin();
-    while (it != vServicenodes.end()) {
-        if ((*it).vin == vin) {
-            LogPrint("servicenode", "CServicenodeMan: Removing Servicenode %s - %i now\n", (*it).vin.prevout.hash.ToString(), size() - 1);
-            vServicenodes.erase(it);
-            break;
-        }
-        ++it;
+    boost::unordered_map<COutPoint, ServicenodeIter, ServicenodeIndexHasher>::iterator it = mapServicenodesByVin.find(vin.prevout);
+    if (it != mapServicenodesByVin.end() && it->second->vin == vin) {
+        LogPrint("servicenode", "CServicenodeMan: Removing Servicenode %s - %i now\n", vin.prevout.hash.ToString(), size() - 1);
+        EraseServicenode(it->second);
     }
 }
 
@@ -831,16 +899,121 @@ void CServicenodeMan::UpdateServicenodeList(CServicenodeBroadcast mnb)
         if (Add(mn)) {
             servicenodeSync.AddedServicenodeList(mnb.GetHash());
         }
-    } else if (pmn->UpdateFromNewBroadcast(mnb)) {
+    } else if (UpdateFromNewBroadcast(*pmn, mnb)) {
         servicenodeSync.AddedServicenodeList(mnb.GetHash());
     }
 }
 
+bool CServicenodeMan::UpdateFromNewBroadcast(CServicenode& mn, CServicenodeBroadcast& mnb)
+{
+    LOCK(cs);
+
+    boost::unordered_map<COutPoint, ServicenodeIter, ServicenodeIndexHasher>::iterator it = mapServicenodesByVin.find(mn.vin.prevout);
+    if (it == mapServicenodesByVin.end() || &*it->second != &mn)
+        return mn.UpdateFromNewBroadcast(mnb); // a copy, not listed here
+
+    UnindexServicenodeKeys(it->second);
+    bool fUpdated = mn.UpdateFromNewBroadcast(mnb);
+    IndexServicenodeKeys(it->second);
+    if (fUpdated)
+        mapRankTables.clear();
+    return fUpdated;
+}
+
+void CServicenodeMan::IndexServicenodeKeys(ServicenodeIter it)
+{
+    mapServicenodesByPayee.insert(std::make_pair(it->pubKeyCollateralAddress.GetID(), it));
+    mapServicenodesByPubKey.insert(std::make_pair(it->pubKeyServicenode, it));
+    mapServicenodesByAddr.insert(std::make_pair(it->addr.ToString(), it));
+}
+
+template <typename Index, typename Key>
+static void EraseIndexEntry(Index& index, const Key& key, std::list<CServicenode>::iterator it)
+{
+    std::pair<typename Index::iterator, typename Index::iterator> range = index.equal_range(key);
+    for (typename Index::iterator mi = range.first; mi != range.second; ++mi) {
+        if (mi->second == it) {
+            index.erase(mi);
+            return;
+        }
+    }
+}
+
+void CServicenodeMan::UnindexServicenodeKeys(ServicenodeIter it)
+{
+    EraseIndexEntry(mapServicenodesByPayee, it->pubKeyCollateralAddress.GetID(), it);
+    EraseIndexEntry(mapServicenodesByPubKey, it->pubKeyServicenode, it);
+    EraseIndexEntry(mapServicenodesByAddr, it->addr.ToString(), it);
+}
+
+template <typename Index, typename Key>
+static bool HasIndexEntry(Index& index, const Key& key, std::list<CServicenode>::iterator it)
+{
+    std::pair<typename Index::iterator, typename Index::iterator> range = index.equal_range(key);
+    for (typename Index::iterator mi = range.first; mi != range.second; ++mi) {
+        if (mi->second == it)
+            return true;
+    }
+    return false;
+}
+
+bool CServicenodeMan::CheckIndexes()
+{
+    LOCK(cs);
+
+    // one entry per servicenode in each index, so finding them all means nothing stale is left
+    const size_t nSize = listServicenodes.size();
+    if (mapServicenodesByVin.size() != nSize || mapServicenodesByPayee.size() != nSize ||
+        mapServicenodesByPubKey.size() != nSize || mapServicenodesByAddr.size() != nSize)
+        return error("CServicenodeMan::CheckIndexes() : %u servicenodes, indexed %u by vin, %u by payee, %u by key, %u by address",
+            nSize, mapServicenodesByVin.size(), mapServicenodesByPayee.size(), mapServicenodesByPubKey.size(), mapServicenodesByAddr.size());
+
+    for (ServicenodeIter it = listServicenodes.begin(); it != listServicenodes.end(); ++it) {
+        boost::unordered_map<COutPoint, ServicenodeIter, ServicenodeIndexHasher>::iterator mi = mapServicenodesByVin.find(it->vin.prevout);
+        if (mi == mapServicenodesByVin.end() || mi->second != it ||
+            !HasIndexEntry(mapServicenodesByPayee, it->pubKeyCollateralAddress.GetID(), it) ||
+            !HasIndexEntry(mapServicenodesByPubKey, it->pubKeyServicenode, it) ||
+            !HasIndexEntry(mapServicenodesByAddr, it->addr.ToString(), it))
+            return error("CServicenodeMan::CheckIndexes() : servicenode %s is not indexed under its keys", it->vin.prevout.ToStringShort());
+    }
+    return true;
+}
+
+CServicenodeMan::ServicenodeIter CServicenodeMan::EraseServicenode(ServicenodeIter it)
+{
+    if (xrouter::App::isEnabled())
+        xrouter::App::instance().removeCandidate(it->addr.ToString());
+    UnindexServicenodeKeys(it);
+    mapServicenodesByVin.erase(it->vin.prevout);
+    mapRankTables.clear();
+    return listServicenodes.erase(it);
+}
+
+void CServicenodeMan::ReindexServicenodes()
+{
+    mapRankTables.clear();
+    mapServicenodesByVin.clear();
+    mapServicenodesByPayee.clear();
+    mapServicenodesByPubKey.clear();
+    mapServicenodesByAddr.clear();
+
+    ServicenodeIter it = listServicenodes.begin();
+    while (it != listServicenodes.end()) {
+        // keep the first of any duplicate vins, as Add would have
+        if (!mapServicenodesByVin.insert(std::make_pair(it->vin.prevout, it)).second) {
+            it = listServicenodes.erase(it);
+            continue;
+        }
+        IndexServicenodeKeys(it);
+        ++it;
+    }
+}
+
 std::string CServicenodeMan::ToString() const
 {
     std::ostringstream info;
 
-    info << "Servicenodes: " << (int)vServicenodes.size() << ", peers who asked us for Servicenode list: " << (int)mAskedUsForServicenodeList.size() << ", peers we asked for Servicenode list: " << (int)mWeAskedForServicenodeList.size() << ", entries in Servicenode list we asked for: " << (int)mWeAskedForServicenodeListEntry.size() << ", nDsqCount: " << (int)nDsqCount;
+    info << "Servicenodes: " << (int)listServicenodes.size() << ", peers who asked us for Servicenode list: " << (int)mAskedUsForServicenodeList.size() << ", peers we asked for Servicenode list: " << (int)mWeAskedForServicenodeList.size() << ", entries in Servicenode list we asked for: " << (int)mWeAskedForServicenodeListEntry.size() << ", nDsqCount: " << (int)nDsqCount;
 
     return info.str();
 }
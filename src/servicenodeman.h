@@ -8,6 +8,7 @@
 #define SERVICENODEMAN_H
 
 #include "base58.h"
+#include "crypto/common.h"
 #include "key.h"
 #include "main.h"
 #include "servicenode.h"
@@ -15,8 +16,13 @@
 #include "sync.h"
 #include "util.h"
 
+#include <list>
+
+#include <boost/unordered_map.hpp>
+
 #define SERVICENODES_DUMP_SECONDS (15 * 60)
 #define SERVICENODES_DSEG_SECONDS (3 * 60 * 60)
+#define SERVICENODES_RANK_CACHE_HEIGHTS 16
 
 using namespace std;
 
@@ -25,7 +31,8 @@ class CServicenodeMan;
 extern CServicenodeMan mnodeman;
 void DumpServicenodes();
 
-/** Access to the MN database (mncache.dat)
+/** Access to the servicenode manager tables of the servicenode cache store,
+ *  reading the mncache.dat of older versions once when the store has none
  */
 class CServicenodeDB
 {
@@ -47,19 +54,43 @@ public:
     CServicenodeDB();
     bool Write(const CServicenodeMan& mnodemanToSave);
     ReadResult Read(CServicenodeMan& mnodemanToLoad, bool fDryRun = false);
+
+private:
+    ReadResult ReadFile(CServicenodeMan& mnodemanToLoad, bool fDryRun);
+};
+
+/** Hashes the keys of the servicenode indexes; outpoints, key ids and public keys are random enough to slice */
+struct ServicenodeIndexHasher {
+    size_t operator()(const COutPoint& out) const { return out.hash.GetLow64() ^ out.n; }
+    size_t operator()(const CKeyID& keyID) const { return keyID.GetLow64(); }
+    size_t operator()(const CPubKey& pubKey) const { return pubKey.size() > 8 ? ReadLE64(pubKey.begin() + 1) : 0; }
+};
+
+/** Servicenodes ordered by score for one block and eligibility filter */
+struct CServicenodeRankTable {
+    uint256 hashBlock;
+    int64_t nTimeBuilt;
+    std::vector<CTxIn> vecRanked; //! the servicenode of rank n is at n - 1
+    boost::unordered_map<COutPoint, int, ServicenodeIndexHasher> mapRanks;
 };
 
 class CServicenodeMan
 {
-private:
-    // critical section to protect the inner data structures
-    mutable CCriticalSection cs;
+    friend class CServicenodeDB;
 
+private:
     // critical section to protect the inner data structures specifically on messaging
     mutable CCriticalSection cs_process_message;
 
-    // map to hold all MNs
-    std::vector<CServicenode> vServicenodes;
+    typedef std::list<CServicenode>::iterator ServicenodeIter;
+
+    // all MNs; a list, so pointers handed out by Find stay valid until that entry is removed
+    std::list<CServicenode> listServicenodes;
+    // lookup indexes into listServicenodes, kept in step by Add, UpdateFromNewBroadcast and the removals
+    boost::unordered_map<COutPoint, ServicenodeIter, ServicenodeIndexHasher> mapServicenodesByVin;
+    boost::unordered_multimap<CKeyID, ServicenodeIter, ServicenodeIndexHasher> mapServicenodesByPayee;
+    boost::unordered_multimap<CPubKey, ServicenodeIter, ServicenodeIndexHasher> mapServicenodesByPubKey;
+    boost::unordered_multimap<std::string, ServicenodeIter> mapServicenodesByAddr;
     // who's asked for the Servicenode list and the last time
     std::map<CNetAddr, int64_t> mAskedUsForServicenodeList;
     // who we asked for the Servicenode list and the last time
@@ -67,7 +98,38 @@ private:
     // which Servicenodes we've asked for
     std::map<COutPoint, int64_t> mWeAskedForServicenodeListEntry;
 
+    // which servicenodes a rank table orders
+    enum RankFilter {
+        RANK_PROTOCOL, // all with a recent enough protocol
+        RANK_ENABLED,  // and enabled
+        RANK_MATURE,   // and enabled, with a mature collateral and old enough to be trusted
+        RANK_LISTED    // all with a recent enough protocol, disabled ones at the bottom
+    };
+
+    // scores of the servicenodes for a block, computed once per block
+    struct ScoreCache {
+        uint256 hashBlock;
+        boost::unordered_map<COutPoint, int64_t, ServicenodeIndexHasher> mapScores;
+    };
+    std::map<int64_t, ScoreCache> mapScoreCache;
+    // rank tables by height, minimum protocol and filter; cleared whenever the list changes
+    std::map<std::pair<int64_t, std::pair<int, int> >, CServicenodeRankTable> mapRankTables;
+
+    /// The rank table for a block, reusing the cached one while the list and eligibility have not changed
+    const CServicenodeRankTable* GetRankTable(int64_t nBlockHeight, int minProtocol, RankFilter filter);
+
+    /// Index the payee, key and address of an entry, or take them out of the indexes
+    void IndexServicenodeKeys(ServicenodeIter it);
+    void UnindexServicenodeKeys(ServicenodeIter it);
+    /// Drop an entry and its index entries, returning the entry after it
+    ServicenodeIter EraseServicenode(ServicenodeIter it);
+    /// Rebuild every index from listServicenodes
+    void ReindexServicenodes();
+
 public:
+    // critical section to protect the inner data structures; hold it while using a servicenode returned by Find
+    mutable CCriticalSection cs;
+
     // Keep track of all broadcasts I've seen
     map<uint256, CServicenodeBroadcast> mapSeenServicenodeBroadcast;
     // Keep track of all pings I've seen
@@ -82,7 +144,12 @@ public:
     inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
     {
         LOCK(cs);
+        std::vector<CServicenode> vServicenodes(listServicenodes.begin(), listServicenodes.end());
         READWRITE(vServicenodes);
+        if (ser_action.ForRead()) {
+            listServicenodes.assign(vServicenodes.begin(), vServicenodes.end());
+            ReindexServicenodes();
+        }
         READWRITE(mAskedUsForServicenodeList);
         READWRITE(mWeAskedForServicenodeList);
         READWRITE(mWeAskedForServicenodeListEntry);
@@ -110,6 +177,9 @@ public:
     /// Clear Servicenode vector
     void Clear();
 
+    /// Check that every lookup index agrees with the list
+    bool CheckIndexes();
+
     int CountEnabled(int protocolVersion = -1);
 
     void DsegUpdate(CNode* pnode);
@@ -132,11 +202,13 @@ public:
     std::vector<CServicenode> GetFullServicenodeVector()
     {
         Check();
-        return vServicenodes;
+        LOCK(cs);
+        return std::vector<CServicenode>(listServicenodes.begin(), listServicenodes.end());
     }
 
     std::vector<CServicenode> GetCurrentList() {
-        return vServicenodes;
+        LOCK(cs);
+        return std::vector<CServicenode>(listServicenodes.begin(), listServicenodes.end());
     }
 
     std::vector<pair<int, CServicenode> > GetServicenodeRanks(int64_t nBlockHeight, int minProtocol = 0);
@@ -148,7 +220,7 @@ public:
     void ProcessMessage(CNode* pfrom, std::string& strCommand, CDataStream& vRecv);
 
     /// Return the number of (unique) Servicenodes
-    int size() { return vServicenodes.size(); }
+    int size() { return listServicenodes.size(); }
 
     std::string ToString() const;
 
@@ -156,6 +228,9 @@ public:
 
     /// Update servicenode list and maps using provided CServicenodeBroadcast
     void UpdateServicenodeList(CServicenodeBroadcast mnb);
+
+    /// Apply a newer broadcast to a listed entry, moving it in the indexes if its keys or address change
+    bool UpdateFromNewBroadcast(CServicenode& mn, CServicenodeBroadcast& mnb);
 };
 
 #endif
@@ -23,6 +23,7 @@ std::map<uint256, CConsensusVote> mapTxLockVote;
 std::map<uint256, CTransactionLock> mapTxLocks;
 std::map<COutPoint, uint256> mapLockedInputs;
 std::map<uint256, int64_t> mapUnknownVotes; //track votes with no tx for DOS
+CCriticalSection cs_swifttx;
 int nCompleteTXLocks;
 
 //txlock - Locks transaction
@@ -32,93 +33,137 @@ int nCompleteTXLocks;
 //         Send "txvote", CTransaction, Signature, Approve
 //step 3.) Top 1 servicenode, waits for SWIFTTX_SIGNATURES_REQUIRED messages. Upon success, sends "txlock'
 
-void ProcessMessageSwiftTX(CNode* pfrom, std::string& strCommand, CDataStream& vRecv)
+/** Handle a lock request, with cs_main and cs_swifttx held so peers are handled one at a time */
+static void ProcessTxLockRequest(CNode* pfrom, CTransaction& tx, CInv& inv, bool& fReprocess)
 {
-    if (fLiteMode) return; //disable all obfuscation/servicenode related functionality
-    if (!IsSporkActive(SPORK_2_SWIFTTX)) return;
-    if (!servicenodeSync.IsBlockchainSynced()) return;
+    LOCK2(cs_main, cs_swifttx);
 
-    if (strCommand == "ix") {
-        //LogPrintf("ProcessMessageSwiftTX::ix\n");
-        CDataStream vMsg(vRecv);
-        CTransaction tx;
-        vRecv >> tx;
+    if (mapTxLockReq.count(tx.GetHash()) || mapTxLockReqRejected.count(tx.GetHash())) {
+        return;
+    }
 
-        CInv inv(MSG_TXLOCK_REQUEST, tx.GetHash());
-        pfrom->AddInventoryKnown(inv);
+    if (!IsIXTXValid(tx)) {
+        return;
+    }
 
-        if (mapTxLockReq.count(tx.GetHash()) || mapTxLockReqRejected.count(tx.GetHash())) {
+    BOOST_FOREACH (const CTxOut o, tx.vout) {
+        // IX supports normal scripts and unspendable scripts (used in DS collateral and Budget collateral).
+        // TODO: Look into other script types that are normal and can be included
+        if (!o.scriptPubKey.IsNormalPaymentScript() && !o.scriptPubKey.IsUnspendable()) {
+            LogPrintf("ProcessMessageSwiftTX::ix - Invalid Script %s\n", tx.ToString().c_str());
             return;
         }
+    }
 
-        if (!IsIXTXValid(tx)) {
-            return;
-        }
+    int nBlockHeight = CreateNewLock(tx);
 
-        BOOST_FOREACH (const CTxOut o, tx.vout) {
-            // IX supports normal scripts and unspendable scripts (used in DS collateral and Budget collateral).
-            // TODO: Look into other script types that are normal and can be included
-            if (!o.scriptPubKey.IsNormalPaymentScript() && !o.scriptPubKey.IsUnspendable()) {
-                LogPrintf("ProcessMessageSwiftTX::ix - Invalid Script %s\n", tx.ToString().c_str());
-                return;
-            }
-        }
+    bool fMissingInputs = false;
+    CValidationState state;
 
-        int nBlockHeight = CreateNewLock(tx);
+    if (AcceptToMemoryPool(mempool, state, tx, true, &fMissingInputs)) {
+        RelayInv(inv);
 
-        bool fMissingInputs = false;
-        CValidationState state;
+        DoConsensusVote(tx, nBlockHeight);
 
-        bool fAccepted = false;
-        {
-            LOCK(cs_main);
-            fAccepted = AcceptToMemoryPool(mempool, state, tx, true, &fMissingInputs);
-        }
-        if (fAccepted) {
-            RelayInv(inv);
+        mapTxLockReq.insert(make_pair(tx.GetHash(), tx));
 
-            DoConsensusVote(tx, nBlockHeight);
+        LogPrintf("ProcessMessageSwiftTX::ix - Transaction Lock Request: %s %s : accepted %s\n",
+            pfrom->addr.ToString().c_str(), pfrom->cleanSubVer.c_str(),
+            tx.GetHash().ToString().c_str());
 
-            mapTxLockReq.insert(make_pair(tx.GetHash(), tx));
+        return;
 
-            LogPrintf("ProcessMessageSwiftTX::ix - Transaction Lock Request: %s %s : accepted %s\n",
-                pfrom->addr.ToString().c_str(), pfrom->cleanSubVer.c_str(),
-                tx.GetHash().ToString().c_str());
+    } else {
+        mapTxLockReqRejected.insert(make_pair(tx.GetHash(), tx));
 
-            return;
+        // can we get the conflicting transaction as proof?
 
-        } else {
-            mapTxLockReqRejected.insert(make_pair(tx.GetHash(), tx));
+        LogPrintf("ProcessMessageSwiftTX::ix - Transaction Lock Request: %s %s : rejected %s\n",
+            pfrom->addr.ToString().c_str(), pfrom->cleanSubVer.c_str(),
+            tx.GetHash().ToString().c_str());
 
-            // can we get the conflicting transaction as proof?
+        BOOST_FOREACH (const CTxIn& in, tx.vin) {
+            if (!mapLockedInputs.count(in.prevout)) {
+                mapLockedInputs.insert(make_pair(in.prevout, tx.GetHash()));
+            }
+        }
 
-            LogPrintf("ProcessMessageSwiftTX::ix - Transaction Lock Request: %s %s : rejected %s\n",
-                pfrom->addr.ToString().c_str(), pfrom->cleanSubVer.c_str(),
-                tx.GetHash().ToString().c_str());
+        // resolve conflicts
+        std::map<uint256, CTransactionLock>::iterator i = mapTxLocks.find(tx.GetHash());
+        if (i != mapTxLocks.end()) {
+            //we only care if we have a complete tx lock
+            if ((*i).second.CountSignatures() >= SWIFTTX_SIGNATURES_REQUIRED) {
+                if (!CheckForConflictingLocks(tx)) {
+                    LogPrintf("ProcessMessageSwiftTX::ix - Found Existing Complete IX Lock\n");
 
-            BOOST_FOREACH (const CTxIn& in, tx.vin) {
-                if (!mapLockedInputs.count(in.prevout)) {
-                    mapLockedInputs.insert(make_pair(in.prevout, tx.GetHash()));
+                    //reprocess the last 15 blocks
+                    fReprocess = true;
+                    mapTxLockReq.insert(make_pair(tx.GetHash(), tx));
                 }
             }
+        }
 
-            // resolve conflicts
-            std::map<uint256, CTransactionLock>::iterator i = mapTxLocks.find(tx.GetHash());
-            if (i != mapTxLocks.end()) {
-                //we only care if we have a complete tx lock
-                if ((*i).second.CountSignatures() >= SWIFTTX_SIGNATURES_REQUIRED) {
-                    if (!CheckForConflictingLocks(tx)) {
-                        LogPrintf("ProcessMessageSwiftTX::ix - Found Existing Complete IX Lock\n");
-
-                        //reprocess the last 15 blocks
-                        ReprocessBlocks(15);
-                        mapTxLockReq.insert(make_pair(tx.GetHash(), tx));
-                    }
-                }
+        return;
+    }
+}
+
+/** Handle a lock vote, with cs_main and cs_swifttx held so peers are handled one at a time */
+static void ProcessTxLockVote(CNode* pfrom, CConsensusVote& ctx, CInv& inv, bool& fReprocess)
+{
+    LOCK2(cs_main, cs_swifttx);
+
+    if (mapTxLockVote.count(ctx.GetHash())) {
+        return;
+    }
+
+    mapTxLockVote.insert(make_pair(ctx.GetHash(), ctx));
+
+    if (ProcessConsensusVote(pfrom, ctx, fReprocess)) {
+        //Spam/Dos protection
+        /*
+            Servicenodes will sometimes propagate votes before the transaction is known to the client.
+            This tracks those messages and allows it at the same rate of the rest of the network, if
+            a peer violates it, it will simply be ignored
+        */
+        if (!mapTxLockReq.count(ctx.txHash) && !mapTxLockReqRejected.count(ctx.txHash)) {
+            if (!mapUnknownVotes.count(ctx.vinServicenode.prevout.hash)) {
+                mapUnknownVotes[ctx.vinServicenode.prevout.hash] = GetTime() + (60 * 10);
             }
 
-            return;
+            if (mapUnknownVotes[ctx.vinServicenode.prevout.hash] > GetTime() &&
+                mapUnknownVotes[ctx.vinServicenode.prevout.hash] - GetAverageVoteTime() > 60 * 10) {
+                LogPrintf("ProcessMessageSwiftTX::ix - servicenode is spamming transaction votes: %s %s\n",
+                    ctx.vinServicenode.ToString().c_str(),
+                    ctx.txHash.ToString().c_str());
+                return;
+            } else {
+                mapUnknownVotes[ctx.vinServicenode.prevout.hash] = GetTime() + (60 * 10);
+            }
         }
+        RelayInv(inv);
+    }
+}
+
+void ProcessMessageSwiftTX(CNode* pfrom, std::string& strCommand, CDataStream& vRecv)
+{
+    if (fLiteMode) return; //disable all obfuscation/servicenode related functionality
+    if (!IsSporkActive(SPORK_2_SWIFTTX)) return;
+    if (!servicenodeSync.IsBlockchainSynced()) return;
+
+    // reprocessing blocks waits for the validation notifications, so it is
+    // done after releasing cs_main
+    bool fReprocess = false;
+
+    if (strCommand == "ix") {
+        //LogPrintf("ProcessMessageSwiftTX::ix\n");
+        CDataStream vMsg(vRecv);
+        CTransaction tx;
+        vRecv >> tx;
+
+        CInv inv(MSG_TXLOCK_REQUEST, tx.GetHash());
+        pfrom->AddInventoryKnown(inv);
+
+        ProcessTxLockRequest(pfrom, tx, inv, fReprocess);
     } else if (strCommand == "txlvote") //SwiftTX Lock Consensus Votes
     {
         CConsensusVote ctx;
@@ -127,39 +172,11 @@ void ProcessMessageSwiftTX(CNode* pfrom, std::string& strCommand, CDataStream& v
         CInv inv(MSG_TXLOCK_VOTE, ctx.GetHash());
         pfrom->AddInventoryKnown(inv);
 
-        if (mapTxLockVote.count(ctx.GetHash())) {
-            return;
-        }
-
-        mapTxLockVote.insert(make_pair(ctx.GetHash(), ctx));
-
-        if (ProcessConsensusVote(pfrom, ctx)) {
-            //Spam/Dos protection
-            /*
-                Servicenodes will sometimes propagate votes before the transaction is known to the client.
-                This tracks those messages and allows it at the same rate of the rest of the network, if
-                a peer violates it, it will simply be ignored
-            */
-            if (!mapTxLockReq.count(ctx.txHash) && !mapTxLockReqRejected.count(ctx.txHash)) {
-                if (!mapUnknownVotes.count(ctx.vinServicenode.prevout.hash)) {
-                    mapUnknownVotes[ctx.vinServicenode.prevout.hash] = GetTime() + (60 * 10);
-                }
-
-                if (mapUnknownVotes[ctx.vinServicenode.prevout.hash] > GetTime() &&
-                    mapUnknownVotes[ctx.vinServicenode.prevout.hash] - GetAverageVoteTime() > 60 * 10) {
-                    LogPrintf("ProcessMessageSwiftTX::ix - servicenode is spamming transaction votes: %s %s\n",
-                        ctx.vinServicenode.ToString().c_str(),
-                        ctx.txHash.ToString().c_str());
-                    return;
-                } else {
-                    mapUnknownVotes[ctx.vinServicenode.prevout.hash] = GetTime() + (60 * 10);
-                }
-            }
-            RelayInv(inv);
-        }
-
-        return;
+        ProcessTxLockVote(pfrom, ctx, inv, fReprocess);
     }
+
+    if (fReprocess)
+        ReprocessBlocks(15);
 }
 
 bool IsIXTXValid(const CTransaction& txCollateral)
@@ -228,6 +245,7 @@ int64_t CreateNewLock(CTransaction tx)
     */
     int nBlockHeight = (chainActive.Tip()->nHeight - nTxAge) + 4;
 
+    LOCK(cs_swifttx);
     if (!mapTxLocks.count(tx.GetHash())) {
         LogPrintf("CreateNewLock - New Transaction Lock %s !\n", tx.GetHash().ToString().c_str());
 
@@ -281,15 +299,19 @@ void DoConsensusVote(CTransaction& tx, int64_t nBlockHeight)
         return;
     }
 
-    mapTxLockVote[ctx.GetHash()] = ctx;
+    {
+        LOCK(cs_swifttx);
+        mapTxLockVote[ctx.GetHash()] = ctx;
+    }
 
     CInv inv(MSG_TXLOCK_VOTE, ctx.GetHash());
     RelayInv(inv);
 }
 
 //received a consensus vote
-bool ProcessConsensusVote(CNode* pnode, CConsensusVote& ctx)
+bool ProcessConsensusVote(CNode* pnode, CConsensusVote& ctx, bool& fReprocess)
 {
+    AssertLockHeld(cs_swifttx);
     int n = mnodeman.GetServicenodeRank(ctx.vinServicenode, ctx.nBlockHeight, MIN_SWIFTTX_PROTO_VERSION);
 
     CServicenode* pmn = mnodeman.Find(ctx.vinServicenode);
@@ -368,7 +390,7 @@ bool ProcessConsensusVote(CNode* pnode, CConsensusVote& ctx)
                 //if this tx lock was rejected, we need to remove the conflicting blocks
                 if (mapTxLockReqRejected.count((*i).second.txHash)) {
                     //reprocess the last 15 blocks
-                    ReprocessBlocks(15);
+                    fReprocess = true;
                 }
             }
         }
@@ -421,6 +443,7 @@ void CleanTransactionLocksList()
 {
     if (chainActive.Tip() == NULL) return;
 
+    LOCK(cs_swifttx);
     std::map<uint256, CTransactionLock>::iterator it = mapTxLocks.begin();
 
     while (it != mapTxLocks.end()) {
@@ -41,6 +41,8 @@ extern map<uint256, CTransaction> mapTxLockReqRejected;
 extern map<uint256, CConsensusVote> mapTxLockVote;
 extern map<uint256, CTransactionLock> mapTxLocks;
 extern std::map<COutPoint, uint256> mapLockedInputs;
+/** Guards the maps above and mapUnknownVotes, taken after cs_main where both are needed */
+extern CCriticalSection cs_swifttx;
 extern int nCompleteTXLocks;
 
 
@@ -56,8 +58,8 @@ void ProcessMessageSwiftTX(CNode* pfrom, std::string& strCommand, CDataStream& v
 //check if we need to vote on this transaction
 void DoConsensusVote(CTransaction& tx, int64_t nBlockHeight);
 
-//process consensus vote message
-bool ProcessConsensusVote(CNode* pnode, CConsensusVote& ctx);
+//process consensus vote message, fReprocess is set when the last blocks have to be reprocessed
+bool ProcessConsensusVote(CNode* pnode, CConsensusVote& ctx, bool& fReprocess);
 
 // keep transaction locks in memory for an hour
 void CleanTransactionLocksList();
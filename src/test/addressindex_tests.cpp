@@ -0,0 +1,245 @@
+// Copyright (c) 2018 The Blocknet developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "addressindex.h"
+#include "chainparams.h"
+#include "checkpoints.h"
+#include "clientversion.h"
+#include "coins.h"
+#include "hash.h"
+#include "key.h"
+#include "keystore.h"
+#include "main.h"
+#include "pow.h"
+#include "random.h"
+#include "script/sign.h"
+#include "script/standard.h"
+#include "streams.h"
+#include "txdb.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(addressindex_tests)
+
+BOOST_AUTO_TEST_CASE(addressindex_script_keys)
+{
+    CKey key;
+    key.MakeNewKey(true);
+    CPubKey pubkey = key.GetPubKey();
+
+    uint160 hashBytes;
+    int type;
+
+    // Pay to pubkey and pay to pubkey hash land on the same entry
+    BOOST_CHECK(GetAddressIndexKey(GetScriptForDestination(pubkey.GetID()), hashBytes, type));
+    BOOST_CHECK_EQUAL(type, ADDRESS_PUBKEYHASH);
+    BOOST_CHECK(hashBytes == uint160(pubkey.GetID()));
+
+    CScript p2pk = CScript() << ToByteVector(pubkey) << OP_CHECKSIG;
+    BOOST_CHECK(GetAddressIndexKey(p2pk, hashBytes, type));
+    BOOST_CHECK_EQUAL(type, ADDRESS_PUBKEYHASH);
+    BOOST_CHECK(hashBytes == uint160(pubkey.GetID()));
+
+    CScriptID scriptID(p2pk);
+    BOOST_CHECK(GetAddressIndexKey(GetScriptForDestination(scriptID), hashBytes, type));
+    BOOST_CHECK_EQUAL(type, ADDRESS_SCRIPTHASH);
+    BOOST_CHECK(hashBytes == uint160(scriptID));
+
+    CScript data = CScript() << OP_RETURN << std::vector<unsigned char>(8, 1);
+    BOOST_CHECK(!GetAddressIndexKey(data, hashBytes, type));
+}
+
+BOOST_AUTO_TEST_CASE(addressindex_key_order)
+{
+    // Entries of an address must sort by height so range scans can stop early
+    uint160 hashBytes = Hash160(std::vector<unsigned char>(1, 42));
+    CDataStream ssLow(SER_DISK, CLIENT_VERSION);
+    CDataStream ssHigh(SER_DISK, CLIENT_VERSION);
+    ssLow << CAddressIndexKey(ADDRESS_PUBKEYHASH, hashBytes, 0x01ff, 7, uint256(), 0, false);
+    ssHigh << CAddressIndexKey(ADDRESS_PUBKEYHASH, hashBytes, 0x0200, 0, uint256(), 0, false);
+    BOOST_CHECK(ssLow.str() < ssHigh.str());
+
+    CDataStream ssSeek(SER_DISK, CLIENT_VERSION);
+    ssSeek << CAddressIndexIteratorKey(ADDRESS_PUBKEYHASH, hashBytes, 0x0200);
+    BOOST_CHECK(ssLow.str() < ssSeek.str());
+    BOOST_CHECK(ssSeek.str() <= ssHigh.str());
+
+    CAddressIndexKey key;
+    ssHigh >> key;
+    BOOST_CHECK_EQUAL(key.blockHeight, 0x0200);
+    BOOST_CHECK(key.hashBytes == hashBytes);
+}
+
+static std::vector<CAddressIndexEntry> History(const uint160& hashBytes)
+{
+    std::vector<CAddressIndexEntry> vIndex;
+    BOOST_CHECK(pblocktree->ReadAddressIndex(ADDRESS_PUBKEYHASH, hashBytes, vIndex));
+    return vIndex;
+}
+
+static std::vector<CAddressUnspentEntry> Unspent(const uint160& hashBytes)
+{
+    std::vector<CAddressUnspentEntry> vUnspent;
+    BOOST_CHECK(pblocktree->ReadAddressUnspentIndex(ADDRESS_PUBKEYHASH, hashBytes, vUnspent));
+    return vUnspent;
+}
+
+static CAddressBalance Balance(const uint160& hashBytes)
+{
+    CAddressBalance balance;
+    pblocktree->ReadAddressBalance(ADDRESS_PUBKEYHASH, hashBytes, balance);
+    return balance;
+}
+
+BOOST_AUTO_TEST_CASE(addressindex_connect_disconnect)
+{
+    Checkpoints::fEnabled = false;
+    ModifiableParams()->setSkipProofOfWorkCheck(true);
+    fAddressIndex = true;
+    LOCK(cs_main);
+
+    CBasicKeyStore keystore;
+    CKey keyFrom, keyTo, keyMiner;
+    keyFrom.MakeNewKey(true);
+    keyTo.MakeNewKey(true);
+    keyMiner.MakeNewKey(true);
+    keystore.AddKey(keyFrom);
+    const uint160 hashFrom = keyFrom.GetPubKey().GetID();
+    const uint160 hashTo = keyTo.GetPubKey().GetID();
+    const uint160 hashMiner = keyMiner.GetPubKey().GetID();
+    const CScript scriptFrom = GetScriptForDestination(keyFrom.GetPubKey().GetID());
+
+    // An output to keyFrom, in the coins view and the index as if an earlier
+    // block had been connected with it
+    CBlockIndex* pindexPrev = chainActive.Tip();
+    const int nHeightFund = pindexPrev->nHeight;
+    const CAmount nValue = 10 * COIN, nFee = COIN / 100;
+    CMutableTransaction txFund;
+    txFund.vin.resize(1);
+    txFund.vin[0].prevout = COutPoint(GetRandHash(), 0);
+    txFund.vout.resize(1);
+    txFund.vout[0].nValue = nValue;
+    txFund.vout[0].scriptPubKey = scriptFrom;
+    const CTransaction txFunded(txFund);
+
+    CCoinsView viewDummy;
+    CCoinsViewCache view(&viewDummy);
+    view.SetBestBlock(pindexPrev->GetBlockHash());
+    *view.ModifyCoins(txFunded.GetHash()) = CCoins(txFunded, nHeightFund);
+
+    std::vector<CAddressIndexEntry> vIndexFund(1, std::make_pair(
+        CAddressIndexKey(ADDRESS_PUBKEYHASH, hashFrom, nHeightFund, 1, txFunded.GetHash(), 0, false), nValue));
+    std::vector<CAddressUnspentEntry> vUnspentFund(1, std::make_pair(
+        CAddressUnspentKey(ADDRESS_PUBKEYHASH, hashFrom, txFunded.GetHash(), 0),
+        CAddressUnspentValue(nValue, scriptFrom, nHeightFund)));
+    BOOST_CHECK(pblocktree->WriteAddressIndex(vIndexFund, vUnspentFund, nHeightFund));
+
+    // A block spending it to keyTo, the fee going to keyMiner
+    CMutableTransaction txSpend;
+    txSpend.vin.resize(1);
+    txSpend.vin[0].prevout = COutPoint(txFunded.GetHash(), 0);
+    txSpend.vout.resize(1);
+    txSpend.vout[0].nValue = nValue - nFee;
+    txSpend.vout[0].scriptPubKey = GetScriptForDestination(keyTo.GetPubKey().GetID());
+    BOOST_CHECK(SignSignature(keystore, txFunded, txSpend, 0));
+
+    CMutableTransaction txCoinbase;
+    txCoinbase.vin.resize(1);
+    txCoinbase.vin[0].scriptSig = CScript() << (pindexPrev->nHeight + 1) << std::vector<unsigned char>(8, 0xa1);
+    txCoinbase.vout.resize(1);
+    txCoinbase.vout[0].nValue = nFee;
+    txCoinbase.vout[0].scriptPubKey = GetScriptForDestination(keyMiner.GetPubKey().GetID());
+
+    CBlock block;
+    block.hashPrevBlock = pindexPrev->GetBlockHash();
+    block.nTime = pindexPrev->GetBlockTime() + 60;
+    block.vtx.push_back(CTransaction(txCoinbase));
+    block.vtx.push_back(CTransaction(txSpend));
+    block.hashMerkleRoot = block.BuildMerkleTree();
+    block.nBits = GetNextWorkRequired(pindexPrev, &block);
+    const uint256 hashSpend = block.vtx[1].GetHash();
+
+    CValidationState state;
+    CBlockIndex* pindex = NULL;
+    BOOST_CHECK(AcceptBlock(block, state, &pindex));
+    BOOST_REQUIRE(pindex);
+    const int nHeight = pindex->nHeight;
+
+    BOOST_CHECK(ConnectBlock(block, state, pindex, view));
+
+    // The spend is in the history of keyFrom, and its output left the unspent index
+    std::vector<CAddressIndexEntry> vIndex = History(hashFrom);
+    BOOST_CHECK_EQUAL(vIndex.size(), 2U);
+    if (vIndex.size() == 2) {
+        BOOST_CHECK(vIndex[1].first.spending);
+        BOOST_CHECK_EQUAL(vIndex[1].first.blockHeight, nHeight);
+        BOOST_CHECK(vIndex[1].first.txhash == hashSpend);
+        BOOST_CHECK_EQUAL(vIndex[1].second, -nValue);
+    }
+    BOOST_CHECK(Unspent(hashFrom).empty());
+    BOOST_CHECK_EQUAL(Balance(hashFrom).nBalance, 0);
+    BOOST_CHECK_EQUAL(Balance(hashFrom).nReceived, nValue);
+    BOOST_CHECK_EQUAL(Balance(hashFrom).nHeight, nHeight);
+
+    // The new outputs are credited and unspent
+    vIndex = History(hashTo);
+    BOOST_CHECK_EQUAL(vIndex.size(), 1U);
+    std::vector<CAddressUnspentEntry> vUnspent = Unspent(hashTo);
+    BOOST_CHECK_EQUAL(vUnspent.size(), 1U);
+    if (vUnspent.size() == 1) {
+        BOOST_CHECK(vUnspent[0].first.txhash == hashSpend);
+        BOOST_CHECK_EQUAL(vUnspent[0].second.satoshis, nValue - nFee);
+        BOOST_CHECK_EQUAL(vUnspent[0].second.blockHeight, nHeight);
+    }
+    BOOST_CHECK_EQUAL(Balance(hashTo).nBalance, nValue - nFee);
+    BOOST_CHECK_EQUAL(Balance(hashTo).nReceived, nValue - nFee);
+    BOOST_CHECK_EQUAL(History(hashMiner).size(), 1U);
+    BOOST_CHECK_EQUAL(Unspent(hashMiner).size(), 1U);
+    BOOST_CHECK_EQUAL(Balance(hashMiner).nBalance, nFee);
+
+    // Disconnecting puts everything back as it was before the block
+    BOOST_CHECK(DisconnectBlock(block, state, pindex, view));
+    BOOST_CHECK(view.GetBestBlock() == pindexPrev->GetBlockHash());
+    BOOST_CHECK(view.HaveCoins(txFunded.GetHash()));
+    BOOST_CHECK(!view.HaveCoins(hashSpend));
+
+    vIndex = History(hashFrom);
+    BOOST_CHECK_EQUAL(vIndex.size(), 1U);
+    if (vIndex.size() == 1)
+        BOOST_CHECK(!vIndex[0].first.spending);
+    vUnspent = Unspent(hashFrom);
+    BOOST_CHECK_EQUAL(vUnspent.size(), 1U);
+    if (vUnspent.size() == 1) {
+        BOOST_CHECK(vUnspent[0].first.txhash == txFunded.GetHash());
+        BOOST_CHECK_EQUAL(vUnspent[0].first.index, 0U);
+        BOOST_CHECK_EQUAL(vUnspent[0].second.satoshis, nValue);
+        BOOST_CHECK(vUnspent[0].second.script == scriptFrom);
+        BOOST_CHECK_EQUAL(vUnspent[0].second.blockHeight, nHeightFund);
+    }
+    BOOST_CHECK_EQUAL(Balance(hashFrom).nBalance, nValue);
+    BOOST_CHECK_EQUAL(Balance(hashFrom).nReceived, nValue);
+    BOOST_CHECK_EQUAL(Balance(hashFrom).nHeight, nHeight - 1);
+
+    BOOST_CHECK(History(hashTo).empty());
+    BOOST_CHECK(Unspent(hashTo).empty());
+    BOOST_CHECK_EQUAL(Balance(hashTo).nBalance, 0);
+    BOOST_CHECK_EQUAL(Balance(hashTo).nReceived, 0);
+    BOOST_CHECK(History(hashMiner).empty());
+    BOOST_CHECK(Unspent(hashMiner).empty());
+    BOOST_CHECK_EQUAL(Balance(hashMiner).nBalance, 0);
+
+    // A second disconnect finds nothing left to take back
+    BOOST_CHECK(pblocktree->EraseAddressIndex(std::vector<CAddressIndexEntry>(1, std::make_pair(
+        CAddressIndexKey(ADDRESS_PUBKEYHASH, hashTo, nHeight, 1, hashSpend, 0, false), nValue - nFee)),
+        std::vector<CAddressUnspentEntry>(), nHeight));
+    BOOST_CHECK_EQUAL(Balance(hashTo).nBalance, 0);
+
+    // The block spends a coin the chain does not have, keep it off the best chain
+    BOOST_CHECK(InvalidateBlock(state, pindex));
+    fAddressIndex = false;
+    ModifiableParams()->setSkipProofOfWorkCheck(false);
+    Checkpoints::fEnabled = true;
+}
+
+BOOST_AUTO_TEST_SUITE_END()
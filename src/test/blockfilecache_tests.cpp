@@ -0,0 +1,78 @@
+// Copyright (c) 2018 The Blocknet developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockfilecache.h"
+#include "chainparams.h"
+#include "clientversion.h"
+#include "main.h"
+#include "undo.h"
+
+#include <boost/filesystem.hpp>
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(blockfilecache_tests)
+
+/** Position at the end of a block or undo file, where the next record gets appended */
+static CDiskBlockPos EndOfFile(int nFile, const char* prefix)
+{
+    CDiskBlockPos pos(nFile, 0);
+    boost::filesystem::path path = GetBlockPosFilename(pos, prefix);
+    if (boost::filesystem::exists(path))
+        pos.nPos = boost::filesystem::file_size(path);
+    return pos;
+}
+
+static void CheckCachedReads(bool fMmap)
+{
+    CBlockFileCache cache(2, fMmap);
+    pblockfilecache = &cache;
+
+    // the genesis block written by InitBlockIndex
+    CBlock genesis;
+    BOOST_CHECK(ReadBlockFromDisk(genesis, chainActive.Genesis()));
+    BOOST_CHECK(genesis.GetHash() == Params().HashGenesisBlock());
+    BOOST_CHECK_EQUAL(cache.GetOpenCount(), 1U);
+
+    // a block appended after the file was opened
+    CBlock block = genesis;
+    block.nNonce++;
+    CDiskBlockPos pos = EndOfFile(chainActive.Genesis()->GetBlockPos().nFile, "blk");
+    BOOST_CHECK(WriteBlockToDisk(block, pos));
+    CBlock read;
+    BOOST_CHECK(ReadBlockFromDisk(read, pos));
+    BOOST_CHECK(read.GetHash() == block.GetHash());
+
+    // undo data and its checksum
+    CBlockUndo undo;
+    undo.vtxundo.resize(1);
+    undo.vtxundo[0].vprevout.push_back(CTxInUndo(genesis.vtx[0].vout[0]));
+    CDiskBlockPos posUndo = EndOfFile(pos.nFile, "rev");
+    BOOST_CHECK(undo.WriteToDisk(posUndo, block.GetHash()));
+    CBlockUndo undoRead;
+    BOOST_CHECK(undoRead.ReadFromDisk(posUndo, block.GetHash()));
+    BOOST_CHECK_EQUAL(undoRead.vtxundo.size(), 1U);
+    BOOST_CHECK(!undoRead.ReadFromDisk(posUndo, genesis.GetHash()));
+    BOOST_CHECK_EQUAL(cache.GetOpenCount(), 2U);
+
+    // positions that do not follow a record header are refused
+    CBlockFileRecord record;
+    BOOST_CHECK(cache.ReadRecord(pos, "blk", 0, record));
+    BOOST_CHECK_EQUAL(record.size(), ::GetSerializeSize(block, SER_DISK, CLIENT_VERSION));
+    BOOST_CHECK(!cache.ReadRecord(CDiskBlockPos(pos.nFile, pos.nPos + 1), "blk", 0, record));
+    BOOST_CHECK(!cache.ReadRecord(CDiskBlockPos(pos.nFile + 1, 8), "blk", 0, record));
+
+    pblockfilecache = NULL;
+}
+
+BOOST_AUTO_TEST_CASE(blockfilecache_mmap)
+{
+    CheckCachedReads(true);
+}
+
+BOOST_AUTO_TEST_CASE(blockfilecache_file)
+{
+    CheckCachedReads(false);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
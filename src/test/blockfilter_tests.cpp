@@ -0,0 +1,175 @@
+// Copyright (c) 2018 The Blocknet developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockfilter.h"
+#include "blockfilterindex.h"
+#include "crypto/common.h"
+#include "main.h"
+#include "primitives/block.h"
+#include "script/script.h"
+#include "utilstrencodings.h"
+
+#include <ios>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(blockfilter_tests)
+
+BOOST_AUTO_TEST_CASE(gcsfilter_test)
+{
+    GCSFilter::ElementSet included_elements, excluded_elements;
+    for (int i = 0; i < 100; ++i) {
+        GCSFilter::Element element1(32);
+        element1[0] = i;
+        included_elements.insert(element1);
+
+        GCSFilter::Element element2(32);
+        element2[1] = i;
+        excluded_elements.insert(element2);
+    }
+
+    GCSFilter filter(GCSFilter::Params(0, 0, 10, 1 << 10), included_elements);
+    BOOST_CHECK_EQUAL(filter.GetN(), 100U);
+    for (GCSFilter::ElementSet::const_iterator it = included_elements.begin(); it != included_elements.end(); ++it) {
+        BOOST_CHECK(filter.Match(*it));
+
+        GCSFilter::ElementSet one;
+        one.insert(*it);
+        BOOST_CHECK(filter.MatchAny(one));
+    }
+    BOOST_CHECK(filter.MatchAny(included_elements));
+
+    // the encoding decodes to the same filter
+    GCSFilter decoded(filter.GetParams(), filter.GetEncoded());
+    BOOST_CHECK_EQUAL(decoded.GetN(), 100U);
+    BOOST_CHECK(decoded.MatchAny(included_elements));
+
+    // truncated or padded encodings are rejected
+    std::vector<unsigned char> encoded = filter.GetEncoded();
+    encoded.push_back(0);
+    BOOST_CHECK_THROW(GCSFilter(filter.GetParams(), encoded), std::ios_base::failure);
+    encoded.resize(encoded.size() - 2);
+    BOOST_CHECK_THROW(GCSFilter(filter.GetParams(), encoded), std::ios_base::failure);
+
+    GCSFilter empty;
+    BOOST_CHECK_EQUAL(empty.GetN(), 0U);
+    BOOST_CHECK(!empty.MatchAny(included_elements));
+}
+
+BOOST_AUTO_TEST_CASE(blockfilter_bip158_vector)
+{
+    // testnet3 genesis block, from the BIP 158 test vectors
+    uint256 hashBlock("000000000933ea01ad0ee984209779baaec3ced90fa3f408719526f8d77f4943");
+    std::vector<unsigned char> script = ParseHex("4104678afdb0fe5548271967f1a67130b7105cd6a828e03909a67962e0ea1f61deb649f6bc3f4cef38c4f35504e51ec112de5c384df7ba0b8d578a4c702b6bf11d5fac");
+
+    GCSFilter::ElementSet elements;
+    elements.insert(script);
+    GCSFilter::Params params(ReadLE64(hashBlock.begin()), ReadLE64(hashBlock.begin() + 8), BASIC_FILTER_P, BASIC_FILTER_M);
+    GCSFilter gcs(params, elements);
+    BOOST_CHECK_EQUAL(HexStr(gcs.GetEncoded()), "019dfca8");
+
+    BlockFilter filter(BLOCK_FILTER_BASIC, hashBlock, gcs.GetEncoded());
+    BOOST_CHECK(filter.GetFilter().Match(script));
+    BOOST_CHECK_EQUAL(filter.ComputeHeader(uint256()).GetHex(), "21584579b7eb08997773e5aeff3a7f932700042d0ed2a6129012b7d7ae81b750");
+}
+
+BOOST_AUTO_TEST_CASE(blockfilter_basic_test)
+{
+    CScript included_scripts[5], excluded_scripts[3];
+
+    // First two are outputs on a single transaction.
+    included_scripts[0] << std::vector<unsigned char>(65, 0) << OP_CHECKSIG;
+    included_scripts[1] << OP_DUP << OP_HASH160 << std::vector<unsigned char>(20, 1) << OP_EQUALVERIFY << OP_CHECKSIG;
+
+    // Third is an output on in a second transaction.
+    included_scripts[2] << OP_1 << std::vector<unsigned char>(33, 2) << OP_1 << OP_CHECKMULTISIG;
+
+    // Last two are spent by a single transaction.
+    included_scripts[3] << OP_0 << std::vector<unsigned char>(32, 3);
+    included_scripts[4] << OP_4 << OP_ADD << OP_8 << OP_EQUAL;
+
+    // OP_RETURN output and empty scripts are not included.
+    excluded_scripts[0] << OP_RETURN << std::vector<unsigned char>(40, 4);
+    // This script is not related to the block at all.
+    excluded_scripts[2] << std::vector<unsigned char>(33, 5) << OP_CHECKSIG;
+
+    CMutableTransaction tx_1;
+    tx_1.vout.resize(2);
+    tx_1.vout[0].nValue = 100;
+    tx_1.vout[0].scriptPubKey = included_scripts[0];
+    tx_1.vout[1].nValue = 200;
+    tx_1.vout[1].scriptPubKey = included_scripts[1];
+
+    CMutableTransaction tx_2;
+    tx_2.vin.resize(2);
+    tx_2.vout.resize(3);
+    tx_2.vout[0].nValue = 300;
+    tx_2.vout[0].scriptPubKey = included_scripts[2];
+    tx_2.vout[1].nValue = 0;
+    tx_2.vout[1].scriptPubKey = excluded_scripts[0];
+    tx_2.vout[2].nValue = 400;
+    tx_2.vout[2].scriptPubKey = excluded_scripts[1]; // coinstake style empty output
+
+    CBlock block;
+    block.vtx.push_back(tx_1);
+    block.vtx.push_back(tx_2);
+
+    CBlockUndo block_undo;
+    block_undo.vtxundo.push_back(CTxUndo());
+    block_undo.vtxundo.back().vprevout.push_back(CTxInUndo(CTxOut(500, included_scripts[3])));
+    block_undo.vtxundo.back().vprevout.push_back(CTxInUndo(CTxOut(600, included_scripts[4])));
+
+    BlockFilter block_filter(BLOCK_FILTER_BASIC, block, block_undo);
+    const GCSFilter& filter = block_filter.GetFilter();
+    BOOST_CHECK_EQUAL(filter.GetN(), 5U);
+
+    for (unsigned int i = 0; i < 5; ++i)
+        BOOST_CHECK(filter.Match(GCSFilter::Element(included_scripts[i].begin(), included_scripts[i].end())));
+    for (unsigned int i = 0; i < 3; ++i)
+        BOOST_CHECK(!filter.Match(GCSFilter::Element(excluded_scripts[i].begin(), excluded_scripts[i].end())));
+
+    // Test serialization/unserialization.
+    BlockFilter block_filter2(BLOCK_FILTER_BASIC, block.GetHash(), block_filter.GetEncodedFilter());
+    BOOST_CHECK(block_filter2.GetFilterType() == block_filter.GetFilterType());
+    BOOST_CHECK(block_filter2.GetBlockHash() == block_filter.GetBlockHash());
+    BOOST_CHECK(block_filter2.GetEncodedFilter() == block_filter.GetEncodedFilter());
+    BOOST_CHECK(block_filter2.GetHash() == block_filter.GetHash());
+
+    BlockFilterType filter_type;
+    BOOST_CHECK(BlockFilterTypeByName(BlockFilterTypeName(BLOCK_FILTER_BASIC), filter_type));
+    BOOST_CHECK(filter_type == BLOCK_FILTER_BASIC);
+    BOOST_CHECK(!BlockFilterTypeByName("unknown", filter_type));
+}
+
+BOOST_AUTO_TEST_CASE(blockfilterindex_db)
+{
+    CBlockFilterIndexDB db(1 << 20, true);
+
+    CBlock block;
+    CMutableTransaction tx;
+    tx.vout.resize(1);
+    tx.vout[0].scriptPubKey << OP_TRUE;
+    block.vtx.push_back(tx);
+
+    BlockFilter filter(BLOCK_FILTER_BASIC, block, CBlockUndo());
+    uint256 prevHeader("1");
+    uint256 header = filter.ComputeHeader(prevHeader);
+    BOOST_CHECK(!db.HasFilter(block.GetHash()));
+    BOOST_CHECK(db.WriteFilter(filter, header));
+    BOOST_CHECK(db.HasFilter(block.GetHash()));
+
+    BlockFilter read;
+    uint256 readHash, readHeader, readBest;
+    BOOST_CHECK(db.ReadFilter(block.GetHash(), read));
+    BOOST_CHECK(read.GetEncodedFilter() == filter.GetEncodedFilter());
+    BOOST_CHECK(db.ReadFilterHash(block.GetHash(), readHash));
+    BOOST_CHECK(readHash == filter.GetHash());
+    BOOST_CHECK(db.ReadFilterHeader(block.GetHash(), readHeader));
+    BOOST_CHECK(readHeader == header);
+    BOOST_CHECK(db.ReadBestBlock(readBest));
+    BOOST_CHECK(readBest == block.GetHash());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
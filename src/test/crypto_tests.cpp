@@ -131,6 +131,66 @@ BOOST_AUTO_TEST_CASE(sha256_testvectors) {
     TestSHA256(test1, "a316d55510b49662420f49d145d42fb83f31ef8dc016aa4e32df049991a91e26");
 }
 
+/** Every optimized implementation on its own, then the ones init picks together */
+static const sha256_implementation::UseImplementation vSHA256Implementations[] = {
+    sha256_implementation::USE_SSE4,
+    sha256_implementation::USE_AVX2,
+    sha256_implementation::USE_SHANI,
+    sha256_implementation::USE_ALL,
+};
+
+BOOST_AUTO_TEST_CASE(sha256d64)
+{
+    // the portable transform against the streaming double hash, then each
+    // implementation the CPU supports against the portable one
+    unsigned char in[64 * 32];
+    unsigned char expected[32 * 32], out[32 * 32];
+    for (size_t j = 0; j < sizeof(in); ++j)
+        in[j] = insecure_rand();
+
+    SHA256AutoDetect(sha256_implementation::STANDARD);
+    for (int j = 0; j < 32; ++j) {
+        unsigned char tmp[32];
+        CSHA256().Write(in + 64 * j, 64).Finalize(tmp);
+        CSHA256().Write(tmp, 32).Finalize(out + 32 * j);
+    }
+    SHA256D64(expected, in, 32);
+    BOOST_CHECK(memcmp(expected, out, sizeof(out)) == 0);
+
+    for (sha256_implementation::UseImplementation use : vSHA256Implementations) {
+        const std::string name = SHA256AutoDetect(use);
+        // every count, so the 8, 4 and 2-way transforms and the tail all run
+        for (int i = 0; i <= 32; ++i) {
+            memset(out, 0, sizeof(out));
+            SHA256D64(out, in, i);
+            BOOST_CHECK_MESSAGE(memcmp(out, expected, 32 * i) == 0, name << " blocks " << i);
+        }
+    }
+    SHA256AutoDetect();
+}
+
+BOOST_AUTO_TEST_CASE(sha256_multiblock)
+{
+    // a single Write of many blocks takes the multi-block transform
+    std::vector<unsigned char> in(64 * 17 + 13);
+    for (size_t i = 0; i < in.size(); ++i)
+        in[i] = insecure_rand();
+
+    unsigned char expected[32], out[32];
+    SHA256AutoDetect(sha256_implementation::STANDARD);
+    CSHA256 hasher;
+    for (size_t i = 0; i < in.size(); ++i)
+        hasher.Write(&in[i], 1);
+    hasher.Finalize(expected);
+
+    for (sha256_implementation::UseImplementation use : vSHA256Implementations) {
+        const std::string name = SHA256AutoDetect(use);
+        CSHA256().Write(&in[0], in.size()).Finalize(out);
+        BOOST_CHECK_MESSAGE(memcmp(out, expected, 32) == 0, name);
+    }
+    SHA256AutoDetect();
+}
+
 BOOST_AUTO_TEST_CASE(sha512_testvectors) {
     TestSHA512("",
                "cf83e1357eefb8bdf1542850d66d8007d620e4050b5715dc83f4a921d36ce9ce"
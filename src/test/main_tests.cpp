@@ -6,8 +6,15 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "primitives/transaction.h"
+#include "chainparams.h"
+#include "checkpoints.h"
+#include "clientversion.h"
 #include "main.h"
+#include "random.h"
+#include "streams.h"
+#include "util.h"
 
+#include <boost/filesystem.hpp>
 #include <boost/test/unit_test.hpp>
 
 BOOST_AUTO_TEST_SUITE(main_tests)
@@ -51,4 +58,79 @@ BOOST_AUTO_TEST_CASE(subsidy_limit_test)
 }
 #endif /* FIXME(unit test) */
 
+/** A coinbase only block on top of hashPrev at the given height, not yet known to the node */
+static CBlock ChildBlock(const uint256& hashPrev, int nHeight, int64_t nTime)
+{
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].scriptSig = CScript() << nHeight << std::vector<unsigned char>(1, 0x4c);
+    tx.vout.resize(1);
+    tx.vout[0].nValue = 0;
+    tx.vout[0].scriptPubKey = CScript() << OP_TRUE;
+
+    CBlock block;
+    block.hashPrevBlock = hashPrev;
+    block.nTime = nTime;
+    block.nBits = Params().ProofOfWorkLimit().GetCompact();
+    block.vtx.push_back(CTransaction(tx));
+    block.hashMerkleRoot = block.BuildMerkleTree();
+    return block;
+}
+
+static bool HaveBlockData(const uint256& hash)
+{
+    LOCK(cs_main);
+    BlockMap::iterator mi = mapBlockIndex.find(hash);
+    return mi != mapBlockIndex.end() && (mi->second->nStatus & BLOCK_HAVE_DATA);
+}
+
+BOOST_AUTO_TEST_CASE(LoadExternalBlockFile_corrupt_record)
+{
+    Checkpoints::fEnabled = false;
+    ModifiableParams()->setSkipProofOfWorkCheck(true);
+    boost::filesystem::path path = GetTempPath() / strprintf("test_loadblock_%s.dat", GetRandHash().ToString());
+
+    std::vector<CBlock> vBlocks;
+    uint256 hashPrev = Params().HashGenesisBlock();
+    int64_t nTime = Params().GenesisBlock().GetBlockTime();
+    for (int i = 1; i <= 4; i++) {
+        vBlocks.push_back(ChildBlock(hashPrev, i, nTime + 60 * i));
+        hashPrev = vBlocks.back().GetHash();
+    }
+
+    // Two blocks, a record whose header and size are fine but whose data is
+    // not a block, then the last two blocks. The whole file is read before
+    // the record fails to deserialize, so the reader is at its end by then.
+    {
+        CAutoFile fileout(fopen(path.string().c_str(), "wb"), SER_DISK, CLIENT_VERSION);
+        for (unsigned int i = 0; i < vBlocks.size(); i++) {
+            if (i == 2) {
+                unsigned int nSize = 80;
+                fileout << FLATDATA(Params().MessageStart()) << nSize;
+                std::vector<char> vGarbage(nSize, 0);
+                fileout.write(&vGarbage[0], vGarbage.size());
+            }
+            unsigned int nSize = fileout.GetSerializeSize(vBlocks[i]);
+            fileout << FLATDATA(Params().MessageStart()) << nSize << vBlocks[i];
+        }
+    }
+
+    BOOST_CHECK(LoadExternalBlockFile(fopen(path.string().c_str(), "rb")));
+    for (unsigned int i = 0; i < vBlocks.size(); i++)
+        BOOST_CHECK(HaveBlockData(vBlocks[i].GetHash()));
+
+    // leave the active chain to the other tests as it was
+    {
+        LOCK(cs_main);
+        CValidationState state;
+        BlockMap::iterator mi = mapBlockIndex.find(vBlocks[0].GetHash());
+        if (mi != mapBlockIndex.end())
+            BOOST_CHECK(InvalidateBlock(state, mi->second));
+    }
+
+    boost::filesystem::remove(path);
+    ModifiableParams()->setSkipProofOfWorkCheck(false);
+    Checkpoints::fEnabled = true;
+}
+
 BOOST_AUTO_TEST_SUITE_END()
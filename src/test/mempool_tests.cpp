@@ -2,7 +2,13 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include "coins.h"
+#include "key.h"
+#include "keystore.h"
 #include "main.h"
+#include "random.h"
+#include "script/sign.h"
+#include "script/standard.h"
 #include "txmempool.h"
 #include "util.h"
 
@@ -99,4 +105,173 @@ BOOST_AUTO_TEST_CASE(MempoolRemoveTest)
     removed.clear();
 }
 
+/** Coins paying to a key, put straight into pcoinsTip for the batch tests to spend */
+struct MempoolBatchSetup {
+    CBasicKeyStore keystore;
+    CKey key;
+    CScript scriptPubKey;
+    uint256 hashFunding;
+
+    MempoolBatchSetup()
+    {
+        key.MakeNewKey(true);
+        keystore.AddKey(key);
+        scriptPubKey = GetScriptForDestination(key.GetPubKey().GetID());
+
+        LOCK(cs_main);
+        hashFunding = GetRandHash();
+        CCoinsModifier coins = pcoinsTip->ModifyCoins(hashFunding);
+        coins->fCoinBase = false;
+        coins->nVersion = 1;
+        coins->nHeight = chainActive.Height();
+        coins->vout.assign(8, CTxOut(10 * COIN, scriptPubKey));
+    }
+
+    ~MempoolBatchSetup()
+    {
+        LOCK(cs_main);
+        pcoinsTip->ModifyCoins(hashFunding)->Clear();
+    }
+
+    /** A transaction spending prevout to the key, signed with signer */
+    CTransaction Spend(const COutPoint& prevout, CAmount nValue, const CKeyStore& signer)
+    {
+        CMutableTransaction tx;
+        tx.vin.push_back(CTxIn(prevout));
+        tx.vout.push_back(CTxOut(nValue, scriptPubKey));
+        SignSignature(signer, scriptPubKey, tx, 0);
+        return tx;
+    }
+
+    CTransaction Spend(const COutPoint& prevout, CAmount nValue) { return Spend(prevout, nValue, keystore); }
+};
+
+BOOST_FIXTURE_TEST_CASE(MempoolBatchChainOutOfOrder, MempoolBatchSetup)
+{
+    // A spends the chain, B spends A and C spends B, but they come in backwards
+    CTransaction txA = Spend(COutPoint(hashFunding, 0), 9 * COIN);
+    CTransaction txB = Spend(COutPoint(txA.GetHash(), 0), 8 * COIN);
+    CTransaction txC = Spend(COutPoint(txB.GetHash(), 0), 7 * COIN);
+    std::vector<CTransaction> vtx;
+    vtx.push_back(txC);
+    vtx.push_back(txB);
+    vtx.push_back(txA);
+
+    CTxMemPool testPool(CFeeRate(0));
+    std::vector<CValidationState> vState;
+    std::vector<bool> vAccepted, vMissingInputs;
+    {
+        LOCK(cs_main);
+        AcceptToMemoryPoolBatch(testPool, vtx, false, vState, vAccepted, vMissingInputs);
+    }
+
+    BOOST_CHECK_EQUAL(vState.size(), vtx.size());
+    for (unsigned int i = 0; i < vtx.size(); i++) {
+        BOOST_CHECK(vAccepted[i]);
+        BOOST_CHECK(!vMissingInputs[i]);
+        BOOST_CHECK(vState[i].IsValid());
+        BOOST_CHECK(testPool.exists(vtx[i].GetHash()));
+    }
+    BOOST_CHECK_EQUAL(testPool.size(), 3U);
+}
+
+BOOST_FIXTURE_TEST_CASE(MempoolBatchDoubleSpend, MempoolBatchSetup)
+{
+    // both spend the same coin, only the first one in the batch gets in
+    std::vector<CTransaction> vtx;
+    vtx.push_back(Spend(COutPoint(hashFunding, 1), 9 * COIN));
+    vtx.push_back(Spend(COutPoint(hashFunding, 1), 8 * COIN));
+
+    CTxMemPool testPool(CFeeRate(0));
+    std::vector<CValidationState> vState;
+    std::vector<bool> vAccepted, vMissingInputs;
+    {
+        LOCK(cs_main);
+        AcceptToMemoryPoolBatch(testPool, vtx, false, vState, vAccepted, vMissingInputs);
+    }
+
+    BOOST_CHECK(vAccepted[0]);
+    BOOST_CHECK(!vAccepted[1]);
+    BOOST_CHECK(!vMissingInputs[0]);
+    BOOST_CHECK(!vMissingInputs[1]);
+    BOOST_CHECK(testPool.exists(vtx[0].GetHash()));
+    BOOST_CHECK(!testPool.exists(vtx[1].GetHash()));
+    BOOST_CHECK_EQUAL(testPool.size(), 1U);
+}
+
+BOOST_FIXTURE_TEST_CASE(MempoolBatchInvalidScript, MempoolBatchSetup)
+{
+    // the middle one is signed with another key, so the scripts verified
+    // together fail and each transaction is checked on its own
+    CBasicKeyStore keystoreOther;
+    CKey keyOther;
+    keyOther.MakeNewKey(true);
+    keystoreOther.AddKey(keyOther);
+
+    std::vector<CTransaction> vtx;
+    vtx.push_back(Spend(COutPoint(hashFunding, 2), 9 * COIN));
+    vtx.push_back(Spend(COutPoint(hashFunding, 3), 9 * COIN, keystoreOther));
+    vtx.push_back(Spend(COutPoint(hashFunding, 4), 9 * COIN));
+
+    CTxMemPool testPool(CFeeRate(0));
+    std::vector<CValidationState> vState;
+    std::vector<bool> vAccepted, vMissingInputs;
+    {
+        LOCK(cs_main);
+        BOOST_CHECK(nScriptCheckThreads > 0);
+        AcceptToMemoryPoolBatch(testPool, vtx, false, vState, vAccepted, vMissingInputs);
+    }
+
+    BOOST_CHECK(vAccepted[0]);
+    BOOST_CHECK(!vAccepted[1]);
+    BOOST_CHECK(vAccepted[2]);
+    BOOST_CHECK(vState[0].IsValid());
+    BOOST_CHECK(vState[2].IsValid());
+    int nDoS = 0;
+    BOOST_CHECK(vState[1].IsInvalid(nDoS));
+    BOOST_CHECK(nDoS > 0);
+    BOOST_CHECK_EQUAL(vState[1].GetRejectCode(), REJECT_INVALID);
+    BOOST_CHECK(!vMissingInputs[1]);
+    BOOST_CHECK(!testPool.exists(vtx[1].GetHash()));
+    BOOST_CHECK_EQUAL(testPool.size(), 2U);
+}
+
+BOOST_FIXTURE_TEST_CASE(MempoolBatchMissingInputs, MempoolBatchSetup)
+{
+    // the parent of the first one is unknown, the second one spends the first
+    // and the third one only the chain
+    CTransaction txOrphan = Spend(COutPoint(GetRandHash(), 0), 9 * COIN);
+    std::vector<CTransaction> vtx;
+    vtx.push_back(txOrphan);
+    vtx.push_back(Spend(COutPoint(txOrphan.GetHash(), 0), 8 * COIN));
+    vtx.push_back(Spend(COutPoint(hashFunding, 5), 9 * COIN));
+
+    CTxMemPool testPool(CFeeRate(0));
+    std::vector<CValidationState> vState;
+    std::vector<bool> vAccepted, vMissingInputs;
+    {
+        LOCK(cs_main);
+        AcceptToMemoryPoolBatch(testPool, vtx, false, vState, vAccepted, vMissingInputs);
+    }
+
+    BOOST_CHECK(!vAccepted[0]);
+    BOOST_CHECK(!vAccepted[1]);
+    BOOST_CHECK(vAccepted[2]);
+    BOOST_CHECK(vMissingInputs[0]);
+    BOOST_CHECK(vMissingInputs[1]);
+    BOOST_CHECK(!vMissingInputs[2]);
+    BOOST_CHECK(vState[0].IsValid());
+    BOOST_CHECK(vState[1].IsValid());
+    BOOST_CHECK_EQUAL(testPool.size(), 1U);
+
+    // a spent coin is not missing, the spend is rejected
+    vtx.assign(1, Spend(COutPoint(hashFunding, 5), 8 * COIN));
+    {
+        LOCK(cs_main);
+        AcceptToMemoryPoolBatch(testPool, vtx, false, vState, vAccepted, vMissingInputs);
+    }
+    BOOST_CHECK(!vAccepted[0]);
+    BOOST_CHECK(!vMissingInputs[0]);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
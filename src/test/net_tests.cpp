@@ -0,0 +1,87 @@
+// Copyright (c) 2018 The Blocknet developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "net.h"
+#include "version.h"
+
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(net_tests)
+
+BOOST_AUTO_TEST_CASE(netbufferpool_reuse)
+{
+    CNetBufferPool pool;
+    BOOST_CHECK_EQUAL(pool.GetPooledCount(), 0U);
+
+    CSerializeData data;
+    pool.Get(data, 100);
+    BOOST_CHECK(data.empty());
+    BOOST_CHECK(data.capacity() >= 100);
+    data.resize(100, 'x');
+    const char* pbuf = &data[0];
+
+    pool.Put(data);
+    BOOST_CHECK(data.empty());
+    BOOST_CHECK_EQUAL(pool.GetPooledCount(), 1U);
+
+    // a message of the same size class gets the same allocation back
+    CSerializeData reused;
+    pool.Get(reused, 200);
+    BOOST_CHECK(reused.empty());
+    BOOST_CHECK(reused.capacity() >= 200);
+    reused.resize(1);
+    BOOST_CHECK(&reused[0] == pbuf);
+    BOOST_CHECK_EQUAL(pool.GetPooledCount(), 0U);
+
+    // a larger one does not
+    CSerializeData large;
+    pool.Get(large, 100000);
+    BOOST_CHECK(large.capacity() >= 100000);
+    pool.Put(reused);
+    pool.Put(large);
+    BOOST_CHECK_EQUAL(pool.GetPooledCount(), 2U);
+
+    // buffers that fit no class are not kept
+    CSerializeData huge;
+    pool.Get(huge, MAX_PROTOCOL_MESSAGE_LENGTH * 4);
+    pool.Put(huge);
+    BOOST_CHECK(huge.capacity() == 0);
+    BOOST_CHECK_EQUAL(pool.GetPooledCount(), 2U);
+}
+
+BOOST_AUTO_TEST_CASE(netmessage_readdata)
+{
+    CDataStream ssMsg(SER_NETWORK, PROTOCOL_VERSION);
+    std::vector<unsigned char> payload(600 * 1024);
+    for (unsigned int i = 0; i < payload.size(); i++)
+        payload[i] = i % 251;
+    CMessageHeader hdr("block", payload.size());
+    ssMsg << hdr;
+    ssMsg.write((const char*)&payload[0], payload.size());
+
+    // feed the message in socket sized chunks, growing the buffer a few times
+    CNetMessage msg(SER_NETWORK, PROTOCOL_VERSION);
+    const char* pch = &ssMsg[0];
+    unsigned int nBytes = ssMsg.size();
+    while (nBytes > 0) {
+        unsigned int nChunk = std::min(nBytes, 0x10000U);
+        while (nChunk > 0) {
+            int handled = msg.in_data ? msg.readData(pch, nChunk) : msg.readHeader(pch, nChunk);
+            BOOST_REQUIRE(handled >= 0);
+            pch += handled;
+            nBytes -= handled;
+            nChunk -= handled;
+        }
+    }
+    BOOST_CHECK(msg.complete());
+    BOOST_CHECK_EQUAL(msg.vRecv.size(), payload.size());
+    BOOST_CHECK(std::equal(payload.begin(), payload.end(), (const unsigned char*)&msg.vRecv[0]));
+
+    msg.ReleaseBuffer();
+    BOOST_CHECK(msg.vRecv.empty());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,186 @@
+// Copyright (c) 2018 The Blocknet developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "packetverifier.h"
+#include "random.h"
+#include "utiltime.h"
+
+#include <atomic>
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(packetverifier_tests)
+
+BOOST_AUTO_TEST_CASE(packetverifier_cache)
+{
+    CPacketSignatureCache cache;
+    cache.SetMaxSize(4);
+
+    std::vector<uint256> vKeys;
+    for (int i = 0; i < 10; i++) {
+        const unsigned char sig[2] = {static_cast<unsigned char>(i), 0};
+        const unsigned char pubkey[1] = {1};
+        vKeys.push_back(CPacketSignatureCache::Key(uint256(i).begin(), sig, sizeof(sig), pubkey, sizeof(pubkey)));
+        cache.Set(vKeys.back());
+        BOOST_CHECK(cache.Get(vKeys.back()));
+    }
+
+    // the signature is part of the key
+    BOOST_CHECK(vKeys[0] != vKeys[1]);
+
+    int nCached = 0;
+    for (const uint256& key : vKeys)
+        nCached += cache.Get(key);
+    BOOST_CHECK_EQUAL(nCached, 4);
+
+    // a size of 0 disables the cache
+    cache.SetMaxSize(0);
+    BOOST_CHECK(!cache.Get(vKeys.back()));
+    cache.Set(vKeys.back());
+    BOOST_CHECK(!cache.Get(vKeys.back()));
+}
+
+BOOST_AUTO_TEST_CASE(packetverifier_batches)
+{
+    static const int nJobs = 1000;
+    CPacketVerifier verifier;
+    CPacketVerifyQueue results;
+
+    // checks run on the calling thread until the verifier is started, the
+    // continuation only once the queue is run
+    boost::thread::id idCaller = boost::this_thread::get_id();
+    bool fInline = false;
+    verifier.Post(results, [&]() { return boost::this_thread::get_id() == idCaller; },
+                  [&](bool fValid) { fInline = fValid; });
+    BOOST_CHECK(!fInline);
+    BOOST_CHECK_EQUAL(results.RunVerified(), 1U);
+    BOOST_CHECK(fInline);
+
+    std::atomic<int> nBatches(0);
+    boost::thread_group threads;
+    verifier.Start(4, [&]() { nBatches++; });
+    for (int i = 0; i < 4; i++)
+        threads.create_thread(boost::bind(&CPacketVerifier::Thread, &verifier));
+
+    std::atomic<int> nOffThread(0);
+    std::vector<int> vDone;
+    int nValid = 0, nOnCaller = 0;
+    for (int i = 0; i < nJobs; i++) {
+        verifier.Post(results,
+                      [i, idCaller, &nOffThread]() {
+                          if (boost::this_thread::get_id() != idCaller)
+                              nOffThread++;
+                          if (i == 7)
+                              throw std::runtime_error("check failed");
+                          return i % 2 == 0;
+                      },
+                      [&, i](bool fValid) {
+                          nValid += fValid;
+                          nOnCaller += boost::this_thread::get_id() == idCaller;
+                          vDone.push_back(i);
+                      });
+    }
+
+    for (int i = 0; i < 1000 && results.GetPending() > 0; i++) {
+        results.RunVerified();
+        MilliSleep(10);
+    }
+    BOOST_CHECK_EQUAL(results.GetPending(), 0U);
+    BOOST_CHECK_EQUAL(verifier.GetPending(), 0U);
+    BOOST_CHECK_EQUAL(nOffThread.load(), nJobs);
+    BOOST_CHECK(nBatches.load() > 0);
+
+    // the continuations ran on the thread running the queue, in the order posted
+    BOOST_REQUIRE_EQUAL(vDone.size(), (size_t)nJobs);
+    for (int i = 0; i < (int)vDone.size(); i++)
+        BOOST_CHECK_EQUAL(vDone[i], i);
+    BOOST_CHECK_EQUAL(nOnCaller, nJobs);
+    BOOST_CHECK_EQUAL(nValid, nJobs / 2);
+
+    // stopped, checks run on the calling thread again
+    verifier.Stop();
+    fInline = false;
+    verifier.Post(results, [&]() { return boost::this_thread::get_id() == idCaller; },
+                  [&](bool fValid) { fInline = fValid; });
+    BOOST_CHECK_EQUAL(results.RunVerified(), 1U);
+    BOOST_CHECK(fInline);
+
+    threads.interrupt_all();
+    threads.join_all();
+}
+
+BOOST_AUTO_TEST_CASE(packetverifier_in_order)
+{
+    CPacketVerifier verifier;
+    CPacketVerifyQueue results;
+    boost::thread_group threads;
+    verifier.Start(2, std::function<void()>());
+    for (int i = 0; i < 2; i++)
+        threads.create_thread(boost::bind(&CPacketVerifier::Thread, &verifier));
+
+    // the first packet is still being verified when the second one is done
+    std::atomic<bool> fFirstStarted(false), fRelease(false), fSecondDone(false);
+    std::vector<int> vDone;
+    verifier.Post(results,
+                  [&]() {
+                      fFirstStarted = true;
+                      while (!fRelease)
+                          MilliSleep(1);
+                      return true;
+                  },
+                  [&](bool fValid) { vDone.push_back(fValid ? 1 : -1); });
+    for (int i = 0; i < 1000 && !fFirstStarted; i++)
+        MilliSleep(1);
+    verifier.Post(results,
+                  [&]() {
+                      fSecondDone = true;
+                      return false;
+                  },
+                  [&](bool fValid) { vDone.push_back(fValid ? 2 : -2); });
+    for (int i = 0; i < 1000 && !fSecondDone; i++)
+        MilliSleep(1);
+    BOOST_CHECK(fSecondDone);
+
+    // the second one waits for the first
+    BOOST_CHECK_EQUAL(results.RunVerified(), 0U);
+    BOOST_CHECK(vDone.empty());
+
+    fRelease = true;
+    for (int i = 0; i < 1000 && results.GetPending() > 0; i++) {
+        results.RunVerified();
+        MilliSleep(1);
+    }
+    BOOST_REQUIRE_EQUAL(vDone.size(), 2U);
+    BOOST_CHECK_EQUAL(vDone[0], 1);
+    BOOST_CHECK_EQUAL(vDone[1], -2);
+
+    verifier.Stop();
+    threads.interrupt_all();
+    threads.join_all();
+}
+
+BOOST_AUTO_TEST_CASE(packetverifier_stop_drains)
+{
+    CPacketVerifier verifier;
+    CPacketVerifyQueue results;
+    verifier.Start(1, std::function<void()>());
+
+    // no threads are running, Stop() verifies what is still queued
+    int nDone = 0;
+    for (int i = 0; i < 10; i++)
+        verifier.Post(results, []() { return true; }, [&](bool fValid) { nDone += fValid; });
+    BOOST_CHECK_EQUAL(verifier.GetPending(), 10U);
+    BOOST_CHECK_EQUAL(results.RunVerified(), 0U);
+
+    verifier.Stop();
+    BOOST_CHECK_EQUAL(verifier.GetPending(), 0U);
+    BOOST_CHECK_EQUAL(nDone, 0);
+    BOOST_CHECK_EQUAL(results.RunVerified(), 10U);
+    BOOST_CHECK_EQUAL(nDone, 10);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
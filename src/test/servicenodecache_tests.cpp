@@ -0,0 +1,63 @@
+// Copyright (c) 2018 The Blocknet developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "servicenodecache.h"
+
+#include <map>
+#include <string>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(servicenodecache_tests)
+
+BOOST_AUTO_TEST_CASE(servicenodecache_tables)
+{
+    CServicenodeCacheDB db(1 << 20, true);
+
+    std::map<int, std::string> mapObjects;
+    mapObjects[1] = "one";
+    mapObjects[2] = "two";
+    mapObjects[3] = "three";
+    db.StageTable(SNCACHE_BLOCK_PAYEES, mapObjects);
+    db.StageObject(SNCACHE_DSQ_COUNT, 0, (int64_t)7);
+    db.StageTableEnd(SNCACHE_DSQ_COUNT);
+    BOOST_CHECK(db.Commit());
+
+    // a changed, a removed and an unchanged object
+    mapObjects[2] = "deux";
+    mapObjects.erase(3);
+    db.StageTable(SNCACHE_BLOCK_PAYEES, mapObjects);
+    BOOST_CHECK(db.Commit());
+
+    std::map<int, std::string> mapRead;
+    BOOST_CHECK(db.ReadTable(SNCACHE_BLOCK_PAYEES, mapRead));
+    BOOST_CHECK(mapRead == mapObjects);
+
+    // tables do not bleed into each other
+    std::map<int, int64_t> mapDsq;
+    BOOST_CHECK(db.ReadTable(SNCACHE_DSQ_COUNT, mapDsq));
+    BOOST_CHECK_EQUAL(mapDsq.size(), 1U);
+    BOOST_CHECK_EQUAL(mapDsq[0], 7);
+
+    BOOST_CHECK(db.WipeTable(SNCACHE_BLOCK_PAYEES));
+    mapRead.clear();
+    BOOST_CHECK(db.ReadTable(SNCACHE_BLOCK_PAYEES, mapRead));
+    BOOST_CHECK(mapRead.empty());
+}
+
+BOOST_AUTO_TEST_CASE(servicenodecache_marker)
+{
+    CServicenodeCacheDB db(1 << 20, true);
+
+    bool fWrongNetwork = true;
+    BOOST_CHECK(!db.HasMarker("mncache", fWrongNetwork));
+    BOOST_CHECK(!fWrongNetwork);
+
+    db.StageMarker("mncache");
+    BOOST_CHECK(db.Commit());
+    BOOST_CHECK(db.HasMarker("mncache", fWrongNetwork));
+    BOOST_CHECK(!db.HasMarker("budget", fWrongNetwork));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
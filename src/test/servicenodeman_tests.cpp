@@ -0,0 +1,293 @@
+// Copyright (c) 2018 The Blocknet developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "arith_uint256.h"
+#include "chainparams.h"
+#include "checkpoints.h"
+#include "clientversion.h"
+#include "key.h"
+#include "main.h"
+#include "servicenodeman.h"
+#include "timedata.h"
+#include "util.h"
+#include "utiltime.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <boost/foreach.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/test/unit_test.hpp>
+
+/** A servicenode that passes Check without looking up its collateral */
+static CServicenode TestServicenode(unsigned int n, const CPubKey& pubKeyCollateral, const CPubKey& pubKeyServicenode, const std::string& strAddr)
+{
+    CServicenode mn;
+    mn.vin = CTxIn(COutPoint(ArithToUint256(arith_uint256(n + 1)), n % 2));
+    mn.addr = CService(strAddr);
+    mn.pubKeyCollateralAddress = pubKeyCollateral;
+    mn.pubKeyServicenode = pubKeyServicenode;
+    mn.unitTest = true;
+    mn.lastPing.vin = mn.vin;
+    mn.lastPing.sigTime = GetAdjustedTime();
+    return mn;
+}
+
+BOOST_AUTO_TEST_SUITE(servicenodeman_tests)
+
+BOOST_AUTO_TEST_CASE(servicenodeman_indexes)
+{
+    std::vector<CPubKey> vPubKeys;
+    for (int i = 0; i < 4; i++) {
+        CKey key;
+        key.MakeNewKey(true);
+        vPubKeys.push_back(key.GetPubKey());
+    }
+
+    // some servicenodes share a payee, a key or an address, the indexes hold them all
+    std::vector<CServicenode> vServicenodes;
+    vServicenodes.push_back(TestServicenode(0, vPubKeys[0], vPubKeys[1], "10.0.0.1:41412"));
+    vServicenodes.push_back(TestServicenode(1, vPubKeys[0], vPubKeys[2], "10.0.0.2:41412"));
+    vServicenodes.push_back(TestServicenode(2, vPubKeys[1], vPubKeys[2], "10.0.0.2:41412"));
+    vServicenodes.push_back(TestServicenode(3, vPubKeys[2], vPubKeys[3], "10.0.0.3:41412"));
+    vServicenodes.push_back(TestServicenode(4, vPubKeys[3], vPubKeys[3], "10.0.0.4:41412"));
+    vServicenodes.push_back(TestServicenode(5, vPubKeys[3], vPubKeys[0], "10.0.0.5:41412"));
+
+    CServicenodeMan man;
+    BOOST_FOREACH (CServicenode& mn, vServicenodes) {
+        BOOST_CHECK(man.Add(mn));
+        BOOST_CHECK(man.CheckIndexes());
+    }
+    BOOST_CHECK_EQUAL(man.size(), 6);
+
+    // a listed vin or a disabled servicenode is not added
+    CServicenode mnDuplicate = TestServicenode(0, vPubKeys[3], vPubKeys[3], "10.0.0.9:41412");
+    BOOST_CHECK(!man.Add(mnDuplicate));
+    CServicenode mnDisabled = TestServicenode(6, vPubKeys[3], vPubKeys[3], "10.0.0.9:41412");
+    mnDisabled.activeState = CServicenode::SERVICENODE_EXPIRED;
+    BOOST_CHECK(!man.Add(mnDisabled));
+    BOOST_CHECK(man.CheckIndexes());
+    BOOST_CHECK_EQUAL(man.size(), 6);
+    BOOST_CHECK(man.Find(std::string("10.0.0.9:41412")) == NULL);
+
+    // removing one of two servicenodes at an address leaves the other findable there
+    man.Remove(vServicenodes[1].vin);
+    BOOST_CHECK(man.CheckIndexes());
+    BOOST_CHECK_EQUAL(man.size(), 5);
+    BOOST_CHECK(man.Find(vServicenodes[1].vin) == NULL);
+    BOOST_REQUIRE(man.Find(std::string("10.0.0.2:41412")) != NULL);
+    BOOST_CHECK(man.Find(std::string("10.0.0.2:41412"))->vin == vServicenodes[2].vin);
+    BOOST_REQUIRE(man.Find(vPubKeys[2]) != NULL);
+    BOOST_CHECK(man.Find(vPubKeys[2])->vin == vServicenodes[2].vin);
+
+    man.Remove(CTxIn(COutPoint(ArithToUint256(arith_uint256(100)), 0)));
+    BOOST_CHECK(man.CheckIndexes());
+    BOOST_CHECK_EQUAL(man.size(), 5);
+
+    // a newer broadcast moves a servicenode to other keys and another address
+    CServicenode* pmn = man.Find(vServicenodes[3].vin);
+    BOOST_REQUIRE(pmn != NULL);
+    CServicenodeBroadcast mnb(*pmn);
+    mnb.sigTime = pmn->sigTime + 1;
+    mnb.pubKeyCollateralAddress = vPubKeys[0];
+    mnb.pubKeyServicenode = vPubKeys[1];
+    mnb.addr = CService("10.0.0.6:41412");
+    mnb.lastPing = CServicenodePing();
+    BOOST_CHECK(man.UpdateFromNewBroadcast(*pmn, mnb));
+    BOOST_CHECK(man.CheckIndexes());
+    BOOST_CHECK(man.Find(std::string("10.0.0.3:41412")) == NULL);
+    BOOST_CHECK(man.Find(std::string("10.0.0.6:41412")) == pmn);
+
+    // an older broadcast, or one applied to a copy, leaves the indexes alone
+    mnb.addr = CService("10.0.0.7:41412");
+    BOOST_CHECK(!man.UpdateFromNewBroadcast(*pmn, mnb));
+    BOOST_CHECK(man.CheckIndexes());
+    CServicenode mnCopy(*man.Find(vServicenodes[4].vin));
+    mnb.sigTime = mnCopy.sigTime + 1;
+    BOOST_CHECK(man.UpdateFromNewBroadcast(mnCopy, mnb));
+    BOOST_CHECK(man.CheckIndexes());
+    BOOST_CHECK(man.Find(std::string("10.0.0.7:41412")) == NULL);
+
+    // the servicenode left without a ping and a spent one are removed
+    BOOST_REQUIRE(man.Find(vServicenodes[5].vin) != NULL);
+    man.Find(vServicenodes[5].vin)->activeState = CServicenode::SERVICENODE_VIN_SPENT;
+    man.CheckAndRemove();
+    BOOST_CHECK(man.CheckIndexes());
+    BOOST_CHECK_EQUAL(man.size(), 3);
+    BOOST_CHECK(man.Find(vServicenodes[3].vin) == NULL);
+    BOOST_CHECK(man.Find(vServicenodes[5].vin) == NULL);
+    BOOST_CHECK(man.Find(std::string("10.0.0.6:41412")) == NULL);
+    BOOST_CHECK(man.Find(vPubKeys[0]) == NULL);
+
+    // and a reloaded list is indexed again
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << man;
+    CServicenodeMan manLoaded;
+    ss >> manLoaded;
+    BOOST_CHECK(manLoaded.CheckIndexes());
+    BOOST_CHECK_EQUAL(manLoaded.size(), 3);
+
+    man.Clear();
+    BOOST_CHECK(man.CheckIndexes());
+    BOOST_CHECK_EQUAL(man.size(), 0);
+}
+
+/** Connect a coinbase only block on top of pindexPrev, tagged so branches from the same parent differ */
+static CBlockIndex* ConnectChild(const CBlockIndex* pindexPrev, unsigned char nTag)
+{
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].scriptSig = CScript() << (pindexPrev->nHeight + 1) << std::vector<unsigned char>(1, nTag);
+    tx.vout.resize(1);
+    tx.vout[0].nValue = 0;
+    tx.vout[0].scriptPubKey = CScript() << OP_TRUE;
+
+    boost::shared_ptr<CBlock> pblock(new CBlock());
+    pblock->hashPrevBlock = pindexPrev->GetBlockHash();
+    pblock->nTime = pindexPrev->GetBlockTime() + 60;
+    pblock->nBits = Params().ProofOfWorkLimit().GetCompact();
+    pblock->vtx.push_back(CTransaction(tx));
+    pblock->hashMerkleRoot = pblock->BuildMerkleTree();
+
+    CValidationState state;
+    BOOST_CHECK(ProcessNewBlock(state, NULL, pblock));
+    LOCK(cs_main);
+    BlockMap::iterator mi = mapBlockIndex.find(pblock->GetHash());
+    BOOST_REQUIRE(mi != mapBlockIndex.end());
+    return mi->second;
+}
+
+/** The servicenodes ranked from scratch for a block, disabled ones at the bottom when fListed */
+static std::vector<CTxIn> RankedFresh(CServicenodeMan& man, int64_t nBlockHeight, bool fListed)
+{
+    uint256 hash;
+    {
+        LOCK(cs_main);
+        hash = chainActive[nBlockHeight - 1]->GetBlockHash();
+    }
+
+    std::vector<CServicenode> vServicenodes = man.GetCurrentList();
+    std::vector<std::pair<int64_t, CTxIn> > vecScores;
+    BOOST_FOREACH (CServicenode& mn, vServicenodes) {
+        if (fListed && !mn.IsEnabled())
+            vecScores.push_back(std::make_pair(9999, mn.vin));
+        else
+            vecScores.push_back(std::make_pair(CServicenode::CalculateScore(mn.vin.prevout, hash).GetCompact(false), mn.vin));
+    }
+    std::sort(vecScores.begin(), vecScores.end(), [](const std::pair<int64_t, CTxIn>& a, const std::pair<int64_t, CTxIn>& b) {
+        return a.first > b.first;
+    });
+
+    std::vector<CTxIn> vecRanked;
+    for (unsigned int i = 0; i < vecScores.size(); i++)
+        vecRanked.push_back(vecScores[i].second);
+    return vecRanked;
+}
+
+/** The ranks the manager hands out, cached or not, are the ones computed from scratch */
+static void CheckRanks(CServicenodeMan& man, int64_t nBlockHeight)
+{
+    std::vector<std::pair<int, CServicenode> > vecRanks = man.GetServicenodeRanks(nBlockHeight);
+    std::vector<CTxIn> vecListed = RankedFresh(man, nBlockHeight, true);
+    BOOST_REQUIRE_EQUAL(vecRanks.size(), vecListed.size());
+    for (unsigned int i = 0; i < vecRanks.size(); i++) {
+        BOOST_CHECK_EQUAL(vecRanks[i].first, (int)i + 1);
+        BOOST_CHECK(vecRanks[i].second.vin == vecListed[i]);
+    }
+
+    std::vector<CTxIn> vecProtocol = RankedFresh(man, nBlockHeight, false);
+    for (unsigned int i = 0; i < vecProtocol.size(); i++)
+        BOOST_CHECK_EQUAL(man.GetServicenodeRank(vecProtocol[i], nBlockHeight, 0, false), (int)i + 1);
+}
+
+BOOST_AUTO_TEST_CASE(servicenodeman_rank_tables)
+{
+    Checkpoints::fEnabled = false;
+    ModifiableParams()->setSkipProofOfWorkCheck(true);
+    const int64_t nTime = GetTime();
+    SetMockTime(nTime);
+
+    // blocks 1 to 4, ranks for block 4 are scored on block 3
+    CBlockIndex* pindexGenesis;
+    {
+        LOCK(cs_main);
+        pindexGenesis = chainActive.Genesis();
+    }
+    CBlockIndex* pindexFirst = ConnectChild(pindexGenesis, 1);
+    CBlockIndex* pindexFork = ConnectChild(pindexFirst, 1);
+    CBlockIndex* pindexScored = ConnectChild(pindexFork, 1);
+    ConnectChild(pindexScored, 1);
+    {
+        LOCK(cs_main);
+        BOOST_REQUIRE_EQUAL(chainActive.Height(), 4);
+    }
+    const int64_t nBlockHeight = 4;
+
+    std::vector<CPubKey> vPubKeys;
+    for (int i = 0; i < 6; i++) {
+        CKey key;
+        key.MakeNewKey(true);
+        vPubKeys.push_back(key.GetPubKey());
+    }
+
+    // each change to the list drops the cached tables
+    CServicenodeMan man;
+    for (unsigned int i = 0; i < vPubKeys.size(); i++) {
+        CServicenode mn = TestServicenode(i, vPubKeys[i], vPubKeys[i], strprintf("10.0.1.%d:41412", i + 1));
+        BOOST_CHECK(man.Add(mn));
+        CheckRanks(man, nBlockHeight);
+    }
+
+    man.Remove(CTxIn(COutPoint(ArithToUint256(arith_uint256(3)), 0)));
+    BOOST_CHECK_EQUAL(man.size(), 5);
+    CheckRanks(man, nBlockHeight);
+
+    CServicenode* pmn = man.Find(CTxIn(COutPoint(ArithToUint256(arith_uint256(4)), 1)));
+    BOOST_REQUIRE(pmn != NULL);
+    CServicenodeBroadcast mnb(*pmn);
+    mnb.sigTime = pmn->sigTime + 1;
+    mnb.addr = CService("10.0.1.9:41412");
+    BOOST_CHECK(man.UpdateFromNewBroadcast(*pmn, mnb));
+    CheckRanks(man, nBlockHeight);
+
+    // a reorg replaces the block the cached tables were scored on
+    ConnectChild(ConnectChild(ConnectChild(pindexFork, 2), 2), 2);
+    {
+        LOCK(cs_main);
+        BOOST_REQUIRE_EQUAL(chainActive.Height(), 5);
+        BOOST_REQUIRE(chainActive[nBlockHeight - 1] != pindexScored);
+    }
+    CheckRanks(man, nBlockHeight);
+
+    // a servicenode that stops pinging drops to the bottom once the cached tables expire
+    pmn = man.Find(CTxIn(COutPoint(ArithToUint256(arith_uint256(1)), 0)));
+    BOOST_REQUIRE(pmn != NULL);
+    pmn->lastPing.sigTime = nTime - SERVICENODE_EXPIRATION_SECONDS - 1;
+    CheckRanks(man, nBlockHeight);
+    SetMockTime(nTime + SERVICENODE_CHECK_SECONDS);
+    CheckRanks(man, nBlockHeight);
+    BOOST_CHECK(man.GetServicenodeRanks(nBlockHeight).back().second.vin == pmn->vin);
+
+    // a reloaded or cleared list is ranked from scratch too
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << man;
+    CServicenodeMan manLoaded;
+    ss >> manLoaded;
+    CheckRanks(manLoaded, nBlockHeight);
+    man.Clear();
+    BOOST_CHECK(man.GetServicenodeRanks(nBlockHeight).empty());
+
+    // leave the active chain to the other tests as it was
+    {
+        LOCK(cs_main);
+        CValidationState state;
+        BOOST_CHECK(InvalidateBlock(state, pindexFirst));
+    }
+    SetMockTime(0);
+    ModifiableParams()->setSkipProofOfWorkCheck(false);
+    Checkpoints::fEnabled = true;
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,194 @@
+// Copyright (c) 2018 The Blocknet developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "arith_uint256.h"
+#include "bloom.h"
+#include "main.h"
+#include "net.h"
+#include "servicenode-budget.h"
+#include "servicenode-payments.h"
+#include "servicenode-sync.h"
+#include "servicenodeman.h"
+
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/foreach.hpp>
+#include <boost/test/unit_test.hpp>
+
+typedef std::vector<std::pair<std::string, CDataStream> > SentMessages;
+
+/** Read back the messages pushed to a node, they stay queued as its socket is invalid */
+static SentMessages GetSentMessages(CNode& node)
+{
+    SentMessages vMessages;
+    LOCK(node.cs_vSend);
+    BOOST_FOREACH (const CSerializeData& data, node.vSendMsg) {
+        CDataStream ss(data.begin(), data.end(), SER_NETWORK, PROTOCOL_VERSION);
+        CMessageHeader hdr;
+        ss >> hdr;
+        vMessages.push_back(std::make_pair(hdr.GetCommand(), ss));
+    }
+    return vMessages;
+}
+
+/** The filter as the serving peer sees it after "mnvsf" or "mnwf" */
+static CBloomFilter RelayFilter(const CBloomFilter& filter)
+{
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << filter;
+    CBloomFilter filterRecv;
+    ss >> filterRecv;
+    BOOST_CHECK(filterRecv.IsWithinSizeConstraints());
+    filterRecv.UpdateEmptyFull();
+    return filterRecv;
+}
+
+static void CheckSyncStatus(CDataStream& ss, int nItemID, int nCount)
+{
+    int nItemIDRecv, nCountRecv;
+    ss >> nItemIDRecv >> nCountRecv;
+    BOOST_CHECK_EQUAL(nItemIDRecv, nItemID);
+    BOOST_CHECK_EQUAL(nCountRecv, nCount);
+}
+
+static CTxIn TestVin(unsigned int n)
+{
+    return CTxIn(COutPoint(ArithToUint256(arith_uint256(n + 1)), n % 2));
+}
+
+BOOST_AUTO_TEST_SUITE(servicenodesync_tests)
+
+BOOST_AUTO_TEST_CASE(servicenodesync_winners_filtered)
+{
+    const int nHeight = GetHeight();
+    BOOST_REQUIRE(nHeight >= 0);
+    BOOST_REQUIRE_EQUAL(mnodeman.CountEnabled(), 0);
+
+    // with no servicenodes enabled only the next 20 blocks are in range
+    CServicenodePayments payments, paymentsPeer;
+    std::set<uint256> setInRange;
+    const CScript payee = CScript() << OP_TRUE;
+    for (unsigned int i = 0; i < 2 * SERVICENODE_SYNC_BULK_MAX + 100; i++) {
+        CServicenodePaymentWinner winner(TestVin(i));
+        winner.nBlockHeight = nHeight + (i % 24) - 1;
+        winner.AddPayee(payee);
+        payments.mapServicenodePayeeVotes[winner.GetHash()] = winner;
+        if (winner.nBlockHeight >= nHeight && winner.nBlockHeight <= nHeight + 20)
+            setInRange.insert(winner.GetHash());
+        if (i % 7 == 0)
+            paymentsPeer.mapServicenodePayeeVotes[winner.GetHash()] = winner;
+    }
+
+    // the peer's filter holds every winner it has
+    const CBloomFilter filter = RelayFilter(paymentsPeer.GetSyncFilter());
+    for (std::map<uint256, CServicenodePaymentWinner>::iterator it = paymentsPeer.mapServicenodePayeeVotes.begin(); it != paymentsPeer.mapServicenodePayeeVotes.end(); ++it)
+        BOOST_CHECK(filter.contains(it->first));
+
+    std::set<uint256> setExpected;
+    BOOST_FOREACH (const uint256& hash, setInRange) {
+        if (!filter.contains(hash))
+            setExpected.insert(hash);
+    }
+    BOOST_CHECK(setExpected.size() > SERVICENODE_SYNC_BULK_MAX);
+
+    CNode node(INVALID_SOCKET, CAddress(CService("127.0.0.1", 0)), "", true);
+    payments.SyncFiltered(&node, 1000, filter);
+
+    // the winners it lacks arrive in full batches, then the count
+    SentMessages vMessages = GetSentMessages(node);
+    BOOST_REQUIRE(vMessages.size() >= 2);
+    std::set<uint256> setSent;
+    for (unsigned int i = 0; i + 1 < vMessages.size(); i++) {
+        BOOST_CHECK_EQUAL(vMessages[i].first, "mnws");
+        std::vector<CServicenodePaymentWinner> vWinners;
+        vMessages[i].second >> vWinners;
+        BOOST_CHECK(vWinners.size() <= SERVICENODE_SYNC_BULK_MAX);
+        if (i + 2 < vMessages.size())
+            BOOST_CHECK_EQUAL(vWinners.size(), SERVICENODE_SYNC_BULK_MAX);
+        BOOST_FOREACH (CServicenodePaymentWinner& winner, vWinners)
+            BOOST_CHECK(setSent.insert(winner.GetHash()).second);
+    }
+    BOOST_CHECK(setSent == setExpected);
+    BOOST_CHECK_EQUAL(vMessages.back().first, "ssc");
+    CheckSyncStatus(vMessages.back().second, SERVICENODE_SYNC_MNW, setExpected.size());
+}
+
+BOOST_AUTO_TEST_CASE(servicenodesync_budget_filtered)
+{
+    CBudgetManager budgetSender, budgetPeer;
+    const CScript address = CScript() << OP_TRUE;
+
+    // a proposal the peer has with some of its votes, one it lacks and one that is no longer valid
+    std::vector<CBudgetProposal> vProposals;
+    vProposals.push_back(CBudgetProposal("known", "http://known", 0, 100, address, COIN, uint256()));
+    vProposals.push_back(CBudgetProposal("unknown", "http://unknown", 0, 100, address, COIN, uint256()));
+    vProposals.push_back(CBudgetProposal("invalid", "http://invalid", 0, 100, address, COIN, uint256()));
+    vProposals[2].fValid = false;
+
+    std::set<uint256> setKnown, setValidVotes;
+    unsigned int nVin = 0;
+    BOOST_FOREACH (CBudgetProposal& proposal, vProposals) {
+        const uint256 nProposalHash = proposal.GetHash();
+        for (int i = 0; i < 10; i++) {
+            CBudgetVote vote(TestVin(nVin++), nProposalHash, VOTE_YES);
+            vote.fValid = i != 9;
+            proposal.mapVotes[vote.GetHash()] = vote;
+            budgetSender.mapSeenServicenodeBudgetVotes[vote.GetHash()] = vote;
+            if (proposal.fValid && vote.fValid)
+                setValidVotes.insert(vote.GetHash());
+            if (proposal.strProposalName == "known" && i % 2 == 0) {
+                budgetPeer.mapSeenServicenodeBudgetVotes[vote.GetHash()] = vote;
+                setKnown.insert(vote.GetHash());
+            }
+        }
+        budgetSender.mapProposals.insert(std::make_pair(nProposalHash, proposal));
+        budgetSender.mapSeenServicenodeBudgetProposals[nProposalHash] = CBudgetProposalBroadcast(proposal);
+    }
+    budgetPeer.mapSeenServicenodeBudgetProposals[vProposals[0].GetHash()] = CBudgetProposalBroadcast(vProposals[0]);
+    setKnown.insert(vProposals[0].GetHash());
+
+    const CBloomFilter filter = RelayFilter(budgetPeer.GetSyncFilter());
+    BOOST_FOREACH (const uint256& hash, setKnown)
+        BOOST_CHECK(filter.contains(hash));
+
+    std::set<uint256> setExpectedVotes;
+    BOOST_FOREACH (const uint256& hash, setValidVotes) {
+        if (!filter.contains(hash))
+            setExpectedVotes.insert(hash);
+    }
+    const bool fExpectProposal = !filter.contains(vProposals[1].GetHash());
+
+    CNode node(INVALID_SOCKET, CAddress(CService("127.0.0.1", 0)), "", true);
+    budgetSender.SyncFiltered(&node, filter);
+
+    // proposals come before the votes on them, and nothing invalid or known is sent
+    SentMessages vMessages = GetSentMessages(node);
+    unsigned int i = 0;
+    std::set<uint256> setSentProposals, setSentVotes;
+    for (; i < vMessages.size() && vMessages[i].first == "mprop"; i++) {
+        CBudgetProposalBroadcast proposal;
+        vMessages[i].second >> proposal;
+        setSentProposals.insert(proposal.GetHash());
+    }
+    for (; i < vMessages.size() && vMessages[i].first == "mvotes"; i++) {
+        std::vector<CBudgetVote> vVotes;
+        vMessages[i].second >> vVotes;
+        BOOST_FOREACH (CBudgetVote& vote, vVotes)
+            BOOST_CHECK(setSentVotes.insert(vote.GetHash()).second);
+    }
+    BOOST_CHECK_EQUAL(setSentProposals.size(), fExpectProposal ? 1U : 0U);
+    BOOST_CHECK(!fExpectProposal || setSentProposals.count(vProposals[1].GetHash()));
+    BOOST_CHECK(setSentVotes == setExpectedVotes);
+
+    BOOST_REQUIRE_EQUAL(vMessages.size(), i + 2);
+    BOOST_CHECK_EQUAL(vMessages[i].first, "ssc");
+    CheckSyncStatus(vMessages[i].second, SERVICENODE_SYNC_BUDGET_PROP, setSentProposals.size() + setSentVotes.size());
+    BOOST_CHECK_EQUAL(vMessages[i + 1].first, "ssc");
+    CheckSyncStatus(vMessages[i + 1].second, SERVICENODE_SYNC_BUDGET_FIN, 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
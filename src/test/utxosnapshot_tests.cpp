@@ -0,0 +1,249 @@
+// Copyright (c) 2018 The Blocknet developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "chainparams.h"
+#include "checkpoints.h"
+#include "clientversion.h"
+#include "coins.h"
+#include "main.h"
+#include "pow.h"
+#include "primitives/transaction.h"
+#include "random.h"
+#include "script/script.h"
+#include "streams.h"
+#include "txdb.h"
+#include "util.h"
+#include "utxosnapshot.h"
+
+#include <boost/filesystem.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(utxosnapshot_tests)
+
+static CCoins RandomCoins(int nOutputs)
+{
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].prevout = COutPoint(GetRandHash(), 0);
+    tx.vout.resize(nOutputs);
+    for (int i = 0; i < nOutputs; i++) {
+        tx.vout[i].nValue = 1000 * (i + 1);
+        tx.vout[i].scriptPubKey << OP_TRUE;
+    }
+    return CCoins(tx, 100 + nOutputs);
+}
+
+static void WriteCoins(CCoinsViewDB& view, const uint256& txid, const CCoins& coins, const uint256& hashBlock)
+{
+    CCoinsMap mapCoins;
+    mapCoins[txid].coins = coins;
+    mapCoins[txid].flags = CCoinsCacheEntry::DIRTY;
+    BOOST_CHECK(view.BatchWrite(mapCoins, hashBlock));
+}
+
+BOOST_AUTO_TEST_CASE(utxosnapshot_roundtrip)
+{
+    uint256 hashBlock = GetRandHash();
+    CCoinsViewDB source(1 << 20, true, false, "snapshot_source");
+    std::vector<std::pair<uint256, CCoins> > vCoins;
+    for (int i = 1; i <= 5; i++) {
+        vCoins.push_back(std::make_pair(GetRandHash(), RandomCoins(i)));
+        WriteCoins(source, vCoins.back().first, vCoins.back().second, hashBlock);
+    }
+
+    boost::filesystem::path path = GetTempPath() / strprintf("test_utxosnapshot_%s.dat", GetRandHash().ToString());
+    CUTXOSnapshotMetadata metadata;
+    uint256 hashSerialized;
+    {
+        boost::scoped_ptr<CCoinsViewDBCursor> pcursor(source.Cursor());
+        CAutoFile fileout(fopen(path.string().c_str(), "wb"), SER_DISK, CLIENT_VERSION);
+        BOOST_CHECK(WriteUTXOSnapshot(*pcursor, 7, fileout, metadata, hashSerialized));
+    }
+    BOOST_CHECK(metadata.hashBlock == hashBlock);
+    BOOST_CHECK_EQUAL(metadata.nHeight, 7);
+    BOOST_CHECK_EQUAL(metadata.nTransactions, 5U);
+
+    // reading the file through commits to the same hash
+    CUTXOSnapshotMetadata metadataRead;
+    uint256 hashRead;
+    {
+        CAutoFile filein(fopen(path.string().c_str(), "rb"), SER_DISK, CLIENT_VERSION);
+        BOOST_CHECK(ReadUTXOSnapshot(filein, metadataRead, hashRead));
+    }
+    BOOST_CHECK(metadataRead.hashBlock == hashBlock);
+    BOOST_CHECK_EQUAL(metadataRead.nHeight, 7);
+    BOOST_CHECK_EQUAL(metadataRead.nTransactions, 5U);
+    BOOST_CHECK(hashRead == hashSerialized);
+
+    // loading replaces whatever coins the target held
+    CCoinsViewDB target(1 << 20, true, false, "snapshot_target");
+    uint256 txidStale = GetRandHash();
+    WriteCoins(target, txidStale, RandomCoins(2), GetRandHash());
+    BOOST_CHECK(WipeCoins(target));
+    {
+        CAutoFile filein(fopen(path.string().c_str(), "rb"), SER_DISK, CLIENT_VERSION);
+        BOOST_CHECK(ReadUTXOSnapshot(filein, metadataRead, hashRead, &target));
+    }
+    CCoinsMap mapNone;
+    BOOST_CHECK(target.BatchWrite(mapNone, metadataRead.hashBlock));
+
+    BOOST_CHECK(!target.HaveCoins(txidStale));
+    BOOST_CHECK(target.GetBestBlock() == hashBlock);
+    for (unsigned int i = 0; i < vCoins.size(); i++) {
+        CCoins coins;
+        BOOST_CHECK(target.GetCoins(vCoins[i].first, coins));
+        BOOST_CHECK(coins == vCoins[i].second);
+    }
+
+    // and a snapshot of the loaded coins is the same snapshot
+    boost::filesystem::path pathAgain = path.string() + ".again";
+    uint256 hashAgain;
+    {
+        boost::scoped_ptr<CCoinsViewDBCursor> pcursor(target.Cursor());
+        CAutoFile fileout(fopen(pathAgain.string().c_str(), "wb"), SER_DISK, CLIENT_VERSION);
+        BOOST_CHECK(WriteUTXOSnapshot(*pcursor, 7, fileout, metadataRead, hashAgain));
+    }
+    BOOST_CHECK(hashAgain == hashSerialized);
+
+    // a truncated file is rejected
+    boost::filesystem::resize_file(path, boost::filesystem::file_size(path) - 1);
+    {
+        CAutoFile filein(fopen(path.string().c_str(), "rb"), SER_DISK, CLIENT_VERSION);
+        BOOST_CHECK(!ReadUTXOSnapshot(filein, metadataRead, hashRead));
+    }
+
+    boost::filesystem::remove(path);
+    boost::filesystem::remove(pathAgain);
+}
+
+/** Store a coinbase only block on top of pindexPrev without connecting it */
+static CBlockIndex* StoreBlock(CBlockIndex* pindexPrev, unsigned char nTag, std::vector<CTransaction>& vCoinbase)
+{
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].scriptSig = CScript() << (pindexPrev->nHeight + 1) << std::vector<unsigned char>(1, nTag);
+    tx.vout.resize(1);
+    tx.vout[0].nValue = 0;
+    tx.vout[0].scriptPubKey = CScript() << OP_TRUE;
+
+    CBlock block;
+    block.hashPrevBlock = pindexPrev->GetBlockHash();
+    block.nTime = pindexPrev->GetBlockTime() + 60;
+    block.vtx.push_back(CTransaction(tx));
+    block.hashMerkleRoot = block.BuildMerkleTree();
+    block.nBits = GetNextWorkRequired(pindexPrev, &block);
+
+    LOCK(cs_main);
+    CValidationState state;
+    CBlockIndex* pindex = NULL;
+    BOOST_CHECK(AcceptBlock(block, state, &pindex));
+    BOOST_CHECK(pindex && pindex->nChainTx > 0);
+    vCoinbase.push_back(block.vtx[0]);
+    return pindex;
+}
+
+/** Write a snapshot of the coinbase outputs of the blocks up to pindexBase, optionally with a coin the blocks never created */
+static uint256 WriteSnapshot(const boost::filesystem::path& path, const CBlockIndex* pindexBase, const std::vector<CTransaction>& vCoinbase, bool fForged)
+{
+    CCoinsViewDB view(1 << 20, true, false, "snapshot_written");
+    for (unsigned int i = 0; i < vCoinbase.size(); i++)
+        WriteCoins(view, vCoinbase[i].GetHash(), CCoins(vCoinbase[i], i + 1), pindexBase->GetBlockHash());
+    if (fForged)
+        WriteCoins(view, GetRandHash(), RandomCoins(1), pindexBase->GetBlockHash());
+
+    boost::scoped_ptr<CCoinsViewDBCursor> pcursor(view.Cursor());
+    CAutoFile fileout(fopen(path.string().c_str(), "wb"), SER_DISK, CLIENT_VERSION);
+    CUTXOSnapshotMetadata metadata;
+    uint256 hashSerialized;
+    BOOST_CHECK(WriteUTXOSnapshot(*pcursor, pindexBase->nHeight, fileout, metadata, hashSerialized));
+    return hashSerialized;
+}
+
+static bool SnapshotPending()
+{
+    LOCK(cs_main);
+    uint256 hashBlock, hashSerialized;
+    return pblocktree->ReadUTXOSnapshot(hashBlock, hashSerialized);
+}
+
+BOOST_AUTO_TEST_CASE(utxosnapshot_load_and_validate)
+{
+    Checkpoints::fEnabled = false;
+    ModifiableParams()->setSkipProofOfWorkCheck(true);
+    boost::filesystem::path path = GetTempPath() / strprintf("test_utxosnapshot_%s.dat", GetRandHash().ToString());
+    boost::filesystem::path pathReplay = GetDataDir() / "chainstate_snapshot";
+    CBlockIndex* pindexGenesis = chainActive.Genesis();
+
+    // A snapshot that hashes as listed in the chain params, but holds a coin
+    // the blocks up to it never created, loads and is then found out
+    std::vector<CTransaction> vCoinbaseForged;
+    CBlockIndex* pindexForged = pindexGenesis;
+    for (int i = 0; i < 5; i++)
+        pindexForged = StoreBlock(pindexForged, 1, vCoinbaseForged);
+    uint256 hashForged = WriteSnapshot(path, pindexForged, vCoinbaseForged, true);
+
+    CUTXOSnapshotMetadata metadata;
+    std::string strError;
+    BOOST_CHECK(!LoadUTXOSnapshot(path, metadata, strError)); // no snapshot is trusted yet
+
+    MapUTXOSnapshots mapSnapshots;
+    mapSnapshots[pindexForged->nHeight].hashBlock = pindexForged->GetBlockHash();
+    mapSnapshots[pindexForged->nHeight].hashSerialized = hashForged;
+    ModifiableParams()->setUTXOSnapshots(mapSnapshots);
+
+    BOOST_CHECK(LoadUTXOSnapshot(path, metadata, strError));
+    BOOST_CHECK_EQUAL(metadata.nHeight, 5);
+    BOOST_CHECK(chainActive.Tip() == pindexForged);
+    BOOST_CHECK(pcoinsTip->HaveCoins(vCoinbaseForged[0].GetHash()));
+    BOOST_CHECK(SnapshotPending());
+
+    // a second snapshot can't be loaded while the first is being validated
+    BOOST_CHECK(!LoadUTXOSnapshot(path, metadata, strError));
+
+    strMiscWarning = "";
+    BOOST_CHECK(!ValidateUTXOSnapshot());
+    BOOST_CHECK(!strMiscWarning.empty());
+    BOOST_CHECK(SnapshotPending());
+
+    // What -reindex would start over from
+    {
+        LOCK(cs_main);
+        BOOST_CHECK(pblocktree->EraseUTXOSnapshot());
+    }
+    strMiscWarning = "";
+
+    // A snapshot matching its blocks, on a chain with more work. Its replay
+    // does not resume from what was left of the other one.
+    std::vector<CTransaction> vCoinbase;
+    CBlockIndex* pindexBase = pindexGenesis;
+    for (int i = 0; i < 7; i++)
+        pindexBase = StoreBlock(pindexBase, 2, vCoinbase);
+    uint256 hashSerialized = WriteSnapshot(path, pindexBase, vCoinbase, false);
+
+    mapSnapshots[pindexBase->nHeight].hashBlock = pindexBase->GetBlockHash();
+    mapSnapshots[pindexBase->nHeight].hashSerialized = GetRandHash();
+    ModifiableParams()->setUTXOSnapshots(mapSnapshots);
+    BOOST_CHECK(!LoadUTXOSnapshot(path, metadata, strError)); // hashes differently than listed
+
+    mapSnapshots[pindexBase->nHeight].hashSerialized = hashSerialized;
+    ModifiableParams()->setUTXOSnapshots(mapSnapshots);
+    BOOST_CHECK(LoadUTXOSnapshot(path, metadata, strError));
+    BOOST_CHECK(chainActive.Tip() == pindexBase);
+    BOOST_CHECK(!pcoinsTip->HaveCoins(vCoinbaseForged[0].GetHash()));
+    for (unsigned int i = 0; i < vCoinbase.size(); i++)
+        BOOST_CHECK(pcoinsTip->HaveCoins(vCoinbase[i].GetHash()));
+
+    BOOST_CHECK(ValidateUTXOSnapshot());
+    BOOST_CHECK(strMiscWarning.empty());
+    BOOST_CHECK(!SnapshotPending());
+    BOOST_CHECK(!boost::filesystem::exists(pathReplay));
+
+    boost::filesystem::remove(path);
+    ModifiableParams()->setUTXOSnapshots(MapUTXOSnapshots());
+    ModifiableParams()->setSkipProofOfWorkCheck(false);
+    Checkpoints::fEnabled = true;
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,92 @@
+// Copyright (c) 2018 The Blocknet developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "primitives/block.h"
+#include "primitives/transaction.h"
+#include "validationinterface.h"
+
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
+
+namespace
+{
+class CTransactionRecorder : public CValidationInterface
+{
+public:
+    std::vector<uint32_t> vLockTimes;
+    std::vector<const CBlock*> vBlocks;
+
+protected:
+    void SyncTransaction(const CTransaction& tx, const CBlock* pblock)
+    {
+        vLockTimes.push_back(tx.nLockTime);
+        vBlocks.push_back(pblock);
+    }
+};
+
+CTransaction MakeTransaction(uint32_t nLockTime)
+{
+    CMutableTransaction tx;
+    tx.nLockTime = nLockTime;
+    return tx;
+}
+}
+
+BOOST_AUTO_TEST_SUITE(validationinterface_tests)
+
+BOOST_AUTO_TEST_CASE(validationqueue_inline)
+{
+    // Without the queue thread notifications are delivered before SyncWithWallets returns
+    CTransactionRecorder recorder;
+    RegisterValidationInterface(&recorder);
+    SyncWithWallets(MakeTransaction(1));
+    boost::shared_ptr<const CBlock> pblock(new CBlock());
+    SyncWithWallets(MakeTransaction(2), pblock);
+    UnregisterValidationInterface(&recorder);
+
+    BOOST_CHECK_EQUAL(recorder.vLockTimes.size(), 2U);
+    BOOST_CHECK_EQUAL(recorder.vLockTimes[0], 1U);
+    BOOST_CHECK_EQUAL(recorder.vLockTimes[1], 2U);
+    BOOST_CHECK(recorder.vBlocks[0] == NULL);
+    BOOST_CHECK(recorder.vBlocks[1] == pblock.get());
+    BOOST_CHECK(!GetValidationQueueStats().fRunning);
+}
+
+BOOST_AUTO_TEST_CASE(validationqueue_thread)
+{
+    CTransactionRecorder recorder;
+    RegisterValidationInterface(&recorder);
+
+    boost::thread thread(&ThreadValidationQueue);
+    while (!GetValidationQueueStats().fRunning)
+        boost::this_thread::yield();
+
+    boost::shared_ptr<const CBlock> pblock(new CBlock());
+    for (uint32_t i = 0; i < 1000; i++)
+        SyncWithWallets(MakeTransaction(i), pblock);
+    SyncWithValidationInterfaceQueue();
+
+    // Delivered in order, and everything posted before the barrier was delivered,
+    // with the block that was posted rather than a copy of it
+    BOOST_CHECK_EQUAL(recorder.vLockTimes.size(), 1000U);
+    for (uint32_t i = 0; i < recorder.vLockTimes.size(); i++) {
+        BOOST_CHECK_EQUAL(recorder.vLockTimes[i], i);
+        BOOST_CHECK(recorder.vBlocks[i] == pblock.get());
+    }
+    BOOST_CHECK_EQUAL(GetValidationQueueStats().nDepth, 0U);
+
+    thread.interrupt();
+    thread.join();
+    BOOST_CHECK(!GetValidationQueueStats().fRunning);
+
+    // Back to inline delivery once the thread has stopped
+    SyncWithWallets(MakeTransaction(1000));
+    BOOST_CHECK_EQUAL(recorder.vLockTimes.size(), 1001U);
+
+    UnregisterValidationInterface(&recorder);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
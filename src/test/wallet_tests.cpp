@@ -4,6 +4,12 @@
 
 #include "wallet.h"
 
+#include "key.h"
+#include "main.h"
+#include "random.h"
+#include "script/standard.h"
+#include "txmempool.h"
+
 #include <set>
 #include <stdint.h>
 #include <utility>
@@ -305,4 +311,173 @@ BOOST_AUTO_TEST_CASE(coin_selection_tests)
     empty_wallet();
 }
 
+/** Append a block holding vtx to the active chain, without validating or storing it */
+static CBlockIndex* ConnectFakeBlock(const std::vector<CTransaction>& vtx, CBlock& block)
+{
+    CBlockIndex* pindexPrev = chainActive.Tip();
+    block.SetNull();
+    block.nVersion = 1;
+    block.hashPrevBlock = pindexPrev->GetBlockHash();
+    block.nTime = pindexPrev->nTime + 60;
+    block.nNonce = GetRand(std::numeric_limits<uint32_t>::max());
+    block.vtx = vtx;
+    block.hashMerkleRoot = block.BuildMerkleTree();
+
+    CBlockIndex* pindex = new CBlockIndex(block);
+    BlockMap::iterator mi = mapBlockIndex.insert(make_pair(block.GetHash(), pindex)).first;
+    pindex->phashBlock = &mi->first;
+    pindex->pprev = pindexPrev;
+    pindex->nHeight = pindexPrev->nHeight + 1;
+    chainActive.SetTip(pindex);
+    return pindex;
+}
+
+static CTransaction PayTo(const COutPoint& prevout, const CScript& scriptPubKey, CAmount nValue)
+{
+    CMutableTransaction tx;
+    tx.vin.push_back(CTxIn(prevout));
+    tx.vout.push_back(CTxOut(nValue, scriptPubKey));
+    return tx;
+}
+
+/** Check the balances and available coins of the unspent index against a walk over all of mapWallet */
+static void CheckUnspentIndex(const CWallet& w)
+{
+    LOCK2(cs_main, w.cs_wallet);
+
+    CWalletBalances walk;
+    std::set<std::pair<uint256, unsigned int> > setConfirmed, setAll;
+    for (std::map<uint256, CWalletTx>::const_iterator it = w.mapWallet.begin(); it != w.mapWallet.end(); ++it) {
+        const CWalletTx& wtx = it->second;
+        const bool fTrusted = wtx.IsTrusted();
+        if (fTrusted) {
+            walk.nTrusted += wtx.GetAvailableCredit(false);
+            walk.nWatchOnlyTrusted += wtx.GetAvailableWatchOnlyCredit(false);
+        } else if (!IsFinalTx(wtx) || wtx.GetDepthInMainChain() == 0) {
+            walk.nUnconfirmed += wtx.GetAvailableCredit(false);
+            walk.nWatchOnlyUnconfirmed += wtx.GetAvailableWatchOnlyCredit(false);
+        }
+        walk.nImmature += wtx.GetImmatureCredit(false);
+        walk.nWatchOnlyImmature += wtx.GetImmatureWatchOnlyCredit(false);
+
+        const int nDepth = wtx.GetDepthInMainChain(false);
+        if (!CheckFinalTx(wtx) || nDepth < 0 || (nDepth == 0 && !wtx.InMempool()))
+            continue;
+        for (unsigned int i = 0; i < wtx.vout.size(); i++) {
+            if (w.IsSpent(it->first, i) || w.IsMine(wtx.vout[i]) == ISMINE_NO || w.IsLockedCoin(it->first, i) || wtx.vout[i].nValue <= 0)
+                continue;
+            setAll.insert(std::make_pair(it->first, i));
+            if (fTrusted)
+                setConfirmed.insert(std::make_pair(it->first, i));
+        }
+    }
+
+    CWalletBalances balances = w.GetBalances();
+    BOOST_CHECK_EQUAL(balances.nTrusted, walk.nTrusted);
+    BOOST_CHECK_EQUAL(balances.nUnconfirmed, walk.nUnconfirmed);
+    BOOST_CHECK_EQUAL(balances.nImmature, walk.nImmature);
+    BOOST_CHECK_EQUAL(balances.nWatchOnlyTrusted, walk.nWatchOnlyTrusted);
+    BOOST_CHECK_EQUAL(balances.nWatchOnlyUnconfirmed, walk.nWatchOnlyUnconfirmed);
+    BOOST_CHECK_EQUAL(balances.nWatchOnlyImmature, walk.nWatchOnlyImmature);
+
+    std::vector<COutput> vConfirmed, vAll;
+    w.AvailableCoins(vConfirmed, true);
+    w.AvailableCoins(vAll, false);
+    std::set<std::pair<uint256, unsigned int> > setIndexConfirmed, setIndexAll;
+    BOOST_FOREACH (const COutput& out, vConfirmed)
+        setIndexConfirmed.insert(std::make_pair(out.tx->GetHash(), (unsigned int)out.i));
+    BOOST_FOREACH (const COutput& out, vAll)
+        setIndexAll.insert(std::make_pair(out.tx->GetHash(), (unsigned int)out.i));
+    BOOST_CHECK(setIndexConfirmed == setConfirmed);
+    BOOST_CHECK(setIndexAll == setAll);
+}
+
+BOOST_AUTO_TEST_CASE(wallet_unspent_index)
+{
+    LOCK(cs_main);
+    CBlockIndex* pindexStart = chainActive.Tip();
+
+    CWallet w("wallet_unspent_index.dat");
+    CKey key, keyImported;
+    key.MakeNewKey(true);
+    keyImported.MakeNewKey(true);
+    const CScript scriptMine = GetScriptForDestination(key.GetPubKey().GetID());
+    const CScript scriptImported = GetScriptForDestination(keyImported.GetPubKey().GetID());
+    const CScript scriptOther = CScript() << OP_TRUE;
+    {
+        LOCK(w.cs_wallet);
+        BOOST_CHECK(w.AddKeyPubKey(key, key.GetPubKey()));
+    }
+
+    // a confirmed and an unconfirmed payment to us
+    std::vector<CBlockIndex*> vFakeBlocks;
+    CBlock block1;
+    CTransaction txFunding = PayTo(COutPoint(GetRandHash(), 0), scriptMine, 10 * COIN);
+    vFakeBlocks.push_back(ConnectFakeBlock(std::vector<CTransaction>(1, txFunding), block1));
+    w.SyncTransaction(txFunding, &block1);
+
+    CTransaction txPending = PayTo(COutPoint(GetRandHash(), 0), scriptMine, 5 * COIN);
+    mempool.addUnchecked(txPending.GetHash(), CTxMemPoolEntry(txPending, 0, 0, 0.0, 1));
+    w.SyncTransaction(txPending, NULL);
+    CheckUnspentIndex(w);
+    BOOST_CHECK_EQUAL(w.GetBalances().nTrusted, 10 * COIN);
+    BOOST_CHECK_EQUAL(w.GetBalances().nUnconfirmed, 5 * COIN);
+
+    // spend the confirmed coin, with change back to us
+    CMutableTransaction txSpendMutable;
+    txSpendMutable.vin.push_back(CTxIn(COutPoint(txFunding.GetHash(), 0)));
+    txSpendMutable.vout.push_back(CTxOut(4 * COIN, scriptMine));
+    txSpendMutable.vout.push_back(CTxOut(5 * COIN, scriptOther));
+    CTransaction txSpend(txSpendMutable);
+    CBlock block2;
+    vFakeBlocks.push_back(ConnectFakeBlock(std::vector<CTransaction>(1, txSpend), block2));
+    w.SyncTransaction(txSpend, &block2);
+    CheckUnspentIndex(w);
+    BOOST_CHECK_EQUAL(w.GetBalances().nTrusted, 4 * COIN);
+
+    // reorg the spend out for a block without it, and tell the wallet as DisconnectTip does
+    chainActive.SetTip(vFakeBlocks[0]);
+    w.SyncTransaction(txSpend, NULL);
+    CBlock block2b;
+    vFakeBlocks.push_back(ConnectFakeBlock(std::vector<CTransaction>(1, PayTo(COutPoint(GetRandHash(), 0), scriptOther, COIN)), block2b));
+    CheckUnspentIndex(w);
+    BOOST_CHECK_EQUAL(w.GetBalances().nTrusted, 10 * COIN);
+
+    // and back, the index is brought up to date without being told
+    chainActive.SetTip(vFakeBlocks[1]);
+    CheckUnspentIndex(w);
+    BOOST_CHECK_EQUAL(w.GetBalances().nTrusted, 4 * COIN);
+
+    // an output that only becomes ours with an imported key shows up after MarkDirty
+    CMutableTransaction txImportMutable;
+    txImportMutable.vin.push_back(CTxIn(COutPoint(GetRandHash(), 0)));
+    txImportMutable.vout.push_back(CTxOut(COIN, scriptMine));
+    txImportMutable.vout.push_back(CTxOut(2 * COIN, scriptImported));
+    CTransaction txImport(txImportMutable);
+    CBlock block3;
+    vFakeBlocks.push_back(ConnectFakeBlock(std::vector<CTransaction>(1, txImport), block3));
+    w.SyncTransaction(txImport, &block3);
+    CheckUnspentIndex(w);
+    BOOST_CHECK_EQUAL(w.GetBalances().nTrusted, 5 * COIN);
+    {
+        LOCK(w.cs_wallet);
+        BOOST_CHECK(w.AddKeyPubKey(keyImported, keyImported.GetPubKey()));
+    }
+    w.MarkDirty();
+    CheckUnspentIndex(w);
+    BOOST_CHECK_EQUAL(w.GetBalances().nTrusted, 7 * COIN);
+
+    // a locked coin is not available, but still part of the balance
+    w.LockCoin(COutPoint(txImport.GetHash(), 1));
+    CheckUnspentIndex(w);
+    BOOST_CHECK_EQUAL(w.GetBalances().nLocked, 2 * COIN);
+
+    mempool.clear();
+    chainActive.SetTip(pindexStart);
+    BOOST_FOREACH (CBlockIndex* pindex, vFakeBlocks) {
+        mapBlockIndex.erase(pindex->GetBlockHash());
+        delete pindex;
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
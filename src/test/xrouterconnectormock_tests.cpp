@@ -0,0 +1,96 @@
+// Copyright (c) 2018 The Blocknet developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "utiltime.h"
+#include "xrouter/xrouterapp.h"
+#include "xrouter/xrouterconnectormock.h"
+
+#include "json/json_spirit_reader_template.h"
+#include "json/json_spirit_utils.h"
+
+#include <boost/test/unit_test.hpp>
+
+using namespace json_spirit;
+using namespace xrouter;
+
+BOOST_AUTO_TEST_SUITE(xrouterconnectormock_tests)
+
+static void InitMock(MockWalletConnectorXRouter& conn, const std::string& currency, double errorRate = 0)
+{
+    xbridge::WalletParam wp;
+    wp.currency = currency;
+    wp.method = "MOCK";
+    wp.COIN = 100000000;
+    wp.blockTime = 60;
+    conn = wp;
+    conn.setSimulation(0, 0, errorRate, 1000);
+}
+
+static Value Result(const std::string& reply)
+{
+    Value val;
+    BOOST_CHECK(read_string(reply, val));
+    BOOST_CHECK(val.type() == obj_type);
+    return find_value(val.get_obj(), "result");
+}
+
+BOOST_AUTO_TEST_CASE(mock_height_shared_epoch)
+{
+    // before the epoch the chain stays at its start height
+    SetMockTime(MOCK_CHAIN_EPOCH - 600);
+    MockWalletConnectorXRouter a;
+    InitMock(a, "BLOCK");
+    BOOST_CHECK_EQUAL(Result(a.getBlockCount()).get_int(), 1000);
+
+    SetMockTime(MOCK_CHAIN_EPOCH + 3600);
+    BOOST_CHECK_EQUAL(Result(a.getBlockCount()).get_int(), 1060);
+
+    // a node started later reports the same chain
+    SetMockTime(MOCK_CHAIN_EPOCH + 7230);
+    MockWalletConnectorXRouter b;
+    InitMock(b, "BLOCK");
+    BOOST_CHECK_EQUAL(Result(a.getBlockCount()).get_int(), 1120);
+    BOOST_CHECK_EQUAL(Result(b.getBlockCount()).get_int(), 1120);
+    BOOST_CHECK_EQUAL(Result(a.getBlockHash(1120)).get_str(), Result(b.getBlockHash(1120)).get_str());
+    BOOST_CHECK(Result(a.getBlockHash(1121)).type() == null_type);
+
+    // other currencies have other blocks
+    MockWalletConnectorXRouter c;
+    InitMock(c, "LTC");
+    BOOST_CHECK(Result(a.getBlockHash(5)).get_str() != Result(c.getBlockHash(5)).get_str());
+
+    SetMockTime(0);
+}
+
+BOOST_AUTO_TEST_CASE(mock_error_rate)
+{
+    MockWalletConnectorXRouter conn;
+    InitMock(conn, "BLOCK", 1);
+
+    Value val;
+    BOOST_CHECK(read_string(conn.getBlockCount(), val));
+    BOOST_CHECK(find_value(val.get_obj(), "result").type() == null_type);
+    BOOST_CHECK(find_value(val.get_obj(), "error").type() == obj_type);
+}
+
+BOOST_AUTO_TEST_CASE(xrouter_load_test)
+{
+    // XRouter is off in the unit tests, so every call fails right away, but
+    // all of them are made and accounted for
+    Value val;
+    BOOST_CHECK(read_string(App::instance().loadTest(xrGetBlockCount, "BLOCK", 20, 4, 1, std::vector<std::string>()), val));
+    BOOST_CHECK(val.type() == obj_type);
+    const Object& result = val.get_obj();
+    BOOST_CHECK_EQUAL(find_value(result, "command").get_str(), "xrGetBlockCount");
+    BOOST_CHECK_EQUAL(find_value(result, "calls").get_int(), 20);
+    BOOST_CHECK_EQUAL(find_value(result, "errors").get_int(), 20);
+    BOOST_CHECK_EQUAL(find_value(result, "concurrency").get_int(), 4);
+
+    const Value& latency = find_value(result, "latencyms");
+    BOOST_CHECK(latency.type() == obj_type);
+    BOOST_CHECK(find_value(latency.get_obj(), "p50").get_real() <= find_value(latency.get_obj(), "max").get_real());
+    BOOST_CHECK(find_value(result, "stages").type() == obj_type);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
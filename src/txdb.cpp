@@ -5,10 +5,12 @@
 
 #include "txdb.h"
 
+#include "checkpoints.h"
 #include "main.h"
 #include "pow.h"
 #include "uint256.h"
 
+#include <atomic>
 #include <stdint.h>
 
 #include <boost/thread.hpp>
@@ -28,7 +30,7 @@ void static BatchWriteHashBestChain(CLevelDBBatch& batch, const uint256& hash)
     batch.Write('B', hash);
 }
 
-CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe) : db(GetDataDir() / "chainstate", nCacheSize, fMemory, fWipe)
+CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe, const std::string& strName) : db(GetDataDir() / strName, nCacheSize, fMemory, fWipe)
 {
 }
 
@@ -114,6 +116,82 @@ bool CBlockTreeDB::ReadLastBlockFile(int& nFile)
     return Read('l', nFile);
 }
 
+void HashCoins(CHashWriter& ss, const uint256& txid, const CCoins& coins)
+{
+    ss << txid;
+    ss << VARINT(coins.nVersion);
+    ss << (coins.fCoinBase ? 'c' : 'n');
+    ss << VARINT(coins.nHeight);
+    for (unsigned int i = 0; i < coins.vout.size(); i++) {
+        const CTxOut& out = coins.vout[i];
+        if (!out.IsNull()) {
+            ss << VARINT(i + 1);
+            ss << out;
+        }
+    }
+    ss << VARINT(0);
+}
+
+CCoinsViewDBCursor::CCoinsViewDBCursor(leveldb::Iterator* pcursorIn, const uint256& hashBlockIn) : pcursor(pcursorIn), hashBlock(hashBlockIn)
+{
+    CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+    ssKey << 'c';
+    pcursor->Seek(leveldb::Slice(&ssKey[0], ssKey.size()));
+}
+
+CCoinsViewDBCursor::~CCoinsViewDBCursor()
+{
+}
+
+bool CCoinsViewDBCursor::Valid() const
+{
+    // the coins records are the ones keyed 'c', sorted together
+    return pcursor->Valid() && pcursor->key().size() > 0 && pcursor->key()[0] == 'c';
+}
+
+void CCoinsViewDBCursor::Next()
+{
+    pcursor->Next();
+}
+
+bool CCoinsViewDBCursor::GetKey(uint256& txid) const
+{
+    try {
+        leveldb::Slice slKey = pcursor->key();
+        CDataStream ssKey(slKey.data(), slKey.data() + slKey.size(), SER_DISK, CLIENT_VERSION);
+        char chType;
+        ssKey >> chType >> txid;
+    } catch (const std::exception& e) {
+        return error("%s : Deserialize or I/O error - %s", __func__, e.what());
+    }
+    return true;
+}
+
+bool CCoinsViewDBCursor::GetValue(CCoins& coins) const
+{
+    try {
+        leveldb::Slice slValue = pcursor->value();
+        CDataStream ssValue(slValue.data(), slValue.data() + slValue.size(), SER_DISK, CLIENT_VERSION);
+        ssValue >> coins;
+    } catch (const std::exception& e) {
+        return error("%s : Deserialize or I/O error - %s", __func__, e.what());
+    }
+    return true;
+}
+
+unsigned int CCoinsViewDBCursor::GetValueSize() const
+{
+    return pcursor->value().size();
+}
+
+CCoinsViewDBCursor* CCoinsViewDB::Cursor() const
+{
+    /* It seems that there are no "const iterators" for LevelDB.  Since we
+       only need read operations on it, use a const-cast to get around
+       that restriction.  */
+    return new CCoinsViewDBCursor(const_cast<CLevelDBWrapper*>(&db)->NewIterator(), GetBestBlock());
+}
+
 bool CCoinsViewDB::GetStats(CCoinsStats& stats) const
 {
     /* It seems that there are no "const iterators" for LevelDB.  Since we
@@ -140,22 +218,16 @@ bool CCoinsViewDB::GetStats(CCoinsStats& stats) const
                 ssValue >> coins;
                 uint256 txhash;
                 ssKey >> txhash;
-                ss << txhash;
-                ss << VARINT(coins.nVersion);
-                ss << (coins.fCoinBase ? 'c' : 'n');
-                ss << VARINT(coins.nHeight);
+                HashCoins(ss, txhash, coins);
                 stats.nTransactions++;
                 for (unsigned int i = 0; i < coins.vout.size(); i++) {
                     const CTxOut& out = coins.vout[i];
                     if (!out.IsNull()) {
                         stats.nTransactionOutputs++;
-                        ss << VARINT(i + 1);
-                        ss << out;
                         nTotalAmount += out.nValue;
                     }
                 }
                 stats.nSerializedSize += 32 + slValue.size();
-                ss << VARINT(0);
             }
             pcursor->Next();
         } catch (std::exception& e) {
@@ -181,6 +253,149 @@ bool CBlockTreeDB::WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos>
     return WriteBatch(batch);
 }
 
+/**
+ * Address history lives under 'a', unspent outputs under 'u' and running
+ * balances under 'A'. A block's entries and the balance changes they imply
+ * go into one batch; the block's first history entry for an address tells
+ * whether its balance change was already applied, so connecting a block
+ * again after an unclean shutdown does not count it twice.
+ */
+void CBlockTreeDB::BatchAddressIndex(CLevelDBBatch& batch, const std::vector<CAddressIndexEntry>& vIndex, const std::vector<CAddressUnspentEntry>& vUnspent, int nHeight, bool fConnect)
+{
+    struct BalanceDelta {
+        CAddressIndexKey firstKey;
+        CAmount nBalance;
+        CAmount nReceived;
+    };
+    std::map<std::pair<unsigned char, uint160>, BalanceDelta> mapDelta;
+
+    for (std::vector<CAddressIndexEntry>::const_iterator it = vIndex.begin(); it != vIndex.end(); it++) {
+        std::pair<std::map<std::pair<unsigned char, uint160>, BalanceDelta>::iterator, bool> ins =
+            mapDelta.insert(std::make_pair(std::make_pair(it->first.type, it->first.hashBytes), BalanceDelta()));
+        BalanceDelta& delta = ins.first->second;
+        if (ins.second) {
+            delta.firstKey = it->first;
+            delta.nBalance = 0;
+            delta.nReceived = 0;
+        }
+        delta.nBalance += it->second;
+        if (it->second > 0)
+            delta.nReceived += it->second;
+
+        if (fConnect)
+            batch.Write(make_pair('a', it->first), it->second);
+        else
+            batch.Erase(make_pair('a', it->first));
+    }
+
+    for (std::map<std::pair<unsigned char, uint160>, BalanceDelta>::const_iterator it = mapDelta.begin(); it != mapDelta.end(); it++) {
+        if (Exists(make_pair('a', it->second.firstKey)) == fConnect)
+            continue;
+        CAddressBalance balance;
+        Read(make_pair('A', it->first), balance);
+        int nSign = fConnect ? 1 : -1;
+        balance.nBalance += nSign * it->second.nBalance;
+        balance.nReceived += nSign * it->second.nReceived;
+        balance.nHeight = fConnect ? nHeight : nHeight - 1;
+        batch.Write(make_pair('A', it->first), balance);
+    }
+
+    for (std::vector<CAddressUnspentEntry>::const_iterator it = vUnspent.begin(); it != vUnspent.end(); it++) {
+        if (it->second.IsNull())
+            batch.Erase(make_pair('u', it->first));
+        else
+            batch.Write(make_pair('u', it->first), it->second);
+    }
+}
+
+bool CBlockTreeDB::WriteAddressIndex(const std::vector<CAddressIndexEntry>& vIndex, const std::vector<CAddressUnspentEntry>& vUnspent, int nHeight)
+{
+    CLevelDBBatch batch;
+    BatchAddressIndex(batch, vIndex, vUnspent, nHeight, true);
+    return WriteBatch(batch);
+}
+
+bool CBlockTreeDB::EraseAddressIndex(const std::vector<CAddressIndexEntry>& vIndex, const std::vector<CAddressUnspentEntry>& vUnspent, int nHeight)
+{
+    CLevelDBBatch batch;
+    BatchAddressIndex(batch, vIndex, vUnspent, nHeight, false);
+    return WriteBatch(batch);
+}
+
+bool CBlockTreeDB::ReadAddressIndex(int type, const uint160& hashBytes, std::vector<CAddressIndexEntry>& vIndex, int nStart, int nEnd)
+{
+    boost::scoped_ptr<leveldb::Iterator> pcursor(NewIterator());
+
+    CDataStream ssKeySet(SER_DISK, CLIENT_VERSION);
+    if (nStart > 0)
+        ssKeySet << make_pair('a', CAddressIndexIteratorKey(type, hashBytes, nStart));
+    else
+        ssKeySet << make_pair('a', CAddressIndexIteratorKey(type, hashBytes));
+    pcursor->Seek(ssKeySet.str());
+
+    for (; pcursor->Valid(); pcursor->Next()) {
+        boost::this_thread::interruption_point();
+        try {
+            leveldb::Slice slKey = pcursor->key();
+            CDataStream ssKey(slKey.data(), slKey.data() + slKey.size(), SER_DISK, CLIENT_VERSION);
+            char chType;
+            ssKey >> chType;
+            if (chType != 'a')
+                break;
+            CAddressIndexKey key;
+            ssKey >> key;
+            if (key.type != type || key.hashBytes != hashBytes || (nEnd > 0 && key.blockHeight > nEnd))
+                break;
+            leveldb::Slice slValue = pcursor->value();
+            CDataStream ssValue(slValue.data(), slValue.data() + slValue.size(), SER_DISK, CLIENT_VERSION);
+            CAmount nValue;
+            ssValue >> nValue;
+            vIndex.push_back(make_pair(key, nValue));
+        } catch (std::exception& e) {
+            return error("%s : Deserialize or I/O error - %s", __func__, e.what());
+        }
+    }
+    return true;
+}
+
+bool CBlockTreeDB::ReadAddressUnspentIndex(int type, const uint160& hashBytes, std::vector<CAddressUnspentEntry>& vUnspent)
+{
+    boost::scoped_ptr<leveldb::Iterator> pcursor(NewIterator());
+
+    CDataStream ssKeySet(SER_DISK, CLIENT_VERSION);
+    ssKeySet << make_pair('u', CAddressIndexIteratorKey(type, hashBytes));
+    pcursor->Seek(ssKeySet.str());
+
+    for (; pcursor->Valid(); pcursor->Next()) {
+        boost::this_thread::interruption_point();
+        try {
+            leveldb::Slice slKey = pcursor->key();
+            CDataStream ssKey(slKey.data(), slKey.data() + slKey.size(), SER_DISK, CLIENT_VERSION);
+            char chType;
+            ssKey >> chType;
+            if (chType != 'u')
+                break;
+            CAddressUnspentKey key;
+            ssKey >> key;
+            if (key.type != type || key.hashBytes != hashBytes)
+                break;
+            leveldb::Slice slValue = pcursor->value();
+            CDataStream ssValue(slValue.data(), slValue.data() + slValue.size(), SER_DISK, CLIENT_VERSION);
+            CAddressUnspentValue value;
+            ssValue >> value;
+            vUnspent.push_back(make_pair(key, value));
+        } catch (std::exception& e) {
+            return error("%s : Deserialize or I/O error - %s", __func__, e.what());
+        }
+    }
+    return true;
+}
+
+bool CBlockTreeDB::ReadAddressBalance(int type, const uint160& hashBytes, CAddressBalance& balance)
+{
+    return Read(make_pair('A', make_pair((unsigned char)type, hashBytes)), balance);
+}
+
 bool CBlockTreeDB::WriteFlag(const std::string& name, bool fValue)
 {
     return Write(std::make_pair('F', name), fValue ? '1' : '0');
@@ -195,6 +410,71 @@ bool CBlockTreeDB::ReadFlag(const std::string& name, bool& fValue)
     return true;
 }
 
+bool CBlockTreeDB::WriteUTXOSnapshot(const uint256& hashBlock, const uint256& hashSerialized)
+{
+    return Write('S', std::make_pair(hashBlock, hashSerialized));
+}
+
+bool CBlockTreeDB::ReadUTXOSnapshot(uint256& hashBlock, uint256& hashSerialized)
+{
+    std::pair<uint256, uint256> snapshot;
+    if (!Read('S', snapshot))
+        return false;
+    hashBlock = snapshot.first;
+    hashSerialized = snapshot.second;
+    return true;
+}
+
+bool CBlockTreeDB::EraseUTXOSnapshot()
+{
+    return Erase('S');
+}
+
+/** Number of block index records decoded and checked together */
+static const size_t BLOCK_INDEX_LOAD_BATCH = 16384;
+
+typedef std::vector<std::pair<uint256, CDiskBlockIndex> > BlockIndexBatch;
+
+/**
+ * Re-hash the headers of proof-of-work era entries and check their work.
+ * Entries at or below the last checkpoint are skipped. Quark hashing
+ * dominates startup time, so the work is spread over all cores.
+ */
+static bool CheckBlockIndexBatch(const BlockIndexBatch& vBatch, int nCheckpointHeight)
+{
+    std::vector<size_t> vCheck;
+    for (size_t i = 0; i < vBatch.size(); i++) {
+        const int nHeight = vBatch[i].second.nHeight;
+        if (nHeight <= Params().LAST_POW_BLOCK() && nHeight > nCheckpointHeight)
+            vCheck.push_back(i);
+    }
+    if (vCheck.empty())
+        return true;
+
+    std::atomic<size_t> nNext(0);
+    std::atomic<size_t> nFailed(vBatch.size());
+    auto worker = [&]() {
+        size_t n;
+        while (nFailed == vBatch.size() && (n = nNext++) < vCheck.size()) {
+            const uint256& hash = vBatch[vCheck[n]].first;
+            const CDiskBlockIndex& diskindex = vBatch[vCheck[n]].second;
+            if (diskindex.GetBlockHash() != hash || !CheckProofOfWork(hash, diskindex.nBits))
+                nFailed = vCheck[n];
+        }
+    };
+
+    const int nThreads = std::min<int>(boost::thread::hardware_concurrency(), vCheck.size());
+    boost::thread_group threadGroup;
+    for (int i = 1; i < nThreads; i++)
+        threadGroup.create_thread(worker);
+    worker();
+    threadGroup.join_all();
+
+    if (nFailed != vBatch.size())
+        return error("LoadBlockIndex() : CheckProofOfWork failed: %s", vBatch[nFailed].second.ToString());
+    return true;
+}
+
 bool CBlockTreeDB::LoadBlockIndexGuts()
 {
     boost::scoped_ptr<leveldb::Iterator> pcursor(NewIterator());
@@ -203,59 +483,79 @@ bool CBlockTreeDB::LoadBlockIndexGuts()
     ssKeySet << make_pair('b', uint256());
     pcursor->Seek(ssKeySet.str());
 
+    const int nCheckpointHeight = Checkpoints::GetTotalBlocksEstimate();
+
+    BlockIndexBatch vBatch;
+    vBatch.reserve(BLOCK_INDEX_LOAD_BATCH);
+
     // Load mapBlockIndex
-    while (pcursor->Valid()) {
+    bool fDone = false;
+    while (!fDone) {
         boost::this_thread::interruption_point();
-        try {
-            leveldb::Slice slKey = pcursor->key();
-            CDataStream ssKey(slKey.data(), slKey.data() + slKey.size(), SER_DISK, CLIENT_VERSION);
-            char chType;
-            ssKey >> chType;
-            if (chType == 'b') {
+
+        // Decode the next batch of records. The block hash is the record key,
+        // so headers only need to be re-hashed where proof of work is checked.
+        vBatch.clear();
+        while (vBatch.size() < BLOCK_INDEX_LOAD_BATCH) {
+            if (!pcursor->Valid()) {
+                fDone = true;
+                break;
+            }
+            try {
+                leveldb::Slice slKey = pcursor->key();
+                CDataStream ssKey(slKey.data(), slKey.data() + slKey.size(), SER_DISK, CLIENT_VERSION);
+                char chType;
+                ssKey >> chType;
+                if (chType != 'b') {
+                    fDone = true;
+                    break;
+                }
+                vBatch.push_back(std::make_pair(uint256(), CDiskBlockIndex()));
+                ssKey >> vBatch.back().first;
                 leveldb::Slice slValue = pcursor->value();
                 CDataStream ssValue(slValue.data(), slValue.data() + slValue.size(), SER_DISK, CLIENT_VERSION);
-                CDiskBlockIndex diskindex;
-                ssValue >> diskindex;
-
-                // Construct block index object
-                CBlockIndex* pindexNew = InsertBlockIndex(diskindex.GetBlockHash());
-                pindexNew->pprev = InsertBlockIndex(diskindex.hashPrev);
-                pindexNew->pnext = InsertBlockIndex(diskindex.hashNext);
-                pindexNew->nHeight = diskindex.nHeight;
-                pindexNew->nFile = diskindex.nFile;
-                pindexNew->nDataPos = diskindex.nDataPos;
-                pindexNew->nUndoPos = diskindex.nUndoPos;
-                pindexNew->nVersion = diskindex.nVersion;
-                pindexNew->hashMerkleRoot = diskindex.hashMerkleRoot;
-                pindexNew->nTime = diskindex.nTime;
-                pindexNew->nBits = diskindex.nBits;
-                pindexNew->nNonce = diskindex.nNonce;
-                pindexNew->nStatus = diskindex.nStatus;
-                pindexNew->nTx = diskindex.nTx;
-
-                //Proof Of Stake
-                pindexNew->nMint = diskindex.nMint;
-                pindexNew->nMoneySupply = diskindex.nMoneySupply;
-                pindexNew->nFlags = diskindex.nFlags;
-                pindexNew->nStakeModifier = diskindex.nStakeModifier;
-                pindexNew->prevoutStake = diskindex.prevoutStake;
-                pindexNew->nStakeTime = diskindex.nStakeTime;
-                pindexNew->hashProofOfStake = diskindex.hashProofOfStake;
-
-                if (pindexNew->nHeight <= Params().LAST_POW_BLOCK()) {
-                    if (!CheckProofOfWork(pindexNew->GetBlockHash(), pindexNew->nBits))
-                        return error("LoadBlockIndex() : CheckProofOfWork failed: %s", pindexNew->ToString());
-                }
-                // ppcoin: build setStakeSeen
-                if (pindexNew->IsProofOfStake())
-                    setStakeSeen.insert(make_pair(pindexNew->prevoutStake, pindexNew->nStakeTime));
-
+                ssValue >> vBatch.back().second;
                 pcursor->Next();
-            } else {
-                break; // if shutdown requested or finished loading block index
+            } catch (std::exception& e) {
+                return error("%s : Deserialize or I/O error - %s", __func__, e.what());
             }
-        } catch (std::exception& e) {
-            return error("%s : Deserialize or I/O error - %s", __func__, e.what());
+        }
+
+        if (!CheckBlockIndexBatch(vBatch, nCheckpointHeight))
+            return false;
+
+        mapBlockIndex.reserve(mapBlockIndex.size() + vBatch.size());
+        for (const std::pair<uint256, CDiskBlockIndex>& entry : vBatch) {
+            const CDiskBlockIndex& diskindex = entry.second;
+
+            // Construct block index object
+            CBlockIndex* pindexNew = InsertBlockIndex(entry.first);
+            pindexNew->pprev = InsertBlockIndex(diskindex.hashPrev);
+            pindexNew->pnext = InsertBlockIndex(diskindex.hashNext);
+            pindexNew->nHeight = diskindex.nHeight;
+            pindexNew->nFile = diskindex.nFile;
+            pindexNew->nDataPos = diskindex.nDataPos;
+            pindexNew->nUndoPos = diskindex.nUndoPos;
+            pindexNew->nVersion = diskindex.nVersion;
+            pindexNew->hashMerkleRoot = diskindex.hashMerkleRoot;
+            pindexNew->nTime = diskindex.nTime;
+            pindexNew->nBits = diskindex.nBits;
+            pindexNew->nNonce = diskindex.nNonce;
+            pindexNew->nStatus = diskindex.nStatus;
+            pindexNew->nTx = diskindex.nTx;
+
+            //Proof Of Stake
+            pindexNew->nMint = diskindex.nMint;
+            pindexNew->nMoneySupply = diskindex.nMoneySupply;
+            pindexNew->nFlags = diskindex.nFlags;
+            pindexNew->nStakeModifier = diskindex.nStakeModifier;
+            pindexNew->prevoutStake = diskindex.prevoutStake;
+            pindexNew->nStakeTime = diskindex.nStakeTime;
+            pindexNew->hashProofOfStake = diskindex.hashProofOfStake;
+
+            // ppcoin: build setStakeSeen
+            if (pindexNew->IsProofOfStake())
+                setStakeSeen.insert(make_pair(pindexNew->prevoutStake, pindexNew->nStakeTime));
         }
     }
 
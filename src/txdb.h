@@ -6,6 +6,7 @@
 #ifndef BITCOIN_TXDB_H
 #define BITCOIN_TXDB_H
 
+#include "addressindex.h"
 #include "leveldbwrapper.h"
 #include "coins.h"
 #include "chain.h"
@@ -15,8 +16,11 @@
 #include <utility>
 #include <vector>
 
+#include <boost/scoped_ptr.hpp>
+
 class CBlockFileInfo;
 class CDiskTxPos;
+class CHashWriter;
 
 //! -dbcache default (MiB)
 static const int64_t nDefaultDbCache = 100;
@@ -25,6 +29,31 @@ static const int64_t nMaxDbCache = sizeof(void*) > 4 ? 4096 : 1024;
 //! min. -dbcache in (MiB)
 static const int64_t nMinDbCache = 4;
 
+/** Add a coins entry to the hash_serialized commitment of gettxoutsetinfo */
+void HashCoins(CHashWriter& ss, const uint256& txid, const CCoins& coins);
+
+/** Iterator over the coins of a CCoinsViewDB, as they were when it was created */
+class CCoinsViewDBCursor
+{
+public:
+    ~CCoinsViewDBCursor();
+
+    bool Valid() const;
+    void Next();
+    bool GetKey(uint256& txid) const;
+    bool GetValue(CCoins& coins) const;
+    unsigned int GetValueSize() const;
+    //! best block of the database when the cursor was created
+    const uint256& GetBestBlock() const { return hashBlock; }
+
+private:
+    friend class CCoinsViewDB;
+    CCoinsViewDBCursor(leveldb::Iterator* pcursorIn, const uint256& hashBlockIn);
+
+    boost::scoped_ptr<leveldb::Iterator> pcursor;
+    uint256 hashBlock;
+};
+
 /** CCoinsView backed by the LevelDB coin database (chainstate/) */
 class CCoinsViewDB : public CCoinsView
 {
@@ -32,13 +61,15 @@ protected:
     CLevelDBWrapper db;
 
 public:
-    CCoinsViewDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+    CCoinsViewDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false, const std::string& strName = "chainstate");
 
     bool GetCoins(const uint256& txid, CCoins& coins) const;
     bool HaveCoins(const uint256& txid) const;
     uint256 GetBestBlock() const;
     bool BatchWrite(CCoinsMap& mapCoins, const uint256& hashBlock);
     bool GetStats(CCoinsStats& stats) const;
+    //! Iterate over the coins; hold cs_main while creating it for a best block that matches them
+    CCoinsViewDBCursor* Cursor() const;
 };
 
 /** Access to the block database (blocks/index/) */
@@ -61,9 +92,20 @@ public:
     bool ReadReindexing(bool& fReindex);
     bool ReadTxIndex(const uint256& txid, CDiskTxPos& pos);
     bool WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos> >& list);
+    bool WriteAddressIndex(const std::vector<CAddressIndexEntry>& vIndex, const std::vector<CAddressUnspentEntry>& vUnspent, int nHeight);
+    bool EraseAddressIndex(const std::vector<CAddressIndexEntry>& vIndex, const std::vector<CAddressUnspentEntry>& vUnspent, int nHeight);
+    bool ReadAddressIndex(int type, const uint160& hashBytes, std::vector<CAddressIndexEntry>& vIndex, int nStart = 0, int nEnd = 0);
+    bool ReadAddressUnspentIndex(int type, const uint160& hashBytes, std::vector<CAddressUnspentEntry>& vUnspent);
+    bool ReadAddressBalance(int type, const uint160& hashBytes, CAddressBalance& balance);
     bool WriteFlag(const std::string& name, bool fValue);
     bool ReadFlag(const std::string& name, bool& fValue);
+    bool WriteUTXOSnapshot(const uint256& hashBlock, const uint256& hashSerialized);
+    bool ReadUTXOSnapshot(uint256& hashBlock, uint256& hashSerialized);
+    bool EraseUTXOSnapshot();
     bool LoadBlockIndexGuts();
+
+private:
+    void BatchAddressIndex(CLevelDBBatch& batch, const std::vector<CAddressIndexEntry>& vIndex, const std::vector<CAddressUnspentEntry>& vUnspent, int nHeight, bool fConnect);
 };
 
 #endif // BITCOIN_TXDB_H
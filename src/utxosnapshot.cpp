@@ -0,0 +1,402 @@
+// Copyright (c) 2018 The Blocknet developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "utxosnapshot.h"
+
+#include "alert.h"
+#include "chainparams.h"
+#include "checkpoints.h"
+#include "hash.h"
+#include "main.h"
+#include "streams.h"
+#include "txdb.h"
+#include "ui_interface.h"
+#include "util.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <boost/filesystem.hpp>
+#include <boost/foreach.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread.hpp>
+
+/** Coins written to the coin database per batch when loading or wiping it */
+static const unsigned int SNAPSHOT_BATCH_COINS = 50000;
+
+/** Coin database the blocks up to a loaded snapshot are replayed into */
+static const char* const SNAPSHOT_VALIDATION_DB = "chainstate_snapshot";
+
+/** LevelDB cache of the replay database, whose coins cache takes up to half of nCoinCacheUsage */
+static const size_t SNAPSHOT_VALIDATION_DB_CACHE = 8 << 20;
+
+static boost::mutex csSnapshotLoaded;
+static boost::condition_variable condSnapshotLoaded;
+static bool fSnapshotLoaded = false;
+
+bool WriteUTXOSnapshot(CCoinsViewDBCursor& cursor, int nHeight, CAutoFile& fileout, CUTXOSnapshotMetadata& metadata, uint256& hashSerialized)
+{
+    metadata = CUTXOSnapshotMetadata();
+    metadata.hashBlock = cursor.GetBestBlock();
+    metadata.nHeight = nHeight;
+
+    CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
+    ss << metadata.hashBlock;
+    try {
+        fileout.write((const char*)Params().MessageStart(), MESSAGE_START_SIZE);
+        fileout << metadata;
+        for (; cursor.Valid(); cursor.Next()) {
+            uint256 txid;
+            CCoins coins;
+            if (!cursor.GetKey(txid) || !cursor.GetValue(coins))
+                return error("%s : Failed to read the coin database", __func__);
+            fileout << txid << coins;
+            HashCoins(ss, txid, coins);
+            metadata.nTransactions++;
+        }
+
+        // the header goes first but the number of entries is only known now
+        if (fseek(fileout.Get(), MESSAGE_START_SIZE, SEEK_SET) != 0)
+            return error("%s : Failed to seek to the header", __func__);
+        fileout << metadata;
+        FileCommit(fileout.Get());
+    } catch (const std::exception& e) {
+        return error("%s : Serialize or I/O error - %s", __func__, e.what());
+    }
+    hashSerialized = ss.GetHash();
+    return true;
+}
+
+bool ReadUTXOSnapshot(CAutoFile& filein, CUTXOSnapshotMetadata& metadata, uint256& hashSerialized, CCoinsViewDB* pview)
+{
+    CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
+    try {
+        unsigned char pchMessageStart[MESSAGE_START_SIZE];
+        filein.read((char*)pchMessageStart, MESSAGE_START_SIZE);
+        if (memcmp(pchMessageStart, Params().MessageStart(), MESSAGE_START_SIZE) != 0)
+            return error("%s : Snapshot of another network", __func__);
+        filein >> metadata;
+        if (metadata.nFormatVersion != CUTXOSnapshotMetadata::CURRENT_VERSION)
+            return error("%s : Unknown snapshot version %d", __func__, metadata.nFormatVersion);
+
+        ss << metadata.hashBlock;
+        CCoinsMap mapCoins;
+        for (uint64_t i = 0; i < metadata.nTransactions; i++) {
+            uint256 txid;
+            CCoins coins;
+            filein >> txid >> coins;
+            if (coins.IsPruned())
+                return error("%s : Snapshot lists the spent transaction %s", __func__, txid.ToString());
+            HashCoins(ss, txid, coins);
+
+            if (pview) {
+                CCoinsCacheEntry& entry = mapCoins[txid];
+                entry.coins.swap(coins);
+                entry.flags = CCoinsCacheEntry::DIRTY;
+                if (mapCoins.size() >= SNAPSHOT_BATCH_COINS && !pview->BatchWrite(mapCoins, uint256()))
+                    return error("%s : Failed to write the coin database", __func__);
+            }
+        }
+        if (pview && !pview->BatchWrite(mapCoins, uint256()))
+            return error("%s : Failed to write the coin database", __func__);
+    } catch (const std::exception& e) {
+        return error("%s : Deserialize or I/O error - %s", __func__, e.what());
+    }
+    hashSerialized = ss.GetHash();
+    return true;
+}
+
+bool WipeCoins(CCoinsViewDB& view)
+{
+    boost::scoped_ptr<CCoinsViewDBCursor> pcursor(view.Cursor());
+    CCoinsMap mapCoins;
+    for (; pcursor->Valid(); pcursor->Next()) {
+        uint256 txid;
+        if (!pcursor->GetKey(txid))
+            return false;
+        // a dirty entry without outputs erases the record
+        mapCoins[txid].flags = CCoinsCacheEntry::DIRTY;
+        if (mapCoins.size() >= SNAPSHOT_BATCH_COINS && !view.BatchWrite(mapCoins, uint256()))
+            return false;
+    }
+    return view.BatchWrite(mapCoins, uint256());
+}
+
+bool DumpUTXOSnapshot(const boost::filesystem::path& path, CUTXOSnapshotMetadata& metadata, uint256& hashSerialized, std::string& strError)
+{
+    if (boost::filesystem::exists(path)) {
+        strError = strprintf("%s already exists", path.string());
+        return false;
+    }
+
+    // The cursor sees the coins as they are now, without holding cs_main while they are written
+    boost::scoped_ptr<CCoinsViewDBCursor> pcursor;
+    int nHeight;
+    {
+        LOCK(cs_main);
+        FlushStateToDisk();
+        pcursor.reset(pcoinsdbview->Cursor());
+        BlockMap::const_iterator it = mapBlockIndex.find(pcursor->GetBestBlock());
+        if (it == mapBlockIndex.end()) {
+            strError = "The chain state has no best block";
+            return false;
+        }
+        nHeight = it->second->nHeight;
+    }
+
+    boost::filesystem::path pathTemp = path.string() + ".incomplete";
+    CAutoFile fileout(fopen(pathTemp.string().c_str(), "wb"), SER_DISK, CLIENT_VERSION);
+    if (fileout.IsNull()) {
+        strError = strprintf("Failed to open %s", pathTemp.string());
+        return false;
+    }
+
+    LogPrintf("Dumping the UTXO set at height %d to %s\n", nHeight, path.string());
+    bool fWritten = WriteUTXOSnapshot(*pcursor, nHeight, fileout, metadata, hashSerialized);
+    fileout.fclose();
+    if (!fWritten || !RenameOver(pathTemp, path)) {
+        boost::filesystem::remove(pathTemp);
+        strError = strprintf("Failed to write %s", path.string());
+        return false;
+    }
+    LogPrintf("Dumped %u transactions, hash_serialized %s\n", metadata.nTransactions, hashSerialized.ToString());
+    return true;
+}
+
+bool LoadUTXOSnapshot(const boost::filesystem::path& path, CUTXOSnapshotMetadata& metadata, std::string& strError)
+{
+    // Check the whole file before touching the chain state
+    uint256 hashSerialized;
+    {
+        CAutoFile filein(fopen(path.string().c_str(), "rb"), SER_DISK, CLIENT_VERSION);
+        if (filein.IsNull()) {
+            strError = strprintf("Failed to open %s", path.string());
+            return false;
+        }
+        if (!ReadUTXOSnapshot(filein, metadata, hashSerialized)) {
+            strError = strprintf("%s is not a valid snapshot", path.string());
+            return false;
+        }
+    }
+
+    MapUTXOSnapshots::const_iterator itSnapshot = Params().UTXOSnapshots().find(metadata.nHeight);
+    if (itSnapshot == Params().UTXOSnapshots().end() || itSnapshot->second.hashBlock != metadata.hashBlock) {
+        strError = strprintf("No snapshot of block %s at height %d is known", metadata.hashBlock.ToString(), metadata.nHeight);
+        return false;
+    }
+    if (itSnapshot->second.hashSerialized != hashSerialized) {
+        strError = strprintf("The snapshot hashes to %s instead of %s", hashSerialized.ToString(), itSnapshot->second.hashSerialized.ToString());
+        return false;
+    }
+
+    {
+        LOCK(cs_main);
+        uint256 hashPending, hashPendingSerialized;
+        if (pblocktree->ReadUTXOSnapshot(hashPending, hashPendingSerialized)) {
+            strError = strprintf("The snapshot of block %s is still being validated", hashPending.ToString());
+            return false;
+        }
+
+        BlockMap::iterator it = mapBlockIndex.find(metadata.hashBlock);
+        if (it == mapBlockIndex.end() || it->second->nHeight != metadata.nHeight) {
+            strError = strprintf("Block %s of the snapshot is unknown", metadata.hashBlock.ToString());
+            return false;
+        }
+        CBlockIndex* pindexBase = it->second;
+        if ((pindexBase->nStatus & BLOCK_FAILED_MASK) || pindexBase->nChainTx == 0) {
+            strError = "The blocks up to the snapshot are not all stored, they have to be imported first";
+            return false;
+        }
+        if (chainActive.Tip() && chainActive.Tip()->nChainWork >= pindexBase->nChainWork) {
+            strError = "The active chain is already past the snapshot";
+            return false;
+        }
+
+        LogPrintf("Loading the UTXO snapshot of block %s at height %d\n", metadata.hashBlock.ToString(), metadata.nHeight);
+        FlushStateToDisk();
+
+        // A partly replaced coin database is unusable, the next start has to know
+        uint256 hashLoaded;
+        CAutoFile filein(fopen(path.string().c_str(), "rb"), SER_DISK, CLIENT_VERSION);
+        CCoinsMap mapNone;
+        if (filein.IsNull() ||
+            !pblocktree->WriteFlag("utxosnapshotloading", true) ||
+            !WipeCoins(*pcoinsdbview) ||
+            !ReadUTXOSnapshot(filein, metadata, hashLoaded, pcoinsdbview) ||
+            hashLoaded != hashSerialized ||
+            !pcoinsdbview->BatchWrite(mapNone, metadata.hashBlock) ||
+            !pblocktree->WriteUTXOSnapshot(metadata.hashBlock, hashSerialized) ||
+            !pblocktree->WriteFlag("utxosnapshotloading", false) ||
+            !ActivateUTXOSnapshot(pindexBase)) {
+            strError = "Failed to load the snapshot, the database needs to be rebuilt using -reindex";
+            return false;
+        }
+        LogPrintf("Loaded %u transactions of the UTXO snapshot\n", metadata.nTransactions);
+    }
+
+    {
+        boost::unique_lock<boost::mutex> lock(csSnapshotLoaded);
+        fSnapshotLoaded = true;
+    }
+    condSnapshotLoaded.notify_one();
+
+    CValidationState state;
+    ActivateBestChain(state);
+    return true;
+}
+
+/** Connect the transactions of a block to the coins of its parent, checking them like ConnectBlock does */
+static bool ReplayBlock(const CBlock& block, const CBlockIndex* pindex, CCoinsViewCache& view)
+{
+    CValidationState state;
+    bool mutated;
+    if (block.BuildMerkleTree(&mutated) != block.hashMerkleRoot || mutated)
+        return error("%s : Merkle root mismatch", __func__);
+
+    // BIP16 didn't become active until Apr 1 2012
+    int64_t nBIP16SwitchTime = 1333238400;
+    unsigned int flags = pindex->GetBlockTime() >= nBIP16SwitchTime ? SCRIPT_VERIFY_P2SH : SCRIPT_VERIFY_NONE;
+    if (block.nVersion >= 3 && CBlockIndex::IsSuperMajority(3, pindex->pprev, Params().EnforceBlockUpgradeMajority()))
+        flags |= SCRIPT_VERIFY_DERSIG;
+    bool fScriptChecks = pindex->nHeight >= Checkpoints::GetTotalBlocksEstimate();
+
+    std::vector<CScriptCheck> vChecks;
+    {
+        // CheckInputs looks the spending height up in mapBlockIndex
+        LOCK(cs_main);
+        BOOST_FOREACH (const CTransaction& tx, block.vtx) {
+            if (!CheckTransaction(tx, state))
+                return error("%s : Transaction %s is invalid", __func__, tx.GetHash().ToString());
+            if (!tx.IsCoinBase() && !CheckInputs(tx, state, view, fScriptChecks, flags, false, &vChecks))
+                return error("%s : Inputs of transaction %s are invalid", __func__, tx.GetHash().ToString());
+            CTxUndo undoDummy;
+            UpdateCoins(tx, state, view, undoDummy, pindex->nHeight);
+        }
+    }
+
+    // the checks hold their own copies of the spent outputs
+    BOOST_FOREACH (CScriptCheck& check, vChecks) {
+        if (!check())
+            return false;
+    }
+    view.SetBestBlock(pindex->GetBlockHash());
+    return true;
+}
+
+static void UTXOSnapshotInvalid(const std::string& strReason)
+{
+    LogPrintf("*** The chain state loaded from a UTXO snapshot does not match the block chain: %s\n", strReason);
+    strMiscWarning = _("Warning: The chain state loaded from a UTXO snapshot does not match the block chain! Rebuild the database using -reindex.");
+    CAlert::Notify(strMiscWarning, true);
+}
+
+bool ValidateUTXOSnapshot()
+{
+    uint256 hashBase, hashSerialized;
+    const CBlockIndex* pindexBase;
+    {
+        LOCK(cs_main);
+        if (!pblocktree->ReadUTXOSnapshot(hashBase, hashSerialized))
+            return true;
+        BlockMap::const_iterator it = mapBlockIndex.find(hashBase);
+        if (it == mapBlockIndex.end()) {
+            LogPrintf("%s : Block %s of the loaded UTXO snapshot is unknown\n", __func__, hashBase.ToString());
+            return true;
+        }
+        pindexBase = it->second;
+    }
+
+    // Resume where an earlier run got to, as long as that leads up to the snapshot
+    boost::scoped_ptr<CCoinsViewDB> pviewdb(new CCoinsViewDB(SNAPSHOT_VALIDATION_DB_CACHE, false, false, SNAPSHOT_VALIDATION_DB));
+    int nHeight = 0;
+    {
+        LOCK(cs_main);
+        BlockMap::const_iterator it = mapBlockIndex.find(pviewdb->GetBestBlock());
+        if (it != mapBlockIndex.end() && pindexBase->GetAncestor(it->second->nHeight) == it->second)
+            nHeight = it->second->nHeight;
+    }
+    if (nHeight == 0) {
+        pviewdb.reset();
+        pviewdb.reset(new CCoinsViewDB(SNAPSHOT_VALIDATION_DB_CACHE, false, true, SNAPSHOT_VALIDATION_DB));
+    }
+
+    CCoinsViewCache view(pviewdb.get());
+    view.SetBestBlock(pindexBase->GetAncestor(nHeight)->GetBlockHash());
+
+    LogPrintf("Validating the blocks up to the loaded UTXO snapshot from height %d\n", nHeight);
+    int64_t nLastLog = GetTime();
+    while (nHeight < pindexBase->nHeight) {
+        boost::this_thread::interruption_point();
+
+        const CBlockIndex* pindex = pindexBase->GetAncestor(++nHeight);
+        CBlock block;
+        if (!ReadBlockFromDisk(block, pindex)) {
+            LogPrintf("%s : Failed to read block %s, stopping until the next start\n", __func__, pindex->GetBlockHash().ToString());
+            return true;
+        }
+        if (!ReplayBlock(block, pindex, view)) {
+            UTXOSnapshotInvalid(strprintf("block %s at height %d is invalid", pindex->GetBlockHash().ToString(), nHeight));
+            return false;
+        }
+        if (view.DynamicMemoryUsage() > nCoinCacheUsage / 2 && !view.Flush()) {
+            LogPrintf("%s : Failed to write the replayed coins, stopping until the next start\n", __func__);
+            return true;
+        }
+
+        if (GetTime() >= nLastLog + 30) {
+            LogPrintf("Validating the blocks up to the loaded UTXO snapshot at height %d\n", nHeight);
+            nLastLog = GetTime();
+        }
+    }
+    if (!view.Flush()) {
+        LogPrintf("%s : Failed to write the replayed coins, stopping until the next start\n", __func__);
+        return true;
+    }
+
+    // The replayed coins must hash like the snapshot did
+    CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
+    ss << hashBase;
+    {
+        boost::scoped_ptr<CCoinsViewDBCursor> pcursor(pviewdb->Cursor());
+        for (; pcursor->Valid(); pcursor->Next()) {
+            boost::this_thread::interruption_point();
+            uint256 txid;
+            CCoins coins;
+            if (!pcursor->GetKey(txid) || !pcursor->GetValue(coins)) {
+                LogPrintf("%s : Failed to read the replayed coins, stopping until the next start\n", __func__);
+                return true;
+            }
+            HashCoins(ss, txid, coins);
+        }
+    }
+    if (ss.GetHash() != hashSerialized) {
+        UTXOSnapshotInvalid(strprintf("the blocks up to it hash to %s instead of %s", ss.GetHash().ToString(), hashSerialized.ToString()));
+        return false;
+    }
+
+    pviewdb.reset();
+    {
+        LOCK(cs_main);
+        pblocktree->EraseUTXOSnapshot();
+    }
+    try {
+        boost::filesystem::remove_all(GetDataDir() / SNAPSHOT_VALIDATION_DB);
+    } catch (const boost::filesystem::filesystem_error& e) {
+        LogPrintf("%s : %s\n", __func__, e.what());
+    }
+    LogPrintf("Validated the blocks up to the loaded UTXO snapshot of block %s\n", hashBase.ToString());
+    return true;
+}
+
+void ThreadValidateUTXOSnapshot()
+{
+    while (true) {
+        ValidateUTXOSnapshot();
+
+        boost::unique_lock<boost::mutex> lock(csSnapshotLoaded);
+        while (!fSnapshotLoaded)
+            condSnapshotLoaded.wait(lock);
+        fSnapshotLoaded = false;
+    }
+}
@@ -0,0 +1,82 @@
+// Copyright (c) 2018 The Blocknet developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef UTXOSNAPSHOT_H
+#define UTXOSNAPSHOT_H
+
+#include "serialize.h"
+#include "uint256.h"
+
+#include <stdint.h>
+#include <string>
+
+#include <boost/filesystem/path.hpp>
+
+class CAutoFile;
+class CCoinsViewDB;
+class CCoinsViewDBCursor;
+
+/**
+ * Header of a UTXO snapshot file. It is followed by nTransactions entries of a
+ * txid and its CCoins, in the order of the coin database, so the coins of a
+ * snapshot hash to the hash_serialized gettxoutsetinfo reports at hashBlock.
+ */
+class CUTXOSnapshotMetadata
+{
+public:
+    static const int CURRENT_VERSION = 1;
+
+    int nFormatVersion;
+    uint256 hashBlock;
+    int nHeight;
+    uint64_t nTransactions;
+
+    CUTXOSnapshotMetadata() : nFormatVersion(CURRENT_VERSION), nHeight(0), nTransactions(0) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
+    {
+        READWRITE(nFormatVersion);
+        READWRITE(hashBlock);
+        READWRITE(nHeight);
+        READWRITE(nTransactions);
+    }
+};
+
+/** Write the coins the cursor iterates over to a snapshot file, taken at nHeight */
+bool WriteUTXOSnapshot(CCoinsViewDBCursor& cursor, int nHeight, CAutoFile& fileout, CUTXOSnapshotMetadata& metadata, uint256& hashSerialized);
+
+/**
+ * Read a snapshot file through and compute the hash of its coins. With pview
+ * the coins are also written to it, which must have been wiped beforehand; its
+ * best block is left to the caller, to set once the hash was checked.
+ */
+bool ReadUTXOSnapshot(CAutoFile& filein, CUTXOSnapshotMetadata& metadata, uint256& hashSerialized, CCoinsViewDB* pview = NULL);
+
+/** Erase all coins of the database, leaving its best block as is */
+bool WipeCoins(CCoinsViewDB& view);
+
+/** Dump the chain state at the tip of the active chain to a new snapshot file */
+bool DumpUTXOSnapshot(const boost::filesystem::path& path, CUTXOSnapshotMetadata& metadata, uint256& hashSerialized, std::string& strError);
+
+/**
+ * Replace the chain state with a snapshot file taken at a block of the chain
+ * params' UTXOSnapshots(), whose block and ancestors are stored but not yet
+ * connected, and start validating the blocks up to it in the background.
+ */
+bool LoadUTXOSnapshot(const boost::filesystem::path& path, CUTXOSnapshotMetadata& metadata, std::string& strError);
+
+/**
+ * Replay the blocks up to the loaded snapshot, if one is pending, into a coin
+ * database of its own, checking their transactions and scripts, and compare the
+ * outcome with the snapshot. Returns false if they do not match it.
+ */
+bool ValidateUTXOSnapshot();
+
+/** Run ValidateUTXOSnapshot, then again each time a snapshot is loaded */
+void ThreadValidateUTXOSnapshot();
+
+#endif // UTXOSNAPSHOT_H
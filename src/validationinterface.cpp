@@ -5,15 +5,185 @@
 
 #include "validationinterface.h"
 
+#include "main.h"
+#include "primitives/block.h"
+#include "util.h"
+
+#include <deque>
+
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
+#include <boost/thread.hpp>
+
 static CMainSignals g_signals;
 
+namespace
+{
+/**
+ * FIFO of pending notifications with a single consumer. fBusy is set while a
+ * notification is being delivered, either by the queue thread or inline by a poster
+ * while the thread is not running, so delivery order is preserved in both modes.
+ */
+class CValidationQueue
+{
+public:
+    CValidationQueue() : fRunning(false), fBusy(false), nLimit(DEFAULT_VALIDATION_QUEUE_SIZE),
+                         nPeak(0), nPosted(0), nDelivered(0), nThrottled(0) {}
+
+    void Post(const boost::function<void()>& fn)
+    {
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            queue.push_back(fn);
+            ++nPosted;
+            nPeak = std::max(nPeak, queue.size());
+            if (fRunning) {
+                cond.notify_all();
+                return;
+            }
+        }
+        DeliverInline();
+    }
+
+    void Run(size_t nLimitIn)
+    {
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            nLimit = nLimitIn;
+            worker = boost::this_thread::get_id();
+            fRunning = true;
+        }
+        try {
+            while (true) {
+                boost::function<void()> fn;
+                {
+                    boost::unique_lock<boost::mutex> lock(mutex);
+                    while (queue.empty() || fBusy)
+                        cond.wait(lock);
+                    fn.swap(queue.front());
+                    queue.pop_front();
+                    fBusy = true;
+                }
+                fn();
+                {
+                    boost::unique_lock<boost::mutex> lock(mutex);
+                    fBusy = false;
+                    ++nDelivered;
+                }
+                cond.notify_all();
+            }
+        } catch (...) {
+            {
+                boost::unique_lock<boost::mutex> lock(mutex);
+                fRunning = false;
+                fBusy = false;
+            }
+            cond.notify_all();
+            throw;
+        }
+    }
+
+    void Sync()
+    {
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            if (fRunning && boost::this_thread::get_id() == worker)
+                return;
+            while (fRunning && (!queue.empty() || fBusy))
+                cond.wait(lock);
+        }
+        DeliverInline();
+    }
+
+    void Limit()
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        if (!fRunning || boost::this_thread::get_id() == worker || queue.size() <= nLimit)
+            return;
+        ++nThrottled;
+        // Callers don't hold cs_main, but a listener could still be waiting for some
+        // other lock of theirs, so only keep waiting while the queue thread makes progress.
+        while (fRunning && queue.size() > nLimit) {
+            const uint64_t nLast = nDelivered;
+            cond.timed_wait(lock, boost::posix_time::milliseconds(100));
+            if (nDelivered == nLast)
+                break;
+        }
+    }
+
+    CValidationQueueStats Stats()
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        CValidationQueueStats stats;
+        stats.fRunning = fRunning;
+        stats.nDepth = queue.size();
+        stats.nPeak = nPeak;
+        stats.nLimit = nLimit;
+        stats.nPosted = nPosted;
+        stats.nDelivered = nDelivered;
+        stats.nThrottled = nThrottled;
+        return stats;
+    }
+
+private:
+    void DeliverInline()
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        if (fBusy)
+            return; // whoever is delivering will pick up the rest
+        while (!fRunning && !queue.empty()) {
+            boost::function<void()> fn;
+            fn.swap(queue.front());
+            queue.pop_front();
+            fBusy = true;
+            lock.unlock();
+            try {
+                fn();
+            } catch (...) {
+                lock.lock();
+                fBusy = false;
+                throw;
+            }
+            lock.lock();
+            fBusy = false;
+            ++nDelivered;
+        }
+        cond.notify_all();
+    }
+
+    boost::mutex mutex;
+    boost::condition_variable cond;
+    std::deque<boost::function<void()> > queue;
+    boost::thread::id worker;
+    bool fRunning;
+    bool fBusy;
+    size_t nLimit;
+    size_t nPeak;
+    uint64_t nPosted;
+    uint64_t nDelivered;
+    uint64_t nThrottled;
+};
+
+CValidationQueue validationQueue;
+
+void DeliverSyncTransaction(const CTransaction& tx, const boost::shared_ptr<const CBlock>& pblock)
+{
+    g_signals.SyncTransaction(tx, pblock.get());
+}
+
+void DeliverUpdatedBlockTip(const CBlockIndex* pindex, const boost::shared_ptr<const CBlock>& pblock)
+{
+    g_signals.UpdatedBlockTip(pindex, pblock.get());
+}
+} // anon namespace
+
 CMainSignals& GetMainSignals()
 {
     return g_signals;
 }
 
 void RegisterValidationInterface(CValidationInterface* pwalletIn) {
-    g_signals.UpdatedBlockTip.connect(boost::bind(&CValidationInterface::UpdatedBlockTip, pwalletIn, _1));
+    g_signals.UpdatedBlockTip.connect(boost::bind(&CValidationInterface::UpdatedBlockTip, pwalletIn, _1, _2));
     g_signals.SyncTransaction.connect(boost::bind(&CValidationInterface::SyncTransaction, pwalletIn, _1, _2));
     g_signals.NotifyTransactionLock.connect(boost::bind(&CValidationInterface::NotifyTransactionLock, pwalletIn, _1));
     g_signals.UpdatedTransaction.connect(boost::bind(&CValidationInterface::UpdatedTransaction, pwalletIn, _1));
@@ -35,7 +205,7 @@ void UnregisterValidationInterface(CValidationInterface* pwalletIn) {
     g_signals.UpdatedTransaction.disconnect(boost::bind(&CValidationInterface::UpdatedTransaction, pwalletIn, _1));
     g_signals.NotifyTransactionLock.disconnect(boost::bind(&CValidationInterface::NotifyTransactionLock, pwalletIn, _1));
     g_signals.SyncTransaction.disconnect(boost::bind(&CValidationInterface::SyncTransaction, pwalletIn, _1, _2));
-    g_signals.UpdatedBlockTip.disconnect(boost::bind(&CValidationInterface::UpdatedBlockTip, pwalletIn, _1));
+    g_signals.UpdatedBlockTip.disconnect(boost::bind(&CValidationInterface::UpdatedBlockTip, pwalletIn, _1, _2));
 }
 
 void UnregisterAllValidationInterfaces() {
@@ -51,6 +221,33 @@ void UnregisterAllValidationInterfaces() {
     g_signals.UpdatedBlockTip.disconnect_all_slots();
 }
 
-void SyncWithWallets(const CTransaction &tx, const CBlock *pblock = NULL) {
-    g_signals.SyncTransaction(tx, pblock);
+void SyncWithWallets(const CTransaction &tx) {
+    SyncWithWallets(tx, boost::shared_ptr<const CBlock>());
+}
+
+void SyncWithWallets(const CTransaction& tx, const boost::shared_ptr<const CBlock>& pblock) {
+    validationQueue.Post(boost::bind(&DeliverSyncTransaction, tx, pblock));
+}
+
+void NotifyUpdatedBlockTip(const CBlockIndex* pindex, const boost::shared_ptr<const CBlock>& pblock) {
+    // Block index entries are never freed, so the pointer outlives the queue
+    validationQueue.Post(boost::bind(&DeliverUpdatedBlockTip, pindex, pblock));
+}
+
+void ThreadValidationQueue() {
+    validationQueue.Run(std::max(1, (int)GetArg("-maxvalidationqueue", DEFAULT_VALIDATION_QUEUE_SIZE)));
+}
+
+void SyncWithValidationInterfaceQueue() {
+    AssertLockNotHeld(cs_main);
+    validationQueue.Sync();
+}
+
+void LimitValidationInterfaceQueue() {
+    AssertLockNotHeld(cs_main);
+    validationQueue.Limit();
+}
+
+CValidationQueueStats GetValidationQueueStats() {
+    return validationQueue.Stats();
 }
@@ -6,6 +6,8 @@
 #ifndef BITCOIN_VALIDATIONINTERFACE_H
 #define BITCOIN_VALIDATIONINTERFACE_H
 
+#include <stdint.h>
+
 #include <boost/signals2/signal.hpp>
 #include <boost/shared_ptr.hpp>
 
@@ -18,6 +20,9 @@ class CValidationInterface;
 class CValidationState;
 class uint256;
 
+/** Default for -maxvalidationqueue, the number of undelivered notifications at which block connection waits */
+static const unsigned int DEFAULT_VALIDATION_QUEUE_SIZE = 2000;
+
 // These functions dispatch to one or all registered wallets
 
 /** Register a wallet to receive updates from core */
@@ -26,12 +31,45 @@ void RegisterValidationInterface(CValidationInterface* pwalletIn);
 void UnregisterValidationInterface(CValidationInterface* pwalletIn);
 /** Unregister all wallets from core */
 void UnregisterAllValidationInterfaces();
-/** Push an updated transaction to all registered wallets */
-void SyncWithWallets(const CTransaction& tx, const CBlock* pblock);
+/** Push an updated transaction that is not in a block to all registered wallets */
+void SyncWithWallets(const CTransaction& tx);
+/** Push a transaction confirmed in pblock to all registered wallets, which share the block until delivered */
+void SyncWithWallets(const CTransaction& tx, const boost::shared_ptr<const CBlock>& pblock);
+/** Notify listeners of a new chain tip. pblock is the tip's block if it is at hand, or empty. */
+void NotifyUpdatedBlockTip(const CBlockIndex* pindex, const boost::shared_ptr<const CBlock>& pblock);
+
+/**
+ * Validation notifications (SyncTransaction, UpdatedBlockTip) are posted
+ * to an ordered queue while cs_main is held and delivered by ThreadValidationQueue, so
+ * listeners like the wallet and ZMQ do not add to block connection time. Until the
+ * thread runs, and after it stops, notifications are delivered by the caller.
+ */
+void ThreadValidationQueue();
+/**
+ * Wait until every notification posted so far has been delivered. Listeners take
+ * cs_main, so this must not be called with cs_main held.
+ */
+void SyncWithValidationInterfaceQueue();
+/**
+ * Wait while more than -maxvalidationqueue notifications are pending and being
+ * delivered. Like SyncWithValidationInterfaceQueue, not to be called with cs_main held.
+ */
+void LimitValidationInterfaceQueue();
+
+struct CValidationQueueStats {
+    bool fRunning;
+    size_t nDepth;
+    size_t nPeak;
+    size_t nLimit;
+    uint64_t nPosted;
+    uint64_t nDelivered;
+    uint64_t nThrottled;
+};
+CValidationQueueStats GetValidationQueueStats();
 
 class CValidationInterface {
 protected:
-    virtual void UpdatedBlockTip(const CBlockIndex *) {}
+    virtual void UpdatedBlockTip(const CBlockIndex *, const CBlock *) {}
     virtual void SyncTransaction(const CTransaction &, const CBlock *) {}
     virtual void NotifyTransactionLock(const CTransaction &) {}
     virtual void SetBestChain(const CBlockLocator &) {}
@@ -48,8 +86,8 @@ protected:
 };
 
 struct CMainSignals {
-    /** Notifies listeners of updated block chain tip */
-    boost::signals2::signal<void (const CBlockIndex *)> UpdatedBlockTip;
+    /** Notifies listeners of updated block chain tip (and its block, if it was at hand) */
+    boost::signals2::signal<void (const CBlockIndex *, const CBlock *)> UpdatedBlockTip;
     /** Notifies listeners of updated transaction data (transaction, and optionally the block it is found in. */
     boost::signals2::signal<void (const CTransaction &, const CBlock *)> SyncTransaction;
     /** Notifies listeners of an updated transaction lock without new data. */
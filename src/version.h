@@ -12,10 +12,13 @@
  * network protocol versioning
  */
 
-static const int PROTOCOL_VERSION = 70712;
+static const int PROTOCOL_VERSION = 70713;
 
 static const int SERVICENODE_WITH_XBRIDGE_INFO_PROTO_VERSION = 70711;
 
+//! "mnvsf"/"mnwf" filtered governance sync and bulk "mvotes"/"fbvotes"/"mnws" replies start with this version
+static const int BULK_GOVERNANCE_SYNC_VERSION = 70713;
+
 //! initial proto version, to be increased after version/verack negotiation
 static const int INIT_PROTO_VERSION = 209;
 
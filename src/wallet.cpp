@@ -426,6 +426,81 @@ void CWallet::AddToSpends(const uint256& wtxid)
         AddToSpends(txin.prevout, wtxid);
 }
 
+/**
+ * Queue a new or changed transaction, and the wallet transactions it spends
+ * from, to be re-evaluated against the unspent index on the next query.
+ */
+void CWallet::MarkUnspentDirty(const CWalletTx& wtx)
+{
+    AssertLockHeld(cs_wallet);
+    setUnspentDirty.insert(wtx.GetHash());
+    if (!wtx.IsCoinBase()) {
+        BOOST_FOREACH (const CTxIn& txin, wtx.vin)
+            if (mapWallet.count(txin.prevout.hash))
+                setUnspentDirty.insert(txin.prevout.hash);
+    }
+    nBalanceVersion++;
+}
+
+/**
+ * Whether a transaction holds an output of ours that no confirmed wallet
+ * transaction spends. Unconfirmed and conflicted spends keep it in the index,
+ * IsSpent() is still checked per output by whoever walks it.
+ */
+bool CWallet::HasUnspentOutput(const CWalletTx& wtx) const
+{
+    const uint256 hash = wtx.GetHash();
+    for (unsigned int i = 0; i < wtx.vout.size(); i++) {
+        if (IsMine(wtx.vout[i]) == ISMINE_NO)
+            continue;
+
+        bool fSpentConfirmed = false;
+        pair<TxSpends::const_iterator, TxSpends::const_iterator> range = mapTxSpends.equal_range(COutPoint(hash, i));
+        for (TxSpends::const_iterator it = range.first; it != range.second && !fSpentConfirmed; ++it) {
+            map<uint256, CWalletTx>::const_iterator mit = mapWallet.find(it->second);
+            // a SwiftTX locked spend does not count, it can still be conflicted before it is mined
+            fSpentConfirmed = mit != mapWallet.end() && mit->second.GetDepthInMainChain(false) >= 1;
+        }
+        if (!fSpentConfirmed)
+            return true;
+    }
+    return false;
+}
+
+void CWallet::UpdateUnspentIndex() const
+{
+    AssertLockHeld(cs_main);
+    AssertLockHeld(cs_wallet);
+
+    // A confirmed spend only leaves the chain through a disconnect, which
+    // hands it back to SyncTransaction. Rebuild all the same if the tip the
+    // index was last brought up to date at is no longer on the active chain.
+    if (fUnspentIndexValid && nUnspentTipHeight >= 0 &&
+        (nUnspentTipHeight > chainActive.Height() || chainActive[nUnspentTipHeight]->GetBlockHash() != hashUnspentTip))
+        fUnspentIndexValid = false;
+
+    if (!fUnspentIndexValid) {
+        setUnspentTx.clear();
+        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
+            if (HasUnspentOutput(it->second))
+                setUnspentTx.insert(setUnspentTx.end(), it->first);
+        }
+        fUnspentIndexValid = true;
+    } else {
+        BOOST_FOREACH (const uint256& hash, setUnspentDirty) {
+            map<uint256, CWalletTx>::const_iterator it = mapWallet.find(hash);
+            if (it != mapWallet.end() && HasUnspentOutput(it->second))
+                setUnspentTx.insert(hash);
+            else
+                setUnspentTx.erase(hash);
+        }
+    }
+    setUnspentDirty.clear();
+
+    nUnspentTipHeight = chainActive.Height();
+    hashUnspentTip = chainActive.Tip() ? chainActive.Tip()->GetBlockHash() : uint256();
+}
+
 bool CWallet::GetServicenodeVinAndKeys(CTxIn& txinRet, CPubKey& pubKeyRet, CKey& keyRet, std::string strTxHash, std::string strOutputIndex)
 {
     // wait for reindex and/or import to finish
@@ -621,6 +696,9 @@ void CWallet::MarkDirty()
         LOCK(cs_wallet);
         BOOST_FOREACH (PAIRTYPE(const uint256, CWalletTx) & item, mapWallet)
             item.second.MarkDirty();
+        // what is ours may have changed too, e.g. after a key import
+        fUnspentIndexValid = false;
+        nBalanceVersion++;
     }
 }
 
@@ -632,6 +710,7 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFromLoadWallet)
         mapWallet[hash] = wtxIn;
         mapWallet[hash].BindWallet(this);
         AddToSpends(hash);
+        fUnspentIndexValid = false;
     } else {
         LOCK(cs_wallet);
         // Inserts only if not already there, returns tx inserted or tx found
@@ -702,6 +781,8 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFromLoadWallet)
             }
         }
 
+        MarkUnspentDirty(wtx);
+
         //// debug print
         LogPrintf("AddToWallet %s  %s%s\n", wtxIn.GetHash().ToString(), (fInsertedNew ? "new" : ""), (fUpdated ? "update" : ""));
 
@@ -772,6 +853,9 @@ void CWallet::EraseFromWallet(const uint256& hash)
         LOCK(cs_wallet);
         if (mapWallet.erase(hash))
             CWalletDB(strWalletFile).EraseTx(hash);
+        setUnspentTx.erase(hash);
+        setUnspentDirty.erase(hash);
+        nBalanceVersion++;
     }
     return;
 }
@@ -1077,46 +1161,117 @@ bool CWalletTx::WriteToDisk()
     return CWalletDB(pwallet->strWalletFile).WriteTx(GetHash(), *this);
 }
 
+/** Blocks read and matched per step of a rescan; cs_main and cs_wallet are free between steps */
+static const size_t WALLET_RESCAN_CHUNK_SIZE = 200;
+
 /**
- * Scan the block chain (starting in pindexStart) for transactions
- * from or to us. If fUpdate is true, found transactions that already
- * exist in the wallet will be updated.
+ * Scan the active chain from pindexStart for wallet transactions.
+ *
+ * Blocks are handled in chunks. Each chunk is read from disk and its
+ * outputs matched against the wallet keys on all cores without holding any
+ * lock, then the candidate transactions are added in chain order under
+ * cs_main and cs_wallet. Returns the number of transactions added or
+ * updated, or -1 if another rescan is running.
  */
 int CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate)
 {
+    bool fExpected = false;
+    if (!fScanningWallet.compare_exchange_strong(fExpected, true)) {
+        LogPrintf("%s : A rescan is already in progress\n", __func__);
+        return -1;
+    }
+    fAbortRescan = false;
+    nScanStartTime = GetTimeMillis();
+    nScanProgress = 0;
+
     int ret = 0;
     int64_t nNow = GetTime();
 
     CBlockIndex* pindex = pindexStart;
+    double dProgressStart, dProgressTip;
     {
-        LOCK2(cs_main, cs_wallet);
+        LOCK(cs_main);
 
         // no need to read and scan block, if block was created before
         // our wallet birthday (as adjusted for block time variability)
         while (pindex && nTimeFirstKey && (pindex->GetBlockTime() < (nTimeFirstKey - 7200)))
             pindex = chainActive.Next(pindex);
 
-        ShowProgress(_("Rescanning..."), 0); // show rescan progress in GUI as dialog or on splashscreen, if -rescan on startup
-        double dProgressStart = Checkpoints::GuessVerificationProgress(pindex, false);
-        double dProgressTip = Checkpoints::GuessVerificationProgress(chainActive.Tip(), false);
-        while (pindex) {
-            if (pindex->nHeight % 100 == 0 && dProgressTip - dProgressStart > 0.0)
-                ShowProgress(_("Rescanning..."), std::max(1, std::min(99, (int)((Checkpoints::GuessVerificationProgress(pindex, false) - dProgressStart) / (dProgressTip - dProgressStart) * 100))));
-
-            CBlock block;
-            ReadBlockFromDisk(block, pindex);
-            BOOST_FOREACH (CTransaction& tx, block.vtx) {
-                if (AddToWalletIfInvolvingMe(tx, &block, fUpdate))
-                    ret++;
+        dProgressStart = Checkpoints::GuessVerificationProgress(pindex, false);
+        dProgressTip = Checkpoints::GuessVerificationProgress(chainActive.Tip(), false);
+    }
+    ShowProgress(_("Rescanning..."), 0); // show rescan progress in GUI as dialog or on splashscreen, if -rescan on startup
+
+    std::vector<CBlockIndex*> vChunk;
+    std::vector<CBlock> vBlocks;
+    std::vector<std::vector<bool> > vIsMine;
+    while (pindex && !fAbortRescan && !ShutdownRequested()) {
+        vChunk.clear();
+        {
+            LOCK(cs_main);
+            // the chain may have reorganized while the locks were released, continue after the fork
+            if (!chainActive.Contains(pindex))
+                pindex = chainActive.Next(chainActive.FindFork(pindex));
+            for (; pindex && vChunk.size() < WALLET_RESCAN_CHUNK_SIZE; pindex = chainActive.Next(pindex))
+                vChunk.push_back(pindex);
+        }
+
+        // read the blocks and match their outputs on all cores
+        vBlocks.assign(vChunk.size(), CBlock());
+        vIsMine.assign(vChunk.size(), std::vector<bool>());
+        std::atomic<size_t> nNext(0);
+        auto worker = [&]() {
+            size_t n;
+            while ((n = nNext++) < vChunk.size()) {
+                ReadBlockFromDisk(vBlocks[n], vChunk[n]);
+                vIsMine[n].resize(vBlocks[n].vtx.size());
+                for (size_t i = 0; i < vBlocks[n].vtx.size(); i++)
+                    vIsMine[n][i] = IsMine(vBlocks[n].vtx[i]);
             }
-            pindex = chainActive.Next(pindex);
+        };
+        const int nThreads = std::min<int>(boost::thread::hardware_concurrency(), vChunk.size());
+        boost::thread_group threadGroup;
+        for (int i = 1; i < nThreads; i++)
+            threadGroup.create_thread(worker);
+        worker();
+        threadGroup.join_all();
+
+        // add the hits in chain order. Spends are only known once the earlier
+        // transactions are in, so inputs are matched here against mapWallet.
+        {
+            LOCK2(cs_main, cs_wallet);
+            for (size_t n = 0; n < vChunk.size(); n++) {
+                if (!chainActive.Contains(vChunk[n])) {
+                    pindex = vChunk[n];
+                    break;
+                }
+                const CBlock& block = vBlocks[n];
+                for (size_t i = 0; i < block.vtx.size(); i++) {
+                    const CTransaction& tx = block.vtx[i];
+                    bool fCandidate = vIsMine[n][i] || mapWallet.count(tx.GetHash());
+                    for (unsigned int j = 0; !fCandidate && j < tx.vin.size(); j++)
+                        fCandidate = mapWallet.count(tx.vin[j].prevout.hash) != 0;
+                    if (fCandidate && AddToWalletIfInvolvingMe(tx, &block, fUpdate))
+                        ret++;
+                }
+            }
+        }
+
+        if (!vChunk.empty() && dProgressTip - dProgressStart > 0.0) {
+            const CBlockIndex* pindexLast = vChunk.back();
+            nScanProgress = std::max(1, std::min(99, (int)((Checkpoints::GuessVerificationProgress(pindexLast, false) - dProgressStart) / (dProgressTip - dProgressStart) * 100)));
+            ShowProgress(_("Rescanning..."), nScanProgress);
             if (GetTime() >= nNow + 60) {
                 nNow = GetTime();
-                LogPrintf("Still rescanning. At block %d. Progress=%f\n", pindex->nHeight, Checkpoints::GuessVerificationProgress(pindex));
+                LogPrintf("Still rescanning. At block %d. Progress=%f\n", pindexLast->nHeight, Checkpoints::GuessVerificationProgress(pindexLast));
             }
         }
-        ShowProgress(_("Rescanning..."), 100); // hide progress dialog in GUI
     }
+    if (pindex && fAbortRescan)
+        LogPrintf("Rescan aborted at block %d\n", pindex->nHeight);
+    ShowProgress(_("Rescanning..."), 100); // hide progress dialog in GUI
+
+    fScanningWallet = false;
     return ret;
 }
 
@@ -1155,7 +1310,10 @@ void CWalletTx::RelayWalletTransaction(std::string strCommand)
             LogPrintf("Relaying wtx %s\n", hash.ToString());
 
             if (strCommand == "ix") {
-                mapTxLockReq.insert(make_pair(hash, (CTransaction) * this));
+                {
+                    LOCK(cs_swifttx);
+                    mapTxLockReq.insert(make_pair(hash, (CTransaction) * this));
+                }
                 CreateNewLock(((CTransaction) * this));
                 RelayTransactionLockReq((CTransaction) * this, true);
             } else {
@@ -1221,19 +1379,55 @@ void CWallet::ResendWalletTransactions()
  */
 
 
-CAmount CWallet::GetBalance() const
+/**
+ * Sum every balance bucket in one pass over the unspent index. The result is
+ * kept until the wallet, the tip or the mempool changes.
+ */
+CWalletBalances CWallet::GetBalances() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx* pcoin = &(*it).second;
-            if (pcoin->IsTrusted())
-                nTotal += pcoin->GetAvailableCredit();
-        }
+    LOCK2(cs_main, cs_wallet);
+    const uint256 hashTip = chainActive.Tip() ? chainActive.Tip()->GetBlockHash() : uint256();
+    const unsigned int nMempoolUpdated = mempool.GetTransactionsUpdated();
+    if (fBalancesCached && nBalancesVersion == nBalanceVersion && hashBalancesTip == hashTip && nBalancesMempoolUpdated == nMempoolUpdated)
+        return cachedBalances;
+
+    UpdateUnspentIndex();
+
+    CWalletBalances balances;
+    BOOST_FOREACH (const uint256& hash, setUnspentTx) {
+        const CWalletTx* pcoin = &mapWallet.find(hash)->second;
+        const bool fTrusted = pcoin->IsTrusted();
+        if (fTrusted) {
+            balances.nTrusted += pcoin->GetAvailableCredit();
+            balances.nWatchOnlyTrusted += pcoin->GetAvailableWatchOnlyCredit();
+        } else if (!IsFinalTx(*pcoin) || pcoin->GetDepthInMainChain() == 0) {
+            balances.nUnconfirmed += pcoin->GetAvailableCredit();
+            balances.nWatchOnlyUnconfirmed += pcoin->GetAvailableWatchOnlyCredit();
+        }
+        balances.nImmature += pcoin->GetImmatureCredit();
+        balances.nWatchOnlyImmature += pcoin->GetImmatureWatchOnlyCredit();
+    }
+
+    BOOST_FOREACH (const COutPoint& outpoint, setLockedCoins) {
+        map<uint256, CWalletTx>::const_iterator it = mapWallet.find(outpoint.hash);
+        if (it == mapWallet.end() || outpoint.n >= it->second.vout.size())
+            continue;
+        const CTxOut& txout = it->second.vout[outpoint.n];
+        if (!IsSpent(outpoint.hash, outpoint.n) && (IsMine(txout) & ISMINE_SPENDABLE) != ISMINE_NO)
+            balances.nLocked += txout.nValue;
     }
 
-    return nTotal;
+    cachedBalances = balances;
+    fBalancesCached = true;
+    nBalancesVersion = nBalanceVersion;
+    hashBalancesTip = hashTip;
+    nBalancesMempoolUpdated = nMempoolUpdated;
+    return balances;
+}
+
+CAmount CWallet::GetBalance() const
+{
+    return GetBalances().nTrusted;
 }
 
 CAmount CWallet::GetAnonymizableBalance() const
@@ -1354,71 +1548,32 @@ CAmount CWallet::GetDenominatedBalance(bool unconfirmed) const
 
 CAmount CWallet::GetUnconfirmedBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx* pcoin = &(*it).second;
-            if (!IsFinalTx(*pcoin) || (!pcoin->IsTrusted() && pcoin->GetDepthInMainChain() == 0))
-                nTotal += pcoin->GetAvailableCredit();
-        }
-    }
-    return nTotal;
+    return GetBalances().nUnconfirmed;
 }
 
 CAmount CWallet::GetImmatureBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx* pcoin = &(*it).second;
-            nTotal += pcoin->GetImmatureCredit();
-        }
-    }
-    return nTotal;
+    return GetBalances().nImmature;
 }
 
 CAmount CWallet::GetWatchOnlyBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx* pcoin = &(*it).second;
-            if (pcoin->IsTrusted())
-                nTotal += pcoin->GetAvailableWatchOnlyCredit();
-        }
-    }
-
-    return nTotal;
+    return GetBalances().nWatchOnlyTrusted;
 }
 
 CAmount CWallet::GetUnconfirmedWatchOnlyBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx* pcoin = &(*it).second;
-            if (!IsFinalTx(*pcoin) || (!pcoin->IsTrusted() && pcoin->GetDepthInMainChain() == 0))
-                nTotal += pcoin->GetAvailableWatchOnlyCredit();
-        }
-    }
-    return nTotal;
+    return GetBalances().nWatchOnlyUnconfirmed;
 }
 
 CAmount CWallet::GetImmatureWatchOnlyBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx* pcoin = &(*it).second;
-            nTotal += pcoin->GetImmatureWatchOnlyCredit();
-        }
-    }
-    return nTotal;
+    return GetBalances().nWatchOnlyImmature;
+}
+
+CAmount CWallet::GetLockedBalance() const
+{
+    return GetBalances().nLocked;
 }
 
 /**
@@ -1430,9 +1585,9 @@ void CWallet::AvailableCoins(vector<COutput>& vCoins, bool fOnlyConfirmed, const
 
     {
         LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const uint256& wtxid = it->first;
-            const CWalletTx* pcoin = &(*it).second;
+        UpdateUnspentIndex();
+        BOOST_FOREACH (const uint256& wtxid, setUnspentTx) {
+            const CWalletTx* pcoin = &mapWallet.find(wtxid)->second;
 
             if (!CheckFinalTx(*pcoin))
                 continue;
@@ -1472,9 +1627,9 @@ void CWallet::AvailableCoins(vector<COutput>& vCoins, bool fOnlyConfirmed, const
 
                 isminetype mine = IsMine(pcoin->vout[i]);
                 if (!(IsSpent(wtxid, i)) && mine != ISMINE_NO &&
-                    (!IsLockedCoin((*it).first, i) || nCoinType == ONLY_SERVICENODE_REQUIRED_AMOUNT) &&
+                    (!IsLockedCoin(wtxid, i) || nCoinType == ONLY_SERVICENODE_REQUIRED_AMOUNT) &&
                     (pcoin->vout[i].nValue > 0 || fIncludeZeroValue) &&
-                    (!coinControl || !coinControl->HasSelected() || coinControl->fAllowOtherInputs || coinControl->IsSelected((*it).first, i)))
+                    (!coinControl || !coinControl->HasSelected() || coinControl->fAllowOtherInputs || coinControl->IsSelected(wtxid, i)))
                     vCoins.push_back(COutput(pcoin, i, nDepth,
                         ((mine & ISMINE_SPENDABLE) != ISMINE_NO) ||
                             (coinControl && coinControl->fAllowWatchOnly && (mine & ISMINE_WATCH_SOLVABLE) != ISMINE_NO)));
@@ -3296,6 +3451,8 @@ bool CWallet::UpdatedTransaction(const uint256& hashTx)
         // Only notify UI if this transaction is in this wallet
         map<uint256, CWalletTx>::const_iterator mi = mapWallet.find(hashTx);
         if (mi != mapWallet.end()) {
+            // a SwiftTX lock changes how deep it counts
+            nBalanceVersion++;
             NotifyTransactionChanged(this, hashTx, CT_UPDATED);
             return true;
         }
@@ -3307,18 +3464,21 @@ void CWallet::LockCoin(const COutPoint& output)
 {
     AssertLockHeld(cs_wallet); // setLockedCoins
     setLockedCoins.insert(output);
+    nBalanceVersion++;
 }
 
 void CWallet::UnlockCoin(const COutPoint &output)
 {
     AssertLockHeld(cs_wallet); // setLockedCoins
     setLockedCoins.erase(output);
+    nBalanceVersion++;
 }
 
 void CWallet::UnlockAllCoins()
 {
     AssertLockHeld(cs_wallet); // setLockedCoins
     setLockedCoins.clear();
+    nBalanceVersion++;
 }
 
 bool CWallet::IsLockedCoin(uint256 hash, unsigned int n) const
@@ -3758,6 +3918,9 @@ int CMerkleTx::GetBlocksToMaturity() const
 
 bool CMerkleTx::AcceptToMemoryPool(bool fLimitFree, bool fRejectInsaneFee, bool ignoreFees)
 {
+    // The obfuscation fee charges get here without cs_main, which also keeps
+    // the script check queue to one user at a time
+    LOCK(cs_main);
     CValidationState state;
     return ::AcceptToMemoryPool(mempool, state, *this, fLimitFree, NULL, fRejectInsaneFee, ignoreFees);
 }
@@ -3769,6 +3932,7 @@ int CMerkleTx::GetTransactionLockSignatures() const
     if (!fEnableSwiftTX) return -1;
 
     //compile consessus vote
+    LOCK(cs_swifttx);
     std::map<uint256, CTransactionLock>::iterator i = mapTxLocks.find(GetHash());
     if (i != mapTxLocks.end()) {
         return (*i).second.CountSignatures();
@@ -3782,6 +3946,7 @@ bool CMerkleTx::IsTransactionLockTimedOut() const
     if (!fEnableSwiftTX) return 0;
 
     //compile consessus vote
+    LOCK(cs_swifttx);
     std::map<uint256, CTransactionLock>::iterator i = mapTxLocks.find(GetHash());
     if (i != mapTxLocks.end()) {
         return GetTime() > (*i).second.nTimeout;
@@ -25,6 +25,7 @@
 #include "walletdb.h"
 
 #include <algorithm>
+#include <atomic>
 #include <map>
 #include <set>
 #include <stdexcept>
@@ -130,6 +131,21 @@ public:
     StringMap destdata;
 };
 
+/** Balance of the wallet split by bucket, summed in one pass over its unspent transactions */
+struct CWalletBalances {
+    CAmount nTrusted;
+    CAmount nUnconfirmed;
+    CAmount nImmature;
+    CAmount nWatchOnlyTrusted;
+    CAmount nWatchOnlyUnconfirmed;
+    CAmount nWatchOnlyImmature;
+    //! spendable outputs held back by LockCoin, they are part of the buckets above too
+    CAmount nLocked;
+
+    CWalletBalances() : nTrusted(0), nUnconfirmed(0), nImmature(0), nWatchOnlyTrusted(0),
+                        nWatchOnlyUnconfirmed(0), nWatchOnlyImmature(0), nLocked(0) {}
+};
+
 /** 
  * A CWallet is an extension of a keystore, which also maintains a set of transactions and balances,
  * and provides the ability to create new transactions.
@@ -142,6 +158,12 @@ private:
 
     CWalletDB* pwalletdbEncryption;
 
+    //! rescan state, read by the RPC thread while a rescan runs elsewhere
+    std::atomic<bool> fScanningWallet;
+    std::atomic<bool> fAbortRescan;
+    std::atomic<int64_t> nScanStartTime;
+    std::atomic<int> nScanProgress;
+
     //! the current wallet version: clients below this version are not able to load the wallet
     int nWalletVersion;
 
@@ -163,6 +185,32 @@ private:
 
     void SyncMetaData(std::pair<TxSpends::iterator, TxSpends::iterator>);
 
+    /**
+     * Wallet transactions that may still hold an output of ours that is not
+     * spent by a confirmed transaction. Balances and coin selection only walk
+     * this set instead of all of mapWallet. Transactions added or changed are
+     * queued in setUnspentDirty and re-evaluated on the next query, the whole
+     * set is rebuilt after MarkDirty() or when the tip it was brought up to
+     * date at left the active chain.
+     */
+    mutable std::set<uint256> setUnspentTx;
+    mutable std::set<uint256> setUnspentDirty;
+    mutable bool fUnspentIndexValid;
+    mutable uint256 hashUnspentTip;
+    mutable int nUnspentTipHeight;
+
+    //! bumped on every change that can move a balance, see GetBalances()
+    int64_t nBalanceVersion;
+    mutable CWalletBalances cachedBalances;
+    mutable bool fBalancesCached;
+    mutable int64_t nBalancesVersion;
+    mutable uint256 hashBalancesTip;
+    mutable unsigned int nBalancesMempoolUpdated;
+
+    void MarkUnspentDirty(const CWalletTx& wtx);
+    bool HasUnspentOutput(const CWalletTx& wtx) const;
+    void UpdateUnspentIndex() const;
+
 public:
     bool MintableCoins();
     bool SelectStakeCoins(std::set<std::pair<const CWalletTx*, unsigned int> >& setCoins, int64_t nTargetAmount) const;
@@ -244,6 +292,16 @@ public:
         nLastResend = 0;
         nTimeFirstKey = 0;
         fWalletUnlockAnonymizeOnly = false;
+        fScanningWallet = false;
+        fAbortRescan = false;
+        nScanStartTime = 0;
+        nScanProgress = 0;
+        fUnspentIndexValid = false;
+        nUnspentTipHeight = -1;
+        nBalanceVersion = 0;
+        fBalancesCached = false;
+        nBalancesVersion = 0;
+        nBalancesMempoolUpdated = 0;
 
         // Stake Settings
         nHashDrift = 45;
@@ -385,8 +443,15 @@ public:
     bool AddToWalletIfInvolvingMe(const CTransaction& tx, const CBlock* pblock, bool fUpdate);
     void EraseFromWallet(const uint256& hash);
     int ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate = false);
+    //! Ask a running rescan to stop after its current chunk of blocks
+    void AbortRescan() { fAbortRescan = true; }
+    bool IsScanning() const { return fScanningWallet; }
+    //! Milliseconds since the running rescan started, and how far it got in percent
+    int64_t ScanningDuration() const { return fScanningWallet ? GetTimeMillis() - nScanStartTime : 0; }
+    int ScanningProgress() const { return fScanningWallet ? (int)nScanProgress : 0; }
     void ReacceptWalletTransactions();
     void ResendWalletTransactions();
+    CWalletBalances GetBalances() const;
     CAmount GetBalance() const;
     CAmount GetUnconfirmedBalance() const;
     CAmount GetImmatureBalance() const;
@@ -398,6 +463,7 @@ public:
     CAmount GetWatchOnlyBalance() const;
     CAmount GetUnconfirmedWatchOnlyBalance() const;
     CAmount GetImmatureWatchOnlyBalance() const;
+    CAmount GetLockedBalance() const;
 
     /**
      * Insert additional inputs into the transaction by
@@ -21,6 +21,7 @@
 #include "xuiconnector.h"
 #include "rpcserver.h"
 #include "net.h"
+#include "packetverifier.h"
 #include "util.h"
 #include "ui_interface.h"
 #include "init.h"
@@ -29,6 +30,7 @@
 #include "activeservicenode.h"
 #include "sync.h"
 #include "spork.h"
+#include "validationinterface.h"
 
 #include <algorithm>
 #include <assert.h>
@@ -542,6 +544,7 @@ SessionPtr App::Impl::getSession(const std::vector<unsigned char> & address)
 //*****************************************************************************
 void App::onMessageReceived(const std::vector<unsigned char> & id,
                             const std::vector<unsigned char> & message,
+                            CPacketVerifyQueue & verifyQueue,
                             CValidationState & /*state*/)
 {
     if (isKnownMessage(message))
@@ -564,12 +567,26 @@ void App::onMessageReceived(const std::vector<unsigned char> & id,
         return;
     }
 
-    if (!packet->verify())
+    // verified on the packet verification threads, processed on the handler
+    // thread of the peer once the packets before it are
+    packetVerifier.Post(verifyQueue, [packet]() { return packet->verify(); },
+                        [this, id, packet](bool valid)
     {
-        LOG() << "unsigned packet or signature error " << __FUNCTION__;
-        return;
-    }
+        if (!valid)
+        {
+            LOG() << "unsigned packet or signature error " << __FUNCTION__;
+            return;
+        }
+
+        processMessage(id, packet);
+    });
+}
 
+//*****************************************************************************
+//*****************************************************************************
+void App::processMessage(const std::vector<unsigned char> & id,
+                         const XBridgePacketPtr & packet)
+{
     LOG() << "received message to " << HexStr(id)
           << " command " << packet->command();
 
@@ -631,6 +648,7 @@ void App::onMessageReceived(const std::vector<unsigned char> & id,
 //*****************************************************************************
 //*****************************************************************************
 void App::onBroadcastReceived(const std::vector<unsigned char> & message,
+                              CPacketVerifyQueue & verifyQueue,
                               CValidationState & state)
 {
     if (isKnownMessage(message))
@@ -654,20 +672,24 @@ void App::onBroadcastReceived(const std::vector<unsigned char> & message,
         return;
     }
 
-    if (!packet->verify())
+    packetVerifier.Post(verifyQueue, [packet]() { return packet->verify(); },
+                        [this, packet](bool valid)
     {
-        LOG() << "unsigned packet or signature error " << __FUNCTION__;
-        return;
-    }
+        if (!valid)
+        {
+            LOG() << "unsigned packet or signature error " << __FUNCTION__;
+            return;
+        }
 
-    LOG() << "broadcast message, command " << packet->command();
+        LOG() << "broadcast message, command " << packet->command();
 
-    SessionPtr ptr = m_p->getSession();
-    if (ptr)
-    {
-        // TODO use post or future
-        ptr->processPacket(packet);
-    }
+        SessionPtr ptr = m_p->getSession();
+        if (ptr)
+        {
+            // TODO use post or future
+            ptr->processPacket(packet);
+        }
+    });
 }
 
 //*****************************************************************************
@@ -1589,6 +1611,10 @@ Error App::acceptXBridgeTransaction(const uint256     & id,
         return xbridge::Error::DUST;
     }
 
+    // the balance and fee utxos are read from the wallet, make sure it has seen
+    // every block and transaction processed so far
+    SyncWithValidationInterfaceQueue();
+
     if (pwalletMain->GetBalance() < connTo->serviceNodeFee)
     {
         return xbridge::Error::INSIFFICIENT_FUNDS_DX;
@@ -2306,6 +2332,7 @@ void App::unlockCoins(const std::string & token, const std::vector<wallet::UtxoE
 //******************************************************************************
 //******************************************************************************
 bool App::canAffordFeePayment(const CAmount & fee) {
+    SyncWithValidationInterfaceQueue();
     const auto & lockedUtxos = getAllLockedUtxos("BLOCK");
     std::vector<COutput> coins;
     pwalletMain->AvailableCoins(coins, false);
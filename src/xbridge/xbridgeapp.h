@@ -28,6 +28,7 @@
 // #include <Ws2tcpip.h>
 #endif
 
+class CPacketVerifyQueue;
 class xQuery;
 class CurrencyPair;
 class xAggregate;
@@ -409,18 +410,22 @@ public:
      * @brief onMessageReceived  call when message from xbridge network received
      * @param id packet id
      * @param message
+     * @param verifyQueue packets of the sending peer, processed once verified
      * @param state
      */
     void onMessageReceived(const std::vector<unsigned char> & id,
                            const std::vector<unsigned char> & message,
+                           CPacketVerifyQueue & verifyQueue,
                            CValidationState & state);
     //
     /**
      * @brief onBroadcastReceived - processing recieved   broadcast message
      * @param message
+     * @param verifyQueue packets of the sending peer, processed once verified
      * @param state
      */
     void onBroadcastReceived(const std::vector<unsigned char> & message,
+                             CPacketVerifyQueue & verifyQueue,
                              CValidationState & state);
 
     /**
@@ -573,6 +578,13 @@ public:
 protected:
     void clearMempool();
 
+    /**
+     * @brief processMessage hands a verified packet to the session it is addressed to
+     * @param id packet id
+     * @param packet
+     */
+    void processMessage(const std::vector<unsigned char> & id, const XBridgePacketPtr & packet);
+
 private:
     std::unique_ptr<Impl> m_p;
     bool m_disconnecting;
@@ -6,6 +6,7 @@
 #include "random.h"
 #include "allocators.h"
 #include "crypto/sha256.h"
+#include "packetverifier.h"
 #include "xbridge/util/logger.h"
 
 //******************************************************************************
@@ -103,6 +104,13 @@ bool XBridgePacket::verify()
     // restore signature
     memcpy(signatureField(), signature, rawSignatureSize);
 
+    const uint256 cacheKey = CPacketSignatureCache::Key(hash, signature, rawSignatureSize,
+                                                        pubkeyField(), pubkeySize);
+    if (packetSignatureCache.Get(cacheKey))
+    {
+        return true;
+    }
+
     secp256k1_ecdsa_signature sig;
     if (secp256k1_ecdsa_signature_parse_compact(secpContext, &sig, signatureField()) == 0)
     {
@@ -139,6 +147,8 @@ bool XBridgePacket::verify()
         return false;
     }
 
+    packetSignatureCache.Set(cacheKey);
+
     // all correct
     return true;
 }
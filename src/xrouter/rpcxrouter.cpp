@@ -373,6 +373,70 @@ Value xrGetBlocks(const Array & params, bool fHelp)
     return xrouter::form_reply(uuid, reply);
 }
 
+Value xrGetBlockFilters(const Array & params, bool fHelp)
+{
+    if (fHelp) {
+        throw std::runtime_error("xrGetBlockFilters currency blockhash1,blockhash2,blockhash3 [node_count]\n"
+                                 "List of BIP 158 basic block filters and filter headers for the specified block hashes.\n"
+                                 "Light clients match their scripts against the filters and only fetch the blocks that match.\n"
+                                 "\n"
+                                 "currency (string) Blockchain to query\n"
+                                 "blockhash1,blockhash2,blockhash3 (string) Block hashes separated by commas (,)\n"
+                                 "[node_count] (int) Optional, number of XRouter nodes to query (default=1)\n"
+                                 "                   The most common reply will be returned (i.e. the reply\n"
+                                 "                   with the most consensus. To see all reply results use\n"
+                                 "                   xrGetReply uuid."
+                                 "\n"
+                                 "Example:\n"
+                                 "xrGetBlockFilters BLOCK 39e11e62d89cfcfd2b0800f7e9b4bd439fa44a7d7aa111e1e7a8b235d848eadf,7b41ea6a8bf0ed93fd4f3a6a67a558941634400e9eaa51676d5af5077a01760c\n"
+                                 "\n"
+                                 "With consensus parameter:\n"
+                                 "xrGetBlockFilters BLOCK 39e11e62d89cfcfd2b0800f7e9b4bd439fa44a7d7aa111e1e7a8b235d848eadf,7b41ea6a8bf0ed93fd4f3a6a67a558941634400e9eaa51676d5af5077a01760c 2\n");
+    }
+
+    if (params.size() < 1 || boost::algorithm::contains(params[0].get_str(), ",")) {
+        Object error;
+        error.emplace_back("error", "Currency not specified");
+        error.emplace_back("code", xrouter::INVALID_PARAMETERS);
+        return error;
+    }
+
+    if (params.size() < 2) {
+        Object error;
+        error.emplace_back("error", "Block hashes not specified (comma delimited list)");
+        error.emplace_back("code", xrouter::INVALID_PARAMETERS);
+        return error;
+    }
+
+    std::vector<std::string> blockHashes;
+    const auto & hashes = params[1].get_str();
+    boost::split(blockHashes, hashes, boost::is_any_of(","));
+    for (const auto & hash : blockHashes) {
+        if (hash.empty() || hash.find(',') != std::string::npos) {
+            Object error;
+            error.emplace_back("error", "Block hashes must be specified in a comma delimited list with no spaces.");
+            error.emplace_back("code", xrouter::INVALID_PARAMETERS);
+            return error;
+        }
+    }
+
+    int consensus{0};
+    if (params.size() >= 3) {
+        consensus = params[2].get_int();
+        if (consensus < 1) {
+            Object error;
+            error.emplace_back("error", "Consensus must be at least 1");
+            error.emplace_back("code", xrouter::INVALID_PARAMETERS);
+            return error;
+        }
+    }
+
+    std::string currency = params[0].get_str();
+    std::string uuid;
+    std::string reply = xrouter::App::instance().getBlockFilters(uuid, currency, consensus, blockHashes);
+    return xrouter::form_reply(uuid, reply);
+}
+
 Value xrGetTransactions(const Array & params, bool fHelp)
 {
     if (fHelp) {
@@ -1179,3 +1243,59 @@ Value xrTest(const Array& params, bool fHelp)
     xrouter::App::instance().runTests();
     return "true";
 }
+
+Value xrLoadTest(const Array & params, bool fHelp)
+{
+    if (fHelp) {
+        throw std::runtime_error("xrLoadTest command service [count] [concurrency] [node_count] [param1 param2 ... paramN]\n"
+                                 "Fires count requests of the specified XRouter command at the network, keeping\n"
+                                 "concurrency requests in flight, and reports throughput, latency percentiles and\n"
+                                 "the average time spent in each stage of a call. Intended for capacity testing\n"
+                                 "against local service nodes configured with mock wallet connectors\n"
+                                 "(CreateTxMethod=MOCK in xbridge.conf, regtest only) and zero fees. Fees are paid for every request.\n"
+                                 "\n"
+                                 "command (string) XRouter command, e.g. xrGetBlockCount or xrService\n"
+                                 "service (string) Blockchain currency or plugin name\n"
+                                 "[count] (int) Optional, total number of requests (default 100)\n"
+                                 "[concurrency] (int) Optional, number of requests in flight (default 10)\n"
+                                 "[node_count] (int) Optional, number of XRouter nodes to query per request (default 1)\n"
+                                 "[param1 param2 ... paramN] (string) Optional, command parameters\n"
+                                 "\n"
+                                 "Example:\n"
+                                 "xrLoadTest xrGetBlockCount BLOCK 1000 50\n");
+    }
+
+    if (params.size() < 2) {
+        Object error;
+        error.emplace_back("error", "Command and service must be specified");
+        error.emplace_back("code", xrouter::INVALID_PARAMETERS);
+        return error;
+    }
+
+    const auto command = xrouter::XRouterCommand_FromString(params[0].get_str());
+    if (command == xrouter::xrInvalid || command == xrouter::xrReply || command == xrouter::xrGetReply
+        || command == xrouter::xrGetConfig || command == xrouter::xrConfigReply)
+    {
+        Object error;
+        error.emplace_back("error", "Unsupported command " + params[0].get_str());
+        error.emplace_back("code", xrouter::INVALID_PARAMETERS);
+        return error;
+    }
+
+    const std::string & service = params[1].get_str();
+    const int count = params.size() > 2 ? params[2].get_int() : 100;
+    const int concurrency = params.size() > 3 ? params[3].get_int() : 10;
+    const int consensus = params.size() > 4 ? params[4].get_int() : 1;
+    if (count < 1 || concurrency < 1 || consensus < 1) {
+        Object error;
+        error.emplace_back("error", "count, concurrency and node_count must be greater than 0");
+        error.emplace_back("code", xrouter::INVALID_PARAMETERS);
+        return error;
+    }
+
+    std::vector<std::string> call_params;
+    for (unsigned int i = 5; i < params.size(); i++)
+        call_params.push_back(params[i].get_str());
+
+    return xrouter::App::instance().loadTest(command, service, count, concurrency, consensus, call_params);
+}
@@ -16,6 +16,7 @@
 #include "servicenodeconfig.h"
 #include "servicenodeman.h"
 #include "obfuscation.h"
+#include "packetverifier.h"
 #include "addrman.h"
 #include "script/standard.h"
 #include "wallet.h"
@@ -38,6 +39,7 @@
 #include <sstream>
 #include <vector>
 #include <chrono>
+#include <atomic>
 #include <assert.h>
 
 //*****************************************************************************
@@ -412,6 +414,7 @@ bool App::openConnections(enum XRouterCommand command, const std::string & servi
         if (settings && !failedChecks(snodeAddr, settings)) {
             ++connected;
             connectedSnodes.insert(snodeAddr);
+            candidateIndex.restore(snodeAddr, settings); // dropped if it disconnected since its config arrived
             return true;
         }
         return false;
@@ -584,9 +587,7 @@ bool App::openConnections(enum XRouterCommand command, const std::string & servi
         }
 
         // Sort by existing config snodes first
-        std::sort(all.begin(), all.end(), [this,command,service](const NodeAddr & a, const NodeAddr & b) {
-            return bestNode(a, b, command, service);
-        });
+        candidateIndex.rank(all, command, service);
 
         boost::thread_group tg;
         std::set<NodeAddr> conns;
@@ -756,10 +757,6 @@ bool App::stop()
     if (!isEnabled() || !isReady())
         return false;
 
-    // shutdown threads
-    requestHandlers.interrupt_all();
-    requestHandlers.join_all();
-
     if (!server->stop())
         return false;
 
@@ -769,98 +766,98 @@ bool App::stop()
 //*****************************************************************************
 //*****************************************************************************
 std::vector<CNode*> App::availableNodesRetained(enum XRouterCommand command, const std::string & service,
-                                                const int & parameterCount, const int & count)
+                                                const int & parameterCount, const int & count,
+                                                const std::vector<CNode*> & skip)
 {
     std::vector<CNode*> selectedNodes;
+    if (count < 1)
+        return selectedNodes;
 
-    auto sconfigs = getConfigs();
-    if (sconfigs.empty())
-        return selectedNodes; // don't have any configs, return
-
-    std::vector<CServicenode> snodes;
-    std::vector<CNode*> nodes;
-    std::map<NodeAddr, CServicenode> snodec;
-    std::map<NodeAddr, CNode*> nodec;
-    getLatestNodeContainers(snodes, nodes, snodec, nodec);
+    std::set<NodeAddr> skipped;
+    for (CNode *pnode : skip)
+        skipped.insert(pnode->NodeAddress());
 
     // Max fee we're willing to pay to snodes
     auto maxfee = xrsettings->maxFee(command, service);
 
-    // Look through known xrouter node configs and select those that support command/service/fees
-    for (const auto & item : sconfigs) {
-        const auto & nodeAddr = item.first;
-        auto settings = item.second;
-
-        // fully qualified command e.g. xr::ServiceName
-        const auto & commandStr = XRouterCommand_ToString(command);
-        const auto & fqCmd = (command == xrService) ? pluginCommandKey(service) // plugin
-                                                    : walletCommandKey(service, commandStr); // spv wallet
-
-        if (command != xrService && !settings->hasWallet(service))
-            continue;
-        if (!settings->isAvailableCommand(command, service))
-            continue;
-        if (!snodec.count(nodeAddr)) // Ignore if not a snode
-            continue;
-        if (!snodec[nodeAddr].HasService(command == xrService ? fqCmd : walletCommandKey(service))) // use top-level wallet key (e.g. xr::BLOCK)
-            continue; // Ignore snodes that don't have the service
+    // fully qualified command e.g. xr::ServiceName
+    const auto & commandStr = XRouterCommand_ToString(command);
+    const auto & fqCmd = (command == xrService) ? pluginCommandKey(service) // plugin
+                                                : walletCommandKey(service, commandStr); // spv wallet
+    // use top-level wallet key (e.g. xr::BLOCK)
+    const auto & fqService = (command == xrService) ? fqCmd : walletCommandKey(service);
+    const bool self = fServiceNode && activeServicenode.status == ACTIVE_SERVICENODE_STARTED;
+
+    // Candidates supporting the command, already ordered by score and lowest price first. Only
+    // as many as still needed are read, the next ones only when a candidate is unusable.
+    auto candidates = candidateIndex.rankedCandidates(command, service, count);
+    while (!candidates.empty()) {
+        for (const auto & candidate : candidates) {
+            const auto & nodeAddr = candidate.node;
+            if (skipped.count(nodeAddr))
+                continue;
+            skipped.insert(nodeAddr);
+            if (CNode::IsBanned(nodeAddr) || (self && activeServicenode.service.ToStringIPPort() == nodeAddr))
+                continue; // skip banned snodes and self
 
-        // This is the node whose config we are looking at now
-        CNode *node = nullptr;
-        if (nodec.count(nodeAddr))
-            node = nodec[nodeAddr];
+            CPubKey snodeCollateral;
+            {
+                CServicenode *snode = mnodeman.Find(nodeAddr);
+                if (!snode) // Ignore if not a snode
+                    continue;
+                if (!snode->HasService(fqService))
+                    continue; // Ignore snodes that don't have the service
+                snodeCollateral = snode->pubKeyCollateralAddress;
+            }
 
-        // If the service node is not among peers
-        if (!node)
-            continue; // skip
+            // Only select nodes with a fee smaller than the max fee we're willing to pay
+            const auto & fee = candidate.fee;
+            if (fee > 0) {
+                if (fee > maxfee) {
+                    const auto & snodeAddr = CBitcoinAddress(snodeCollateral.GetID()).ToString();
+                    LOG() << "Skipping node " << snodeAddr << " because its fee " << fee << " is higher than maxfee " << maxfee;
+                    continue;
+                }
+                if (!xbridge::App::instance().canAffordFeePayment(fee * COIN)) {
+                    const auto & snodeAddr = CBitcoinAddress(snodeCollateral.GetID()).ToString();
+                    LOG() << "Skipping node " << snodeAddr << " because there's not enough utxos to cover payment " << fee;
+                    continue;
+                }
+            }
 
-        // Only select nodes with a fee smaller than the max fee we're willing to pay
-        auto fee = settings->commandFee(command, service);
-        if (fee > 0) {
-            if (fee > maxfee) {
-                const auto & snodeAddr = CBitcoinAddress(snodec[nodeAddr].pubKeyCollateralAddress.GetID()).ToString();
-                LOG() << "Skipping node " << snodeAddr << " because its fee " << fee << " is higher than maxfee " << maxfee;
+            // Only select nodes who's fetch limit is acceptable
+            if (parameterCount > candidate.fetchLimit) {
+                const auto & snodeAddr = CBitcoinAddress(snodeCollateral.GetID()).ToString();
+                LOG() << "Skipping node " << snodeAddr << " because its fetch limit " << candidate.fetchLimit << " is lower than "
+                      << parameterCount;
                 continue;
             }
-            if (!xbridge::App::instance().canAffordFeePayment(fee * COIN)) {
-                const auto & snodeAddr = CBitcoinAddress(snodec[nodeAddr].pubKeyCollateralAddress.GetID()).ToString();
-                LOG() << "Skipping node " << snodeAddr << " because there's not enough utxos to cover payment " << fee;
+
+            if (rateLimitExceeded(nodeAddr, fqCmd, getLastRequest(nodeAddr, fqCmd), candidate.requestLimit)) {
+                const auto & snodeAddr = CBitcoinAddress(snodeCollateral.GetID()).ToString();
+                LOG() << "Skipping node " << snodeAddr << " because not enough time passed since the last call";
                 continue;
             }
-        }
 
-        // Only select nodes who's fetch limit is acceptable
-        const auto & fetchLimit = settings->commandFetchLimit(command, service);
-        if (parameterCount > fetchLimit) {
-            const auto & snodeAddr = CBitcoinAddress(snodec[nodeAddr].pubKeyCollateralAddress.GetID()).ToString();
-            LOG() << "Skipping node " << snodeAddr << " because its fetch limit " << fetchLimit << " is lower than "
-                  << parameterCount;
-            continue;
-        }
+            // If the service node is not among peers skip it, otherwise retain it
+            CNode *node = nullptr;
+            {
+                LOCK(cs_vNodes);
+                node = FindNode(CService(nodeAddr));
+                if (node)
+                    node->AddRef();
+            }
+            if (!node)
+                continue;
 
-        auto rateLimit = settings->clientRequestLimit(command, service);
-        if (rateLimitExceeded(nodeAddr, fqCmd, getLastRequest(nodeAddr, fqCmd), rateLimit)) {
-            const auto & snodeAddr = CBitcoinAddress(snodec[nodeAddr].pubKeyCollateralAddress.GetID()).ToString();
-            LOG() << "Skipping node " << snodeAddr << " because not enough time passed since the last call";
-            continue;
+            selectedNodes.push_back(node);
         }
-        
-        selectedNodes.push_back(node);
-    }
 
-    // Sort selected nodes descending by score and lowest price first
-    std::sort(selectedNodes.begin(), selectedNodes.end(), [this,command,service](const CNode *a, const CNode *b) {
-        const auto & a_addr = a->NodeAddress();
-        const auto & b_addr = b->NodeAddress();
-        return bestNode(a_addr, b_addr, command, service);
-    });
-
-    // Retain selected nodes
-    for (auto & pnode : selectedNodes)
-        pnode->AddRef();
-
-    // Release other nodes
-    releaseNodes(nodes);
+        const auto need = count - static_cast<int>(selectedNodes.size());
+        if (need <= 0)
+            break;
+        candidates = candidateIndex.rankedCandidates(command, service, need, &candidates.back());
+    }
 
     return selectedNodes;
 }
@@ -890,7 +887,9 @@ bool App::processInvalid(CNode *node, XRouterPacketPtr packet, CValidationState
 
     // Verify servicenode response
     std::vector<unsigned char> spubkey;
-    if (!servicenodePubKey(nodeAddr, spubkey) || !packet->verify(spubkey)) {
+    if (!servicenodePubKey(nodeAddr, spubkey))
+        return false; // not the peer's fault
+    if (!packet->verify(spubkey)) {
         state.DoS(20, error("XRouter: unsigned packet or signature error"), REJECT_INVALID, "xrouter-error");
         return false;
     }
@@ -916,7 +915,9 @@ bool App::processReply(CNode *node, XRouterPacketPtr packet, CValidationState &
 
     // Verify servicenode response
     std::vector<unsigned char> spubkey;
-    if (!servicenodePubKey(nodeAddr, spubkey) || !packet->verify(spubkey)) {
+    if (!servicenodePubKey(nodeAddr, spubkey))
+        return false; // not the peer's fault
+    if (!packet->verify(spubkey)) {
         state.DoS(20, error("XRouter: unsigned packet or signature error"), REJECT_INVALID, "xrouter-error");
         return false;
     }
@@ -945,7 +946,9 @@ bool App::processConfigReply(CNode *node, XRouterPacketPtr packet, CValidationSt
 
     // Verify servicenode response
     std::vector<unsigned char> spubkey;
-    if (!servicenodePubKey(nodeAddr, spubkey) || !packet->verify(spubkey)) {
+    if (!servicenodePubKey(nodeAddr, spubkey))
+        return false; // not the peer's fault
+    if (!packet->verify(spubkey)) {
         state.DoS(20, error("XRouter: unsigned packet or signature error"), REJECT_INVALID, "xrouter-error");
         return false;
     }
@@ -1012,94 +1015,135 @@ void App::onMessageReceived(CNode* node, const std::vector<unsigned char> & mess
     if (!isEnabled() || !isReady())
         return;
 
-    auto retainNode = [](CNode *pnode) {
-        pnode->AddRef();
-    };
+    // Packets are verified on the packet verification threads and rate limited once they are
+    // processed. Server requests are handed to the per-service worker pools so backend latency
+    // never blocks here.
+    CValidationState state;
 
-    retainNode(node); // retain for thread below
+    try {
+        XRouterPacketPtr packet(new XRouterPacket);
+        if (!packet->copyFrom(message)) {
+            if (server->isStarted()) { // Send error back to client
+                try {
+                    Object error;
+                    error.emplace_back("error", "XRouter Node reported a protocol error on a received packet. "
+                                                "Unable to deserialize packet, possible bad packet header");
+                    error.emplace_back("code", xrouter::BAD_REQUEST);
+                    const std::string reply = json_spirit::write_string(Value(error), true);
+                    XRouterPacket packet(xrInvalid, "protocol_error");
+                    packet.append(reply);
+                    packet.sign(server->pubKey(), server->privKey());
+                    node->PushXRouter(packet.body());
+                } catch (std::exception & e) { // catch json errors
+                    ERR() << "Failed to send error reply to client " << node->NodeAddress() << " error: "
+                          << e.what();
+                }
+            }
 
-    // Handle the xrouter request
-    requestHandlers.create_thread([this, node, message]() {
-        RenameThread("blocknetdx-xrouter");
-        boost::this_thread::interruption_point();
-        CValidationState state;
+            updateScore(node->NodeAddress(), -10);
+            state.DoS(10, error("XRouter: invalid packet received"), REJECT_INVALID, "xrouter-error");
+            checkDoS(state, node);
 
-        bool released{false};
-        auto releaseNode = [&released](CNode *pnode) {
-            if (!released) {
-                released = true;
-                pnode->Release();
-            }
-        };
-
-        try {
-            XRouterPacketPtr packet(new XRouterPacket);
-            if (!packet->copyFrom(message)) {
-                if (server->isStarted()) { // Send error back to client
-                    try {
-                        Object error;
-                        error.emplace_back("error", "XRouter Node reported a protocol error on a received packet. "
-                                                    "Unable to deserialize packet, possible bad packet header");
-                        error.emplace_back("code", xrouter::BAD_REQUEST);
-                        const std::string reply = json_spirit::write_string(Value(error), true);
-                        XRouterPacket packet(xrInvalid, "protocol_error");
-                        packet.append(reply);
-                        packet.sign(server->pubKey(), server->privKey());
-                        node->PushXRouter(packet.body());
-                    } catch (std::exception & e) { // catch json errors
-                        ERR() << "Failed to send error reply to client " << node->NodeAddress() << " error: "
-                              << e.what();
-                    }
-                }
+            return;
+        }
 
-                updateScore(node->NodeAddress(), -10);
-                state.DoS(10, error("XRouter: invalid packet received"), REJECT_INVALID, "xrouter-error");
-                checkDoS(state, node);
-                releaseNode(node);
+        // Verify the signature on the packet verification threads, the packet is then processed
+        // on this peer's handler thread in the order it arrived. Replies are signed by the
+        // servicenode, requests by the client. The handlers check the signature again against
+        // the same pubkey, which is then answered from the packet signature cache.
+        const auto command = packet->command();
+        const auto & uuid = packet->suuid();
+        const auto & nodeAddr = node->NodeAddress();
+        if (command == xrInvalid || command == xrReply || command == xrConfigReply) {
+            // Ignore replies we aren't expecting, and any but the first reply to a query
+            if (command == xrInvalid) {
+                if (!queryMgr.hasNodeQuery(nodeAddr))
+                    return;
+            } else if (!queryMgr.hasQuery(uuid, nodeAddr) || queryMgr.hasReply(uuid, nodeAddr))
+                return;
 
+            std::vector<unsigned char> spubkey;
+            if (!servicenodePubKey(nodeAddr, spubkey)) {
+                LOG() << "Ignoring reply to query " << uuid << " from " << nodeAddr << ", servicenode pubkey unknown";
                 return;
             }
 
-            const auto & command = packet->command();
-            const auto & uuid = packet->suuid();
-            const auto & nodeAddr = node->NodeAddress();
-            const auto & commandStr = XRouterCommand_ToString(command);
-
-            if (command == xrService) {
-                auto service = packet->service();
-                if (service.size() > 100) // truncate service name
-                    service = service.substr(0, 100);
-                LOG() << "XRouter command: " << commandStr << xrdelimiter + service << " query: " << uuid << " node: " << nodeAddr;
-            }
-            else
-                LOG() << "XRouter command: " << commandStr << " query: " << uuid << " node: " << nodeAddr;
-
-            if (command == xrInvalid) { // Process invalid packets (protocol error packets)
-                processInvalid(node, packet, state);
-            } else if (command == xrReply) { // Process replies
-                processReply(node, packet, state);
-            } else if (command == xrConfigReply) { // Process config replies
-                processConfigReply(node, packet, state);
-            } else if (canListen() && server->isStarted()) { // Process server requests
-                server->addInFlightQuery(nodeAddr, uuid);
-                try {
-                    server->onMessageReceived(node, packet, state);
-                    server->removeInFlightQuery(nodeAddr, uuid);
-                } catch (...) { // clean up on error
-                    server->removeInFlightQuery(nodeAddr, uuid);
+            packetVerifier.Post(node->packetVerifyQueue,
+                                [packet, spubkey]() { return packet->verify(spubkey); },
+                                [this, node, packet](bool valid) {
+                if (!valid) { // dropped, the reply handlers would only find the same signature error
+                    CValidationState state;
+                    state.DoS(20, error("XRouter: unsigned packet or signature error"), REJECT_INVALID, "xrouter-error");
+                    checkDoS(state, node);
+                    return;
                 }
-            }
+                processMessage(node, packet);
+            });
+            return;
+        }
 
-            // Done with request, process DoS and release node
-            checkDoS(state, node);
-            releaseNode(node);
+        // Requests are only served by a started server
+        if (!canListen() || !server->isStarted())
+            return;
 
-        } catch (...) {
-            ERR() << strprintf("xrouter query from %s processed with error: ", node->NodeAddress());
-            checkDoS(state, node);
-            releaseNode(node);
+        // A request that fails verification is still handed to the server, which replies to
+        // the client with BAD_VERSION or BAD_REQUEST
+        packetVerifier.Post(node->packetVerifyQueue,
+                            [packet]() { return packet->verify(packet->vpubkey()); },
+                            [this, node, packet](bool) {
+            processMessage(node, packet);
+        });
+
+    } catch (...) {
+        ERR() << strprintf("xrouter query from %s processed with error: ", node->NodeAddress());
+        checkDoS(state, node);
+    }
+}
+
+//*****************************************************************************
+//*****************************************************************************
+void App::processMessage(CNode* node, XRouterPacketPtr packet)
+{
+    CValidationState state;
+
+    try {
+        const auto & command = packet->command();
+        const auto & uuid = packet->suuid();
+        const auto & nodeAddr = node->NodeAddress();
+        const auto & commandStr = XRouterCommand_ToString(command);
+
+        if (command == xrService) {
+            auto service = packet->service();
+            if (service.size() > 100) // truncate service name
+                service = service.substr(0, 100);
+            LOG() << "XRouter command: " << commandStr << xrdelimiter + service << " query: " << uuid << " node: " << nodeAddr;
+        }
+        else
+            LOG() << "XRouter command: " << commandStr << " query: " << uuid << " node: " << nodeAddr;
+
+        if (command == xrInvalid) { // Process invalid packets (protocol error packets)
+            processInvalid(node, packet, state);
+        } else if (command == xrReply) { // Process replies
+            processReply(node, packet, state);
+        } else if (command == xrConfigReply) { // Process config replies
+            processConfigReply(node, packet, state);
+        } else if (canListen() && server->isStarted()) { // Process server requests
+            server->addInFlightQuery(nodeAddr, uuid); // removed by the server when the reply is sent
+            try {
+                server->onMessageReceived(node, packet, state);
+            } catch (...) { // clean up on error
+                server->removeInFlightQuery(nodeAddr, uuid);
+                throw;
+            }
         }
-    });
+
+        // Done with request, process DoS
+        checkDoS(state, node);
+
+    } catch (...) {
+        ERR() << strprintf("xrouter query from %s processed with error: ", node->NodeAddress());
+        checkDoS(state, node);
+    }
 }
 
 //*****************************************************************************
@@ -1113,6 +1157,14 @@ std::string App::xrouterCall(enum XRouterCommand command, std::string & uuidRet,
     std::vector<CNode*> selectedNodes;
     std::vector<std::pair<std::string, int> > nodeErrors;
 
+    // Record the time spent in each stage of the call
+    int64_t stageStart = GetTimeMicros();
+    auto stageDone = [this,&stageStart](const std::string & stage) {
+        const int64_t now = GetTimeMicros();
+        callStats.add(stage, now - stageStart);
+        stageStart = now;
+    };
+
     try {
         if (!isEnabled() || !isReady())
             throw XRouterError("XRouter is turned off. Please set 'xrouter=1' in blocknetdx.conf", xrouter::UNAUTHORIZED);
@@ -1140,6 +1192,7 @@ std::string App::xrouterCall(enum XRouterCommand command, std::string & uuidRet,
                         throw XRouterError("Incorrect hash: " + params[0], xrouter::INVALID_PARAMETERS);
                     break;
                 case xrGetBlocks:
+                case xrGetBlockFilters:
                 case xrGetTransactions: {
                     if (params.empty())
                         throw XRouterError("Missing parameters for " + fqServiceName, xrouter::INVALID_PARAMETERS);
@@ -1186,6 +1239,8 @@ std::string App::xrouterCall(enum XRouterCommand command, std::string & uuidRet,
             throw XRouterError("Failed to find " + std::to_string(confs) + " service node(s) supporting " +
                                fqService + " with config limits, found " + std::to_string(selected), xrouter::NOT_ENOUGH_NODES);
 
+        stageDone("select");
+
         std::vector<CNode*> queryNodes;
         int snodeCount = 0;
         std::string fundErr{"Could not create payments. Please check that your wallet "
@@ -1193,13 +1248,16 @@ std::string App::xrouterCall(enum XRouterCommand command, std::string & uuidRet,
                             " available unspent transaction."};
 
         // Compose a final list of snodes to request. selectedNodes here should be sorted
-        // ascending best to worst
-        for (CNode* pnode : selectedNodes) {
+        // ascending best to worst, a node that can't be paid is replaced by the next best
+        for (size_t i = 0; i < selectedNodes.size() && snodeCount < confs; ++i) {
+            CNode* pnode = selectedNodes[i];
             const auto & addr = pnode->NodeAddress();
-            if (!hasConfig(addr))
-                continue; // skip nodes that do not have configs
-
             auto config = getConfig(addr);
+            if (!config) { // replace nodes that do not have configs
+                const auto next = availableNodesRetained(command, service, params.size(), 1, selectedNodes);
+                selectedNodes.insert(selectedNodes.end(), next.begin(), next.end());
+                continue;
+            }
 
             // Create the fee payment
             CAmount fee = to_amount(config->commandFee(command, service));
@@ -1214,14 +1272,14 @@ std::string App::xrouterCall(enum XRouterCommand command, std::string & uuidRet,
                 } catch (XRouterError & e) {
                     ERR() << "Failed to create payment to node " << addr << " " << e.msg;
                     nodeErrors.emplace_back(e.msg, e.code);
+                    const auto next = availableNodesRetained(command, service, params.size(), 1, selectedNodes);
+                    selectedNodes.insert(selectedNodes.end(), next.begin(), next.end());
                     continue;
                 }
             }
 
             queryNodes.push_back(pnode);
             ++snodeCount;
-            if (snodeCount == confs)
-                break;
         }
 
         // Do we have enough snodes? If not unlock utxos
@@ -1231,6 +1289,8 @@ std::string App::xrouterCall(enum XRouterCommand command, std::string & uuidRet,
             throw XRouterError(msg, xrouter::NOT_ENOUGH_NODES);
         }
 
+        stageDone("payment");
+
         int timeout = xrsettings->commandTimeout(command, service);
 
         // Send xrouter request to each selected node
@@ -1257,6 +1317,8 @@ std::string App::xrouterCall(enum XRouterCommand command, std::string & uuidRet,
             LOG() << "Sent command " << fqService << " query " << uuid << " to node " << pnode->addrName;
         }
 
+        stageDone("send");
+
         // At this point we need to wait for responses
         int confirmation_count = 0;
         auto queryCheckStart = GetAdjustedTime();
@@ -1277,6 +1339,8 @@ std::string App::xrouterCall(enum XRouterCommand command, std::string & uuidRet,
                 }
         }
 
+        stageDone("wait");
+
         // Clean up
         queryMgr.purge(uuid);
 
@@ -1403,6 +1467,8 @@ std::string App::xrouterCall(enum XRouterCommand command, std::string & uuidRet,
             }
         }
 
+        stageDone("consensus");
+
         releaseNodes(selectedNodes);
         return rawResult;
 
@@ -1468,6 +1534,11 @@ std::string App::getBlocks(std::string & uuidRet, const std::string & currency,
     return this->xrouterCall(xrGetBlocks, uuidRet, currency, confirmations, { blockHashes.begin(), blockHashes.end() });
 }
 
+std::string App::getBlockFilters(std::string & uuidRet, const std::string & currency, const int & confirmations, const std::vector<std::string> & blockHashes)
+{
+    return this->xrouterCall(xrGetBlockFilters, uuidRet, currency, confirmations, { blockHashes.begin(), blockHashes.end() });
+}
+
 std::string App::getTransaction(std::string & uuidRet, const std::string & currency, const int & confirmations, const std::string & hash)
 {
     return this->xrouterCall(xrGetTransaction, uuidRet, currency, confirmations, { hash });
@@ -1634,16 +1705,11 @@ std::map<NodeAddr, XRouterSettingsPtr> App::xrConnect(const std::string & fqServ
     uint32_t found{0};
     openConnections(command, service, count, -1, { }, found); // open connections to snodes that have our service
 
-    const auto configs = getNodeConfigs(); // get configs and store matching ones
+    const auto configs = candidateIndex.serviceConfigs(command, service); // get configs of nodes with the service
     for (const auto & item : configs) {
         if (CNode::IsBanned(item.first)) // exclude banned
             continue;
-        if (command != xrService && item.second->hasWallet(service)) {
-            selectedConfigs.insert(item);
-            continue;
-        }
-        if (item.second->hasPlugin(service))
-            selectedConfigs.insert(item);
+        selectedConfigs.insert(item);
     }
 
     foundCount = static_cast<uint32_t>(selectedConfigs.size());
@@ -1806,6 +1872,18 @@ std::string App::getStatus() {
     }
     result.emplace_back("plugins", plugins);
 
+    // Request queue depths of the server worker pools
+    Object queues;
+    if (server && server->isStarted()) {
+        for (const auto & item : server->queueDepths()) {
+            Object q;
+            q.emplace_back("depth", item.second.first);
+            q.emplace_back("limit", item.second.second);
+            queues.emplace_back(item.first, q);
+        }
+    }
+    result.emplace_back("requestqueues", queues);
+
     return json_spirit::write_string(Value(result), json_spirit::pretty_print, 8);
 }
 
@@ -1871,6 +1949,76 @@ void App::runTests() {
     server->runPerformanceTests();
 }
 
+std::string App::loadTest(enum XRouterCommand command, const std::string & service, const int & count,
+                          const int & concurrency, const int & confirmations, const std::vector<std::string> & params)
+{
+    callStats.reset();
+
+    std::atomic<int> next{0};
+    std::atomic<int> errors{0};
+    std::vector<int64_t> latencies;
+    latencies.reserve(count);
+    boost::mutex latenciesLock;
+
+    const int64_t start = GetTimeMicros();
+    boost::thread_group threads;
+    for (int i = 0; i < std::min(concurrency, count); ++i) {
+        threads.create_thread([&]() {
+            while (!ShutdownRequested() && next++ < count) {
+                std::string uuid;
+                const int64_t callStart = GetTimeMicros();
+                const std::string reply = xrouterCall(command, uuid, service, confirmations, params);
+                const int64_t elapsed = GetTimeMicros() - callStart;
+
+                Value replyVal; read_string(reply, replyVal);
+                if (replyVal.type() != obj_type || find_value(replyVal.get_obj(), "error").type() != null_type)
+                    ++errors;
+
+                boost::mutex::scoped_lock l(latenciesLock);
+                latencies.push_back(elapsed);
+            }
+        });
+    }
+    threads.join_all();
+    const double seconds = (GetTimeMicros() - start) / 1000000.0;
+
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&latencies](const double p) -> double {
+        if (latencies.empty())
+            return 0;
+        const auto i = std::min(latencies.size() - 1, static_cast<size_t>(p * latencies.size()));
+        return latencies[i] / 1000.0;
+    };
+
+    Object latency;
+    latency.emplace_back("min", percentile(0));
+    latency.emplace_back("p50", percentile(0.5));
+    latency.emplace_back("p90", percentile(0.9));
+    latency.emplace_back("p99", percentile(0.99));
+    latency.emplace_back("max", percentile(1));
+
+    Object stages;
+    for (const auto & item : callStats.snapshot()) {
+        Object stage;
+        stage.emplace_back("count", item.second.count);
+        stage.emplace_back("avgms", item.second.count > 0 ? item.second.micros / 1000.0 / item.second.count : 0.0);
+        stages.emplace_back(item.first, stage);
+    }
+
+    Object result;
+    result.emplace_back("command", XRouterCommand_ToString(command));
+    result.emplace_back("service", service);
+    result.emplace_back("calls", static_cast<int>(latencies.size()));
+    result.emplace_back("errors", errors.load());
+    result.emplace_back("concurrency", concurrency);
+    result.emplace_back("seconds", seconds);
+    result.emplace_back("throughput", seconds > 0 ? latencies.size() / seconds : 0.0);
+    result.emplace_back("latencyms", latency);
+    result.emplace_back("stages", stages);
+
+    return json_spirit::write_string(Value(result), true);
+}
+
 bool App::isDebug() {
     //int b;
     //verifyDomain("98fa59764df5d2022994ca98e8ad3ca795681920bb7cad0af8df07ab48539ac6", "antihype", "yBW61mwkjuqFK1rVfm2Az2s2WU5Vubrhhw", b);
@@ -1951,10 +2099,8 @@ void App::checkDoS(CValidationState & state, CNode *pnode) {
     if (state.IsInvalid(dos)) {
         LogPrint("xrouter", "invalid xrouter packet from peer=%d %s : %s\n", pnode->id, pnode->cleanSubVer,
                  state.GetRejectReason());
-        if (dos > 0) {
-            LOCK(cs_main);
+        if (dos > 0)
             Misbehaving(pnode->GetId(), dos);
-        }
     } else if (state.IsError()) {
         LogPrint("xrouter", "xrouter packet from peer=%d %s processed with error: %s\n", pnode->id, pnode->cleanSubVer,
                  state.GetRejectReason());
@@ -30,6 +30,8 @@
 #include <memory>
 #include <chrono>
 #include <algorithm>
+#include <limits>
+#include <tuple>
 
 #include <json/json_spirit.h>
 #include <json/json_spirit_reader_template.h>
@@ -205,6 +207,16 @@ public:
      */
     std::string getBlocks(std::string & uuidRet, const std::string & currency, const int & confirmations, const std::vector<std::string> & blockHashes);
 
+    /**
+     * @brief returns the BIP 158 basic filters of the given blocks (requires block filter index on server side)
+     * @param uuidRet uuid of the request
+     * @param currency chain code (BTC, LTC etc)
+     * @param confirmations number of service nodes to call (final result is selected from all answers by majority vote)
+     * @param blockHashes set of hashes to obtain the filters for
+     * @return json array with the filter and filter header of each block
+     */
+    std::string getBlockFilters(std::string & uuidRet, const std::string & currency, const int & confirmations, const std::vector<std::string> & blockHashes);
+
     /**
      * @brief returns transaction by hash (requires tx idnex on server side)
      * @param uuidRet uuid of the request
@@ -384,15 +396,17 @@ public:
     bool processConfigReply(CNode *node, XRouterPacketPtr packet, CValidationState & state);
 
     /**
-     * @brief get all nodes that support the command for a given chain
+     * @brief get the best usable nodes that support the command for a given chain
      * @param command XRouter command
      * @param service Wallet or currency name
      * @param parameterCount Number of parameters in request
-     * @param count Number of nodes to fetch (default 1 node)
+     * @param count Number of nodes wanted (default 1 node), at most count are returned best first
+     * @param skip Nodes already selected, e.g. when replacing a node that turned out unusable
      * @return
      */
     std::vector<CNode*> availableNodesRetained(enum XRouterCommand command, const std::string & service,
-                                               const int & parameterCount, const int & count = 1);
+                                               const int & parameterCount, const int & count = 1,
+                                               const std::vector<CNode*> & skip = {});
     
     /**
      * @brief generates a payment transaction to given service node
@@ -407,16 +421,41 @@ public:
             const CAmount & fee, std::string & payment);
     
     /**
-     * @brief onMessageReceived  call when message from xrouter network received
+     * @brief onMessageReceived  call when message from xrouter network received. Runs on the
+     * message handler thread, the packet is processed once its signature is verified and
+     * server requests are answered asynchronously.
      * @param node source CNode
      * @param message packet contents
      */
     void onMessageReceived(CNode* node, const std::vector<unsigned char> & message);
+
+    /**
+     * @brief processMessage handle a received packet after its signature was verified. Runs on
+     * the message handler thread of the sending peer, in the order the packets arrived.
+     * @param node source CNode
+     * @param packet
+     */
+    void processMessage(CNode* node, XRouterPacketPtr packet);
     
     /**
      * @brief run performance tests (xrTest)
      */
     void runTests();
+
+    /**
+     * @brief fires count xrouter calls from concurrency threads and reports latency percentiles,
+     * throughput and the average time spent in each stage of xrouterCall (xrLoadTest). Meant for
+     * capacity testing against local service nodes running mock wallet connectors.
+     * @param command xrouter command
+     * @param service currency or plugin name
+     * @param count total number of calls
+     * @param concurrency number of calls in flight
+     * @param confirmations number of service nodes to query per call
+     * @param params command parameters
+     * @return json object with the results
+     */
+    std::string loadTest(enum XRouterCommand command, const std::string & service, const int & count,
+                         const int & concurrency, const int & confirmations, const std::vector<std::string> & params);
     
     /**
      * @brief returns true if [Main]debug=1 is set
@@ -556,6 +595,15 @@ public:
         lastPacketsSent[node][command] = std::chrono::system_clock::now();
     }
 
+    /**
+     * Drops the node from the service node candidates, when its connection closes or it
+     * leaves the servicenode list.
+     * @param node
+     */
+    void removeCandidate(const NodeAddr & node) {
+        candidateIndex.remove(node);
+    }
+
 private:
     /**
      * @brief App - default contructor,
@@ -593,19 +641,7 @@ private:
                 Misbehaving(pnode->GetId(), 100);
             }
         }
-    }
-    bool bestNode(const NodeAddr & a, const NodeAddr & b, const XRouterCommand & command, const std::string & service) {
-        const auto & a_score = getScore(a);
-        const auto & b_score = getScore(b);
-        if (a_score < 0)
-            return a_score > b_score;
-        if (b_score < 0)
-            return true;
-        auto sa = getConfig(a);
-        auto sb = getConfig(b);
-        if (!sa || !sb)
-            return a_score > b_score;
-        return sa->commandFee(command, service) < sb->commandFee(command, service);
+        candidateIndex.updateScore(node, snodeScore[node]);
     }
 
     std::map<NodeAddr, XRouterSettingsPtr> getConfigs() {
@@ -656,8 +692,11 @@ private:
         return nullptr;
     }
     void updateConfig(const NodeAddr & node, XRouterSettingsPtr config) {
-        WaitableLock l(mu);
-        snodeConfigs[node] = config;
+        {
+            WaitableLock l(mu);
+            snodeConfigs[node] = config;
+        }
+        candidateIndex.updateConfig(node, config);
     }
     bool needConfigUpdate(const NodeAddr & node, const bool & isServer = false) {
         const auto & service = XRouterCommand_ToString(xrGetConfig);
@@ -807,6 +846,233 @@ private:
         std::map<NodeAddr, PendingConnection> pendingConnections;
     };
 
+    /**
+     * Per-service index of service node candidates. Fee and score keys are computed when a
+     * config reply or score change arrives, allowing node selection to read candidates in
+     * rank order without re-fetching configs or sorting on every call. Nodes are dropped
+     * when they disconnect or leave the servicenode list, and added back when selected again.
+     */
+    class CandidateIndex {
+    public:
+        struct Candidate {
+            NodeAddr node;
+            XRouterSettingsPtr config;
+            double fee{0};
+            int fetchLimit{XROUTER_DEFAULT_FETCHLIMIT};
+            int requestLimit{-1};
+            int score{0};
+        };
+        CandidateIndex() = default;
+        /**
+         * Indexes the services supported by the node config. Any precomputed keys for the
+         * node are replaced.
+         * @param node
+         * @param config
+         */
+        void updateConfig(const NodeAddr & node, XRouterSettingsPtr config) {
+            WaitableLock l(mu);
+            removeNode(node);
+            addNode(node, config);
+        }
+        /**
+         * Indexes the node unless it already is, e.g. when a node that was dropped on
+         * disconnect is selected again with its cached config.
+         * @param node
+         * @param config
+         */
+        void restore(const NodeAddr & node, XRouterSettingsPtr config) {
+            WaitableLock l(mu);
+            if (!configs.count(node))
+                addNode(node, config);
+        }
+        /**
+         * Drops the node from all services and commands.
+         * @param node
+         */
+        void remove(const NodeAddr & node) {
+            WaitableLock l(mu);
+            removeNode(node);
+        }
+        /**
+         * Updates the score key of the node on all indexed commands.
+         * @param node
+         * @param score
+         */
+        void updateScore(const NodeAddr & node, const int & score) {
+            WaitableLock l(mu);
+            scores[node] = score;
+            for (auto & item : candidates) {
+                auto it = item.second.find(node);
+                if (it == item.second.end())
+                    continue;
+                ranked[item.first].erase(rankKey(it->second));
+                it->second.score = score;
+                ranked[item.first].insert(rankKey(it->second));
+            }
+        }
+        /**
+         * Returns up to count candidates supporting the command ordered best to worst, starting
+         * after the given candidate if any. Keys for a command are computed on first use and
+         * maintained incrementally afterwards.
+         * @param command
+         * @param service
+         * @param count
+         * @param after Last candidate of a previous call, nullptr to start with the best
+         * @return
+         */
+        std::vector<Candidate> rankedCandidates(const XRouterCommand & command, const std::string & service,
+                                                const size_t & count, const Candidate * after = nullptr) {
+            WaitableLock l(mu);
+            const auto & fqCmd = commandKey(command, service);
+            if (!commands.count(fqCmd)) {
+                commands[fqCmd] = std::make_pair(command, service);
+                const auto & key = serviceKey(command, service);
+                if (services.count(key)) {
+                    for (const auto & node : services[key])
+                        addCandidate(fqCmd, node);
+                }
+            }
+            std::vector<Candidate> result;
+            const auto & keys = ranked[fqCmd];
+            const auto & cmdCandidates = candidates[fqCmd];
+            auto it = after ? keys.upper_bound(rankKey(*after)) : keys.begin();
+            for (; it != keys.end() && result.size() < count; ++it)
+                result.push_back(cmdCandidates.at(std::get<3>(*it)));
+            return result;
+        }
+        /**
+         * Returns the configs of all nodes that support the service.
+         * @param command
+         * @param service
+         * @return
+         */
+        std::map<NodeAddr, XRouterSettingsPtr> serviceConfigs(const XRouterCommand & command, const std::string & service) {
+            WaitableLock l(mu);
+            std::map<NodeAddr, XRouterSettingsPtr> result;
+            const auto & key = serviceKey(command, service);
+            if (!services.count(key))
+                return result;
+            for (const auto & node : services[key])
+                result[node] = configs[node];
+            return result;
+        }
+        /**
+         * Sorts the nodes best to worst using the precomputed keys. Nodes without a config
+         * are ranked after configured nodes with the same score sign.
+         * @param nodes
+         * @param command
+         * @param service
+         */
+        void rank(std::vector<NodeAddr> & nodes, const XRouterCommand & command, const std::string & service) {
+            WaitableLock l(mu);
+            std::vector<RankKey> keys;
+            for (const auto & node : nodes) {
+                Candidate c;
+                c.node = node;
+                c.fee = std::numeric_limits<double>::max();
+                c.score = scores.count(node) ? scores[node] : 0;
+                if (configs.count(node) && configs[node]->isAvailableCommand(command, service))
+                    c.fee = configs[node]->commandFee(command, service);
+                keys.push_back(rankKey(c));
+            }
+            std::sort(keys.begin(), keys.end());
+            nodes.clear();
+            for (const auto & rk : keys)
+                nodes.push_back(std::get<3>(rk));
+        }
+    private:
+        // Non-negative scores first (lowest fee, then highest score), negative scores last (highest score)
+        typedef std::tuple<bool, double, int, NodeAddr> RankKey;
+        static RankKey rankKey(const Candidate & c) {
+            const bool penalized = c.score < 0;
+            return RankKey{penalized, penalized ? 0 : c.fee, -c.score, c.node};
+        }
+        static std::string commandKey(const XRouterCommand & command, const std::string & service) {
+            return command == xrService ? pluginCommandKey(service)
+                                        : walletCommandKey(service, XRouterCommand_ToString(command));
+        }
+        static std::string serviceKey(const XRouterCommand & command, const std::string & service) {
+            return command == xrService ? pluginCommandKey(service) : walletCommandKey(service);
+        }
+        void addCandidate(const std::string & fqCmd, const NodeAddr & node) {
+            const auto & command = commands[fqCmd].first;
+            const auto & service = commands[fqCmd].second;
+            auto config = configs[node];
+            if (!config || !config->isAvailableCommand(command, service))
+                return;
+            Candidate c;
+            c.node = node;
+            c.config = config;
+            c.fee = config->commandFee(command, service);
+            c.fetchLimit = config->commandFetchLimit(command, service);
+            c.requestLimit = config->clientRequestLimit(command, service);
+            c.score = scores.count(node) ? scores[node] : 0;
+            candidates[fqCmd][node] = c;
+            ranked[fqCmd].insert(rankKey(c));
+        }
+        void addNode(const NodeAddr & node, XRouterSettingsPtr config) {
+            configs[node] = config;
+            for (const auto & wallet : config->getWallets())
+                services[walletCommandKey(wallet)].insert(node);
+            for (const auto & plugin : config->getPlugins())
+                services[pluginCommandKey(plugin)].insert(node);
+            for (auto & item : commands) { // refresh keys of commands already indexed
+                const auto & key = serviceKey(item.second.first, item.second.second);
+                if (services.count(key) && services[key].count(node))
+                    addCandidate(item.first, node);
+            }
+        }
+        void removeNode(const NodeAddr & node) {
+            for (auto & item : candidates) {
+                auto it = item.second.find(node);
+                if (it == item.second.end())
+                    continue;
+                ranked[item.first].erase(rankKey(it->second));
+                item.second.erase(it);
+            }
+            for (auto & item : services)
+                item.second.erase(node);
+            configs.erase(node);
+        }
+    private:
+        CWaitableCriticalSection mu;
+        std::map<NodeAddr, XRouterSettingsPtr> configs;
+        std::map<NodeAddr, int> scores;
+        std::map<std::string, std::set<NodeAddr> > services; // xr::BLOCK, xrs::ServiceName
+        std::map<std::string, std::pair<XRouterCommand, std::string> > commands; // indexed commands
+        std::map<std::string, std::map<NodeAddr, Candidate> > candidates;
+        std::map<std::string, std::set<RankKey> > ranked;
+    };
+
+    /**
+     * Accumulates the time xrouterCall spends in each stage (node selection, payment creation,
+     * sending, waiting for replies, consensus), used by loadTest.
+     */
+    class CallStats {
+    public:
+        struct Stage {
+            int64_t count{0};
+            int64_t micros{0};
+        };
+        void add(const std::string & stage, const int64_t micros) {
+            WaitableLock l(mu);
+            auto & s = stages[stage];
+            ++s.count;
+            s.micros += micros;
+        }
+        void reset() {
+            WaitableLock l(mu);
+            stages.clear();
+        }
+        std::map<std::string, Stage> snapshot() {
+            WaitableLock l(mu);
+            return stages;
+        }
+    private:
+        CWaitableCriticalSection mu;
+        std::map<std::string, Stage> stages;
+    };
+
     class QueryMgr {
     public:
         typedef std::string QueryReply;
@@ -1105,7 +1371,6 @@ private:
     boost::filesystem::path xrouterpath;
     bool xrouterIsReady{false};
 
-    boost::thread_group requestHandlers;
     std::deque<std::shared_ptr<boost::asio::io_service> > ioservices;
     std::deque<std::shared_ptr<boost::asio::io_service::work> > ioworkers;
 
@@ -1122,6 +1387,8 @@ private:
 
     QueryMgr queryMgr;
     PendingConnectionMgr pendingConnMgr;
+    CandidateIndex candidateIndex;
+    CallStats callStats;
 };
 
 } // namespace xrouter
@@ -5,6 +5,9 @@
 #include "json/json_spirit_reader_template.h"
 #include "json/json_spirit_writer_template.h"
 
+#include <algorithm>
+#include <iterator>
+
 using namespace json_spirit;
 
 namespace xrouter
@@ -195,87 +198,135 @@ std::vector<std::string> BtcWalletConnectorXRouter::getTransactionsBloomFilter(c
     return results;
 }
 
+std::vector<std::string> BtcWalletConnectorXRouter::getBlockFilters(const std::vector<std::string> & blockHashes) const
+{
+    // The filters are precomputed by the wallet's block filter index (-blockfilterindex),
+    // so serving them costs one lookup per block instead of decoding its transactions
+    static const std::string command("getblockfilter");
+
+    std::set<std::string> unique{blockHashes.begin(), blockHashes.end()};
+    std::map<std::string, std::string> results;
+    std::vector<std::string> list;
+
+    for (const auto & hash : unique)
+        results[hash] = CallRPC(m_user, m_passwd, m_ip, m_port, command, { hash });
+
+    for (const auto & hash : blockHashes)
+        list.push_back(results[hash]);
+
+    return list;
+}
+
 std::string BtcWalletConnectorXRouter::sendTransaction(const std::string & transaction) const
 {
     static const std::string command("sendrawtransaction");
     return checkError(CallRPC(m_user, m_passwd, m_ip, m_port, command, { transaction }), BAD_REQUEST);
 }
 
+bool BtcWalletConnectorXRouter::getBlockTime(const int & block, const int & tip, int64_t & time, std::string & error) const
+{
+    {
+        boost::mutex::scoped_lock l(blockTimesLock);
+        auto it = blockTimes.find(block);
+        if (it != blockTimes.end()) {
+            time = it->second;
+            return true;
+        }
+    }
+
+    const auto & hashObj = getBlockHash(block);
+    if (hasError(hashObj)) {
+        error = hashObj;
+        return false;
+    }
+    const auto & blockObj = getBlock(getResult(hashObj).get_str());
+    if (hasError(blockObj)) {
+        error = blockObj;
+        return false;
+    }
+    const Value & time_val = find_value(getResult(blockObj).get_obj(), "time");
+    if (time_val.type() != int_type) {
+        error = blockObj;
+        return false;
+    }
+    time = time_val.get_int64();
+
+    // Blocks near the tip may still be reorganized away
+    if (block <= tip - BLOCK_TIME_SAMPLE_DEPTH) {
+        boost::mutex::scoped_lock l(blockTimesLock);
+        if (blockTimes.size() >= MAX_BLOCK_TIME_SAMPLES) {
+            blockTimes.clear();
+            blockHeights.clear();
+        }
+        blockTimes[block] = time;
+        blockHeights[time] = block;
+    }
+    return true;
+}
+
 std::string BtcWalletConnectorXRouter::convertTimeToBlockCount(const std::string & timestamp) const
 {
-//    const auto & blockCountObj = CallRPC(m_user, m_passwd, m_ip, m_port, "getblockcount", {});
-//    Value res = getResult(blockCountObj);
-//    int blockcount = res.get_int();
-//    if (blockcount <= 51)
-//        return "0";
-//
-//    // Estimate average block creation time from the last 10 blocks
-//    Array paramsGBH { blockcount };
-//    Object blockHashObj = CallRPC(m_user, m_passwd, m_ip, m_port, "getblockhash", paramsGBH);
-//    std::string hash = getResult(blockHashObj).get_str();
-//    Array paramsGB { hash };
-//    Object blockObj = CallRPC(m_user, m_passwd, m_ip, m_port, "getblock", paramsGB);
-//    Object block = getResult(blockObj).get_obj();
-//    int curblocktime = find_value(block, "time").get_int();
-//
-//    Array paramsGBH2 { blockcount-50 };
-//    blockHashObj = CallRPC(m_user, m_passwd, m_ip, m_port, "getblockhash", paramsGBH2);
-//    hash = getResult(blockHashObj).get_str();
-//    Array paramsGB2 { hash };
-//    blockObj = CallRPC(m_user, m_passwd, m_ip, m_port, "getblock", paramsGB2);
-//    block = getResult(blockObj).get_obj();
-//    int blocktime50ago = find_value(block, "time").get_int();
-//
-//    int averageBlockTime = (curblocktime - blocktime50ago) / 50;
-//
-//    int time = std::stoi(timestamp);
-//
-//    if (time >= curblocktime)
-//        return std::to_string(blockcount);
-//
-//    int blockEstimate = blockcount - (curblocktime - time) / averageBlockTime;
-//    if (blockEstimate <= 1)
-//        return "0";
-//
-//    Array paramsGBH3 { blockEstimate };
-//    blockHashObj = CallRPC(m_user, m_passwd, m_ip, m_port, "getblockhash", paramsGBH3);
-//    hash = getResult(blockHashObj).get_str();
-//    Array paramsGB3 { hash };
-//    blockObj = CallRPC(m_user, m_passwd, m_ip, m_port, "getblock", paramsGB3);
-//    block = getResult(blockObj).get_obj();
-//    int cur_estimate = find_value(block, "time").get_int();
-//
-//    int sign = 1;
-//    if (cur_estimate > time)
-//        sign = -1;
-//
-//    while (true) {
-//        blockEstimate += sign;
-//        Array paramsGBH { blockEstimate };
-//        Object blockHashObj = CallRPC(m_user, m_passwd, m_ip, m_port, "getblockhash", paramsGBH);
-//        std::string hash = getResult(blockHashObj).get_str();
-//        Array paramsGB { hash };
-//        Object blockObj = CallRPC(m_user, m_passwd, m_ip, m_port, "getblock", paramsGB);
-//        Object block = getResult(blockObj).get_obj();
-//        int new_estimate = find_value(block, "time").get_int();
-//        //std::cout << blockEstimate << " " << new_estimate << " " << cur_estimate << " " << (new_estimate - time) << " " << (cur_estimate - time) << " " << (cur_estimate - time) * (new_estimate - time) << std::endl << std::flush;
-//        int sign1 = (cur_estimate - time > 0) ? 1 : -1;
-//        if (sign1 * (new_estimate - time) < 0) {
-//            if (sign > 0)
-//                return std::to_string(blockEstimate - 1);
-//            else
-//                return std::to_string(blockEstimate);
-//        }
-//
-//        cur_estimate = new_estimate;
-//    }
-    
-    return "0"; // TODO Implement
+    int64_t target{0};
+    try {
+        target = std::stoll(timestamp);
+    } catch (...) {
+        throw XRouterError("Bad timestamp: " + timestamp, INVALID_PARAMETERS);
+    }
+
+    const auto & countObj = getBlockCount();
+    if (hasError(countObj))
+        return countObj;
+    const Value & count_val = getResult(countObj);
+    if (count_val.type() != int_type)
+        return countObj;
+    const int tip = count_val.get_int();
+
+    // Find the last block with time <= target by bisecting the height range.
+    // Cached samples narrow the range first, so repeated lookups over the
+    // same chain need only a few backend calls each.
+    int lo{0}, hi{tip};
+    int64_t time{0};
+    std::string error;
+    {
+        boost::mutex::scoped_lock l(blockTimesLock);
+        auto it = blockHeights.upper_bound(target);
+        if (it != blockHeights.end())
+            hi = std::min(hi, it->second);
+        if (it != blockHeights.begin())
+            lo = std::prev(it)->second;
+    }
+    // Block times are only roughly ordered, fall back to the whole chain
+    if (lo >= hi) {
+        lo = 0;
+        hi = tip;
+    }
+
+    if (!getBlockTime(hi, tip, time, error))
+        return error;
+    if (time <= target)
+        return std::to_string(hi);
+    if (!getBlockTime(lo, tip, time, error))
+        return error;
+    if (time > target)
+        return "0";
+
+    while (hi - lo > 1) {
+        const int mid = lo + (hi - lo) / 2;
+        if (!getBlockTime(mid, tip, time, error))
+            return error;
+        if (time <= target)
+            lo = mid;
+        else
+            hi = mid;
+    }
+    return std::to_string(lo);
 }
 
 std::string BtcWalletConnectorXRouter::getBalance(const std::string & address) const
 {
-    return "0"; // TODO Implement
+    // Needs a daemon running with an address index (-addressindex)
+    static const std::string command("getaddressbalance");
+    return CallRPC(m_user, m_passwd, m_ip, m_port, command, { address });
 }
 
 } // namespace xrouter
@@ -11,10 +11,13 @@
 #include "main.h"
 #include "net.h"
 
+#include <map>
 #include <vector>
 #include <string>
 #include <cstdint>
 
+#include <boost/thread/mutex.hpp>
+
 namespace xrouter
 {
 
@@ -27,10 +30,35 @@ public:
     std::string              getTransaction(const std::string & hash) const override;
     std::vector<std::string> getTransactions(const std::vector<std::string> & txHashes) const override;
     std::vector<std::string> getTransactionsBloomFilter(const int & number, CDataStream & stream, const int & fetchlimit) const override;
+    std::vector<std::string> getBlockFilters(const std::vector<std::string> & blockHashes) const override;
     std::string              sendTransaction(const std::string & transaction) const override;
     std::string              decodeRawTransaction(const std::string & hex) const override;
     std::string              convertTimeToBlockCount(const std::string & timestamp) const override;
     std::string              getBalance(const std::string & address) const override;
+
+private:
+    /**
+     * @brief Looks up the time of a block, remembering it once the block
+     * is buried deep enough not to change
+     * @param block height of the block
+     * @param tip current chain height
+     * @param time block time
+     * @param error backend reply when the lookup failed
+     * @return true if the time was found
+     */
+    bool getBlockTime(const int & block, const int & tip, int64_t & time, std::string & error) const;
+
+private:
+    //! Depth below the tip from which block times are cached
+    static const int BLOCK_TIME_SAMPLE_DEPTH = 6;
+    //! Cache is dropped and refilled when it grows past this
+    static const size_t MAX_BLOCK_TIME_SAMPLES = 65536;
+
+    mutable boost::mutex blockTimesLock;
+    //! Sparse (height, time) samples from earlier time to height lookups
+    mutable std::map<int, int64_t> blockTimes;
+    //! The same samples keyed by time
+    mutable std::map<int64_t, int> blockHeights;
 };
 
 } // namespace xrouter
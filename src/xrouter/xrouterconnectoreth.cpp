@@ -205,6 +205,12 @@ std::vector<std::string> EthWalletConnectorXRouter::getTransactionsBloomFilter(c
     return std::vector<std::string>{write_string(Value(unsupported), pretty_print)};
 }
 
+std::vector<std::string> EthWalletConnectorXRouter::getBlockFilters(const std::vector<std::string> & blockHashes) const
+{
+    Object unsupported; unsupported.emplace_back("error", "Unsupported");
+    return std::vector<std::string>(blockHashes.size(), write_string(Value(unsupported), pretty_print));
+}
+
 std::string EthWalletConnectorXRouter::sendTransaction(const std::string & rawtx) const
 {
     static const std::string command("eth_sendRawTransaction");
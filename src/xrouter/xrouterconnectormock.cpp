@@ -0,0 +1,203 @@
+#include "xrouterconnectormock.h"
+#include "xroutererror.h"
+
+#include "hash.h"
+#include "random.h"
+#include "utilstrencodings.h"
+#include "utiltime.h"
+
+#include "json/json_spirit.h"
+#include "json/json_spirit_writer_template.h"
+
+#include <boost/chrono.hpp>
+#include <boost/thread.hpp>
+
+using namespace json_spirit;
+
+namespace xrouter
+{
+
+static std::string rpcResult(const Value & result)
+{
+    Object o;
+    o.emplace_back("result", result);
+    o.emplace_back("error", Value());
+    o.emplace_back("id", Value());
+    return write_string(Value(o), false);
+}
+
+static std::string rpcError(const std::string & message, const int & code)
+{
+    Object err;
+    err.emplace_back("code", code);
+    err.emplace_back("message", message);
+    Object o;
+    o.emplace_back("result", Value());
+    o.emplace_back("error", err);
+    o.emplace_back("id", Value());
+    return write_string(Value(o), false);
+}
+
+static uint256 hashOf(const std::string & s)
+{
+    return Hash(s.begin(), s.end());
+}
+
+void MockWalletConnectorXRouter::setSimulation(const int & latency, const int & jitter,
+                                               const double & errorRate, const int & startHeight)
+{
+    this->latency     = std::max(latency, 0);
+    this->jitter      = std::max(jitter, 0);
+    this->errorRate   = std::min(std::max(errorRate, 0.0), 1.0);
+    this->startHeight = std::max(startHeight, 0);
+}
+
+bool MockWalletConnectorXRouter::simulate() const
+{
+    int ms = latency + (jitter > 0 ? static_cast<int>(GetRand(jitter + 1)) : 0);
+    if (ms > 0)
+        boost::this_thread::sleep_for(boost::chrono::milliseconds(ms));
+    return errorRate > 0 && GetRand(1000000) < static_cast<uint64_t>(errorRate * 1000000);
+}
+
+int MockWalletConnectorXRouter::height() const
+{
+    const int64_t now = GetTime();
+    if (blockTime <= 0 || now <= MOCK_CHAIN_EPOCH)
+        return startHeight;
+    return startHeight + static_cast<int>((now - MOCK_CHAIN_EPOCH) / blockTime);
+}
+
+uint256 MockWalletConnectorXRouter::blockHash(const int & block) const
+{
+    return hashOf(currency + ":block:" + std::to_string(block));
+}
+
+std::string MockWalletConnectorXRouter::getBlockCount() const
+{
+    if (simulate())
+        return rpcError("Mock connector error", INTERNAL_SERVER_ERROR);
+    return rpcResult(height());
+}
+
+std::string MockWalletConnectorXRouter::getBlockHash(const int & block) const
+{
+    if (simulate())
+        return rpcError("Mock connector error", INTERNAL_SERVER_ERROR);
+    if (block < 0 || block > height())
+        return rpcError("Block height out of range", -8);
+    return rpcResult(blockHash(block).GetHex());
+}
+
+std::string MockWalletConnectorXRouter::getBlock(const std::string & hash) const
+{
+    if (simulate())
+        return rpcError("Mock connector error", INTERNAL_SERVER_ERROR);
+
+    Array txs;
+    for (int i = 0; i < 2; ++i)
+        txs.push_back(hashOf(hash + ":tx:" + std::to_string(i)).GetHex());
+
+    Object block;
+    block.emplace_back("hash", hash);
+    block.emplace_back("size", 250);
+    block.emplace_back("version", 3);
+    block.emplace_back("merkleroot", hashOf(hash + ":merkle").GetHex());
+    block.emplace_back("tx", txs);
+    return rpcResult(block);
+}
+
+std::vector<std::string> MockWalletConnectorXRouter::getBlocks(const std::vector<std::string> & blockHashes) const
+{
+    std::vector<std::string> list;
+    for (const auto & hash : blockHashes)
+        list.push_back(getBlock(hash));
+    return list;
+}
+
+std::string MockWalletConnectorXRouter::getTransaction(const std::string & hash) const
+{
+    if (simulate())
+        return rpcError("Mock connector error", INTERNAL_SERVER_ERROR);
+
+    Object tx;
+    tx.emplace_back("txid", hash);
+    tx.emplace_back("version", 1);
+    tx.emplace_back("locktime", 0);
+    tx.emplace_back("vin", Array());
+    tx.emplace_back("vout", Array());
+    return rpcResult(tx);
+}
+
+std::vector<std::string> MockWalletConnectorXRouter::getTransactions(const std::vector<std::string> & txHashes) const
+{
+    std::vector<std::string> list;
+    for (const auto & hash : txHashes)
+        list.push_back(getTransaction(hash));
+    return list;
+}
+
+std::vector<std::string> MockWalletConnectorXRouter::getTransactionsBloomFilter(const int &, CDataStream &, const int &) const
+{
+    simulate();
+    return {};
+}
+
+std::vector<std::string> MockWalletConnectorXRouter::getBlockFilters(const std::vector<std::string> & blockHashes) const
+{
+    std::vector<std::string> list;
+    for (const auto & hash : blockHashes) {
+        if (simulate()) {
+            list.push_back(rpcError("Mock connector error", INTERNAL_SERVER_ERROR));
+            continue;
+        }
+        Object filter;
+        filter.emplace_back("filter", hashOf(hash + ":filter").GetHex());
+        filter.emplace_back("header", hashOf(hash + ":filterheader").GetHex());
+        list.push_back(rpcResult(filter));
+    }
+    return list;
+}
+
+std::string MockWalletConnectorXRouter::sendTransaction(const std::string & transaction) const
+{
+    if (simulate())
+        return rpcError("Mock connector error", BAD_REQUEST);
+    if (!IsHex(transaction))
+        return rpcError("TX decode failed", BAD_REQUEST);
+    return rpcResult(hashOf(transaction).GetHex());
+}
+
+std::string MockWalletConnectorXRouter::decodeRawTransaction(const std::string & hex) const
+{
+    if (simulate())
+        return rpcError("Mock connector error", INTERNAL_SERVER_ERROR);
+    if (!IsHex(hex))
+        return rpcError("TX decode failed", -22);
+
+    Object tx;
+    tx.emplace_back("txid", hashOf(hex).GetHex());
+    tx.emplace_back("size", static_cast<int>(hex.size() / 2));
+    return rpcResult(tx);
+}
+
+std::string MockWalletConnectorXRouter::convertTimeToBlockCount(const std::string & timestamp) const
+{
+    if (simulate())
+        return rpcError("Mock connector error", INTERNAL_SERVER_ERROR);
+    if (blockTime <= 0)
+        return rpcResult(startHeight);
+
+    int64_t time = atoi64(timestamp);
+    int block = startHeight + static_cast<int>((std::max(time, MOCK_CHAIN_EPOCH) - MOCK_CHAIN_EPOCH) / blockTime);
+    return rpcResult(std::max(0, std::min(block, height())));
+}
+
+std::string MockWalletConnectorXRouter::getBalance(const std::string & address) const
+{
+    if (simulate())
+        return rpcError("Mock connector error", INTERNAL_SERVER_ERROR);
+    return rpcResult(0.0);
+}
+
+} // namespace xrouter
@@ -0,0 +1,77 @@
+//******************************************************************************
+//******************************************************************************
+
+#ifndef _XROUTER_CONNECTOR_MOCK_H_
+#define _XROUTER_CONNECTOR_MOCK_H_
+
+#include "xrouterconnector.h"
+
+#include "streams.h"
+#include "uint256.h"
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+namespace xrouter
+{
+
+/** Time at which every mock chain is at its MockHeight, 2018-01-01 00:00:00 UTC */
+static const int64_t MOCK_CHAIN_EPOCH = 1514764800;
+
+/**
+ * In-process wallet connector serving a synthetic chain, used to load test
+ * XRouter service nodes without coin daemons. Selected with
+ * CreateTxMethod=MOCK in the wallet's xbridge.conf section.
+ * The chain is at MockHeight at MOCK_CHAIN_EPOCH and grows by one block every
+ * BlockTime seconds since. Block and transaction hashes are derived from the
+ * currency and height, so every mock node of a currency agrees on the data
+ * (and on consensus) no matter when it was started.
+ * Each call sleeps MockLatency ms (plus up to MockJitter ms) and fails with
+ * probability MockErrorRate.
+ */
+class MockWalletConnectorXRouter : public WalletConnectorXRouter {
+public:
+    using WalletConnectorXRouter::operator=;
+
+    /**
+     * @brief set the simulated behaviour
+     * @param latency milliseconds every call takes
+     * @param jitter extra random milliseconds, up to this value
+     * @param errorRate probability [0..1] of a call returning an rpc error
+     * @param startHeight chain height at MOCK_CHAIN_EPOCH
+     */
+    void setSimulation(const int & latency, const int & jitter, const double & errorRate, const int & startHeight);
+
+    std::string              getBlockCount() const override;
+    std::string              getBlockHash(const int & block) const override;
+    std::string              getBlock(const std::string & hash) const override;
+    std::vector<std::string> getBlocks(const std::vector<std::string> & blockHashes) const override;
+    std::string              getTransaction(const std::string & hash) const override;
+    std::vector<std::string> getTransactions(const std::vector<std::string> & txHashes) const override;
+    std::vector<std::string> getTransactionsBloomFilter(const int & number, CDataStream & stream, const int & fetchlimit=0) const override;
+    std::vector<std::string> getBlockFilters(const std::vector<std::string> & blockHashes) const override;
+    std::string              sendTransaction(const std::string & transaction) const override;
+    std::string              decodeRawTransaction(const std::string & hex) const override;
+    std::string              convertTimeToBlockCount(const std::string & timestamp) const override;
+    std::string              getBalance(const std::string & address) const override;
+
+private:
+    /**
+     * @brief sleeps for the simulated latency
+     * @return true if this call should fail
+     */
+    bool simulate() const;
+    int height() const;
+    uint256 blockHash(const int & block) const;
+
+private:
+    int     latency{0};
+    int     jitter{0};
+    double  errorRate{0};
+    int     startHeight{1000};
+};
+
+} // namespace xrouter
+
+#endif
@@ -16,5 +16,7 @@
 #define XROUTER_DOMAIN_REGISTRATION_DEPOSIT 1.0
 #define XROUTER_DEFAULT_CONFIRMATIONS 1
 #define XROUTER_TIMER_SECONDS 15
+#define XROUTER_DEFAULT_WORKERS 4      // request handlers per wallet or plugin
+#define XROUTER_DEFAULT_QUEUELIMIT 50  // queued requests per service
 
 #endif // XROUTERDEF_H
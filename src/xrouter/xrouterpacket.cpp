@@ -8,6 +8,7 @@
 #include "random.h"
 #include "allocators.h"
 #include "crypto/sha256.h"
+#include "packetverifier.h"
 
 #include <iostream>
 
@@ -109,6 +110,13 @@ bool XRouterPacket::verify()
     // restore signature
     memcpy(signatureField(), signature, rawSignatureSize);
 
+    const uint256 cacheKey = CPacketSignatureCache::Key(hash, signature, rawSignatureSize,
+                                                        pubkeyField(), pubkeySize);
+    if (packetSignatureCache.Get(cacheKey))
+    {
+        return true;
+    }
+
     secp256k1_ecdsa_signature sig;
     if (secp256k1_ecdsa_signature_parse_compact(secpContext, &sig, signatureField()) == 0)
     {
@@ -146,6 +154,8 @@ bool XRouterPacket::verify()
         return false;
     }
 
+    packetSignatureCache.Set(cacheKey);
+
     // all correct
     return true;
 }
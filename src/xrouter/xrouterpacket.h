@@ -43,6 +43,7 @@ enum XRouterCommand
 
     xrGetTxBloomFilter               = 40,
     xrGenerateBloomFilter            = 41,
+    xrGetBlockFilters                = 42,
 
     xrGetBlocks                      = 50,
     xrGetTransactions                = 51,
@@ -70,6 +71,7 @@ inline const char* XRouterCommand_ToString(enum XRouterCommand c)
         case xrSendTransaction            : return "xrSendTransaction";
         case xrGetTxBloomFilter           : return "xrGetTxBloomFilter";
         case xrGenerateBloomFilter        : return "xrGenerateBloomFilter";
+        case xrGetBlockFilters            : return "xrGetBlockFilters";
         case xrGetBlocks                  : return "xrGetBlocks";
         case xrGetTransactions            : return "xrGetTransactions";
         case xrGetBlockAtTime             : return "xrGetBlockAtTime";
@@ -98,6 +100,7 @@ inline bool XRouterCommand_IsValid(const char* c)
            XRouterCommand_ToString(xrSendTransaction)            == c ||
            XRouterCommand_ToString(xrGetTxBloomFilter)           == c ||
            XRouterCommand_ToString(xrGenerateBloomFilter)        == c ||
+           XRouterCommand_ToString(xrGetBlockFilters)            == c ||
            XRouterCommand_ToString(xrGetBlocks)                  == c ||
            XRouterCommand_ToString(xrGetTransactions)            == c ||
            XRouterCommand_ToString(xrGetBlockAtTime)             == c ||
@@ -122,6 +125,7 @@ inline XRouterCommand XRouterCommand_FromString(const std::string & command)
     if (strcmp(XRouterCommand_ToString(xrSendTransaction)      , c) == 0) return xrSendTransaction;
     if (strcmp(XRouterCommand_ToString(xrGetTxBloomFilter)     , c) == 0) return xrGetTxBloomFilter;
     if (strcmp(XRouterCommand_ToString(xrGenerateBloomFilter)  , c) == 0) return xrGenerateBloomFilter;
+    if (strcmp(XRouterCommand_ToString(xrGetBlockFilters)      , c) == 0) return xrGetBlockFilters;
     if (strcmp(XRouterCommand_ToString(xrGetBlocks)            , c) == 0) return xrGetBlocks;
     if (strcmp(XRouterCommand_ToString(xrGetTransactions)      , c) == 0) return xrGetTransactions;
     if (strcmp(XRouterCommand_ToString(xrGetBlockAtTime)       , c) == 0) return xrGetBlockAtTime;
@@ -142,6 +146,7 @@ inline std::set<XRouterCommand> XRouterCommands()
     r.insert(xrSendTransaction);
 //    r.insert(xrGetTxBloomFilter);
 //    r.insert(xrGenerateBloomFilter);
+    r.insert(xrGetBlockFilters);
     r.insert(xrGetBlocks);
     r.insert(xrGetTransactions);
 //    r.insert(xrGetBlockAtTime);
@@ -12,6 +12,11 @@
 #include "activeservicenode.h"
 #include "rpcserver.h"
 #include "init.h"
+#include "base58.h"
+#include "chainparams.h"
+#include "main.h"
+#include "txdb.h"
+#include "script/standard.h"
 
 #include "json/json_spirit_reader_template.h"
 #include "json/json_spirit_writer_template.h"
@@ -52,6 +57,15 @@ bool XRouterServer::start()
 
 bool XRouterServer::stop()
 {
+    std::map<std::string, RequestQueuePtr> queues;
+    {
+        WaitableLock l(_lock);
+        started = false;
+        queues.swap(requestQueues);
+    }
+    for (auto & item : queues) // stop request handlers before releasing connectors
+        item.second->stop();
+
     WaitableLock l(_lock);
     connectors.clear();
     connectorLocks.clear();
@@ -83,8 +97,18 @@ bool XRouterServer::createConnectors() {
             wp.blockTime                   = s.get<int>(*i + ".BlockTime", 0);
             wp.requiredConfirmations       = s.get<int>(*i + ".Confirmations", 0);
 
-            if (wp.m_ip.empty() || wp.m_port.empty() ||
-                wp.m_user.empty() || wp.m_passwd.empty() ||
+            const bool mock = wp.method == "MOCK";
+
+            // the mock connector makes up its chain data, never serve it on a real network
+            if (mock && Params().NetworkID() != CBaseChainParams::REGTEST &&
+                        Params().NetworkID() != CBaseChainParams::UNITTEST)
+            {
+                ERR() << "Skipping currency " << wp.currency << ", CreateTxMethod=MOCK is only allowed on regtest";
+                continue;
+            }
+
+            if ((!mock && (wp.m_ip.empty() || wp.m_port.empty() ||
+                           wp.m_user.empty() || wp.m_passwd.empty())) ||
                 wp.COIN == 0 || wp.blockTime == 0)
             {
                 LOG() << "Skipping currency " << wp.method << " because of missing credentials, COIN or BlockTime parameters";
@@ -94,7 +118,17 @@ bool XRouterServer::createConnectors() {
             LOG() << "Adding connector to " << wp.currency;
 
             xrouter::WalletConnectorXRouterPtr conn;
-            if ((wp.method == "ETH") || (wp.method == "ETHER"))
+            if (mock)
+            {
+                auto mconn = std::make_shared<MockWalletConnectorXRouter>();
+                *mconn = wp;
+                mconn->setSimulation(s.get<int>(*i + ".MockLatency", 0),
+                                     s.get<int>(*i + ".MockJitter", 0),
+                                     s.get<double>(*i + ".MockErrorRate", 0),
+                                     s.get<int>(*i + ".MockHeight", 1000));
+                conn = mconn;
+            }
+            else if ((wp.method == "ETH") || (wp.method == "ETHER"))
             {
                 conn.reset(new EthWalletConnectorXRouter);
                 *conn = wp;
@@ -225,6 +259,7 @@ void XRouterServer::onMessageReceived(CNode* node, XRouterPacketPtr packet, CVal
             rpacket.append(reply);
             rpacket.sign(spubkey, sprivkey);
             node->PushXRouter(rpacket.body());
+            removeInFlightQuery(nodeAddr, uuid);
             return;
         }
 
@@ -252,174 +287,94 @@ void XRouterServer::onMessageReceived(CNode* node, XRouterPacketPtr packet, CVal
             throw XRouterError("Too many parameters from client, max is " +
                                std::to_string(fetchLimit) + ": " + fqService, xrouter::BAD_REQUEST);
 
-        auto handlePayment = [this](const bool & expectingPayment, const std::string & feeTransaction,
-                const std::string & fqService, CValidationState & state, const NodeAddr & nodeAddr)
-        {
-            if (!expectingPayment)
-                return;
-            try {
-                if (!processPayment(feeTransaction)) {
-                    const std::string err_msg = strprintf("Bad fee payment from client %s service %s", nodeAddr, fqService);
-                    state.DoS(50, error(err_msg.c_str()), REJECT_INVALID, "xrouter-error");
-                    throw XRouterError(err_msg, xrouter::INSUFFICIENT_FEE);
-                }
-                LOG() << "Received payment for service " << fqService << " from node " << nodeAddr << "\n" << feeTransaction;
-            } catch (XRouterError & e) {
-                state.DoS(1, error("XRouter: bad request"), REJECT_INVALID, "xrouter-error"); // prevent abuse
-                throw e;
-            } catch (std::exception & e) {
-                state.DoS(1, error("XRouter: server error"), REJECT_INVALID, "xrouter-error"); // prevent abuse
-                throw XRouterError(e.what(), xrouter::INTERNAL_SERVER_ERROR);
-            }
-        };
+        if (command == xrService && !app.xrSettings()->hasPlugin(service))
+            throw XRouterError("Service not supported: " + fqService, xrouter::BAD_REQUEST);
 
-        // Handle calls to XRouter plugins
-        if (command == xrService) {
-            if (!app.xrSettings()->hasPlugin(service))
-                throw XRouterError("Service not supported: " + fqService, xrouter::BAD_REQUEST);
-
-            // Check rate limit
-            XRouterPluginSettingsPtr psettings = app.xrSettings()->getPluginSettings(service);
-            auto rateLimit = app.xrSettings()->clientRequestLimit(command, service);
-            if (rateLimit >= 0 && rateLimitExceeded(nodeAddr, fqService, rateLimit)) {
-                std::string err_msg = "Rate limit exceeded: " + fqService;
-                state.DoS(20, error(err_msg.c_str()), REJECT_INVALID, "xrouter-error");
-            }
-            app.updateSentRequest(nodeAddr, fqService); // Record request time
+        // Rate limit check
+        int rateLimit = app.xrSettings()->clientRequestLimit(command, service);
+        if (rateLimit >= 0 && rateLimitExceeded(nodeAddr, fqService, rateLimit)) {
+            std::string err_msg = "Rate limit exceeded: " + fqService;
+            state.DoS(20, error(err_msg.c_str()), REJECT_INVALID, "xrouter-error");
+        }
+        app.updateSentRequest(nodeAddr, fqService); // Record request time
 
-            if (!app.xrSettings()->isAvailableCommand(command, service))
-                throw XRouterError("Unsupported command: " + fqService, xrouter::UNSUPPORTED_SERVICE);
+        if (!app.xrSettings()->isAvailableCommand(command, service))
+            throw XRouterError("Unsupported command: " + fqService, xrouter::UNSUPPORTED_SERVICE);
+
+        // Get parameters from packet
+        std::vector<std::string> params;
+        if (!processParameters(packet, paramsCount, params, offset)) {
+            state.DoS(1, error("XRouter: too many parameters in query"), REJECT_INVALID, "xrouter-error"); // prevent abuse
+            throw XRouterError("XRouter: too many parameters in call " + fqService + " query " + uuid +
+                               " from node " + nodeAddr, xrouter::BAD_REQUEST);
+        }
 
-            // Get parameters from packet
-            std::vector<std::string> params;
-            if (!processParameters(packet, paramsCount, params, offset)) {
-                state.DoS(1, error("XRouter: too many parameters in query"), REJECT_INVALID, "xrouter-error"); // prevent abuse
-                throw XRouterError("XRouter: too many parameters in call " + fqService + " query " + uuid +
-                                   " from node " + nodeAddr, xrouter::BAD_REQUEST);
-            }
+        const auto dfee = app.xrSettings()->commandFee(command, service);
+        const auto fee = to_amount(dfee); // convert to satoshi
+        const auto paymentAddress = app.xrSettings()->paymentAddress(command, service);
 
-            // Check payment
-            const auto dfee = app.xrSettings()->commandFee(command, service);
-            const auto fee = to_amount(dfee);
-            bool expectingPayment = fee > 0;
-            if (expectingPayment) {
-                if (!checkFeePayment(nodeAddr, app.xrSettings()->paymentAddress(command, service), feetx, fee)) {
-                    const std::string err_msg = strprintf("Bad fee payment from client %s service %s", nodeAddr, fqService);
-                    state.DoS(25, error(err_msg.c_str()), REJECT_INVALID, "xrouter-error");
-                    throw XRouterError(err_msg, xrouter::INSUFFICIENT_FEE);
+        // Payment checks and the backend call run on the service's worker pool, the message
+        // handler does not wait on them. The node is retained until the reply is sent.
+        {
+            LOCK(cs_vNodes);
+            node->AddRef();
+        }
+        auto work = [this,node,nodeAddr,command,service,fqService,uuid,params,feetx,dfee,fee,paymentAddress]() {
+            CValidationState wstate;
+            std::string wreply;
+            try {
+                // Check payment
+                bool expectingPayment = fee > 0;
+                if (expectingPayment) {
+                    if (!checkFeePayment(nodeAddr, paymentAddress, feetx, fee)) {
+                        const std::string err_msg = strprintf("Bad fee payment from client %s service %s", nodeAddr, fqService);
+                        wstate.DoS(25, error(err_msg.c_str()), REJECT_INVALID, "xrouter-error");
+                        throw XRouterError(err_msg, xrouter::INSUFFICIENT_FEE);
+                    }
+                    LOG() << "XRouter command: " << fqService << " expecting fee " << dfee << " for query " << uuid;
                 }
-                LOG() << "XRouter command: " << fqService << " expecting fee " << dfee << " for query " << uuid;
-            }
 
-            try {
-                reply = processServiceCall(service, params);
+                wreply = processCall(command, service, fqService, uuid, nodeAddr, params, wstate);
+                // Spend client payment
+                handlePayment(expectingPayment, feetx, fqService, wstate, nodeAddr);
             } catch (XRouterError & e) {
-                state.DoS(1, error("XRouter: bad request"), REJECT_INVALID, "xrouter-error"); // prevent abuse
-                throw e;
+                LOG() << e.msg;
+                Object error;
+                error.emplace_back("error", e.msg);
+                error.emplace_back("code", e.code);
+                wreply = json_spirit::write_string(Value(error), true);
             } catch (std::exception & e) {
-                ERR() << "Error: " << fqService << " : " << e.what();
-                state.DoS(1, error("XRouter: server error"), REJECT_INVALID, "xrouter-error"); // prevent abuse
-                throw XRouterError("Unknown server error in " + fqService, xrouter::INTERNAL_SERVER_ERROR);
-            }
-
-            // Spend client payment
-            handlePayment(expectingPayment, feetx, fqService, state, nodeAddr);
-
-        } else { // Handle default XRouter calls
-            const auto dfee = app.xrSettings()->commandFee(command, service);
-            const auto fee = to_amount(dfee); // convert to satoshi
-
-            // Rate limit check
-            int rateLimit = app.xrSettings()->clientRequestLimit(command, service);
-            if (rateLimit >= 0 && rateLimitExceeded(nodeAddr, fqService, rateLimit)) {
-                std::string err_msg = "Rate limit exceeded: " + fqService;
-                state.DoS(20, error(err_msg.c_str()), REJECT_INVALID, "xrouter-error");
-            }
-            app.updateSentRequest(nodeAddr, fqService); // Record request time
-
-            if (!app.xrSettings()->isAvailableCommand(command, service))
-                throw XRouterError("Unsupported command: " + fqService, xrouter::UNSUPPORTED_SERVICE);
-
-            std::vector<std::string> params;
-            if (!processParameters(packet, paramsCount, params, offset)) {
-                state.DoS(1, error("XRouter: too many parameters in query"), REJECT_INVALID, "xrouter-error"); // prevent abuse
-                throw XRouterError("XRouter: too many parameters in call " + fqService + " query " + uuid +
-                                   " from node " + nodeAddr, xrouter::BAD_REQUEST);
+                LOG() << "Exception: " << e.what();
+                Object error;
+                error.emplace_back("error", "Internal Server Error");
+                error.emplace_back("code", xrouter::INTERNAL_SERVER_ERROR);
+                wreply = json_spirit::write_string(Value(error), true);
             }
 
-            // Check payment
-            bool expectingPayment = fee > 0;
-            if (expectingPayment) {
-                if (!checkFeePayment(nodeAddr, app.xrSettings()->paymentAddress(command, service), feetx, fee)) {
-                    const std::string err_msg = strprintf("Bad fee payment from client %s service %s", nodeAddr, fqService);
-                    state.DoS(25, error(err_msg.c_str()), REJECT_INVALID, "xrouter-error");
-                    throw XRouterError(err_msg, xrouter::INSUFFICIENT_FEE);
-                }
-                LOG() << "XRouter command: " << fqService << " expecting fee " << dfee << " for query " << uuid;
-            }
+            sendPacketToClient(uuid, wreply, node);
+            removeInFlightQuery(nodeAddr, uuid);
+            App::instance().checkDoS(wstate, node);
+            LOCK(cs_vNodes);
+            node->Release();
+        };
+        auto cancel = [this,node,nodeAddr,uuid]() {
+            removeInFlightQuery(nodeAddr, uuid);
+            LOCK(cs_vNodes);
+            node->Release();
+        };
 
-            try {
-                switch (command) {
-                    case xrGetBlockCount:
-                        reply = parseResult(processGetBlockCount(service, params));
-                        break;
-                    case xrGetBlockHash:
-                        reply = parseResult(processGetBlockHash(service, params));
-                        break;
-                    case xrGetBlock:
-                        reply = parseResult(processGetBlock(service, params));
-                        break;
-                    case xrGetTransaction:
-                        reply = parseResult(processGetTransaction(service, params));
-                        break;
-                    case xrGetBlocks:
-                        reply = parseResult(processGetBlocks(service, params));
-                        break;
-                    case xrGetTransactions:
-                        reply = parseResult(processGetTransactions(service, params));
-                        break;
-                    case xrDecodeRawTransaction:
-                        reply = parseResult(processDecodeRawTransaction(service, params));
-                        break;
-                    case xrGetBalance:
-                        throw XRouterError("This call is not supported: " + fqService, xrouter::UNSUPPORTED_SERVICE);
-//                        reply = parseResult(processGetBalance(service, params));
-                        break;
-                    case xrGetTxBloomFilter:
-                        throw XRouterError("This call is not supported: " + fqService, xrouter::UNSUPPORTED_SERVICE);
-//                        reply = parseResult(processGetTxBloomFilter(service, params));
-                        break;
-                    case xrGenerateBloomFilter:
-                        throw XRouterError("This call is not supported: " + fqService, xrouter::UNSUPPORTED_SERVICE);
-//                        reply = parseResult(processGenerateBloomFilter(service, params));
-                        break;
-                    case xrGetBlockAtTime:
-                        throw XRouterError("This call is not supported: " + fqService, xrouter::UNSUPPORTED_SERVICE);
-//                        reply = parseResult(processConvertTimeToBlockCount(service, params));
-                        break;
-                    case xrGetReply:
-                        reply = parseResult(processFetchReply(uuid));
-                        break;
-                    case xrSendTransaction:
-                        reply = parseResult(processSendTransaction(service, params));
-                        break;
-                    default:
-                        throw XRouterError("Unknown command " + fqService, xrouter::UNSUPPORTED_SERVICE);
-                }
-            } catch (XRouterError & e) {
-                state.DoS(1, error("XRouter: bad request"), REJECT_INVALID, "xrouter-error"); // prevent abuse
-                ERR() << "Failed to process " << fqService << "from node " << nodeAddr << " msg: " << e.msg << " code: " << e.code;
-                throw e;
-            } catch (std::exception & e) {
-                state.DoS(1, error("XRouter: server error"), REJECT_INVALID, "xrouter-error"); // prevent abuse
-                ERR() << "Failed to process " << fqService << "from node " << nodeAddr << " " << e.what();
-                throw XRouterError("Internal Server Error: Bad connector for " + fqService, xrouter::BAD_CONNECTOR);
+        // all commands of a wallet share its pool, they serialize on its connector anyway
+        const auto queueKey = (command == xrService) ? fqService : walletCommandKey(service);
+        if (!queueRequest(queueKey, work, cancel)) {
+            {
+                LOCK(cs_vNodes);
+                node->Release();
             }
-
-            // Spend client payment
-            handlePayment(expectingPayment, feetx, fqService, state, nodeAddr);
+            throw XRouterError("Too many requests for " + fqService + ", try again later", xrouter::TOO_MANY_REQUESTS);
         }
 
+        return; // reply is sent by the worker
+
     } catch (XRouterError & e) {
         LOG() << e.msg;
         Object error;
@@ -435,6 +390,184 @@ void XRouterServer::onMessageReceived(CNode* node, XRouterPacketPtr packet, CVal
     }
 
     sendPacketToClient(uuid, reply, node);
+    removeInFlightQuery(nodeAddr, uuid);
+}
+
+std::string XRouterServer::processCall(const XRouterCommand & command, const std::string & service,
+                                       const std::string & fqService, const std::string & uuid, const NodeAddr & nodeAddr,
+                                       const std::vector<std::string> & params, CValidationState & state)
+{
+    // Handle calls to XRouter plugins
+    if (command == xrService) {
+        try {
+            return processServiceCall(service, params);
+        } catch (XRouterError & e) {
+            state.DoS(1, error("XRouter: bad request"), REJECT_INVALID, "xrouter-error"); // prevent abuse
+            throw e;
+        } catch (std::exception & e) {
+            ERR() << "Error: " << fqService << " : " << e.what();
+            state.DoS(1, error("XRouter: server error"), REJECT_INVALID, "xrouter-error"); // prevent abuse
+            throw XRouterError("Unknown server error in " + fqService, xrouter::INTERNAL_SERVER_ERROR);
+        }
+    }
+
+    // Handle default XRouter calls
+    try {
+        switch (command) {
+            case xrGetBlockCount:
+                return parseResult(processGetBlockCount(service, params));
+            case xrGetBlockHash:
+                return parseResult(processGetBlockHash(service, params));
+            case xrGetBlock:
+                return parseResult(processGetBlock(service, params));
+            case xrGetTransaction:
+                return parseResult(processGetTransaction(service, params));
+            case xrGetBlocks:
+                return parseResult(processGetBlocks(service, params));
+            case xrGetTransactions:
+                return parseResult(processGetTransactions(service, params));
+            case xrDecodeRawTransaction:
+                return parseResult(processDecodeRawTransaction(service, params));
+            case xrGetBalance:
+                return parseResult(processGetBalance(service, params));
+            case xrGetTxBloomFilter:
+                throw XRouterError("This call is not supported: " + fqService, xrouter::UNSUPPORTED_SERVICE);
+//                return parseResult(processGetTxBloomFilter(service, params));
+            case xrGenerateBloomFilter:
+                throw XRouterError("This call is not supported: " + fqService, xrouter::UNSUPPORTED_SERVICE);
+//                return parseResult(processGenerateBloomFilter(service, params));
+            case xrGetBlockFilters:
+                return parseResult(processGetBlockFilters(service, params));
+            case xrGetBlockAtTime:
+                return parseResult(processConvertTimeToBlockCount(service, params));
+            case xrGetReply:
+                return parseResult(processFetchReply(uuid));
+            case xrSendTransaction:
+                return parseResult(processSendTransaction(service, params));
+            default:
+                throw XRouterError("Unknown command " + fqService, xrouter::UNSUPPORTED_SERVICE);
+        }
+    } catch (XRouterError & e) {
+        state.DoS(1, error("XRouter: bad request"), REJECT_INVALID, "xrouter-error"); // prevent abuse
+        ERR() << "Failed to process " << fqService << "from node " << nodeAddr << " msg: " << e.msg << " code: " << e.code;
+        throw e;
+    } catch (std::exception & e) {
+        state.DoS(1, error("XRouter: server error"), REJECT_INVALID, "xrouter-error"); // prevent abuse
+        ERR() << "Failed to process " << fqService << "from node " << nodeAddr << " " << e.what();
+        throw XRouterError("Internal Server Error: Bad connector for " + fqService, xrouter::BAD_CONNECTOR);
+    }
+}
+
+void XRouterServer::handlePayment(const bool & expectingPayment, const std::string & feeTransaction,
+                                  const std::string & fqService, CValidationState & state, const NodeAddr & nodeAddr)
+{
+    if (!expectingPayment)
+        return;
+    try {
+        if (!processPayment(feeTransaction)) {
+            const std::string err_msg = strprintf("Bad fee payment from client %s service %s", nodeAddr, fqService);
+            state.DoS(50, error(err_msg.c_str()), REJECT_INVALID, "xrouter-error");
+            throw XRouterError(err_msg, xrouter::INSUFFICIENT_FEE);
+        }
+        LOG() << "Received payment for service " << fqService << " from node " << nodeAddr << "\n" << feeTransaction;
+    } catch (XRouterError & e) {
+        state.DoS(1, error("XRouter: bad request"), REJECT_INVALID, "xrouter-error"); // prevent abuse
+        throw e;
+    } catch (std::exception & e) {
+        state.DoS(1, error("XRouter: server error"), REJECT_INVALID, "xrouter-error"); // prevent abuse
+        throw XRouterError(e.what(), xrouter::INTERNAL_SERVER_ERROR);
+    }
+}
+
+bool XRouterServer::queueRequest(const std::string & queueKey, const std::function<void()> & work,
+                                 const std::function<void()> & cancel)
+{
+    RequestQueuePtr queue;
+    {
+        WaitableLock l(_lock);
+        if (!started)
+            return false;
+        if (!requestQueues.count(queueKey)) {
+            const int workers = std::max(static_cast<int>(GetArg("-xrouterworkers", XROUTER_DEFAULT_WORKERS)), 1);
+            const int limit = std::max(static_cast<int>(GetArg("-xrouterqueuelimit", XROUTER_DEFAULT_QUEUELIMIT)), 1);
+            requestQueues[queueKey] = std::make_shared<RequestQueue>(workers, limit);
+        }
+        queue = requestQueues[queueKey];
+    }
+    if (!queue->post(work, cancel)) {
+        WARN() << "Request queue for " << queueKey << " is full (" << queue->limit() << "), rejecting request";
+        return false;
+    }
+    return true;
+}
+
+std::map<std::string, std::pair<int, int> > XRouterServer::queueDepths()
+{
+    std::map<std::string, RequestQueuePtr> queues;
+    {
+        WaitableLock l(_lock);
+        queues = requestQueues;
+    }
+    std::map<std::string, std::pair<int, int> > result;
+    for (const auto & item : queues)
+        result[item.first] = std::make_pair(item.second->depth(), item.second->limit());
+    return result;
+}
+
+//*****************************************************************************
+//*****************************************************************************
+XRouterServer::RequestQueue::RequestQueue(const int & workers, const int & limit)
+    : iosWork(std::make_shared<boost::asio::io_service::work>(ios))
+    , maxPending(limit)
+{
+    for (int i = 0; i < workers; ++i) {
+        this->workers.create_thread([this]() {
+            RenameThread("blocknetdx-xrouter");
+            ios.run();
+        });
+    }
+}
+
+XRouterServer::RequestQueue::~RequestQueue()
+{
+    stop();
+}
+
+bool XRouterServer::RequestQueue::post(const std::function<void()> & work, const std::function<void()> & cancel)
+{
+    {
+        WaitableLock l(mu);
+        if (stopping || pending >= maxPending)
+            return false;
+        ++pending;
+    }
+    ios.post([this,work,cancel]() {
+        bool cancelled;
+        {
+            WaitableLock l(mu);
+            cancelled = stopping;
+        }
+        try {
+            if (cancelled)
+                cancel();
+            else
+                work();
+        } catch (...) { }
+        WaitableLock l(mu);
+        --pending;
+    });
+    return true;
+}
+
+void XRouterServer::RequestQueue::stop()
+{
+    {
+        WaitableLock l(mu);
+        stopping = true;
+    }
+    // Let the workers drain the queue, cancelling what has not started, and exit
+    iosWork.reset();
+    workers.join_all();
 }
 
 //*****************************************************************************
@@ -594,6 +727,25 @@ std::vector<std::string> XRouterServer::processGetTxBloomFilter(const std::strin
     throw XRouterError("Internal Server Error: No connector for " + currency, xrouter::BAD_CONNECTOR);
 }
 
+std::vector<std::string> XRouterServer::processGetBlockFilters(const std::string & currency, const std::vector<std::string> & params) {
+    if (params.empty())
+        throw XRouterError("Missing block hashes for " + currency, xrouter::BAD_REQUEST);
+
+    App & app = App::instance();
+    const auto & fetchlimit = app.xrSettings()->commandFetchLimit(xrGetBlockFilters, currency);
+    if (params.size() > fetchlimit)
+        throw XRouterError("Too many block filters requested for " + currency + " limit is " +
+                           std::to_string(fetchlimit) + " received " + std::to_string(params.size()), xrouter::BAD_REQUEST);
+
+    xrouter::WalletConnectorXRouterPtr conn = connectorByCurrency(currency);
+    if (conn && hasConnectorLock(currency)) {
+        boost::mutex::scoped_lock l(*getConnectorLock(currency));
+        return conn->getBlockFilters(params);
+    }
+
+    throw XRouterError("Internal Server Error: No connector for " + currency, xrouter::BAD_CONNECTOR);
+}
+
 std::string XRouterServer::processGenerateBloomFilter(const std::string & currency, const std::vector<std::string> & params) {
     CBloomFilter f(10 * static_cast<unsigned int>(params.size()), 0.1, 5, 0);
 
@@ -634,8 +786,24 @@ std::string XRouterServer::processGenerateBloomFilter(const std::string & curren
 }
 
 std::string XRouterServer::processConvertTimeToBlockCount(const std::string & currency, const std::vector<std::string> & params) {
+    if (params.empty())
+        throw XRouterError("Unix time not specified", xrouter::INVALID_PARAMETERS);
     const std::string timestamp(params[0]);
 
+    // Our own chain is answered from the block index
+    if (currency == "BLOCK") {
+        int64_t time{0};
+        try {
+            time = std::stoll(timestamp);
+        } catch (...) {
+            throw XRouterError("Bad timestamp: " + timestamp, xrouter::INVALID_PARAMETERS);
+        }
+        LOCK(cs_main);
+        const CBlockIndex * pindex = chainActive.FindEarliestAtLeast(time + 1);
+        const int height = pindex ? pindex->nHeight - 1 : chainActive.Height();
+        return std::to_string(std::max(height, 0));
+    }
+
     xrouter::WalletConnectorXRouterPtr conn = connectorByCurrency(currency);
     if (conn && hasConnectorLock(currency)) {
         boost::mutex::scoped_lock l(*getConnectorLock(currency));
@@ -646,7 +814,33 @@ std::string XRouterServer::processConvertTimeToBlockCount(const std::string & cu
 }
 
 std::string XRouterServer::processGetBalance(const std::string & currency, const std::vector<std::string> & params) {
-    throw XRouterError("Internal Server Error: Not implemented for " + currency, xrouter::BAD_CONNECTOR);
+    if (params.empty())
+        throw XRouterError("Address not specified", xrouter::INVALID_PARAMETERS);
+    const auto & address = params[0];
+
+    // Our own chain is answered from the local address index
+    if (currency == "BLOCK" && fAddressIndex) {
+        CBitcoinAddress addr(address);
+        uint160 hashBytes;
+        int type{0};
+        if (!addr.IsValid() || !GetAddressIndexKey(GetScriptForDestination(addr.Get()), hashBytes, type))
+            throw XRouterError("Invalid address: " + address, xrouter::INVALID_PARAMETERS);
+
+        CAddressBalance balance;
+        {
+            LOCK(cs_main);
+            pblocktree->ReadAddressBalance(type, hashBytes, balance);
+        }
+        return write_string(ValueFromAmount(balance.nBalance));
+    }
+
+    xrouter::WalletConnectorXRouterPtr conn = connectorByCurrency(currency);
+    if (conn && hasConnectorLock(currency)) {
+        boost::mutex::scoped_lock l(*getConnectorLock(currency));
+        return conn->getBalance(address);
+    }
+
+    throw XRouterError("Internal Server Error: No connector for " + currency, xrouter::BAD_CONNECTOR);
 }
 
 std::string XRouterServer::processServiceCall(const std::string & name, const std::vector<std::string> & params)
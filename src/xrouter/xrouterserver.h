@@ -6,6 +6,7 @@
 #include "xrouterconnector.h"
 #include "xrouterconnectorbtc.h"
 #include "xrouterconnectoreth.h"
+#include "xrouterconnectormock.h"
 #include "xrouterdef.h"
 #include "xrouterutils.h"
 
@@ -14,7 +15,10 @@
 #include <vector>
 #include <string>
 #include <chrono>
+#include <functional>
+#include <boost/asio.hpp>
 #include <boost/container/map.hpp>
+#include <boost/thread.hpp>
 
 namespace xrouter
 {
@@ -52,12 +56,21 @@ public:
     }
     
     /**
-     * @brief onMessageReceived  call when message from xrouter network received
+     * @brief onMessageReceived  call when message from xrouter network received. The packet is
+     * verified and rate limited on the calling thread, backend calls are queued on the service's
+     * worker pool and the reply is sent when the call completes.
      * @param node source CNode
      * @param message packet contents
      * @param state variable, used to ban misbehaving nodes
      */
     void onMessageReceived(CNode* node, XRouterPacketPtr packet, CValidationState & state);
+
+    /**
+     * Returns the number of queued and running requests for each wallet and plugin along
+     * with the queue limit.
+     * @return
+     */
+    std::map<std::string, std::pair<int, int> > queueDepths();
     
        /**
      * @brief process xrGetBlockCount call on service node side
@@ -123,6 +136,14 @@ public:
      */
     std::vector<std::string> processGetTxBloomFilter(const std::string & currency, const std::vector<std::string> & params);
 
+    /**
+     * @brief process xrGetBlockFilters call on service node side
+     * @param currency blockchain to query
+     * @param params list of block hashes
+     * @return
+     */
+    std::vector<std::string> processGetBlockFilters(const std::string & currency, const std::vector<std::string> & params);
+
     /**
      * @brief process xrGenerateBloomFilter call on service node side
      * @param currency blockchain to query
@@ -266,6 +287,79 @@ public:
     void runPerformanceTests();
 
 private:
+    /**
+     * Bounded pool of request handlers for a single service. Slow backends only occupy the
+     * workers of their own service and requests beyond the queue limit are rejected.
+     */
+    class RequestQueue {
+    public:
+        RequestQueue(const int & workers, const int & limit);
+        ~RequestQueue();
+        /**
+         * Queues the work. Returns false if the queue is full or stopped.
+         * @param work
+         * @param cancel run instead of work if the queue is stopped before the work started
+         * @return
+         */
+        bool post(const std::function<void()> & work, const std::function<void()> & cancel);
+        /**
+         * Number of queued and running requests.
+         * @return
+         */
+        int depth() {
+            WaitableLock l(mu);
+            return pending;
+        }
+        int limit() const { return maxPending; }
+        /**
+         * Stops the workers. Queued requests that have not started are cancelled, running
+         * requests are waited for.
+         */
+        void stop();
+    private:
+        boost::asio::io_service ios;
+        std::shared_ptr<boost::asio::io_service::work> iosWork;
+        boost::thread_group workers;
+        CWaitableCriticalSection mu;
+        int pending{0};
+        bool stopping{false};
+        const int maxPending;
+    };
+    typedef std::shared_ptr<RequestQueue> RequestQueuePtr;
+
+    /**
+     * Queues the work on the worker pool of the specified wallet or plugin.
+     * @param queueKey wallet key (xr::BLOCK) or fully qualified plugin name
+     * @param work
+     * @param cancel releases what work would have if the server stops before it runs
+     * @return false if the service queue is full
+     */
+    bool queueRequest(const std::string & queueKey, const std::function<void()> & work,
+                      const std::function<void()> & cancel);
+
+    /**
+     * Runs the backend call for the request.
+     * @param command
+     * @param service wallet or plugin name
+     * @param fqService fully qualified service name
+     * @param uuid query id
+     * @param nodeAddr client address
+     * @param params
+     * @param state
+     * @return reply
+     * @throws XRouterError
+     */
+    std::string processCall(const XRouterCommand & command, const std::string & service, const std::string & fqService,
+                            const std::string & uuid, const NodeAddr & nodeAddr, const std::vector<std::string> & params,
+                            CValidationState & state);
+
+    /**
+     * Spends the client payment if one is expected.
+     * @throws XRouterError
+     */
+    void handlePayment(const bool & expectingPayment, const std::string & feeTransaction,
+                       const std::string & fqService, CValidationState & state, const NodeAddr & nodeAddr);
+
     /**
      * @brief load the connector (class used to communicate with other chains)
      * @param conn
@@ -326,6 +420,7 @@ private:
     std::map<std::string, std::pair<std::string, CAmount> > hashedQueries;
     std::map<std::string, std::chrono::time_point<std::chrono::system_clock> > hashedQueriesDeadlines;
     std::map<NodeAddr, std::set<std::string> > inFlightQueries;
+    std::map<std::string, RequestQueuePtr> requestQueues;
 
     std::vector<unsigned char> spubkey;
     std::vector<unsigned char> sprivkey;
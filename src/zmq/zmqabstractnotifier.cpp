@@ -3,25 +3,56 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "zmqabstractnotifier.h"
+#include "main.h"
 #include "util.h"
+#include "version.h"
 
+CZMQPayload CZMQSerializedData::Get()
+{
+    if (fDone)
+        return payload;
+    fDone = true;
+
+    boost::shared_ptr<CDataStream> ss(new CDataStream(SER_NETWORK, PROTOCOL_VERSION));
+    if (ptx) {
+        *ss << *ptx;
+    } else if (pblock) {
+        *ss << *pblock;
+    } else {
+        LOCK(cs_main);
+        CBlock block;
+        if (!ReadBlockFromDisk(block, pindex)) {
+            zmqError("Can't read block from disk");
+            return payload;
+        }
+        *ss << block;
+    }
+
+    payload = ss;
+    return payload;
+}
 
 CZMQAbstractNotifier::~CZMQAbstractNotifier()
 {
     assert(!psocket);
 }
 
-bool CZMQAbstractNotifier::NotifyBlock(const CBlockIndex * /*CBlockIndex*/)
+bool CZMQAbstractNotifier::NotifyBlock(const CBlockIndex * /*CBlockIndex*/, CZMQSerializedData &/*block*/)
+{
+    return true;
+}
+
+bool CZMQAbstractNotifier::NotifyTransaction(const CTransaction &/*transaction*/, CZMQSerializedData &/*raw*/)
 {
     return true;
 }
 
-bool CZMQAbstractNotifier::NotifyTransaction(const CTransaction &/*transaction*/)
+bool CZMQAbstractNotifier::NotifyTransactionLock(const CTransaction &/*transaction*/, CZMQSerializedData &/*raw*/)
 {
     return true;
 }
 
-bool CZMQAbstractNotifier::NotifyTransactionLock(const CTransaction &/*transaction*/)
+bool CZMQAbstractNotifier::NotifyXBridgeOrder(const CZMQPayload &/*order*/)
 {
     return true;
 }
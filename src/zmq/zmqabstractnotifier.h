@@ -6,12 +6,40 @@
 #define BITCOIN_ZMQ_ZMQABSTRACTNOTIFIER_H
 
 #include "zmqconfig.h"
+#include "streams.h"
+
+#include <boost/shared_ptr.hpp>
 
 class CBlockIndex;
 class CZMQAbstractNotifier;
 
 typedef CZMQAbstractNotifier* (*CZMQNotifierFactory)();
 
+/** Serialized message payload, shared by reference count until ZMQ has sent it */
+typedef boost::shared_ptr<const CDataStream> CZMQPayload;
+
+/**
+ * Serialized form of the block or transaction being notified, produced on first use so
+ * every publisher of the event shares one copy. When the connected block was not passed
+ * along it is read from disk.
+ */
+class CZMQSerializedData
+{
+public:
+    explicit CZMQSerializedData(const CTransaction &tx) : ptx(&tx), pindex(NULL), pblock(NULL), fDone(false) { }
+    CZMQSerializedData(const CBlockIndex *pindexIn, const CBlock *pblockIn) : ptx(NULL), pindex(pindexIn), pblock(pblockIn), fDone(false) { }
+
+    /** Returns the serialized bytes, or an empty pointer if they could not be produced */
+    CZMQPayload Get();
+
+private:
+    const CTransaction *ptx;
+    const CBlockIndex *pindex;
+    const CBlock *pblock;
+    bool fDone;
+    CZMQPayload payload;
+};
+
 class CZMQAbstractNotifier
 {
 public:
@@ -32,9 +60,10 @@ public:
     virtual bool Initialize(void *pcontext) = 0;
     virtual void Shutdown() = 0;
 
-    virtual bool NotifyBlock(const CBlockIndex *pindex);
-    virtual bool NotifyTransaction(const CTransaction &transaction);
-    virtual bool NotifyTransactionLock(const CTransaction &transaction);
+    virtual bool NotifyBlock(const CBlockIndex *pindex, CZMQSerializedData &block);
+    virtual bool NotifyTransaction(const CTransaction &transaction, CZMQSerializedData &raw);
+    virtual bool NotifyTransactionLock(const CTransaction &transaction, CZMQSerializedData &raw);
+    virtual bool NotifyXBridgeOrder(const CZMQPayload &order);
 
 protected:
     void *psocket;
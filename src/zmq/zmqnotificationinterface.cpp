@@ -9,6 +9,12 @@
 #include "main.h"
 #include "streams.h"
 #include "util.h"
+#include "xbridge/xbridgeapp.h"
+#include "xbridge/xbridgetransactiondescr.h"
+#include "xbridge/xuiconnector.h"
+#include "xbridge/util/xutil.h"
+
+#include <boost/bind.hpp>
 
 void zmqError(const char *str)
 {
@@ -39,8 +45,10 @@ CZMQNotificationInterface* CZMQNotificationInterface::CreateWithArguments(const
     factories["pubhashtx"] = CZMQAbstractNotifier::Create<CZMQPublishHashTransactionNotifier>;
     factories["pubhashtxlock"] = CZMQAbstractNotifier::Create<CZMQPublishHashTransactionLockNotifier>;
     factories["pubrawblock"] = CZMQAbstractNotifier::Create<CZMQPublishRawBlockNotifier>;
+    factories["pubrawblockheader"] = CZMQAbstractNotifier::Create<CZMQPublishRawBlockHeaderNotifier>;
     factories["pubrawtx"] = CZMQAbstractNotifier::Create<CZMQPublishRawTransactionNotifier>;
     factories["pubrawtxlock"] = CZMQAbstractNotifier::Create<CZMQPublishRawTransactionLockNotifier>;
+    factories["pubrawxbridgeorder"] = CZMQAbstractNotifier::Create<CZMQPublishRawXBridgeOrderNotifier>;
 
     for (std::map<std::string, CZMQNotifierFactory>::const_iterator i=factories.begin(); i!=factories.end(); ++i)
     {
@@ -105,6 +113,9 @@ bool CZMQNotificationInterface::Initialize()
         return false;
     }
 
+    xuiConnector.NotifyXBridgeTransactionReceived.connect(boost::bind(&CZMQNotificationInterface::XBridgeOrderReceived, this, _1));
+    xuiConnector.NotifyXBridgeTransactionChanged.connect(boost::bind(&CZMQNotificationInterface::XBridgeOrderChanged, this, _1));
+
     return true;
 }
 
@@ -114,6 +125,10 @@ void CZMQNotificationInterface::Shutdown()
     LogPrint("zmq", "zmq: Shutdown notification interface\n");
     if (pcontext)
     {
+        xuiConnector.NotifyXBridgeTransactionReceived.disconnect(boost::bind(&CZMQNotificationInterface::XBridgeOrderReceived, this, _1));
+        xuiConnector.NotifyXBridgeTransactionChanged.disconnect(boost::bind(&CZMQNotificationInterface::XBridgeOrderChanged, this, _1));
+
+        boost::mutex::scoped_lock lock(cs);
         for (std::list<CZMQAbstractNotifier*>::iterator i=notifiers.begin(); i!=notifiers.end(); ++i)
         {
             CZMQAbstractNotifier *notifier = *i;
@@ -126,12 +141,14 @@ void CZMQNotificationInterface::Shutdown()
     }
 }
 
-void CZMQNotificationInterface::UpdatedBlockTip(const CBlockIndex *pindex)
+void CZMQNotificationInterface::UpdatedBlockTip(const CBlockIndex *pindex, const CBlock *pblock)
 {
+    boost::mutex::scoped_lock lock(cs);
+    CZMQSerializedData block(pindex, pblock);
     for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i!=notifiers.end(); )
     {
         CZMQAbstractNotifier *notifier = *i;
-        if (notifier->NotifyBlock(pindex))
+        if (notifier->NotifyBlock(pindex, block))
         {
             i++;
         }
@@ -145,10 +162,12 @@ void CZMQNotificationInterface::UpdatedBlockTip(const CBlockIndex *pindex)
 
 void CZMQNotificationInterface::SyncTransaction(const CTransaction &tx, const CBlock *pblock)
 {
+    boost::mutex::scoped_lock lock(cs);
+    CZMQSerializedData raw(tx);
     for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i!=notifiers.end(); )
     {
         CZMQAbstractNotifier *notifier = *i;
-        if (notifier->NotifyTransaction(tx))
+        if (notifier->NotifyTransaction(tx, raw))
         {
             i++;
         }
@@ -162,10 +181,12 @@ void CZMQNotificationInterface::SyncTransaction(const CTransaction &tx, const CB
 
 void CZMQNotificationInterface::NotifyTransactionLock(const CTransaction &tx)
 {
+    boost::mutex::scoped_lock lock(cs);
+    CZMQSerializedData raw(tx);
     for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i!=notifiers.end(); )
     {
         CZMQAbstractNotifier *notifier = *i;
-        if (notifier->NotifyTransactionLock(tx))
+        if (notifier->NotifyTransactionLock(tx, raw))
         {
             i++;
         }
@@ -176,3 +197,43 @@ void CZMQNotificationInterface::NotifyTransactionLock(const CTransaction &tx)
         }
     }
 }
+
+void CZMQNotificationInterface::XBridgeOrderReceived(const xbridge::TransactionDescrPtr &order)
+{
+    if (!order)
+        return;
+
+    // Same fields as dxGetOrder
+    json_spirit::Object o;
+    o.emplace_back("id",          order->id.GetHex());
+    o.emplace_back("maker",       order->fromCurrency);
+    o.emplace_back("maker_size",  util::xBridgeStringValueFromAmount(order->fromAmount));
+    o.emplace_back("taker",       order->toCurrency);
+    o.emplace_back("taker_size",  util::xBridgeStringValueFromAmount(order->toAmount));
+    o.emplace_back("updated_at",  util::iso8601(order->txtime));
+    o.emplace_back("created_at",  util::iso8601(order->created));
+    o.emplace_back("status",      order->strState());
+    const std::string json = json_spirit::write_string(json_spirit::Value(o), false);
+
+    boost::shared_ptr<CDataStream> payload(new CDataStream(json.data(), json.data() + json.size(), SER_NETWORK, PROTOCOL_VERSION));
+
+    boost::mutex::scoped_lock lock(cs);
+    for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i!=notifiers.end(); )
+    {
+        CZMQAbstractNotifier *notifier = *i;
+        if (notifier->NotifyXBridgeOrder(payload))
+        {
+            i++;
+        }
+        else
+        {
+            notifier->Shutdown();
+            i = notifiers.erase(i);
+        }
+    }
+}
+
+void CZMQNotificationInterface::XBridgeOrderChanged(const uint256 &id)
+{
+    XBridgeOrderReceived(xbridge::App::instance().transaction(id));
+}
@@ -9,8 +9,17 @@
 #include <string>
 #include <map>
 
+#include <boost/thread/mutex.hpp>
+
 class CBlockIndex;
 class CZMQAbstractNotifier;
+class uint256;
+
+namespace xbridge
+{
+struct TransactionDescr;
+typedef boost::shared_ptr<TransactionDescr> TransactionDescrPtr;
+}
 
 class CZMQNotificationInterface : public CValidationInterface
 {
@@ -25,14 +34,20 @@ protected:
 
     // CValidationInterface
     void SyncTransaction(const CTransaction &tx, const CBlock *pblock);
-    void UpdatedBlockTip(const CBlockIndex *pindex);
+    void UpdatedBlockTip(const CBlockIndex *pindex, const CBlock *pblock);
     void NotifyTransactionLock(const CTransaction &tx);
 
+    // XBridge order events
+    void XBridgeOrderReceived(const xbridge::TransactionDescrPtr &order);
+    void XBridgeOrderChanged(const uint256 &id);
+
 private:
     CZMQNotificationInterface();
 
     void *pcontext;
     std::list<CZMQAbstractNotifier*> notifiers;
+    // ZMQ sockets are not thread safe, validation and XBridge events arrive on different threads
+    boost::mutex cs;
 };
 
 #endif // BITCOIN_ZMQ_ZMQNOTIFICATIONINTERFACE_H